@@ -0,0 +1,214 @@
+/**
+ * @file LoopbackBench.cpp
+ * @brief Маршрутизация личных сообщений между многими клиентами без сокетов
+ *
+ * Запускает сервер в этом же процессе и подключает к нему N клиентов
+ * через LoopbackTransport (Server::attachConnection). Каждый клиент
+ * входит в систему, затем в каждом раунде все клиенты одновременно
+ * отправляют личное сообщение следующему по кругу, и бенчмарк дожидается
+ * доставки всех сообщений раунда. Сообщения проходят полный путь
+ * сервера - кадрирование, ограничения скорости, пул рабочих потоков,
+ * надежную доставку и сериализацию, - но не ядро, поэтому результат
+ * отражает только стоимость обработки и повторяется от запуска к запуску.
+ *
+ * Время сервера - SimulatedClock: раунд сдвигает его на фиксированный
+ * шаг, и решения ограничителей скорости не зависят от скорости машины.
+ *
+ * Использование: loopback_bench [--clients N] [--rounds R] [--step-ms S] [--port P]
+ */
+#include "common/FrameBuffer.h"
+#include "common/LoopbackTransport.h"
+#include "common/Logger.h"
+#include "common/Message.h"
+#include "common/SimulatedClock.h"
+#include "server/Server.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Клиент бенчмарка: конец loopback-соединения и разбор кадров
+ */
+class BenchClient {
+public:
+    explicit BenchClient(std::unique_ptr<LoopbackTransport> transport)
+        : m_transport(std::move(transport)), m_userId(-1), m_lastSeq(0) {
+    }
+
+    bool send(const std::string& frame) {
+        return m_transport->send(frame.data(), frame.size());
+    }
+
+    /**
+     * @brief Вход и ожидание LOGIN_OK
+     */
+    bool login(const std::string& username) {
+        if (!send(Message(Message::Type::LOGIN, username + ":benchmark", -1).serialize())) {
+            return false;
+        }
+        Message message;
+        while (nextMessage(message)) {
+            std::string_view content = message.getContent();
+            if (message.getType() == Message::Type::STATUS && content.compare(0, 9, "LOGIN_OK:") == 0) {
+                m_userId = std::atoi(std::string(content.substr(9)).c_str());
+                return true;
+            }
+            if (message.getType() == Message::Type::ERROR) {
+                std::fprintf(stderr, "Вход %s отклонен: %s\n", username.c_str(), std::string(content).c_str());
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Ожидание count текстовых сообщений
+     */
+    bool receiveTexts(size_t count) {
+        Message message;
+        while (count > 0 && nextMessage(message)) {
+            if (message.getType() == Message::Type::TEXT) {
+                m_lastSeq = message.getSeq();
+                --count;
+            } else if (message.getType() == Message::Type::ERROR) {
+                std::fprintf(stderr, "Сервер отклонил сообщение: %s\n", std::string(message.getContent()).c_str());
+                return false;
+            }
+        }
+        return count == 0;
+    }
+
+    int userId() const { return m_userId; }
+
+    /**
+     * @brief Последний принятый номер: уходит подтверждением в следующем кадре
+     */
+    uint64_t lastSeq() const { return m_lastSeq; }
+
+private:
+    bool nextMessage(Message& message) {
+        while (!m_frames.nextFrame(m_frame)) {
+            int received = m_transport->receive(m_buffer, sizeof(m_buffer));
+            if (received <= 0) {
+                return false;
+            }
+            m_frames.append(m_buffer, static_cast<size_t>(received));
+        }
+        return message.deserialize(m_frame);
+    }
+
+    std::unique_ptr<LoopbackTransport> m_transport;
+    FrameBuffer m_frames;
+    std::string m_frame;
+    int m_userId;
+    uint64_t m_lastSeq;
+    char m_buffer[16 * 1024];
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t clientCount = 256;
+    size_t rounds = 200;
+    int64_t stepMs = 20;
+    int port = 18081;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--clients") {
+            clientCount = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--rounds") {
+            rounds = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--step-ms") {
+            stepMs = std::atoll(argv[i + 1]);
+        } else if (option == "--port") {
+            port = std::atoi(argv[i + 1]);
+        }
+    }
+    if (clientCount < 2) {
+        std::fprintf(stderr, "Нужно не меньше двух клиентов\n");
+        return 1;
+    }
+
+    Logger::start("", Logger::Level::WARNING);
+    SimulatedClock::enable(Message::currentTimeNs());
+
+    // Ограничения скорости действуют как обычно, но по управляемому времени
+    Server server(port);
+    TimeoutSettings timeouts;
+    timeouts.loginTimeout = std::chrono::hours(1);
+    timeouts.idleTimeout = std::chrono::hours(1);
+    server.setTimeouts(timeouts);
+    if (!server.start()) {
+        std::fprintf(stderr, "Не удалось запустить сервер\n");
+        Logger::stop();
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<BenchClient>> clients;
+    int status = 0;
+    for (size_t i = 0; i < clientCount && status == 0; ++i) {
+        auto pair = LoopbackTransport::createPair();
+        if (server.attachConnection(std::move(pair.second)) == -1) {
+            std::fprintf(stderr, "Сервер не принял соединение %zu\n", i);
+            status = 1;
+            break;
+        }
+        clients.push_back(std::make_unique<BenchClient>(std::move(pair.first)));
+        // Входы идут по одному: все соединения приходят с одного адреса
+        if (!clients.back()->login("bench_" + std::to_string(i))) {
+            status = 1;
+        }
+    }
+
+    int64_t routeNs = 0;
+    size_t delivered = 0;
+    for (size_t round = 0; round < rounds && status == 0; ++round) {
+        SimulatedClock::advance(stepMs * 1000000LL);
+        int64_t start = nowNs();
+        for (size_t i = 0; i < clients.size() && status == 0; ++i) {
+            // Подтверждение принятых сообщений освобождает окно повтора сервера
+            Message text(Message::Type::TEXT, "round " + std::to_string(round), clients[i]->userId(),
+                         clients[(i + 1) % clients.size()]->userId());
+            text.setAck(clients[i]->lastSeq());
+            if (!clients[i]->send(text.serialize())) {
+                status = 1;
+            }
+        }
+        for (auto& client : clients) {
+            if (status == 0 && !client->receiveTexts(1)) {
+                std::fprintf(stderr, "Сообщение раунда %zu не доставлено\n", round);
+                status = 1;
+            }
+        }
+        routeNs += nowNs() - start;
+        delivered += status == 0 ? clients.size() : 0;
+    }
+
+    ServerStats stats = server.getStats();
+    if (status == 0) {
+        std::printf("клиентов %zu, раундов %zu, доставлено %zu\n", clients.size(), rounds, delivered);
+        std::printf("сообщ/с %.0f, мкс на раунд %.1f\n",
+                    static_cast<double>(delivered) * 1e9 / static_cast<double>(std::max<int64_t>(routeNs, 1)),
+                    static_cast<double>(routeNs) / 1000.0 / static_cast<double>(rounds));
+        std::printf("отказы по скорости %llu, сброшено при перегрузке %llu\n",
+                    static_cast<unsigned long long>(stats.rateLimitedMessages),
+                    static_cast<unsigned long long>(stats.shedMessages));
+    }
+
+    clients.clear();
+    server.stop();
+    SimulatedClock::disable();
+    Logger::stop();
+    return status;
+}
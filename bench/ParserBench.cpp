@@ -0,0 +1,300 @@
+/**
+ * @file ParserBench.cpp
+ * @brief Сравнение разборщиков текстового формата кадров
+ *
+ * Поток кадров TEXT с заданным размером содержимого подается порциями,
+ * как из recv (--chunk байтов), и разбирается до объектов сообщений:
+ *   - istringstream: прежний разбор через istringstream/getline в вектор
+ *     строк и std::stoi/stoll (воспроизведен здесь для сравнения);
+ *   - nextFrame: FrameBuffer::nextFrame с копией кадра и
+ *     Message::deserialize(std::string_view) с поиском разделителей;
+ *   - scan scalar/sse2/avx2: FrameScanner::scan с заданным набором
+ *     инструкций, пачками по FrameScanner::BATCH_SIZE кадров, и
+ *     Message::deserialize(const FrameScanner::Frame&);
+ *   - nextFrames: FrameBuffer::nextFrames, как в циклах приема сервера
+ *     и клиента (набор инструкций выбран при запуске).
+ * Для каждого способа выводится лучшее из --repeat повторений: время на
+ * кадр и скорость разбора.
+ *
+ * Использование: parser_bench [--payload 16,256,4096] [--bytes МБ]
+ *                             [--chunk байтов] [--repeat N]
+ */
+#include "common/FrameBuffer.h"
+#include "common/FrameScanner.h"
+#include "common/Message.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Результат прежнего разбора
+ */
+struct LegacyMessage {
+    Message::Type type = Message::Type::TEXT;
+    int senderId = 0;
+    int receiverId = 0;
+    int64_t timestampNs = 0;
+    int64_t serverReceiveNs = 0;
+    int64_t serverSendNs = 0;
+    uint64_t seq = 0;
+    uint64_t ack = 0;
+    std::string content;
+};
+
+std::string legacyUnescape(const std::string& content) {
+    std::string result;
+    result.reserve(content.size());
+    for (size_t i = 0; i < content.size(); ++i) {
+        if (content[i] == '\\' && i + 1 < content.size()) {
+            ++i;
+            result += content[i] == 'n' ? Message::FRAME_DELIMITER : content[i];
+        } else {
+            result += content[i];
+        }
+    }
+    return result;
+}
+
+// Разбор в том виде, в каком он был до перехода на std::string_view
+bool legacyDeserialize(const std::string& data, LegacyMessage& message) {
+    size_t length = data.size();
+    if (length > 0 && data[length - 1] == Message::FRAME_DELIMITER) {
+        --length;
+    }
+    std::istringstream iss(data.substr(0, length));
+    std::string token;
+    std::vector<std::string> tokens;
+    while (tokens.size() < FrameScanner::HEADER_FIELDS && std::getline(iss, token, '|')) {
+        tokens.push_back(token);
+    }
+    if (tokens.size() < FrameScanner::HEADER_FIELDS || iss.eof()) {
+        return false;
+    }
+    try {
+        message.type = Message::stringToType(tokens[0]);
+        message.senderId = std::stoi(tokens[1]);
+        message.receiverId = std::stoi(tokens[2]);
+        message.timestampNs = std::stoll(tokens[3]);
+        message.serverReceiveNs = std::stoll(tokens[4]);
+        message.serverSendNs = std::stoll(tokens[5]);
+        message.seq = std::stoull(tokens[6]);
+        message.ack = std::stoull(tokens[7]);
+        message.content = legacyUnescape(std::string(std::istreambuf_iterator<char>(iss), std::istreambuf_iterator<char>()));
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+/**
+ * @brief Сборка кадров из порций с заданным вариантом FrameScanner
+ *
+ * Повторяет FrameBuffer::nextFrames, но с выбором набора инструкций.
+ */
+class ScannerStream {
+public:
+    explicit ScannerStream(FrameScanner::Isa isa) : m_isa(isa), m_readPos(0) {}
+
+    void append(const char* data, size_t length) {
+        if (m_readPos > 0 && m_readPos >= m_buffer.size() / 2) {
+            m_buffer.erase(0, m_readPos);
+            m_readPos = 0;
+        }
+        m_buffer.append(data, length);
+    }
+
+    size_t nextFrames(FrameScanner::Frame* frames, size_t capacity) {
+        size_t consumed = 0;
+        size_t count = FrameScanner::scan(m_isa, std::string_view(m_buffer).substr(m_readPos), frames, capacity, consumed);
+        m_readPos += consumed;
+        return count;
+    }
+
+private:
+    FrameScanner::Isa m_isa;
+    std::string m_buffer;
+    size_t m_readPos;
+};
+
+/**
+ * @brief Поток кадров для разбора
+ */
+struct Stream {
+    std::string bytes;      ///< Кадры подряд
+    size_t frames = 0;      ///< Количество кадров
+};
+
+Stream buildStream(size_t payload, size_t totalBytes) {
+    // Содержимое с символами, требующими экранирования, и '|' внутри
+    std::string content;
+    const char pattern[] = "lorem ipsum|dolor sit amet, consectetur\nadipiscing elit ";
+    while (content.size() < payload) {
+        content.push_back(pattern[content.size() % (sizeof(pattern) - 1)]);
+    }
+
+    Stream stream;
+    std::string frame;
+    int64_t timestamp = Message::currentTimeNs();
+    while (stream.bytes.size() < totalBytes || stream.frames == 0) {
+        Message message(Message::Type::TEXT, content, static_cast<int>(stream.frames % 1000) + 1,
+                        static_cast<int>(stream.frames % 777) + 1);
+        message.setTimestampNs(timestamp + static_cast<int64_t>(stream.frames) * 1000);
+        message.setServerReceiveNs(timestamp + static_cast<int64_t>(stream.frames) * 1000 + 250);
+        message.setSeq(stream.frames + 1);
+        message.setAck(stream.frames / 2);
+        message.serializeTo(frame);
+        stream.bytes += frame;
+        ++stream.frames;
+    }
+    return stream;
+}
+
+/**
+ * @brief Прогон разбора всего потока порциями
+ * @return Количество разобранных кадров
+ */
+using Parser = std::function<size_t(const Stream&, size_t chunk)>;
+
+size_t parseLegacy(const Stream& stream, size_t chunk) {
+    FrameBuffer frames;
+    std::string frame;
+    size_t parsed = 0;
+    for (size_t offset = 0; offset < stream.bytes.size(); offset += chunk) {
+        frames.append(stream.bytes.data() + offset, std::min(chunk, stream.bytes.size() - offset));
+        while (frames.nextFrame(frame)) {
+            LegacyMessage message;
+            parsed += legacyDeserialize(frame, message) ? 1 : 0;
+        }
+    }
+    return parsed;
+}
+
+size_t parseNextFrame(const Stream& stream, size_t chunk) {
+    FrameBuffer frames;
+    std::string frame;
+    size_t parsed = 0;
+    for (size_t offset = 0; offset < stream.bytes.size(); offset += chunk) {
+        frames.append(stream.bytes.data() + offset, std::min(chunk, stream.bytes.size() - offset));
+        while (frames.nextFrame(frame)) {
+            Message message;
+            parsed += message.deserialize(frame) ? 1 : 0;
+        }
+    }
+    return parsed;
+}
+
+template <typename Buffer>
+size_t parseBatches(Buffer& frames, const Stream& stream, size_t chunk) {
+    FrameScanner::Frame batch[FrameScanner::BATCH_SIZE];
+    size_t parsed = 0;
+    for (size_t offset = 0; offset < stream.bytes.size(); offset += chunk) {
+        frames.append(stream.bytes.data() + offset, std::min(chunk, stream.bytes.size() - offset));
+        size_t count;
+        while ((count = frames.nextFrames(batch, FrameScanner::BATCH_SIZE)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                Message message;
+                parsed += message.deserialize(batch[i]) ? 1 : 0;
+            }
+        }
+    }
+    return parsed;
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        size_t size = 0;
+        if (std::from_chars(list.data() + start, list.data() + comma, size).ec == std::errc()) {
+            sizes.push_back(size);
+        }
+        start = comma + 1;
+    }
+    return sizes;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string payloadList = "16,256,4096";
+    size_t megabytes = 64;
+    size_t chunk = 16 * 1024;
+    size_t repeat = 5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--payload") {
+            payloadList = argv[i + 1];
+        } else if (option == "--bytes") {
+            megabytes = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--chunk") {
+            chunk = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--repeat") {
+            repeat = static_cast<size_t>(std::atol(argv[i + 1]));
+        }
+    }
+    std::vector<size_t> payloads = parseSizes(payloadList);
+    if (payloads.empty() || megabytes == 0 || chunk == 0 || repeat == 0) {
+        std::fprintf(stderr, "Размеры, объем, порция и число повторений должны быть положительными\n");
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, Parser>> parsers = {
+        {"istringstream", parseLegacy},
+        {"nextFrame", parseNextFrame},
+    };
+    for (FrameScanner::Isa isa : {FrameScanner::Isa::SCALAR, FrameScanner::Isa::SSE2, FrameScanner::Isa::AVX2}) {
+        if (!FrameScanner::supported(isa)) {
+            continue;
+        }
+        parsers.emplace_back(std::string("scan ") + FrameScanner::isaName(isa), [isa](const Stream& stream, size_t size) {
+            ScannerStream frames(isa);
+            return parseBatches(frames, stream, size);
+        });
+    }
+    parsers.emplace_back("nextFrames", [](const Stream& stream, size_t size) {
+        FrameBuffer frames;
+        return parseBatches(frames, stream, size);
+    });
+
+    std::printf("порция %zu байтов, FrameScanner: %s, лучшее из %zu повторений\n",
+                chunk, FrameScanner::isaName(FrameScanner::active()), repeat);
+    std::printf("%7s %-14s %10s %10s %10s\n", "payload", "parser", "ns/кадр", "МБ/с", "ускорение");
+    for (size_t payload : payloads) {
+        Stream stream = buildStream(payload, megabytes * 1024 * 1024);
+        double baselineNs = 0;
+        for (const auto& parser : parsers) {
+            double bestNs = 0;
+            for (size_t run = 0; run < repeat; ++run) {
+                auto start = std::chrono::steady_clock::now();
+                size_t parsed = parser.second(stream, chunk);
+                double elapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+                if (parsed != stream.frames) {
+                    std::fprintf(stderr, "%s: разобрано %zu кадров из %zu\n", parser.first.c_str(), parsed, stream.frames);
+                    return 1;
+                }
+                bestNs = run == 0 ? elapsedNs : std::min(bestNs, elapsedNs);
+            }
+            if (baselineNs == 0) {
+                baselineNs = bestNs;
+            }
+            std::printf("%7zu %-14s %10.1f %10.0f %9.2fx\n", payload, parser.first.c_str(),
+                        bestNs / static_cast<double>(stream.frames),
+                        static_cast<double>(stream.bytes.size()) / (bestNs / 1e9) / (1024.0 * 1024.0),
+                        baselineNs / bestNs);
+        }
+    }
+    return 0;
+}
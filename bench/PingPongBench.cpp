@@ -0,0 +1,544 @@
+/**
+ * @file PingPongBench.cpp
+ * @brief Задержка полного круга через Client и сервер при заданной частоте
+ *
+ * Клиенты (Client) входят в систему и отправляют личные сообщения самим
+ * себе: сервер маршрутизирует каждое обратно отправителю. Сообщения уходят
+ * по расписанию с фиксированной частотой, а не после ответа на предыдущее,
+ * поэтому задержка считается от запланированного момента отправки:
+ * если сервер или сам бенчмарк задержался, ожидание в очереди попадает
+ * в распределение (поправка на coordinated omission). Задержка от
+ * фактической отправки выводится рядом для сравнения.
+ *
+ * Сервер запускается в этом же процессе (без ограничений скорости) или
+ * отдельным процессом (--server путь к исполняемому файлу сервера); во
+ * втором случае действуют ограничения сервера по умолчанию -
+ * 100 сообщений/с на подключение и пользователя, и частоту следует
+ * делить между подключениями (--connections).
+ *
+ * Результаты для каждого размера содержимого выводятся таблицей и, с
+ * --json, в файл для scripts/compare_latency.py.
+ *
+ * Использование: pingpong [--rate R] [--duration S] [--warmup N]
+ *                         [--payload 16,256,4096] [--connections K]
+ *                         [--port P] [--server путь] [--json файл]
+ */
+#include "client/Client.h"
+#include "common/Logger.h"
+#include "common/Message.h"
+#include "server/Server.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Гистограмма задержек с логарифмически-линейными корзинами
+ *
+ * Значения до 128 нс хранятся точно, дальше каждая степень двойки
+ * делится на 64 корзины: относительная погрешность не больше 1/64.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : m_counts(bucketCount(), 0), m_total(0), m_sum(0), m_max(0) {}
+
+    void record(int64_t valueNs) {
+        uint64_t value = static_cast<uint64_t>(std::max<int64_t>(valueNs, 0));
+        ++m_counts[bucketIndex(value)];
+        ++m_total;
+        m_sum += value;
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    void reset() {
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+        m_total = 0;
+        m_sum = 0;
+        m_max = 0;
+    }
+
+    /**
+     * @brief Перцентиль: верхняя граница корзины, в которую он попал
+     */
+    uint64_t percentile(double percent) const {
+        if (m_total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * static_cast<double>(m_total) + 0.5);
+        rank = std::min(std::max<uint64_t>(rank, 1), m_total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    uint64_t count() const { return m_total; }
+    uint64_t max() const { return m_max; }
+    uint64_t mean() const { return m_total > 0 ? m_sum / m_total : 0; }
+
+private:
+    static constexpr unsigned EXACT_BITS = 7;
+    static constexpr uint64_t EXACT_LIMIT = 1ULL << EXACT_BITS;
+    static constexpr uint64_t SUB_BUCKETS = EXACT_LIMIT / 2;
+
+    static size_t bucketCount() {
+        return static_cast<size_t>(EXACT_LIMIT + (64 - EXACT_BITS) * SUB_BUCKETS);
+    }
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < EXACT_LIMIT) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = static_cast<unsigned>(63 - __builtin_clzll(value)) - (EXACT_BITS - 1);
+        return static_cast<size_t>(EXACT_LIMIT + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    static uint64_t bucketUpperBound(size_t index) {
+        if (index < EXACT_LIMIT) {
+            return index;
+        }
+        uint64_t shift = (index - EXACT_LIMIT) / SUB_BUCKETS + 1;
+        uint64_t sub = (index - EXACT_LIMIT) % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total;
+    uint64_t m_sum;
+    uint64_t m_max;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Моменты отправки одного прогона: запланированный и фактический
+ */
+struct Schedule {
+    explicit Schedule(size_t count) : intended(count), actual(count) {}
+
+    std::vector<int64_t> intended;              ///< Заполняется до начала прогона
+    std::vector<std::atomic<int64_t>> actual;   ///< Записывает поток отправки
+};
+
+/**
+ * @brief Подключение бенчмарка: Client, отправляющий сообщения себе
+ */
+class EchoConnection {
+public:
+    EchoConnection() : m_userId(-1), m_loginFailed(false), m_run(0), m_warmup(0), m_received(0) {
+        m_client.setMessageHandler([this](const Message& message) { onMessage(message); });
+    }
+
+    ~EchoConnection() {
+        m_client.disconnect();
+    }
+
+    /**
+     * @brief Подключение, вход и ожидание LOGIN_OK
+     */
+    bool open(int port, const std::string& username) {
+        if (!m_client.connect("127.0.0.1", port) || !m_client.login(username, "benchmark")) {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_loggedIn.wait_for(lock, std::chrono::seconds(10), [this] { return m_userId != -1 || m_loginFailed; });
+        return m_userId != -1;
+    }
+
+    /**
+     * @brief Начало прогона: сообщения прежних прогонов больше не учитываются
+     */
+    void startRun(int run, const Schedule* schedule, size_t warmup) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_run = run;
+        m_schedule = schedule;
+        m_warmup = warmup;
+        m_received = 0;
+        m_corrected.reset();
+        m_uncorrected.reset();
+    }
+
+    bool send(std::string_view content) {
+        return m_client.sendTextMessage(content, m_userId);
+    }
+
+    size_t received() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_received;
+    }
+
+    void collect(LatencyHistogram& corrected, LatencyHistogram& uncorrected) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        corrected.merge(m_corrected);
+        uncorrected.merge(m_uncorrected);
+    }
+
+private:
+    void onMessage(const Message& message) {
+        int64_t receivedNs = nowNs();
+        std::string_view content = message.getContent();
+        if (message.getType() == Message::Type::STATUS && content.compare(0, 9, "LOGIN_OK:") == 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::from_chars(content.data() + 9, content.data() + content.size(), m_userId);
+            m_loggedIn.notify_all();
+            return;
+        }
+        if (message.getType() == Message::Type::ERROR) {
+            std::fprintf(stderr, "Сервер вернул ошибку: %s\n", std::string(content).c_str());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_loginFailed = m_userId == -1;
+            m_loggedIn.notify_all();
+            return;
+        }
+        if (message.getType() != Message::Type::TEXT) {
+            return;
+        }
+
+        // Содержимое: "<прогон>:<номер>:" и заполнитель до нужного размера
+        int run = -1;
+        size_t index = 0;
+        const char* end = content.data() + content.size();
+        auto parsedRun = std::from_chars(content.data(), end, run);
+        if (parsedRun.ptr == end || *parsedRun.ptr != ':' ||
+            std::from_chars(parsedRun.ptr + 1, end, index).ec != std::errc()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (run != m_run || !m_schedule || index >= m_schedule->intended.size()) {
+            return;
+        }
+        ++m_received;
+        if (index >= m_warmup) {
+            m_corrected.record(receivedNs - m_schedule->intended[index]);
+            m_uncorrected.record(receivedNs - m_schedule->actual[index].load(std::memory_order_acquire));
+        }
+    }
+
+    Client m_client;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_loggedIn;
+    int m_userId;
+    bool m_loginFailed;
+    int m_run;
+    const Schedule* m_schedule = nullptr;
+    size_t m_warmup;
+    size_t m_received;
+    LatencyHistogram m_corrected;
+    LatencyHistogram m_uncorrected;
+};
+
+/**
+ * @brief Итог прогона для одного размера содержимого
+ */
+struct RunResult {
+    size_t payload = 0;
+    size_t sent = 0;
+    size_t received = 0;
+    double achievedRate = 0;
+    int64_t maxSendLagNs = 0;
+    LatencyHistogram corrected;
+    LatencyHistogram uncorrected;
+};
+
+const double PERCENTILES[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+const char* const PERCENTILE_KEYS[] = {"p50", "p90", "p99", "p999", "p9999"};
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        size_t size = 0;
+        if (std::from_chars(list.data() + start, list.data() + comma, size).ec == std::errc()) {
+            sizes.push_back(size);
+        }
+        start = comma + 1;
+    }
+    return sizes;
+}
+
+/**
+ * @brief Запуск сервера отдельным процессом
+ * @return PID процесса или -1
+ */
+pid_t spawnServer(const std::string& path, int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string portText = std::to_string(port);
+        execl(path.c_str(), path.c_str(), "--port", portText.c_str(), "--log-level", "WARNING",
+              static_cast<char*>(nullptr));
+        std::perror("execl");
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief Прогон: count сообщений по расписанию с частотой rate
+ */
+RunResult runPayload(std::vector<std::unique_ptr<EchoConnection>>& connections, int run, size_t payload,
+                     double rate, size_t warmup, size_t count) {
+    RunResult result;
+    result.payload = payload;
+    size_t total = warmup + count;
+    Schedule schedule(total);
+    int64_t intervalNs = static_cast<int64_t>(1e9 / rate);
+    int64_t startNs = nowNs() + 1000000;
+    for (size_t i = 0; i < total; ++i) {
+        schedule.intended[i] = startNs + static_cast<int64_t>(i) * intervalNs;
+    }
+    for (auto& connection : connections) {
+        connection->startRun(run, &schedule, warmup);
+    }
+
+    std::string content;
+    for (size_t i = 0; i < total; ++i) {
+        int64_t intended = schedule.intended[i];
+        // Отстающий бенчмарк не пропускает отправки: догоняет расписание,
+        // а ожидание попадает в исправленную задержку
+        int64_t waitNs = intended - nowNs();
+        if (waitNs > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+        }
+        content = std::to_string(run) + ":" + std::to_string(i) + ":";
+        if (content.size() < payload) {
+            content.append(payload - content.size(), 'x');
+        }
+        int64_t actual = nowNs();
+        schedule.actual[i].store(actual, std::memory_order_release);
+        result.maxSendLagNs = std::max(result.maxSendLagNs, actual - intended);
+        if (!connections[i % connections.size()]->send(content)) {
+            std::fprintf(stderr, "Не удалось отправить сообщение %zu\n", i);
+            break;
+        }
+        ++result.sent;
+    }
+    int64_t sendEndNs = nowNs();
+
+    // Ответы, не пришедшие за секунду после последней отправки, считаются потерянными
+    int64_t deadline = nowNs() + 1000000000LL;
+    while (true) {
+        result.received = 0;
+        for (auto& connection : connections) {
+            result.received += connection->received();
+        }
+        if (result.received >= result.sent || nowNs() > deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Дальнейшие ответы этого прогона отбрасываются до сбора результатов
+    for (auto& connection : connections) {
+        connection->collect(result.corrected, result.uncorrected);
+        connection->startRun(-1, nullptr, 0);
+    }
+    result.achievedRate = static_cast<double>(result.sent) * 1e9 /
+                          static_cast<double>(std::max<int64_t>(sendEndNs - startNs, 1));
+    return result;
+}
+
+void printResult(const RunResult& result) {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    std::printf("%7zu %8zu %8zu %9.0f", result.payload, result.sent, result.received, result.achievedRate);
+    for (double percent : PERCENTILES) {
+        std::printf(" %9.1f", us(result.corrected.percentile(percent)));
+    }
+    std::printf(" %9.1f | %9.1f %9.1f\n", us(result.corrected.max()),
+                us(result.uncorrected.percentile(50.0)), us(result.uncorrected.percentile(99.0)));
+}
+
+void writeHistogram(FILE* file, const char* name, const LatencyHistogram& histogram) {
+    std::fprintf(file, "      \"%s\": {", name);
+    for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); ++i) {
+        std::fprintf(file, "\"%s_ns\": %llu, ", PERCENTILE_KEYS[i],
+                     static_cast<unsigned long long>(histogram.percentile(PERCENTILES[i])));
+    }
+    std::fprintf(file, "\"max_ns\": %llu, \"mean_ns\": %llu, \"count\": %llu}",
+                 static_cast<unsigned long long>(histogram.max()),
+                 static_cast<unsigned long long>(histogram.mean()),
+                 static_cast<unsigned long long>(histogram.count()));
+}
+
+bool writeJson(const std::string& path, const std::vector<RunResult>& results, double rate,
+               size_t connections, bool subprocess) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::fprintf(file, "{\n  \"benchmark\": \"pingpong\",\n  \"server\": \"%s\",\n",
+                 subprocess ? "subprocess" : "in-process");
+    std::fprintf(file, "  \"rate\": %.1f,\n  \"connections\": %zu,\n  \"results\": [\n", rate, connections);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult& result = results[i];
+        std::fprintf(file, "    {\n      \"payload\": %zu,\n      \"sent\": %zu,\n      \"received\": %zu,\n",
+                     result.payload, result.sent, result.received);
+        std::fprintf(file, "      \"achieved_rate\": %.1f,\n      \"max_send_lag_ns\": %lld,\n",
+                     result.achievedRate, static_cast<long long>(result.maxSendLagNs));
+        writeHistogram(file, "corrected", result.corrected);
+        std::fprintf(file, ",\n");
+        writeHistogram(file, "uncorrected", result.uncorrected);
+        std::fprintf(file, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double rate = 1000.0;
+    double durationSeconds = 5.0;
+    size_t warmup = 200;
+    std::string payloadList = "16,256,4096";
+    size_t connectionCount = 1;
+    int port = 18082;
+    std::string serverPath;
+    std::string jsonPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--rate") {
+            rate = std::atof(argv[i + 1]);
+        } else if (option == "--duration") {
+            durationSeconds = std::atof(argv[i + 1]);
+        } else if (option == "--warmup") {
+            warmup = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--payload") {
+            payloadList = argv[i + 1];
+        } else if (option == "--connections") {
+            connectionCount = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--port") {
+            port = std::atoi(argv[i + 1]);
+        } else if (option == "--server") {
+            serverPath = argv[i + 1];
+        } else if (option == "--json") {
+            jsonPath = argv[i + 1];
+        }
+    }
+    std::vector<size_t> payloads = parseSizes(payloadList);
+    size_t count = static_cast<size_t>(rate * durationSeconds);
+    if (rate <= 0 || count == 0 || connectionCount == 0 || payloads.empty()) {
+        std::fprintf(stderr, "Частота, длительность, число подключений и размеры должны быть положительными\n");
+        return 1;
+    }
+    bool subprocess = !serverPath.empty();
+    if (subprocess && rate / static_cast<double>(connectionCount) > 100.0) {
+        std::fprintf(stderr, "Предупреждение: сервер ограничивает подключение 100 сообщениями/с, "
+                             "увеличьте --connections\n");
+    }
+
+    Logger::start("", Logger::Level::WARNING);
+
+    std::unique_ptr<Server> server;
+    pid_t serverPid = -1;
+    if (subprocess) {
+        serverPid = spawnServer(serverPath, port);
+    } else {
+        server = std::make_unique<Server>(port);
+        RateLimits unlimited{1e12, 1e12, 1e15, 1e15};
+        server->setConnectionRateLimits(unlimited);
+        server->setUserRateLimits(unlimited);
+        if (!server->start()) {
+            server.reset();
+        }
+    }
+    if (!server && serverPid <= 0) {
+        std::fprintf(stderr, "Не удалось запустить сервер\n");
+        Logger::stop();
+        return 1;
+    }
+
+    int status = 0;
+    std::vector<std::unique_ptr<EchoConnection>> connections;
+    for (size_t i = 0; i < connectionCount && status == 0; ++i) {
+        auto connection = std::make_unique<EchoConnection>();
+        // Сервер в отдельном процессе начинает слушать не сразу
+        bool opened = false;
+        for (int attempt = 0; attempt < 50 && !opened; ++attempt) {
+            opened = connection->open(port, "pingpong_" + std::to_string(i));
+            if (!opened) {
+                connection = std::make_unique<EchoConnection>();
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+        if (!opened) {
+            std::fprintf(stderr, "Подключение %zu не вошло в систему\n", i);
+            status = 1;
+        }
+        connections.push_back(std::move(connection));
+    }
+
+    std::vector<RunResult> results;
+    if (status == 0) {
+        std::printf("частота %.0f сообщ/с, подключений %zu, сервер %s, задержки в мкс от запланированной отправки (raw - от фактической)\n",
+                    rate, connectionCount, subprocess ? "в отдельном процессе" : "в процессе бенчмарка");
+        std::printf("%7s %8s %8s %9s %9s %9s %9s %9s %9s %9s | %9s %9s\n", "bytes", "sent", "recv",
+                    "msg/s", "p50", "p90", "p99", "p99.9", "p99.99", "max", "raw p50", "raw p99");
+        for (size_t i = 0; i < payloads.size(); ++i) {
+            results.push_back(runPayload(connections, static_cast<int>(i), payloads[i], rate, warmup, count));
+            printResult(results.back());
+            if (results.back().received < results.back().sent) {
+                status = 1;
+            }
+        }
+    }
+    if (!jsonPath.empty() && !results.empty() &&
+        !writeJson(jsonPath, results, rate, connectionCount, subprocess)) {
+        std::fprintf(stderr, "Не удалось записать %s\n", jsonPath.c_str());
+        status = 1;
+    }
+
+    if (server && status == 0) {
+        // Ожидание в исходящих очередях сервера по классам приоритета
+        ServerStats stats = server->getStats();
+        const char* const classes[] = {"control", "interactive", "bulk"};
+        for (size_t i = 0; i < OutboundQueue::PRIORITY_COUNT; ++i) {
+            const QueueLatency& latency = stats.outboundLatency[i];
+            std::printf("очередь %-11s сообщений %8llu, мкс: среднее %.1f, p99 %.1f, max %.1f\n", classes[i],
+                        static_cast<unsigned long long>(latency.messages), static_cast<double>(latency.meanNs) / 1000.0,
+                        static_cast<double>(latency.p99Ns) / 1000.0, static_cast<double>(latency.maxNs) / 1000.0);
+        }
+    }
+
+    connections.clear();
+    if (server) {
+        server->stop();
+    }
+    if (serverPid > 0) {
+        kill(serverPid, SIGTERM);
+        waitpid(serverPid, nullptr, 0);
+    }
+    Logger::stop();
+    return status;
+}
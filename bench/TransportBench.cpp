@@ -0,0 +1,255 @@
+/**
+ * @file TransportBench.cpp
+ * @brief Сравнение TCP через loopback, Unix-сокета и разделяемой памяти
+ *
+ * Запускает сервер в этом же процессе на TCP-порту и Unix-сокете и для
+ * каждого транспорта (разделяемая память подключается через тот же
+ * Unix-сокет) измеряет:
+ *   - задержку PING -> PONG (один запрос в полете, перцентили);
+ *   - пропускную способность (окно запросов в полете, сообщений в секунду).
+ * Запросы проходят полный путь сервера: кадрирование, ограничения,
+ * пул рабочих потоков и отправку ответа.
+ *
+ * Использование: transport_bench [--iterations N] [--window W] [--port P]
+ */
+#include "common/Endpoint.h"
+#include "common/FrameBuffer.h"
+#include "common/Logger.h"
+#include "common/Message.h"
+#include "common/ShmSegment.h"
+#include "server/Server.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Соединение бенчмарка с сервером
+ */
+class BenchConnection {
+public:
+    explicit BenchConnection(const Endpoint& endpoint) : m_socket(INVALID_SOCKET) {
+        sockaddr_storage address{};
+        socklen_t length = 0;
+        if (!endpoint.toSockaddr(address, length)) {
+            return;
+        }
+        m_socket = socket(endpoint.family(), SOCK_STREAM, 0);
+        if (m_socket != INVALID_SOCKET &&
+            connect(m_socket, reinterpret_cast<sockaddr*>(&address), length) == SOCKET_ERROR) {
+            close(m_socket);
+            m_socket = INVALID_SOCKET;
+        }
+        if (m_socket != INVALID_SOCKET && endpoint.scheme == Endpoint::Scheme::SHM && !attachSharedMemory()) {
+            close(m_socket);
+            m_socket = INVALID_SOCKET;
+        }
+    }
+
+    ~BenchConnection() {
+        if (m_socket != INVALID_SOCKET) {
+            close(m_socket);
+        }
+    }
+
+    bool isOpen() const { return m_socket != INVALID_SOCKET; }
+
+    bool sendFrames(const std::string& frames) {
+        if (m_shm) {
+            return m_shm->write(frames.data(), frames.size(), m_socket);
+        }
+        size_t sent = 0;
+        while (sent < frames.size()) {
+            ssize_t result = send(m_socket, frames.data() + sent, frames.size() - sent, 0);
+            if (result <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Ожидание count ответов PONG
+     */
+    bool receivePongs(size_t count) {
+        std::string frame;
+        while (count > 0) {
+            while (count > 0 && m_frames.nextFrame(frame)) {
+                if (frame.compare(0, 4, "PONG") == 0) {
+                    --count;
+                }
+            }
+            if (count == 0) {
+                break;
+            }
+            ssize_t received = m_shm ? receiveShared() : recv(m_socket, m_buffer, sizeof(m_buffer), 0);
+            if (received <= 0) {
+                return false;
+            }
+            m_frames.append(m_buffer, static_cast<size_t>(received));
+        }
+        return true;
+    }
+
+private:
+    /**
+     * @brief Передача сегмента серверу (как в Client::attachSharedMemory)
+     */
+    bool attachSharedMemory() {
+        auto segment = ShmSegment::create();
+        if (!segment || !segment->sendAttach(m_socket, Message(Message::Type::SHM_ATTACH, "", -1).serialize())) {
+            return false;
+        }
+        std::string frame;
+        while (!m_frames.nextFrame(frame)) {
+            ssize_t received = recv(m_socket, m_buffer, sizeof(m_buffer), 0);
+            if (received <= 0) {
+                return false;
+            }
+            m_frames.append(m_buffer, static_cast<size_t>(received));
+        }
+        if (frame.find("SHM_OK") == std::string::npos) {
+            return false;
+        }
+        m_shm = std::move(segment);
+        return true;
+    }
+
+    ssize_t receiveShared() {
+        pollfd socketFd{m_socket, POLLIN, 0};
+        if (m_shm->waitForData(&socketFd, 1, -1) != ShmSegment::WaitResult::DATA) {
+            return 0;
+        }
+        return m_shm->read(m_buffer, sizeof(m_buffer));
+    }
+
+    socket_t m_socket;
+    std::unique_ptr<ShmSegment> m_shm;
+    FrameBuffer m_frames;
+    char m_buffer[64 * 1024];
+};
+
+struct Result {
+    std::vector<int64_t> latencyNs;
+    double messagesPerSecond = 0;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool measure(const Endpoint& endpoint, size_t iterations, size_t window, Result& result) {
+    BenchConnection connection(endpoint);
+    if (!connection.isOpen()) {
+        std::fprintf(stderr, "Не удалось подключиться к %s\n", endpoint.toString().c_str());
+        return false;
+    }
+    const std::string ping = Message(Message::Type::PING, "", -1).serialize();
+
+    // Прогрев: пул потоков, буферы сокетов, кэши
+    for (size_t i = 0; i < 1000; ++i) {
+        if (!connection.sendFrames(ping) || !connection.receivePongs(1)) {
+            return false;
+        }
+    }
+
+    result.latencyNs.clear();
+    result.latencyNs.reserve(iterations);
+    for (size_t i = 0; i < iterations; ++i) {
+        int64_t start = nowNs();
+        if (!connection.sendFrames(ping) || !connection.receivePongs(1)) {
+            return false;
+        }
+        result.latencyNs.push_back(nowNs() - start);
+    }
+
+    // Пропускная способность: окно запросов в полете, ответы забираются пачками
+    std::string batch;
+    for (size_t i = 0; i < window; ++i) {
+        batch += ping;
+    }
+    size_t rounds = std::max<size_t>(1, iterations * 4 / window);
+    int64_t start = nowNs();
+    for (size_t i = 0; i < rounds; ++i) {
+        if (!connection.sendFrames(batch) || !connection.receivePongs(window)) {
+            return false;
+        }
+    }
+    result.messagesPerSecond = static_cast<double>(rounds * window) * 1e9 / static_cast<double>(nowNs() - start);
+    return true;
+}
+
+double percentileUs(std::vector<int64_t> values, double percentile) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+    return static_cast<double>(values[index]) / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 20000;
+    size_t window = 64;
+    int port = 18080;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--iterations") {
+            iterations = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--window") {
+            window = static_cast<size_t>(std::atol(argv[i + 1]));
+        } else if (option == "--port") {
+            port = std::atoi(argv[i + 1]);
+        }
+    }
+
+    Logger::start("", Logger::Level::WARNING);
+    std::string unixPath = "/tmp/transport-bench-" + std::to_string(getpid()) + ".sock";
+
+    // Ограничения скорости и сроки не должны влиять на измерение
+    Server server(port);
+    RateLimits unlimited{1e12, 1e12, 1e15, 1e15};
+    server.setConnectionRateLimits(unlimited);
+    server.setUserRateLimits(unlimited);
+    TimeoutSettings timeouts;
+    timeouts.loginTimeout = std::chrono::hours(1);
+    server.setTimeouts(timeouts);
+    server.addListenAddress("unix:" + unixPath);
+    if (!server.start()) {
+        std::fprintf(stderr, "Не удалось запустить сервер\n");
+        Logger::stop();
+        return 1;
+    }
+
+    // Заголовок выровнен вручную: printf считает байты, а не символы
+    std::printf("транспорт         p50 мкс    p99 мкс  p99.9 мкс    max мкс        сообщ/с\n");
+    const char* addresses[] = {"tcp:127.0.0.1:", "unix:", "shm:"};
+    int status = 0;
+    for (const char* prefix : addresses) {
+        std::string address = prefix + (prefix[0] == 't' ? std::to_string(port) : unixPath);
+        Endpoint endpoint;
+        Result result;
+        if (!Endpoint::parse(address, port, endpoint) || !measure(endpoint, iterations, window, result)) {
+            status = 1;
+            continue;
+        }
+        std::printf("%-14s %10.1f %10.1f %10.1f %10.1f %14.0f\n",
+                    endpoint.scheme == Endpoint::Scheme::TCP ? "tcp loopback" :
+                    endpoint.scheme == Endpoint::Scheme::UNIX ? "unix" : "shm",
+                    percentileUs(result.latencyNs, 50), percentileUs(result.latencyNs, 99),
+                    percentileUs(result.latencyNs, 99.9), percentileUs(result.latencyNs, 100),
+                    result.messagesPerSecond);
+    }
+
+    server.stop();
+    Logger::stop();
+    return status;
+}
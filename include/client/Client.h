@@ -2,12 +2,23 @@
 #define CLIENT_H
 
 #include <string>
+#include <string_view>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include "client/DeliveryQueue.h"
+#include "common/DeliveryReport.h"
+#include "common/PresenceUpdate.h"
 #include "common/User.h"
 #include "common/Message.h"
+#include "common/ReliableChannel.h"
+#include "common/ShmSegment.h"
+#include "common/SocketTransport.h"
+#include "common/Transport.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -18,7 +29,14 @@
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
+    #include <unistd.h>
     typedef int socket_t;
+    #ifndef INVALID_SOCKET
+        #define INVALID_SOCKET (-1)
+    #endif
+    #ifndef SOCKET_ERROR
+        #define SOCKET_ERROR (-1)
+    #endif
 #endif
 
 /**
@@ -26,6 +44,18 @@
  * 
  * Этот класс реализует клиентскую часть приложения,
  * обеспечивая подключение к серверу и обмен сообщениями.
+ *
+ * Служебные сообщения (вход, сессия, PING, подтверждения) обрабатываются
+ * в потоке приема. Обработчики приложения по умолчанию вызываются там
+ * же, по одному сообщению; в пакетном режиме (setBatchHandler) поток
+ * приема только кладет сообщения в DeliveryQueue, а обработчики
+ * вызывает отдельный поток доставки, и медленный обработчик не
+ * задерживает чтение сокета.
+ *
+ * Отправка тоже не ждет сети: кадр ставится в очередь, а пишет его в
+ * транспорт поток отправки. Вызывающий следит за объемом очереди
+ * (bytesQueued, isWritable) и обработчиком готовности к записи вместо
+ * того, чтобы блокироваться на заполненном буфере сокета.
  */
 class Client {
 public:
@@ -41,17 +71,59 @@ public:
 
     /**
      * @brief Подключение к серверу
+     *
+     * Адрес вида "unix:/путь" подключает через Unix-сокет (для клиентов
+     * на одном хосте с сервером), остальные - через TCP (см. Endpoint).
+     * Адрес "shm:/путь" подключает к тому же Unix-сокету и переводит
+     * соединение на кольца в разделяемой памяти (ShmSegment): кадры
+     * передаются без системных вызовов, пока обе стороны активны.
      * @param serverAddress Адрес сервера
-     * @param port Порт сервера
+     * @param port Порт сервера (для TCP-адреса без порта)
      * @return true если подключение успешно
      */
     bool connect(const std::string& serverAddress, int port = 8080);
 
+    /**
+     * @brief Подключение через готовый транспорт
+     *
+     * Например, через конец LoopbackTransport, другой конец которого
+     * передан Server::attachConnection: клиент и сервер работают в одном
+     * процессе без сокетов. reconnect() для такого подключения недоступен.
+     * @param transport Транспорт соединения со стороны клиента
+     * @return true если подключение установлено
+     */
+    bool connect(std::unique_ptr<Transport> transport);
+
     /**
      * @brief Отключение от сервера
      */
     void disconnect();
 
+    /**
+     * @brief Переподключение к тому же серверу с восстановлением сессии
+     *
+     * Если сервер выдал токен сессии, он отправляется сразу после
+     * подключения (RESUME): пользователь восстанавливается за один обмен
+     * без повторного входа. Если токен отклонен, приходит ошибка
+     * "RESUME_FAILED", токен сбрасывается и нужен обычный вход.
+     * После восстановления неподтвержденные сервером сообщения
+     * отправляются повторно, а повторы от сервера отбрасываются.
+     * @return true если подключение установлено
+     */
+    bool reconnect();
+
+    /**
+     * @brief Получение токена сессии, выданного сервером при входе
+     * @return Токен (пусто - вход не выполнен)
+     */
+    std::string getSessionToken() const;
+
+    /**
+     * @brief Установка токена сессии (например, сохраненного между запусками)
+     * @param token Токен
+     */
+    void setSessionToken(const std::string& token);
+
     /**
      * @brief Проверка статуса подключения
      * @return true если подключен
@@ -60,18 +132,42 @@ public:
 
     /**
      * @brief Отправка сообщения на сервер
+     *
+     * После входа текстовые сообщения и файлы получают номер и хранятся
+     * до подтверждения сервером. Если сервер не подтверждает прием и
+     * окно заполнено, сообщение не отправляется. Кадр ставится в
+     * очередь отправки целиком; вызов не ждет записи в сеть.
      * @param message Сообщение для отправки
-     * @return true если сообщение отправлено успешно
+     * @return true если сообщение принято к отправке
      */
     bool sendMessage(const Message& message);
 
+    /**
+     * @brief Отправка сообщения на сервер без копирования
+     * @param message Сообщение для отправки
+     * @return true если сообщение принято к отправке
+     */
+    bool sendMessage(Message&& message);
+
     /**
      * @brief Отправка текстового сообщения
      * @param content Содержимое сообщения
      * @param receiverId ID получателя (опционально)
      * @return true если сообщение отправлено успешно
      */
-    bool sendTextMessage(const std::string& content, int receiverId = -1);
+    bool sendTextMessage(std::string_view content, int receiverId = -1);
+
+    /**
+     * @brief Отправка текстового сообщения нескольким получателям одним кадром
+     *
+     * Сервер разбирает кадр один раз и ставит сообщение в очередь
+     * каждому получателю; получатели видят общий список.
+     * @param content Содержимое сообщения
+     * @param receiverIds ID получателей
+     * @param deliveryReport Запросить отчет о доставке (см. setDeliveryReportHandler)
+     * @return true если сообщение принято к отправке
+     */
+    bool sendTextMessage(std::string_view content, const std::vector<int>& receiverIds, bool deliveryReport = false);
 
     /**
      * @brief Вход в систему
@@ -108,12 +204,100 @@ public:
      */
     void setMessageHandler(std::function<void(const Message&)> handler);
 
+    /**
+     * @brief Включение пакетной доставки через поток доставки
+     *
+     * Обработчик получает сообщения пакетами до settings.maxBatch штук в
+     * порядке приема. Обработчики сообщений и задержек, если заданы,
+     * тоже вызываются из потока доставки - перед обработчиком пакета,
+     * для каждого сообщения. Пустой обработчик возвращает доставку в
+     * поток приема. Вызывать до connect().
+     * @param handler Функция-обработчик пакета
+     * @param settings Емкость очереди, размер пакета, отметки и поведение при переполнении
+     */
+    void setBatchHandler(std::function<void(MessageSpan)> handler,
+                         const DeliveryQueue::Settings& settings = DeliveryQueue::Settings());
+
+    /**
+     * @brief Установка обработчика отметок очереди доставки
+     *
+     * Вызывается с флагом true, когда очередь достигла верхней отметки,
+     * и с false, когда она опустилась до нижней. Вызывать до setBatchHandler().
+     * @param handler Функция-обработчик (глубина очереди, выше ли верхней отметки)
+     */
+    void setWatermarkHandler(std::function<void(size_t, bool)> handler);
+
+    /**
+     * @brief Количество сообщений, отброшенных очередью доставки
+     * @return Отброшено из-за переполнения (0 вне пакетного режима)
+     */
+    uint64_t getDroppedMessages() const;
+
+    /**
+     * @brief Байтов в очереди отправки, еще не записанных в транспорт
+     * @return Объем очереди, включая кадры, которые пишутся сейчас
+     */
+    size_t bytesQueued() const { return m_queuedBytes.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Можно ли отправлять без роста очереди сверх верхней отметки
+     * @return true если объем очереди ниже верхней отметки
+     */
+    bool isWritable() const { return bytesQueued() < m_sendHighWaterMark.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Установка верхней отметки очереди отправки
+     *
+     * Достигнув ее, очередь считается заполненной (isWritable() == false);
+     * обработчик готовности вызывается, когда объем опустится до половины.
+     * Очередь не ограничивает отправку: сообщения сверх отметки тоже
+     * принимаются, сдерживать поток - задача вызывающего.
+     * @param bytes Отметка, байтов
+     */
+    void setSendHighWaterMark(size_t bytes);
+
+    /**
+     * @brief Установка обработчика готовности к записи
+     *
+     * Вызывается из потока отправки, когда заполненная очередь опустилась
+     * до половины верхней отметки.
+     * @param handler Функция-обработчик
+     */
+    void setWritableHandler(std::function<void()> handler);
+
     /**
      * @brief Установка обработчика ошибок
      * @param handler Функция-обработчик
      */
     void setErrorHandler(std::function<void(const std::string&)> handler);
 
+    /**
+     * @brief Установка обработчика отчетов о доставке
+     *
+     * Вызывается из потока приема для каждого отчета, запрошенного
+     * при отправке нескольким получателям.
+     * @param handler Функция-обработчик
+     */
+    void setDeliveryReportHandler(std::function<void(const DeliveryReport&)> handler);
+
+    /**
+     * @brief Установка обработчика присутствия контактов
+     *
+     * После входа обработчик получает снимок всех контактов, затем -
+     * объединенные сервером изменения. Вызывается из потока приема.
+     * @param handler Функция-обработчик
+     */
+    void setPresenceHandler(std::function<void(const PresenceUpdate&)> handler);
+
+    /**
+     * @brief Установка обработчика задержек по участкам пути
+     *
+     * Вызывается для каждого принятого сообщения с задержками
+     * "отправитель -> сервер -> клиент", рассчитанными по временным меткам.
+     * @param handler Функция-обработчик
+     */
+    void setLatencyHandler(std::function<void(const Message&, const Message::HopLatency&)> handler);
+
     /**
      * @brief Получение ID клиента
      * @return ID клиента
@@ -128,10 +312,93 @@ private:
 
     /**
      * @brief Обработка входящего сообщения
+     *
+     * Обработчик выбирается по типу через MessageDispatcher.
      * @param message Сообщение
      */
     void processIncomingMessage(const Message& message);
 
+    /**
+     * @brief Передача принятого сообщения обработчикам приложения
+     *
+     * В пакетном режиме сообщение ставится в очередь доставки,
+     * иначе обработчики вызываются сразу.
+     * @param message Сообщение
+     * @param receivedNs Время приема, нс
+     */
+    void deliver(Message&& message, int64_t receivedNs);
+
+    /**
+     * @brief Цикл потока доставки: пакеты из очереди обработчикам приложения
+     */
+    void dispatchLoop();
+
+    /**
+     * @brief Остановка потока доставки после передачи оставшихся сообщений
+     */
+    void stopDispatcher();
+
+    /**
+     * @brief Обработка статуса от сервера: ID пользователя, токен сессии, восстановление
+     * @param message Сообщение STATUS
+     */
+    void handleStatus(const Message& message);
+
+    /**
+     * @brief Получение канала надежной доставки текущей сессии
+     * @return Канал (nullptr - вход не выполнен)
+     */
+    std::shared_ptr<ReliableChannel> getChannel() const;
+
+    /**
+     * @brief Установка канала надежной доставки
+     * @param channel Канал (nullptr - сессия завершена)
+     */
+    void setChannel(std::shared_ptr<ReliableChannel> channel);
+
+    /**
+     * @brief Передача серверу сегмента разделяемой памяти и ожидание ответа
+     * @param transport Подключенный Unix-сокет
+     * @return true если сервер перевел соединение на разделяемую память
+     */
+    bool attachSharedMemory(SocketTransport& transport);
+
+    /**
+     * @brief Постановка кадра в очередь отправки
+     *
+     * Вызывается под мьютексом отправки.
+     * @param frame Сериализованное сообщение
+     * @return true если кадр принят (соединение не потеряно)
+     */
+    bool enqueueFrame(const std::string& frame);
+
+    /**
+     * @brief Цикл потока отправки: запись накопленных кадров в транспорт
+     *
+     * Забирает всю очередь разом и пишет ее частями до SEND_CHUNK_BYTES;
+     * Transport::send досылает короткие записи, а объем очереди
+     * уменьшается после каждой части.
+     */
+    void sendLoop();
+
+    /**
+     * @brief Учет записанных байтов и вызов обработчика готовности
+     * @param bytes Записано байтов
+     */
+    void releaseQueued(size_t bytes);
+
+    /**
+     * @brief Отправка отдельного подтверждения, если оно накопилось
+     */
+    void flushAck();
+
+    /**
+     * @brief Повтор неподтвержденных сообщений после восстановления сессии
+     * @param peerAck Подтверждение сервера из ответа RESUME_OK
+     * @param reset true если сервер потерял состояние сессии и нумерация начинается заново
+     */
+    void replayUnacknowledged(uint64_t peerAck, bool reset);
+
     /**
      * @brief Инициализация сетевой библиотеки
      * @return true если инициализация успешна
@@ -143,15 +410,36 @@ private:
      */
     void cleanupNetwork();
 
-    socket_t m_socket;                               ///< Сокет клиента
+    std::unique_ptr<Transport> m_transport;          ///< Транспорт соединения
     std::atomic<bool> m_connected;                   ///< Флаг подключения
     std::thread m_receiveThread;                     ///< Поток приема сообщений
     std::shared_ptr<User> m_currentUser;             ///< Текущий пользователь
     std::function<void(const Message&)> m_messageHandler; ///< Обработчик сообщений
     std::function<void(const std::string&)> m_errorHandler; ///< Обработчик ошибок
+    std::function<void(const DeliveryReport&)> m_deliveryReportHandler; ///< Обработчик отчетов о доставке
+    std::function<void(const PresenceUpdate&)> m_presenceHandler; ///< Обработчик присутствия контактов
+    std::function<void(const Message&, const Message::HopLatency&)> m_latencyHandler; ///< Обработчик задержек
+    std::function<void(MessageSpan)> m_batchHandler; ///< Обработчик пакетов (пакетный режим)
+    std::function<void(size_t, bool)> m_watermarkHandler; ///< Обработчик отметок очереди доставки
+    std::unique_ptr<DeliveryQueue> m_delivery;       ///< Очередь доставки (пакетный режим)
+    std::thread m_dispatchThread;                    ///< Поток доставки
     int m_clientId;                                  ///< ID клиента
     std::string m_serverAddress;                     ///< Адрес сервера
     int m_serverPort;                                ///< Порт сервера
+    mutable std::mutex m_sessionMutex;               ///< Мьютекс токена сессии и канала
+    std::string m_sessionToken;                      ///< Токен сессии
+    std::shared_ptr<ReliableChannel> m_channel;      ///< Номера и окно повтора сессии
+    std::mutex m_sendMutex;                          ///< Мьютекс записи в транспорт
+    std::string m_sendBuffer;                        ///< Буфер сериализации (под m_sendMutex)
+    std::string m_outbox;                            ///< Кадры, ожидающие потока отправки (под m_sendMutex)
+    std::condition_variable m_sendReady;             ///< В очереди появились кадры или соединение закрыто
+    std::condition_variable m_sendDrained;           ///< Очередь записана или запись не удалась
+    std::thread m_sendThread;                        ///< Поток отправки
+    bool m_sendFailed;                               ///< Запись не удалась, кадры отбрасываются (под m_sendMutex)
+    std::atomic<size_t> m_queuedBytes;               ///< Байтов в очереди отправки (изменяется под m_sendMutex)
+    std::atomic<size_t> m_sendHighWaterMark;         ///< Верхняя отметка очереди отправки (изменяется под m_sendMutex)
+    bool m_aboveHighWater;                           ///< Отметка достигнута, ждем опустошения до половины (под m_sendMutex)
+    std::function<void()> m_writableHandler;         ///< Обработчик готовности к записи
 };
 
 #endif // CLIENT_H
@@ -0,0 +1,157 @@
+#ifndef DELIVERYQUEUE_H
+#define DELIVERYQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "common/Message.h"
+
+/**
+ * @brief Непрерывный диапазон сообщений, переданный обработчику пакета
+ *
+ * Действителен только на время вызова обработчика.
+ */
+class MessageSpan {
+public:
+    MessageSpan(const Message* data, size_t size) : m_data(data), m_size(size) {}
+
+    const Message* begin() const { return m_data; }
+    const Message* end() const { return m_data + m_size; }
+    const Message& operator[](size_t index) const { return m_data[index]; }
+    const Message* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    const Message* m_data;  ///< Первое сообщение
+    size_t m_size;          ///< Количество сообщений
+};
+
+/**
+ * @brief Ограниченная очередь принятых сообщений между потоком приема
+ *        и потоком доставки клиента
+ *
+ * Поток приема разбирает кадры и кладет сообщения в кольцо
+ * фиксированной емкости, поток доставки забирает их пакетами. При
+ * заполненной очереди действует выбранная политика: ждать (поток приема
+ * перестает читать сокет, и сервер упирается в окно TCP) или отбросить
+ * новое либо самое старое сообщение. Достижение верхней отметки и
+ * возврат к нижней сообщаются обработчику отметок - один раз на каждое
+ * пересечение.
+ *
+ * Рассчитана на одного производителя и одного потребителя.
+ */
+class DeliveryQueue {
+public:
+    /**
+     * @brief Поведение при заполненной очереди
+     */
+    enum class Overflow {
+        BLOCK,          ///< Поток приема ждет места
+        DROP_NEWEST,    ///< Новое сообщение отбрасывается
+        DROP_OLDEST     ///< Отбрасывается самое старое сообщение в очереди
+    };
+
+    /**
+     * @brief Параметры очереди
+     */
+    struct Settings {
+        size_t capacity = 4096;         ///< Емкость, сообщений
+        size_t maxBatch = 256;          ///< Наибольший пакет для обработчика
+        size_t highWaterMark = 3072;    ///< Отметка, при достижении которой очередь считается переполняющейся
+        size_t lowWaterMark = 1024;     ///< Отметка, опустившись до которой очередь снова считается нормальной
+        Overflow overflow = Overflow::BLOCK; ///< Поведение при заполненной очереди
+    };
+
+    /**
+     * @brief Конструктор
+     * @param settings Параметры очереди
+     */
+    explicit DeliveryQueue(const Settings& settings);
+
+    DeliveryQueue(const DeliveryQueue&) = delete;
+    DeliveryQueue& operator=(const DeliveryQueue&) = delete;
+
+    /**
+     * @brief Установка обработчика отметок
+     *
+     * Вызывается без блокировки очереди: с флагом true - из потока приема
+     * при достижении верхней отметки, с false - из потока доставки, когда
+     * очередь опустилась до нижней. Вызывать до начала работы очереди.
+     * @param handler Функция-обработчик (глубина очереди, выше ли верхней отметки)
+     */
+    void setWatermarkHandler(std::function<void(size_t, bool)> handler);
+
+    /**
+     * @brief Постановка принятого сообщения
+     * @param message Сообщение
+     * @param receivedNs Время приема, нс
+     * @return false если сообщение отброшено или очередь закрыта
+     */
+    bool push(Message&& message, int64_t receivedNs);
+
+    /**
+     * @brief Извлечение пакета с ожиданием
+     *
+     * Ждет хотя бы одного сообщения; пакеты заменяют содержимое
+     * векторов, буферы которых переиспользуются между вызовами.
+     * @param messages Сообщения пакета
+     * @param receivedNs Время приема каждого сообщения
+     * @return false если очередь закрыта и пуста
+     */
+    bool popBatch(std::vector<Message>& messages, std::vector<int64_t>& receivedNs);
+
+    /**
+     * @brief Закрытие очереди
+     *
+     * Ожидающая постановка прекращается, оставшиеся сообщения
+     * еще можно извлечь.
+     */
+    void close();
+
+    /**
+     * @brief Прерывание ожидания места в очереди
+     *
+     * Нужно при отключении: поток приема, ждущий места при BLOCK, иначе
+     * не завершится, пока обработчик не разберет очередь. До resume()
+     * сообщения, не поместившиеся в очередь, отбрасываются.
+     */
+    void interrupt();
+
+    /**
+     * @brief Возобновление ожидания места после interrupt()
+     */
+    void resume();
+
+    /**
+     * @brief Количество сообщений в очереди
+     * @return Глубина очереди
+     */
+    size_t size() const;
+
+    /**
+     * @brief Количество отброшенных сообщений
+     * @return Сообщений, отброшенных из-за заполненной очереди
+     */
+    uint64_t dropped() const;
+
+private:
+    Settings m_settings;                        ///< Параметры очереди
+    mutable std::mutex m_mutex;                 ///< Мьютекс очереди
+    std::condition_variable m_notEmpty;         ///< Появилось сообщение или очередь закрыта
+    std::condition_variable m_notFull;          ///< Освободилось место или очередь закрыта
+    std::vector<Message> m_messages;            ///< Кольцо сообщений
+    std::vector<int64_t> m_receivedNs;          ///< Время приема (параллельно кольцу)
+    size_t m_head;                              ///< Первое сообщение
+    size_t m_count;                             ///< Количество сообщений
+    bool m_closed;                              ///< Очередь закрыта
+    bool m_interrupted;                         ///< Ожидание места прервано
+    bool m_aboveHighWater;                      ///< Верхняя отметка достигнута и еще не пройдена вниз
+    uint64_t m_dropped;                         ///< Отброшено сообщений
+    std::function<void(size_t, bool)> m_watermarkHandler; ///< Обработчик отметок
+};
+
+#endif // DELIVERYQUEUE_H
@@ -0,0 +1,65 @@
+#ifndef DELIVERYREPORT_H
+#define DELIVERYREPORT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Отчет о доставке сообщения нескольким получателям
+ *
+ * Сервер отправляет его в статусе "DELIVERY:<TIMESTAMP_NS>:12=QUEUED,15=STORED",
+ * если отправитель запросил отчет ("+" перед списком получателей).
+ * TIMESTAMP_NS - время создания исходного сообщения, по нему отправитель
+ * находит, к какому сообщению относится отчет.
+ *
+ * Отчет отправляется сразу после разбора сообщения по получателям, поэтому
+ * QUEUED значит только, что сообщение принято в исходящую очередь
+ * соединения получателя, а не записано в сокет и не подтверждено им:
+ * при разрыве соединения пронумерованное сообщение остается в окне
+ * повтора сессии и будет доставлено, только если получатель восстановит
+ * ее (RESUME).
+ */
+struct DeliveryReport {
+    /**
+     * @brief Состояние доставки одному получателю
+     */
+    enum class Status {
+        QUEUED,     ///< Принято в исходящую очередь соединения получателя (не записано)
+        STORED,     ///< Получатель не в сети, сообщение ждет его входа
+        FORWARDED,  ///< Передано узлу кластера, обслуживающему получателя
+        NOT_FOUND   ///< Получатель не существует
+    };
+
+    /**
+     * @brief Префикс содержимого статуса
+     */
+    static constexpr std::string_view PREFIX = "DELIVERY:";
+
+    int64_t messageTimestampNs = 0;                     ///< Время создания исходного сообщения
+    std::vector<std::pair<int, Status>> recipients;     ///< Получатели и состояние доставки
+
+    /**
+     * @brief Запись отчета в содержимое статуса
+     * @return Содержимое с префиксом PREFIX
+     */
+    std::string toContent() const;
+
+    /**
+     * @brief Разбор содержимого статуса
+     * @param content Содержимое
+     * @return false если это не отчет о доставке или он записан неверно
+     */
+    bool parse(std::string_view content);
+
+    /**
+     * @brief Имя состояния в отчете
+     * @param status Состояние
+     * @return Имя
+     */
+    static std::string_view statusName(Status status);
+};
+
+#endif // DELIVERYREPORT_H
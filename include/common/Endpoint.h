@@ -0,0 +1,71 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+#include <string>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+#endif
+
+/**
+ * @brief Адрес подключения с выбором транспорта по схеме
+ *
+ * Поддерживаемые формы:
+ *   "unix:/путь"      - потоковый Unix-сокет (только POSIX);
+ *   "shm:/путь"       - разделяемая память; путь - Unix-сокет сервера,
+ *                       через который передается сегмент (только Linux);
+ *   "tcp:хост:порт"   - TCP;
+ *   "хост:порт", "хост" - TCP (порт по умолчанию).
+ * Хост TCP задается IPv4-адресом; пустой хост у слушающего сокета
+ * означает все интерфейсы. Кадры и семантика сообщений одинаковы для
+ * обоих транспортов.
+ */
+struct Endpoint {
+    /**
+     * @brief Транспорт
+     */
+    enum class Scheme {
+        TCP,    ///< TCP/IP
+        UNIX,   ///< Unix-сокет
+        SHM     ///< Разделяемая память с подключением через Unix-сокет
+    };
+
+    Scheme scheme = Scheme::TCP;    ///< Транспорт
+    std::string host;               ///< Хост (TCP)
+    int port = 0;                   ///< Порт (TCP)
+    std::string path;               ///< Путь к сокету (UNIX, SHM)
+
+    /**
+     * @brief Разбор адреса
+     * @param address Адрес
+     * @param defaultPort Порт, если в TCP-адресе он не указан
+     * @param endpoint Результат разбора
+     * @return true если адрес корректен
+     */
+    static bool parse(const std::string& address, int defaultPort, Endpoint& endpoint);
+
+    /**
+     * @brief Семейство адресов сокета
+     * @return AF_INET или AF_UNIX
+     */
+    int family() const;
+
+    /**
+     * @brief Заполнение адреса для connect/bind
+     * @param address Адрес сокета
+     * @param length Длина адреса
+     * @return false если адрес не представим на этой платформе
+     */
+    bool toSockaddr(sockaddr_storage& address, socklen_t& length) const;
+
+    /**
+     * @brief Текстовая форма адреса (обратная parse)
+     * @return Адрес
+     */
+    std::string toString() const;
+};
+
+#endif // ENDPOINT_H
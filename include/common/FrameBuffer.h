@@ -0,0 +1,84 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <string>
+#include <cstddef>
+#include "common/FrameScanner.h"
+
+/**
+ * @brief Буфер сборки кадров из потока байтов
+ *
+ * TCP не сохраняет границы сообщений: один recv может вернуть часть
+ * кадра или несколько кадров сразу. Буфер накапливает принятые байты
+ * и выдает кадры, завершенные разделителем Message::FRAME_DELIMITER.
+ */
+class FrameBuffer {
+public:
+    /**
+     * @brief Максимальный размер кадра по умолчанию
+     */
+    static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024;
+
+    /**
+     * @brief Конструктор
+     * @param maxFrameSize Максимальный размер одного кадра
+     */
+    explicit FrameBuffer(size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+
+    /**
+     * @brief Добавление принятых байтов
+     * @param data Данные
+     * @param length Длина данных
+     */
+    void append(const char* data, size_t length);
+
+    /**
+     * @brief Извлечение следующего полного кадра
+     * @param frame Кадр без разделителя
+     * @return true если кадр извлечен
+     */
+    bool nextFrame(std::string& frame);
+
+    /**
+     * @brief Извлечение нескольких полных кадров без копирования
+     *
+     * Кадры находятся за один проход FrameScanner и указывают прямо
+     * в буфер: они действительны до следующего append(), takePending()
+     * или clear().
+     * @param frames Массив для кадров
+     * @param capacity Размер массива
+     * @return Количество извлеченных кадров
+     */
+    size_t nextFrames(FrameScanner::Frame* frames, size_t capacity);
+
+    /**
+     * @brief Проверка превышения максимального размера кадра
+     * @return true если незавершенный кадр длиннее допустимого
+     */
+    bool overflowed() const { return pending() > m_maxFrameSize; }
+
+    /**
+     * @brief Количество байтов незавершенного кадра
+     * @return Количество байтов
+     */
+    size_t pending() const { return m_buffer.size() - m_readPos; }
+
+    /**
+     * @brief Извлечение байтов незавершенного кадра с очисткой буфера
+     * @return Байты, еще не выданные как кадры
+     */
+    std::string takePending();
+
+    /**
+     * @brief Очистка буфера
+     */
+    void clear();
+
+private:
+    std::string m_buffer;       ///< Накопленные байты
+    size_t m_readPos;           ///< Начало первого неизвлеченного кадра
+    size_t m_scanPos;           ///< Позиция, с которой продолжать поиск разделителя
+    size_t m_maxFrameSize;      ///< Максимальный размер кадра
+};
+
+#endif // FRAMEBUFFER_H
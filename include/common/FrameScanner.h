@@ -0,0 +1,97 @@
+#ifndef FRAMESCANNER_H
+#define FRAMESCANNER_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Пакетный разбор текстовых кадров в буфере приема
+ *
+ * За один проход по буферу находит границы кадров ('\n') и разделители
+ * полей заголовка ('|') сразу для нескольких кадров и возвращает их как
+ * представления строк без копирования. Буфер просматривается блоками:
+ * по 32 байта с AVX2, по 16 с SSE2; каждый блок сравнивается с обоими
+ * символами за две инструкции, а позиции найденных символов берутся из
+ * битовой маски. На процессорах без этих расширений работает побайтовый
+ * вариант. Набор инструкций выбирается один раз при запуске.
+ *
+ * Разделители внутри содержимого не учитываются: после восьмого '|'
+ * ищется только конец кадра.
+ */
+class FrameScanner {
+public:
+    /**
+     * @brief Количество полей заголовка (TYPE|SENDER|...|ACK)
+     */
+    static constexpr size_t HEADER_FIELDS = 8;
+
+    /**
+     * @brief Кадров за один вызов в циклах приема
+     */
+    static constexpr size_t BATCH_SIZE = 32;
+
+    /**
+     * @brief Вариант реализации
+     */
+    enum class Isa {
+        SCALAR,     ///< Побайтовый просмотр
+        SSE2,       ///< Блоки по 16 байтов
+        AVX2        ///< Блоки по 32 байта
+    };
+
+    /**
+     * @brief Найденный кадр
+     *
+     * Представления указывают в просмотренный буфер и действительны,
+     * пока он не изменен.
+     */
+    struct Frame {
+        std::string_view data;                      ///< Кадр без разделителя
+        std::string_view fields[HEADER_FIELDS];     ///< Поля заголовка
+        std::string_view content;                   ///< Содержимое (экранированное)
+        bool complete = false;                      ///< В заголовке все разделители
+    };
+
+    /**
+     * @brief Поиск полных кадров лучшим доступным набором инструкций
+     * @param data Буфер
+     * @param frames Массив для найденных кадров
+     * @param capacity Размер массива
+     * @param consumed Байтов занято найденными кадрами с их разделителями
+     * @return Количество найденных кадров
+     */
+    static size_t scan(std::string_view data, Frame* frames, size_t capacity, size_t& consumed);
+
+    /**
+     * @brief Поиск полных кадров заданным вариантом (для сравнения вариантов)
+     * @param isa Вариант (должен поддерживаться процессором)
+     * @param data Буфер
+     * @param frames Массив для найденных кадров
+     * @param capacity Размер массива
+     * @param consumed Байтов занято найденными кадрами с их разделителями
+     * @return Количество найденных кадров
+     */
+    static size_t scan(Isa isa, std::string_view data, Frame* frames, size_t capacity, size_t& consumed);
+
+    /**
+     * @brief Проверка поддержки варианта процессором и сборкой
+     * @param isa Вариант
+     * @return true если вариант доступен
+     */
+    static bool supported(Isa isa);
+
+    /**
+     * @brief Вариант, выбранный при запуске
+     * @return Лучший доступный вариант
+     */
+    static Isa active();
+
+    /**
+     * @brief Имя варианта
+     * @param isa Вариант
+     * @return "scalar", "sse2" или "avx2"
+     */
+    static const char* isaName(Isa isa);
+};
+
+#endif // FRAMESCANNER_H
@@ -0,0 +1,175 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <charconv>
+
+/**
+ * @brief Асинхронный журнал с уровнями
+ *
+ * Запись в журнал из рабочих потоков сводится к форматированию строки
+ * в буфер на стеке и копированию ее в кольцевой буфер текущего потока
+ * (один производитель, один потребитель, без блокировок). Фоновый поток
+ * забирает записи из буферов всех потоков и пишет их в файл пакетами,
+ * поэтому потоки не конкурируют за блокировку потока вывода и не
+ * сбрасывают буфер на каждую строку.
+ *
+ * Если фоновый поток не запущен (например, в интерактивном клиенте),
+ * записи выводятся синхронно в stdout/stderr, как раньше.
+ * При переполнении буфера потока запись отбрасывается и учитывается
+ * в droppedCount(): горячий путь никогда не блокируется на журнале.
+ */
+class Logger {
+public:
+    /**
+     * @brief Уровни важности записей
+     */
+    enum class Level {
+        DEBUG,      ///< Отладочная информация
+        INFO,       ///< Обычные события
+        WARNING,    ///< Предупреждения
+        ERROR       ///< Ошибки
+    };
+
+    /**
+     * @brief Максимальная длина текста одной записи (длиннее - обрезается)
+     */
+    static constexpr size_t RECORD_TEXT_SIZE = 232;
+
+    /**
+     * @brief Емкость кольцевого буфера одного потока (степень двойки)
+     */
+    static constexpr size_t RING_CAPACITY = 256;
+
+    /**
+     * @brief Запуск фонового потока записи
+     * @param path Путь к файлу журнала (пустая строка - stdout)
+     * @param minLevel Минимальный уровень записываемых сообщений
+     * @return true если журнал открыт успешно
+     */
+    static bool start(const std::string& path = "", Level minLevel = Level::INFO);
+
+    /**
+     * @brief Остановка фонового потока с записью оставшихся сообщений
+     *
+     * Не вызывается из обработчика сигнала: ждет завершения потока
+     * и берет мьютексы.
+     */
+    static void stop();
+
+    /**
+     * @brief Установка минимального уровня записываемых сообщений
+     * @param level Уровень
+     */
+    static void setLevel(Level level);
+
+    /**
+     * @brief Проверка, будет ли записано сообщение данного уровня
+     * @param level Уровень
+     * @return true если уровень не ниже минимального
+     */
+    static bool isEnabled(Level level);
+
+    /**
+     * @brief Количество записей, отброшенных из-за переполнения буферов
+     * @return Количество записей
+     */
+    static uint64_t droppedCount();
+
+    /**
+     * @brief Получение строкового представления уровня
+     * @param level Уровень
+     * @return Строковое представление
+     */
+    static std::string levelToString(Level level);
+
+    /**
+     * @brief Получение уровня из строки
+     * @param levelStr Строковое представление уровня
+     * @return Уровень (INFO по умолчанию)
+     */
+    static Level stringToLevel(const std::string& levelStr);
+
+    /**
+     * @brief Запись сообщения, составленного из нескольких частей
+     *
+     * Части форматируются без выделения памяти: строки копируются,
+     * целые числа преобразуются через std::to_chars.
+     * @param level Уровень
+     * @param args Части сообщения
+     */
+    template <typename... Args>
+    static void log(Level level, const Args&... args) {
+        LineBuilder line;
+        (line.append(args), ...);
+        write(level, line.data(), line.size());
+    }
+
+private:
+    /**
+     * @brief Строка фиксированной длины для форматирования записи
+     */
+    class LineBuilder {
+    public:
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+        void append(const char* text) { appendRaw(text, std::char_traits<char>::length(text)); }
+        void append(const std::string& text) { appendRaw(text.data(), text.size()); }
+        void append(std::string_view text) { appendRaw(text.data(), text.size()); }
+        void append(char c) { appendRaw(&c, 1); }
+        void append(bool value) { append(value ? "true" : "false"); }
+        void append(double value) {
+            char buffer[32];
+            int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+            appendRaw(buffer, length > 0 ? static_cast<size_t>(length) : 0);
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+        void append(T value) {
+            char buffer[24];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            appendRaw(buffer, static_cast<size_t>(result.ptr - buffer));
+        }
+
+    private:
+        void appendRaw(const char* text, size_t length) {
+            size_t available = RECORD_TEXT_SIZE - m_size;
+            if (length > available) {
+                length = available;
+            }
+            std::char_traits<char>::copy(m_data + m_size, text, length);
+            m_size += length;
+        }
+
+        char m_data[RECORD_TEXT_SIZE];
+        size_t m_size = 0;
+    };
+
+    /**
+     * @brief Передача готовой записи в буфер текущего потока
+     * @param level Уровень
+     * @param text Текст записи
+     * @param length Длина текста
+     */
+    static void write(Level level, const char* text, size_t length);
+};
+
+#define LOG_AT(level, ...) \
+    do { \
+        if (Logger::isEnabled(level)) { \
+            Logger::log(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(Logger::Level::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(Logger::Level::INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(Logger::Level::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(Logger::Level::ERROR, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -0,0 +1,103 @@
+#ifndef LOOPBACKTRANSPORT_H
+#define LOOPBACKTRANSPORT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "common/Transport.h"
+
+/**
+ * @brief Соединение внутри процесса через пару буферов в памяти
+ *
+ * Концы пары создаются вместе: байты, записанные одним, читает другой.
+ * Ни сокетов, ни системных вызовов, кроме синхронизации потоков, поэтому
+ * бенчмарк через loopback измеряет только разбор, маршрутизацию,
+ * очереди и сериализацию сервера, а тысячи соединений стоят столько,
+ * сколько их буферы. Каждое направление - кольцо фиксированной емкости:
+ * писатель ждет места, как при заполненном буфере сокета.
+ *
+ * Соединение нельзя передать другому процессу: release() закрывает его.
+ */
+class LoopbackTransport : public Transport {
+public:
+    /**
+     * @brief Емкость буфера одного направления по умолчанию
+     */
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    /**
+     * @brief Создание пары связанных концов
+     * @param capacity Емкость буфера каждого направления
+     * @return Концы соединения (например, клиент и сервер)
+     */
+    static std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+    createPair(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Деструктор (закрывает соединение для другого конца)
+     */
+    ~LoopbackTransport() override;
+
+    LoopbackTransport(const LoopbackTransport&) = delete;
+    LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+    int receive(char* buffer, size_t size) override;
+    bool send(const char* data, size_t size) override;
+    bool wait(int wakeFd, int timeoutMs) override;
+    void shutdown() override;
+    void close() override;
+    socket_t release() override;
+
+    /**
+     * @brief Количество байтов, готовых к чтению
+     * @return Количество байтов во входящем буфере
+     */
+    size_t available() const;
+
+private:
+    /**
+     * @brief Одно направление: кольцо байтов с ожиданием данных и места
+     */
+    struct Pipe {
+        explicit Pipe(size_t capacity) : data(capacity) {}
+
+        mutable std::mutex mutex;
+        std::condition_variable readable;   ///< Появились данные или соединение закрыто
+        std::condition_variable writable;   ///< Освободилось место или соединение закрыто
+        std::vector<char> data;             ///< Кольцо байтов
+        size_t head = 0;                    ///< Начало непрочитанных данных
+        size_t size = 0;                    ///< Количество непрочитанных байтов
+        bool closed = false;                ///< Соединение закрыто
+    };
+
+    /**
+     * @brief Общее состояние пары: по направлению на каждый конец
+     */
+    struct Shared {
+        explicit Shared(size_t capacity) : pipes{Pipe(capacity), Pipe(capacity)} {}
+
+        Pipe pipes[2];
+    };
+
+    /**
+     * @brief Конструктор
+     * @param shared Общее состояние пары
+     * @param side Номер конца (0 или 1): читает pipes[side], пишет в другой
+     */
+    LoopbackTransport(std::shared_ptr<Shared> shared, int side);
+
+    /**
+     * @brief Закрытие направления с пробуждением ожидающих
+     * @param pipe Направление
+     */
+    static void closePipe(Pipe& pipe);
+
+    std::shared_ptr<Shared> m_shared;   ///< Общее состояние пары
+    Pipe& m_incoming;                   ///< Направление, которое читает этот конец
+    Pipe& m_outgoing;                   ///< Направление, в которое пишет этот конец
+};
+
+#endif // LOOPBACKTRANSPORT_H
@@ -1,15 +1,24 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "common/FrameScanner.h"
+#include "common/Payload.h"
 
 /**
  * @brief Класс для представления сообщения в системе
  * 
  * Этот класс инкапсулирует сообщение между клиентом и сервером,
- * включая тип сообщения, содержимое и метаданные.
+ * включая тип сообщения, содержимое и метаданные. Содержимое до
+ * Payload::INLINE_CAPACITY байтов хранится внутри объекта: создание,
+ * копирование, сериализация в переиспользуемый буфер и разбор такого
+ * сообщения не выделяют память.
  */
 class Message {
 public:
@@ -22,7 +31,44 @@ public:
         TEXT,           ///< Текстовое сообщение
         FILE,           ///< Файловое сообщение
         STATUS,         ///< Статусное сообщение
-        ERROR           ///< Сообщение об ошибке
+        ERROR,          ///< Сообщение об ошибке
+        PING,           ///< Проверка живости соединения
+        PONG,           ///< Ответ на проверку живости
+        RESUME,         ///< Восстановление сессии по токену
+        ACK,            ///< Подтверждение без данных (см. ReliableChannel)
+        SHM_ATTACH      ///< Переход соединения на разделяемую память (см. ShmSegment)
+    };
+
+    /**
+     * @brief Количество типов сообщений
+     *
+     * Считается по последнему типу перечисления: новый тип добавляется
+     * в конец, а его имя - в MESSAGE_TYPE_NAMES.
+     */
+    static constexpr size_t TYPE_COUNT = static_cast<size_t>(Type::SHM_ATTACH) + 1;
+
+    /**
+     * @brief Наибольшая длина списка получателей в кадре
+     */
+    static constexpr size_t MAX_RECIPIENTS = 1024;
+
+    /**
+     * @brief Разделитель кадров в потоке (в содержимом экранируется)
+     */
+    static constexpr char FRAME_DELIMITER = '\n';
+
+    /**
+     * @brief Задержки на отдельных участках пути сообщения
+     *
+     * Значение -1 означает, что соответствующая временная метка отсутствует.
+     * Участки, вычисленные по часам разных хостов, точны настолько,
+     * насколько синхронизированы их часы.
+     */
+    struct HopLatency {
+        int64_t uplinkNs = -1;      ///< Отправитель -> прием сервером
+        int64_t serverNs = -1;      ///< Прием сервером -> отправка сервером
+        int64_t downlinkNs = -1;    ///< Отправка сервером -> прием получателем
+        int64_t totalNs = -1;       ///< Отправитель -> прием получателем
     };
 
     /**
@@ -33,42 +79,146 @@ public:
     /**
      * @brief Конструктор с параметрами
      * @param type Тип сообщения
-     * @param content Содержимое сообщения
+     * @param content Содержимое сообщения (строка, string_view или rvalue-строка,
+     *                длинная rvalue-строка забирается без копирования)
      * @param senderId ID отправителя
      * @param receiverId ID получателя
      */
-    Message(Type type, const std::string& content, int senderId, int receiverId = -1);
+    Message(Type type, Payload content, int senderId, int receiverId = -1);
 
     /**
      * @brief Деструктор
      */
     ~Message() = default;
 
+    Message(const Message&) = default;
+    Message& operator=(const Message&) = default;
+    Message(Message&&) noexcept = default;
+    Message& operator=(Message&&) noexcept = default;
+
     // Геттеры
     Type getType() const { return m_type; }
-    const std::string& getContent() const { return m_content; }
+    std::string_view getContent() const { return m_content.view(); }
     int getSenderId() const { return m_senderId; }
     int getReceiverId() const { return m_receiverId; }
-    const std::chrono::system_clock::time_point& getTimestamp() const { return m_timestamp; }
+    const std::vector<int>& getRecipients() const { return m_recipients; }
+    bool wantsDeliveryReport() const { return m_deliveryReport; }
+    std::chrono::system_clock::time_point getTimestamp() const;
+    int64_t getTimestampNs() const { return m_timestampNs; }
+    int64_t getServerReceiveNs() const { return m_serverReceiveNs; }
+    int64_t getServerSendNs() const { return m_serverSendNs; }
+    uint64_t getSeq() const { return m_seq; }
+    uint64_t getAck() const { return m_ack; }
 
     // Сеттеры
     void setType(Type type) { m_type = type; }
-    void setContent(const std::string& content) { m_content = content; }
+    void setContent(Payload content) { m_content = std::move(content); }
     void setSenderId(int senderId) { m_senderId = senderId; }
-    void setReceiverId(int receiverId) { m_receiverId = receiverId; }
+    void setReceiverId(int receiverId) { m_receiverId = receiverId; m_recipients.clear(); }
+    void setDeliveryReport(bool report) { m_deliveryReport = report; }
+    void setTimestampNs(int64_t timestampNs) { m_timestampNs = timestampNs; }
+    void setServerReceiveNs(int64_t receiveNs) { m_serverReceiveNs = receiveNs; }
+    void setServerSendNs(int64_t sendNs) { m_serverSendNs = sendNs; }
+    void setSeq(uint64_t seq) { m_seq = seq; }
+    void setAck(uint64_t ack) { m_ack = ack; }
+
+    /**
+     * @brief Установка нескольких получателей
+     *
+     * Кадр несет список "12,15,19" в поле получателя, а getReceiverId()
+     * возвращает первого из них. Пустой список возвращает сообщение к
+     * одному получателю.
+     * @param recipients ID получателей
+     */
+    void setRecipients(std::vector<int> recipients);
+
+    /**
+     * @brief Текущее время в наносекундах от эпохи Unix
+     *
+     * При включенных SimulatedClock возвращает их показание.
+     * @return Наносекунды UTC, без зависимости от часового пояса
+     */
+    static int64_t currentTimeNs();
 
     /**
-     * @brief Сериализация сообщения в строку
-     * @return Строковое представление сообщения
+     * @brief Расчет задержек по участкам пути
+     * @param receivedNs Время приема сообщения получателем (currentTimeNs())
+     * @return Задержки по участкам
+     */
+    HopLatency hopLatency(int64_t receivedNs) const;
+
+    /**
+     * @brief Сериализация сообщения в кадр для передачи
+     *
+     * Формат: TYPE|SENDER_ID|RECEIVER_ID|TIMESTAMP_NS|SERVER_RECV_NS|SERVER_SEND_NS|SEQ|ACK|CONTENT\n,
+     * где RECEIVER_ID - ID получателя или список "12,15,19" (см. setRecipients),
+     * перед которым "+" означает запрос отчета о доставке,
+     * временные метки - целые наносекунды от эпохи Unix (0 - метки нет),
+     * SEQ и ACK - номер сообщения в сессии и накопительное подтверждение
+     * (0 - нет), а '\n' и '\\' в содержимом экранируются как "\\n" и "\\\\".
+     * @return Строковое представление сообщения, завершенное FRAME_DELIMITER
      */
     std::string serialize() const;
 
+    /**
+     * @brief Сериализация в переиспользуемый буфер
+     *
+     * Буфер очищается, его емкость сохраняется: при повторных вызовах
+     * с буфером соединения память не выделяется.
+     * @param buffer Буфер для кадра (формат как у serialize())
+     */
+    void serializeTo(std::string& buffer) const;
+
+    /**
+     * @brief Сериализация заголовка кадра (поля до содержимого)
+     *
+     * Вместе с serializeContent() дает кадр serializeTo(): содержимое,
+     * общее для нескольких получателей, экранируется один раз, а заголовок
+     * со своими номером и подтверждением пишется для каждого.
+     * @param buffer Буфер для заголовка (очищается; заканчивается '|')
+     */
+    void serializeHeaderTo(std::string& buffer) const;
+
+    /**
+     * @brief Экранированное содержимое кадра
+     * @return Содержимое, завершенное FRAME_DELIMITER
+     */
+    std::string serializeContent() const;
+
     /**
      * @brief Десериализация сообщения из строки
-     * @param data Строковое представление сообщения
+     * @param data Строковое представление сообщения (один кадр)
      * @return true если десериализация успешна
      */
-    bool deserialize(const std::string& data);
+    bool deserialize(std::string_view data);
+
+    /**
+     * @brief Десериализация кадра, уже разделенного на поля FrameScanner
+     *
+     * Поиск разделителей не повторяется: разбираются только числа
+     * заголовка и экранирование содержимого.
+     * @param frame Кадр из FrameScanner::scan или FrameBuffer::nextFrames
+     * @return true если десериализация успешна
+     */
+    bool deserialize(const FrameScanner::Frame& frame);
+
+    /**
+     * @brief Имя типа сообщения в кадре (выбор из таблицы по индексу)
+     * @param type Тип сообщения
+     * @return Имя типа
+     */
+    static constexpr std::string_view typeName(Type type);
+
+    /**
+     * @brief Разбор имени типа из кадра без создания строк
+     *
+     * Имя находится хешем без коллизий, подобранным при компиляции,
+     * и одним сравнением с именем из таблицы.
+     * @param name Имя типа
+     * @param type Тип сообщения
+     * @return false если имя не соответствует ни одному типу
+     */
+    static bool parseType(std::string_view name, Type& type);
 
     /**
      * @brief Получение строкового представления типа сообщения
@@ -80,16 +230,42 @@ public:
     /**
      * @brief Получение типа сообщения из строки
      * @param typeStr Строковое представление типа
-     * @return Тип сообщения
+     * @return Тип сообщения (TEXT для неизвестного имени)
      */
     static Type stringToType(const std::string& typeStr);
 
 private:
+    /**
+     * @brief Разбор полей заголовка и содержимого кадра
+     * @param fields Поля заголовка (FrameScanner::HEADER_FIELDS)
+     * @param content Экранированное содержимое
+     * @return false если поле заголовка неверно
+     */
+    bool parseFields(const std::string_view* fields, std::string_view content);
+
     Type m_type;                                    ///< Тип сообщения
-    std::string m_content;                          ///< Содержимое сообщения
+    Payload m_content;                              ///< Содержимое сообщения
     int m_senderId;                                 ///< ID отправителя
-    int m_receiverId;                               ///< ID получателя
-    std::chrono::system_clock::time_point m_timestamp; ///< Временная метка
+    int m_receiverId;                               ///< ID получателя (первого из списка)
+    std::vector<int> m_recipients;                  ///< Получатели списком (пусто - один m_receiverId)
+    bool m_deliveryReport;                          ///< Отправитель просит отчет о доставке
+    int64_t m_timestampNs;                          ///< Время создания, нс от эпохи Unix
+    int64_t m_serverReceiveNs;                      ///< Время приема сервером (0 - нет)
+    int64_t m_serverSendNs;                         ///< Время отправки сервером (0 - нет)
+    uint64_t m_seq;                                 ///< Номер сообщения в сессии (0 - без номера)
+    uint64_t m_ack;                                 ///< Последний принятый номер собеседника (0 - нет)
+};
+
+/**
+ * @brief Имена типов сообщений в кадре в порядке Message::Type
+ */
+inline constexpr std::array<std::string_view, Message::TYPE_COUNT> MESSAGE_TYPE_NAMES = {
+    "LOGIN", "LOGOUT", "TEXT", "FILE", "STATUS", "ERROR",
+    "PING", "PONG", "RESUME", "ACK", "SHM_ATTACH"
 };
 
+constexpr std::string_view Message::typeName(Type type) {
+    return MESSAGE_TYPE_NAMES[static_cast<size_t>(type)];
+}
+
 #endif // MESSAGE_H
@@ -0,0 +1,100 @@
+#ifndef MESSAGEDISPATCH_H
+#define MESSAGEDISPATCH_H
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "common/Message.h"
+
+/**
+ * @brief Метка типа сообщения для выбора перегрузки обработчика
+ */
+template <Message::Type T>
+struct MessageTag {
+    static constexpr Message::Type type = T;    ///< Тип сообщения
+};
+
+/**
+ * @brief Типы, которые обработчик сознательно пропускает
+ */
+template <Message::Type... Types>
+struct IgnoredTypes {
+    /**
+     * @brief Проверка, входит ли тип в набор
+     * @param type Тип сообщения
+     * @return true если тип пропускается
+     */
+    static constexpr bool contains(Message::Type type) {
+        return ((type == Types) || ... || false);
+    }
+};
+
+/**
+ * @brief Диспетчер сообщений по таблице, построенной при компиляции
+ *
+ * Обработчик - класс с перегрузками
+ *   void handle(MessageTag<Message::Type::X>, const Message& message);
+ * для обрабатываемых типов и псевдонимом Ignored = IgnoredTypes<...>
+ * для пропускаемых. Каждый тип должен попасть ровно в одну из групп,
+ * иначе сборка прерывается: новый тип сообщения нельзя забыть
+ * в обработчике. Вызов - один переход по индексу типа без сравнений.
+ * У локального класса обработчика псевдоним помечается [[maybe_unused]]:
+ * GCC не видит его использования в шаблоне и предупреждает.
+ *
+ * @tparam Handlers Класс обработчика
+ */
+template <typename Handlers>
+class MessageDispatcher {
+public:
+    /**
+     * @brief Вызов обработчика для типа сообщения
+     * @param handlers Обработчик
+     * @param message Сообщение
+     */
+    static void dispatch(Handlers& handlers, const Message& message) {
+        TABLE[static_cast<size_t>(message.getType())](handlers, message);
+    }
+
+private:
+    using Entry = void (*)(Handlers&, const Message&);
+
+    template <Message::Type T, typename = void>
+    struct HasHandler : std::false_type {};
+
+    template <Message::Type T>
+    struct HasHandler<T, std::void_t<decltype(std::declval<Handlers&>().handle(
+        MessageTag<T>{}, std::declval<const Message&>()))>> : std::true_type {};
+
+    template <Message::Type T>
+    static void invoke(Handlers& handlers, const Message& message) {
+        handlers.handle(MessageTag<T>{}, message);
+    }
+
+    static void skip(Handlers&, const Message&) {
+    }
+
+    template <size_t I>
+    static constexpr Entry entry() {
+        constexpr Message::Type type = static_cast<Message::Type>(I);
+        constexpr bool handled = HasHandler<type>::value;
+        constexpr bool ignored = Handlers::Ignored::contains(type);
+        static_assert(handled || ignored, "тип сообщения не обработан и не указан в Ignored");
+        static_assert(!(handled && ignored), "тип сообщения одновременно обработан и указан в Ignored");
+        if constexpr (handled) {
+            return &MessageDispatcher::invoke<type>;
+        } else {
+            return &MessageDispatcher::skip;
+        }
+    }
+
+    template <size_t... I>
+    static constexpr std::array<Entry, Message::TYPE_COUNT> makeTable(std::index_sequence<I...>) {
+        return {{entry<I>()...}};
+    }
+
+    static constexpr std::array<Entry, Message::TYPE_COUNT> TABLE =
+        makeTable(std::make_index_sequence<Message::TYPE_COUNT>{});
+};
+
+#endif // MESSAGEDISPATCH_H
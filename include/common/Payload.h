@@ -0,0 +1,123 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * @brief Содержимое сообщения с встроенным буфером для коротких данных
+ *
+ * Содержимое до INLINE_CAPACITY байтов хранится внутри объекта, поэтому
+ * создание, копирование и пересылка коротких сообщений не обращаются
+ * к куче. Длинное содержимое хранится в std::string и при передаче
+ * rvalue-строки забирается без копирования. Данные всегда завершены
+ * нулевым символом.
+ */
+class Payload {
+public:
+    /**
+     * @brief Размер встроенного буфера
+     */
+    static constexpr size_t INLINE_CAPACITY = 64;
+
+    /**
+     * @brief Пустое содержимое
+     */
+    Payload() noexcept : m_size(0) { m_inline[0] = '\0'; }
+
+    /**
+     * @brief Копия данных
+     * @param text Данные
+     */
+    Payload(std::string_view text) : Payload() { assign(text); }
+
+    /**
+     * @brief Копия данных строки
+     * @param text Строка
+     */
+    Payload(const std::string& text) : Payload(std::string_view(text)) {}
+
+    /**
+     * @brief Данные строки (длинная строка забирается без копирования)
+     * @param text Строка
+     */
+    Payload(std::string&& text) : Payload() { assign(std::move(text)); }
+
+    /**
+     * @brief Копия данных строки C
+     * @param text Строка, завершенная нулем
+     */
+    Payload(const char* text) : Payload(std::string_view(text)) {}
+
+    Payload(const Payload& other) : Payload() { assign(other.view()); }
+    Payload(Payload&& other) noexcept;
+    Payload& operator=(const Payload& other);
+    Payload& operator=(Payload&& other) noexcept;
+
+    /**
+     * @brief Замена содержимого копией данных
+     * @param text Данные
+     */
+    void assign(std::string_view text);
+
+    /**
+     * @brief Замена содержимого строкой
+     * @param text Строка (длинная забирается без копирования)
+     */
+    void assign(std::string&& text);
+
+    /**
+     * @brief Подготовка места под содержимое заданной длины
+     *
+     * Старое содержимое не сохраняется; после записи данных длину
+     * можно уменьшить через truncate().
+     * @param size Длина
+     * @return Указатель на size байтов для записи
+     */
+    char* prepare(size_t size);
+
+    /**
+     * @brief Уменьшение длины содержимого
+     * @param size Новая длина (не больше текущей)
+     */
+    void truncate(size_t size);
+
+    /**
+     * @brief Представление содержимого без копирования
+     * @return Данные
+     */
+    std::string_view view() const { return std::string_view(data(), m_size); }
+
+    /**
+     * @brief Данные, завершенные нулем
+     * @return Указатель на данные
+     */
+    const char* data() const { return isInline() ? m_inline : m_heap.data(); }
+
+    /**
+     * @brief Длина содержимого
+     * @return Длина в байтах
+     */
+    size_t size() const { return m_size; }
+
+    /**
+     * @brief Проверка на пустое содержимое
+     * @return true если содержимое пусто
+     */
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * @brief Хранится ли содержимое во встроенном буфере
+     * @return true если куча не используется
+     */
+    bool isInline() const { return m_size <= INLINE_CAPACITY; }
+
+private:
+    size_t m_size;                          ///< Длина содержимого
+    std::string m_heap;                     ///< Длинное содержимое
+    char m_inline[INLINE_CAPACITY + 1];     ///< Короткое содержимое и завершающий ноль
+};
+
+#endif // PAYLOAD_H
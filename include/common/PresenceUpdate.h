@@ -0,0 +1,42 @@
+#ifndef PRESENCEUPDATE_H
+#define PRESENCEUPDATE_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Состояние присутствия контактов пользователя
+ *
+ * Сервер отправляет его в статусе "PRESENCE:SNAPSHOT:12=ONLINE,15=OFFLINE":
+ * снимок со всеми контактами приходит сразу после входа, а затем
+ * изменения ("PRESENCE:UPDATE:...") только тех контактов, чье состояние
+ * поменялось. Изменения накапливаются на сервере в течение короткого
+ * окна, поэтому контакт, который вошел и сразу вышел, не порождает
+ * ни одного кадра.
+ */
+struct PresenceUpdate {
+    /**
+     * @brief Префикс содержимого статуса
+     */
+    static constexpr std::string_view PREFIX = "PRESENCE:";
+
+    bool snapshot = false;                          ///< Полный снимок (иначе - изменения)
+    std::vector<std::pair<int, bool>> contacts;     ///< Контакты и признак "в сети"
+
+    /**
+     * @brief Запись состояния в содержимое статуса
+     * @return Содержимое с префиксом PREFIX
+     */
+    std::string toContent() const;
+
+    /**
+     * @brief Разбор содержимого статуса
+     * @param content Содержимое
+     * @return false если это не состояние присутствия или оно записано неверно
+     */
+    bool parse(std::string_view content);
+};
+
+#endif // PRESENCEUPDATE_H
@@ -0,0 +1,144 @@
+#ifndef RELIABLECHANNEL_H
+#define RELIABLECHANNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "common/Message.h"
+
+/**
+ * @brief Надежная доставка в рамках сессии: номера, подтверждения, повтор
+ *
+ * Сообщения с данными (TEXT, FILE) получают последовательные номера,
+ * а их копии хранятся в окне до подтверждения. Подтверждение
+ * накопительное (номер последнего принятого по порядку сообщения) и
+ * передается в поле ACK любого исходящего кадра; отдельный кадр ACK
+ * нужен, только если встречного трафика нет. После переподключения
+ * неподтвержденные сообщения отправляются повторно, а получатель
+ * отбрасывает уже принятые номера.
+ *
+ * Номера присваиваются в порядке записи в сокет, поэтому stamp()
+ * вызывается под мьютексом отправки соединения.
+ */
+class ReliableChannel {
+public:
+    /**
+     * @brief Размер окна неподтвержденных сообщений по умолчанию
+     */
+    static constexpr size_t DEFAULT_WINDOW_SIZE = 1024;
+
+    /**
+     * @brief Число неподтвержденных принятых сообщений, после которого ACK отправляется сразу
+     */
+    static constexpr size_t ACK_BATCH_SIZE = 32;
+
+    /**
+     * @brief Конструктор
+     * @param windowSize Максимум неподтвержденных исходящих сообщений
+     */
+    explicit ReliableChannel(size_t windowSize = DEFAULT_WINDOW_SIZE);
+
+    /**
+     * @brief Проверка, получает ли тип сообщения номер
+     * @param type Тип сообщения
+     * @return true для сообщений с данными
+     */
+    static bool isSequenced(Message::Type type);
+
+    /**
+     * @brief Подготовка исходящего сообщения: номер, подтверждение, копия в окне
+     * @param message Сообщение
+     * @return false если окно заполнено (сообщение не отправляется)
+     */
+    bool stamp(Message& message);
+
+    /**
+     * @brief Обработка входящего сообщения
+     *
+     * Подтверждение из сообщения освобождает окно. Сообщение с уже
+     * принятым номером считается повтором.
+     * @param message Входящее сообщение
+     * @return false если сообщение - повтор и должно быть отброшено
+     */
+    bool accept(const Message& message);
+
+    /**
+     * @brief Освобождение окна по накопительному подтверждению
+     * @param ack Номер последнего принятого собеседником сообщения
+     */
+    void acknowledge(uint64_t ack);
+
+    /**
+     * @brief Неподтвержденные сообщения для повторной отправки
+     *
+     * Копии несут текущее подтверждение.
+     * @return Сообщения в порядке номеров
+     */
+    std::vector<Message> unacknowledged();
+
+    /**
+     * @brief Перенумерация после потери состояния собеседником
+     *
+     * Неподтвержденные сообщения сохраняются и получают номера с 1,
+     * счетчик принятых сбрасывается.
+     */
+    void restart();
+
+    /**
+     * @brief Номер последнего принятого по порядку сообщения
+     * @return Номер (0 - ничего не принято)
+     */
+    uint64_t received() const;
+
+    /**
+     * @brief Количество принятых, но еще не подтвержденных сообщений
+     * @return Количество
+     */
+    size_t pendingAcks() const;
+
+    /**
+     * @brief Взвод таймера отложенного подтверждения
+     * @return true если есть что подтверждать и таймер еще не взведен
+     */
+    bool armAckTimer();
+
+    /**
+     * @brief Создание кадра ACK с текущим подтверждением
+     * @param ackMessage Кадр ACK
+     * @return false если подтверждать нечего (таймер при этом снимается)
+     */
+    bool takeAck(Message& ackMessage);
+
+    /**
+     * @brief Количество неподтвержденных исходящих сообщений
+     * @return Количество
+     */
+    size_t inFlight() const;
+
+private:
+    /**
+     * @brief Сообщение окна по порядковому номеру от начала
+     * @param index Индекс (меньше m_windowCount)
+     * @return Сообщение
+     */
+    Message& windowAt(size_t index) { return m_window[(m_windowHead + index) % m_window.size()]; }
+
+    /**
+     * @brief Освобождение окна до подтвержденного номера включительно
+     * @param ack Подтвержденный номер
+     */
+    void releaseUpTo(uint64_t ack);
+
+    mutable std::mutex m_mutex;                     ///< Мьютекс состояния
+    size_t m_windowSize;                            ///< Размер окна
+    uint64_t m_nextSeq;                             ///< Номер следующего исходящего сообщения
+    uint64_t m_received;                            ///< Последний принятый номер
+    uint64_t m_ackSent;                             ///< Последнее отправленное подтверждение
+    bool m_ackTimerArmed;                           ///< Взведен таймер отложенного подтверждения
+    std::vector<Message> m_window;                  ///< Кольцо неподтвержденных исходящих сообщений
+    size_t m_windowHead;                            ///< Индекс самого старого сообщения в кольце
+    size_t m_windowCount;                           ///< Количество сообщений в кольце
+};
+
+#endif // RELIABLECHANNEL_H
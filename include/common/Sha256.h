@@ -0,0 +1,83 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Хеш-функция SHA-256 (FIPS 180-4) и HMAC-SHA256 (RFC 2104)
+ */
+class Sha256 {
+public:
+    /**
+     * @brief Размер хеша в байтах
+     */
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    /**
+     * @brief Хеш
+     */
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+    /**
+     * @brief Конструктор (начальное состояние)
+     */
+    Sha256();
+
+    /**
+     * @brief Добавление данных
+     * @param data Данные
+     * @param length Длина данных
+     */
+    void update(const void* data, size_t length);
+
+    /**
+     * @brief Добавление строки
+     * @param data Строка
+     */
+    void update(const std::string& data) { update(data.data(), data.size()); }
+
+    /**
+     * @brief Завершение вычисления (объект после этого не используется)
+     * @return Хеш
+     */
+    Digest finish();
+
+    /**
+     * @brief Хеш данных
+     * @param data Данные
+     * @return Хеш
+     */
+    static Digest hash(const std::string& data);
+
+    /**
+     * @brief HMAC-SHA256
+     * @param key Ключ
+     * @param data Данные
+     * @return Код аутентификации
+     */
+    static Digest hmac(const std::string& key, const std::string& data);
+
+    /**
+     * @brief Шестнадцатеричная запись хеша
+     * @param digest Хеш
+     * @return Строка из 64 символов
+     */
+    static std::string toHex(const Digest& digest);
+
+private:
+    /**
+     * @brief Обработка одного блока из 64 байт
+     * @param block Блок
+     */
+    void processBlock(const uint8_t* block);
+
+    std::array<uint32_t, 8> m_state;                ///< Промежуточное значение хеша
+    std::array<uint8_t, 64> m_block;                ///< Незаполненный блок
+    size_t m_blockSize;                             ///< Байтов в незаполненном блоке
+    uint64_t m_totalSize;                           ///< Всего обработано байтов
+};
+
+#endif // SHA256_H
@@ -0,0 +1,205 @@
+#ifndef SHMSEGMENT_H
+#define SHMSEGMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+    #include <poll.h>
+#endif
+
+/**
+ * @brief Сегмент разделяемой памяти с парой колец для клиента на одном хосте
+ *
+ * Сегмент (memfd) содержит два кольца байтов с одним писателем и одним
+ * читателем: клиент -> сервер и сервер -> клиент. По кольцам идут те же
+ * кадры, что и по сокету, поэтому разбор, ограничения и семантика
+ * сообщений не меняются; запись и чтение кадра не требуют системных
+ * вызовов. Читатель сначала коротко крутится в ожидании данных и только
+ * затем засыпает на eventfd, выставив флаг ожидания; писатель будит его
+ * только при выставленном флаге. Так же писатель ждет места в полном
+ * кольце.
+ *
+ * Клиент создает сегмент и передает серверу его дескрипторы через
+ * Unix-сокет (SCM_RIGHTS) вместе с кадром SHM_ATTACH; после ответа
+ * "SHM_OK" сокет остается только признаком жизни соединения: его
+ * закрытие любой стороной прерывает ожидание другой. Доступно только
+ * на Linux.
+ */
+class ShmSegment {
+public:
+    /**
+     * @brief Сторона соединения
+     */
+    enum class Side {
+        CLIENT,     ///< Пишет в кольцо 0, читает кольцо 1
+        SERVER      ///< Пишет в кольцо 1, читает кольцо 0
+    };
+
+    /**
+     * @brief Размер одного кольца по умолчанию
+     */
+    static constexpr size_t DEFAULT_RING_SIZE = 1024 * 1024;
+
+    /**
+     * @brief Максимальный размер кольца, принимаемый от другой стороны
+     */
+    static constexpr size_t MAX_RING_SIZE = 64 * 1024 * 1024;
+
+    /**
+     * @brief Количество дескрипторов сегмента: memfd и четыре eventfd
+     */
+    static constexpr size_t DESCRIPTOR_COUNT = 5;
+
+    /**
+     * @brief Длительность ожидания вращением перед сном на eventfd, нс
+     */
+    static constexpr int64_t SPIN_NS = 50000;
+
+    /**
+     * @brief Результат ожидания данных
+     */
+    enum class WaitResult {
+        DATA,       ///< Во входящем кольце есть данные
+        EVENT,      ///< Готов один из дополнительных дескрипторов
+        TIMEOUT     ///< Истек срок ожидания
+    };
+
+    /**
+     * @brief Создание сегмента (сторона клиента)
+     * @param ringSize Размер каждого кольца (степень двойки)
+     * @return Сегмент или nullptr при ошибке
+     */
+    static std::unique_ptr<ShmSegment> create(size_t ringSize = DEFAULT_RING_SIZE);
+
+    /**
+     * @brief Подключение к сегменту по принятым дескрипторам (сторона сервера)
+     *
+     * Забирает все дескрипторы: при ошибке они закрываются. Содержимое
+     * сегмента записывает другой процесс, поэтому размеры проверяются.
+     * @param descriptors Дескрипторы в порядке descriptors()
+     * @return Сегмент или nullptr, если дескрипторы не описывают сегмент
+     */
+    static std::unique_ptr<ShmSegment> attach(std::vector<int>& descriptors);
+
+    /**
+     * @brief Деструктор (снимает отображение и закрывает дескрипторы)
+     */
+    ~ShmSegment();
+
+    ShmSegment(const ShmSegment&) = delete;
+    ShmSegment& operator=(const ShmSegment&) = delete;
+
+    /**
+     * @brief Дескрипторы для передачи другой стороне
+     * @return memfd и eventfd колец
+     */
+    const std::vector<int>& descriptors() const { return m_descriptors; }
+
+    /**
+     * @brief Запись байтов в исходящее кольцо
+     *
+     * Пишет столько, сколько помещается, и ждет места для остатка.
+     * Вызывается одним потоком за раз (под мьютексом отправки).
+     * @param data Данные
+     * @param size Размер данных
+     * @param aliveFd Сокет соединения: его готовность означает, что другая сторона отключилась
+     * @param timeoutMs Предельное ожидание места, мс (-1 - без ограничения)
+     * @return false если другая сторона отключилась или место не освободилось
+     */
+    bool write(const char* data, size_t size, int aliveFd, int timeoutMs = -1);
+
+    /**
+     * @brief Чтение доступных байтов входящего кольца без ожидания
+     *
+     * Вызывается только потоком чтения соединения.
+     * @param buffer Буфер
+     * @param size Размер буфера
+     * @return Количество прочитанных байтов (0 - кольцо пусто, -1 - сегмент поврежден)
+     */
+    int read(char* buffer, size_t size);
+
+#ifndef _WIN32
+    /**
+     * @brief Ожидание данных во входящем кольце или событий на дескрипторах
+     *
+     * Сначала проверяет кольцо в течение SPIN_NS (если ядер больше одного),
+     * затем выставляет флаг ожидания и засыпает в poll вместе
+     * с дополнительными дескрипторами.
+     * @param fds Дополнительные дескрипторы (revents заполняется)
+     * @param count Количество дополнительных дескрипторов
+     * @param timeoutMs Предельное ожидание, мс (-1 - без ограничения)
+     * @return Результат ожидания
+     */
+    WaitResult waitForData(pollfd* fds, size_t count, int timeoutMs);
+#endif
+
+    /**
+     * @brief Отправка кадра вместе с дескрипторами сегмента
+     * @param socket Unix-сокет
+     * @param frame Кадр SHM_ATTACH
+     * @return true если кадр отправлен целиком
+     */
+    bool sendAttach(int socket, const std::string& frame) const;
+
+    /**
+     * @brief Прием байтов сокета с дескрипторами SCM_RIGHTS
+     *
+     * Дескрипторы, пришедшие вместе с данными, добавляются в descriptors;
+     * для сокетов без вспомогательных данных работает как recv.
+     * @param socket Сокет
+     * @param buffer Буфер
+     * @param size Размер буфера
+     * @param descriptors Принятые дескрипторы
+     * @return Результат recvmsg
+     */
+    static int receive(int socket, char* buffer, size_t size, std::vector<int>& descriptors);
+
+private:
+    struct RingHeader;
+    struct SegmentHeader;
+
+    /**
+     * @brief Представление одного кольца в отображенной памяти
+     */
+    struct Ring {
+        RingHeader* header = nullptr;   ///< Позиции и флаги ожидания
+        char* data = nullptr;           ///< Данные кольца
+        int dataFd = -1;                ///< eventfd "появились данные"
+        int spaceFd = -1;               ///< eventfd "освободилось место"
+    };
+
+    /**
+     * @brief Конструктор
+     * @param memory Отображенный сегмент
+     * @param mappedSize Размер отображения
+     * @param ringSize Размер кольца
+     * @param descriptors memfd и eventfd
+     * @param side Сторона соединения
+     */
+    ShmSegment(void* memory, size_t mappedSize, size_t ringSize, std::vector<int> descriptors, Side side);
+
+    /**
+     * @brief Пробуждение другой стороны через eventfd
+     * @param fd eventfd
+     */
+    static void signal(int fd);
+
+    /**
+     * @brief Сброс счетчика eventfd после пробуждения
+     * @param fd eventfd
+     */
+    static void drain(int fd);
+
+    void* m_memory;                     ///< Отображенный сегмент
+    size_t m_mappedSize;                ///< Размер отображения
+    size_t m_ringSize;                  ///< Размер кольца (степень двойки)
+    std::vector<int> m_descriptors;     ///< memfd и eventfd
+    Ring m_outgoing;                    ///< Кольцо, в которое пишет эта сторона
+    Ring m_incoming;                    ///< Кольцо, которое читает эта сторона
+};
+
+#endif // SHMSEGMENT_H
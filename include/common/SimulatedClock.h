@@ -0,0 +1,48 @@
+#ifndef SIMULATEDCLOCK_H
+#define SIMULATEDCLOCK_H
+
+#include <cstdint>
+
+/**
+ * @brief Управляемое время для воспроизводимых прогонов
+ *
+ * Пока часы включены, Message::currentTimeNs() возвращает их показание,
+ * а не системное время. От него зависят метки сообщений, ограничения
+ * скорости и отметки активности соединений, поэтому бенчмарк или
+ * нагрузочный прогон через LoopbackTransport дает одинаковые решения
+ * ограничителей при любой скорости машины. Колесо таймеров по-прежнему
+ * идет по steady_clock.
+ */
+class SimulatedClock {
+public:
+    /**
+     * @brief Включение управляемого времени
+     * @param startNs Начальное показание, нс от эпохи Unix
+     */
+    static void enable(int64_t startNs);
+
+    /**
+     * @brief Возврат к системному времени
+     */
+    static void disable();
+
+    /**
+     * @brief Включены ли управляемые часы
+     * @return true если время берется из часов
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Текущее показание
+     * @return Наносекунды от эпохи Unix
+     */
+    static int64_t now();
+
+    /**
+     * @brief Сдвиг времени вперед
+     * @param deltaNs Шаг, нс
+     */
+    static void advance(int64_t deltaNs);
+};
+
+#endif // SIMULATEDCLOCK_H
@@ -0,0 +1,88 @@
+#ifndef SOCKETTRANSPORT_H
+#define SOCKETTRANSPORT_H
+
+#include <memory>
+#include <vector>
+#include "common/ShmSegment.h"
+#include "common/Transport.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/socket.h>
+    #include <unistd.h>
+    #ifndef SOCKET_ERROR
+        #define SOCKET_ERROR (-1)
+    #endif
+#endif
+
+/**
+ * @brief Соединение через TCP или Unix-сокет
+ *
+ * После перехода на разделяемую память (useSharedMemory) кадры идут
+ * через кольца ShmSegment, а сокет остается признаком жизни соединения:
+ * его закрытие другой стороной прерывает ожидание. Дескрипторы,
+ * пришедшие через SCM_RIGHTS, накапливаются до кадра SHM_ATTACH.
+ */
+class SocketTransport : public Transport {
+public:
+    /**
+     * @brief Конструктор
+     * @param socket Подключенный сокет (переходит во владение)
+     */
+    explicit SocketTransport(socket_t socket);
+
+    /**
+     * @brief Деструктор (закрывает сокет и принятые дескрипторы)
+     */
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    int receive(char* buffer, size_t size) override;
+    bool send(const char* data, size_t size) override;
+    bool wait(int wakeFd, int timeoutMs) override;
+    void shutdown() override;
+    void close() override;
+    socket_t release() override;
+
+    /**
+     * @brief Сокет соединения
+     * @return Сокет или INVALID_SOCKET после закрытия
+     */
+    socket_t socket() const { return m_socket; }
+
+    /**
+     * @brief Переведено ли соединение на разделяемую память
+     * @return true после useSharedMemory
+     */
+    bool usesSharedMemory() const { return m_shm != nullptr; }
+
+    /**
+     * @brief Подключение к сегменту по дескрипторам, принятым с SCM_RIGHTS
+     *
+     * Принятые дескрипторы забираются в любом случае.
+     * @return Сегмент или nullptr, если дескрипторы не описывают сегмент
+     *         или соединение уже использует разделяемую память
+     */
+    std::unique_ptr<ShmSegment> attachReceivedSegment();
+
+    /**
+     * @brief Перевод соединения на кольца разделяемой памяти
+     *
+     * Ожидание места в кольце ограничивается SO_SNDTIMEO сокета.
+     * Вызывается под мьютексом отправки, после записи последнего кадра
+     * в сокет.
+     * @param segment Сегмент
+     */
+    void useSharedMemory(std::unique_ptr<ShmSegment> segment);
+
+private:
+    socket_t m_socket;                      ///< Сокет соединения
+    std::unique_ptr<ShmSegment> m_shm;      ///< Разделяемая память (после SHM_ATTACH)
+    int m_shmSendTimeoutMs;                 ///< Предельное ожидание места в кольце
+    std::vector<int> m_receivedFds;         ///< Дескрипторы, принятые через SCM_RIGHTS
+};
+
+#endif // SOCKETTRANSPORT_H
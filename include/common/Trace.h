@@ -0,0 +1,112 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Трассировка горячего пути
+ *
+ * Каждый поток пишет события в собственный кольцевой буфер без блокировок,
+ * поэтому точки трассировки не конкурируют между собой. По запросу
+ * (сигнал или явный вызов) буферы всех потоков выгружаются в JSON-файл
+ * формата Chrome trace-event, который открывается в Perfetto или chrome://tracing.
+ *
+ * Точки трассировки расставляются макросом TRACE_SCOPE и компилируются
+ * только при включенной опции ENABLE_TRACING, иначе они ничего не стоят.
+ */
+class Trace {
+public:
+    /**
+     * @brief Емкость кольцевого буфера одного потока (степень двойки)
+     */
+    static constexpr size_t RING_CAPACITY = 4096;
+
+    /**
+     * @brief Событие трассировки (интервал времени)
+     */
+    struct Event {
+        const char* name;       ///< Имя точки трассировки (строковый литерал)
+        uint64_t startNs;       ///< Начало интервала, нс монотонных часов
+        uint64_t durationNs;    ///< Длительность интервала, нс
+        uint32_t threadId;      ///< Номер потока, записавшего событие
+    };
+
+    /**
+     * @brief RAII-интервал: фиксирует время от создания до разрушения
+     */
+    class Scope {
+    public:
+        explicit Scope(const char* name) : m_name(name), m_startNs(nowNs()) {}
+        ~Scope() { record(m_name, m_startNs, nowNs()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_name;     ///< Имя точки трассировки
+        uint64_t m_startNs;     ///< Время начала интервала
+    };
+
+    /**
+     * @brief Текущее время монотонных часов
+     * @return Наносекунды от произвольной точки отсчета
+     */
+    static uint64_t nowNs();
+
+    /**
+     * @brief Запись события в буфер текущего потока
+     * @param name Имя точки трассировки (должно жить все время работы программы)
+     * @param startNs Начало интервала
+     * @param endNs Конец интервала
+     */
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    /**
+     * @brief Установка имени текущего потока для отображения в трассе
+     *
+     * Имя хранится вместе с буфером потока и заменяется, когда буфер
+     * завершившегося потока займет новый.
+     * @param name Имя потока
+     */
+    static void setThreadName(const std::string& name);
+
+    /**
+     * @brief Выгрузка буферов всех потоков в формате Chrome trace-event
+     * @param path Путь к выходному JSON-файлу
+     * @return true если файл записан успешно
+     */
+    static bool dumpChromeTrace(const std::string& path);
+
+    /**
+     * @brief Запрос выгрузки трассы
+     *
+     * Безопасен для вызова из обработчика сигнала: только выставляет флаг,
+     * который обрабатывает фоновый поток, запущенный startDumpWatcher().
+     */
+    static void requestDump();
+
+    /**
+     * @brief Запуск фонового потока, выполняющего запрошенные выгрузки
+     * @param filePrefix Префикс имени файла (к нему добавляются PID и номер выгрузки)
+     */
+    static void startDumpWatcher(const std::string& filePrefix);
+
+    /**
+     * @brief Остановка фонового потока выгрузки
+     */
+    static void stopDumpWatcher();
+};
+
+#ifdef ENABLE_TRACING
+    #define TRACE_CONCAT_INNER(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+    #define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+    #define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#else
+    #define TRACE_SCOPE(name) ((void)0)
+    #define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_H
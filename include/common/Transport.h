@@ -0,0 +1,84 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    typedef SOCKET socket_t;
+#else
+    typedef int socket_t;
+    #ifndef INVALID_SOCKET
+        #define INVALID_SOCKET (-1)
+    #endif
+#endif
+
+/**
+ * @brief Поток байтов одного соединения
+ *
+ * ClientHandler и Client читают и пишут кадры только через этот
+ * интерфейс, поэтому соединение не обязано быть сокетом: SocketTransport
+ * работает с TCP или Unix-сокетом (и кольцами разделяемой памяти после
+ * SHM_ATTACH), LoopbackTransport - с буферами в памяти процесса.
+ *
+ * receive() и wait() вызывает только поток чтения соединения, send() -
+ * один поток за раз (под мьютексом отправки); shutdown() допустим из
+ * любого потока и будит ожидающих.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Чтение доступных байтов (блокирует, пока данных нет)
+     * @param buffer Буфер
+     * @param size Размер буфера
+     * @return Количество байтов; 0 или меньше - соединение закрыто
+     */
+    virtual int receive(char* buffer, size_t size) = 0;
+
+    /**
+     * @brief Запись байтов целиком
+     *
+     * При неудаче часть данных могла уйти, и поток кадров испорчен:
+     * вызывающий должен закрыть соединение.
+     * @param data Данные
+     * @param size Размер данных
+     * @return false если соединение закрыто или запись не удалась
+     */
+    virtual bool send(const char* data, size_t size) = 0;
+
+    /**
+     * @brief Ожидание данных для чтения
+     *
+     * Возвращает и при готовности wakeFd (пробуждение потока чтения при
+     * передаче соединений), и при закрытии соединения: следующий
+     * receive() тогда не блокирует.
+     * @param wakeFd Дескриптор пробуждения (-1 - нет)
+     * @param timeoutMs Предельное ожидание, мс (-1 - без ограничения)
+     * @return false если истек срок ожидания
+     */
+    virtual bool wait(int wakeFd, int timeoutMs) = 0;
+
+    /**
+     * @brief Закрытие соединения в обе стороны без освобождения ресурсов
+     *
+     * Будит потоки в receive(), wait() и send().
+     */
+    virtual void shutdown() = 0;
+
+    /**
+     * @brief Освобождение ресурсов соединения
+     */
+    virtual void close() = 0;
+
+    /**
+     * @brief Передача сокета другому владельцу (горячее обновление)
+     *
+     * Соединение, которое нельзя передать другому процессу, закрывается.
+     * @return Сокет или INVALID_SOCKET, если передавать нечего
+     */
+    virtual socket_t release() = 0;
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,177 @@
+#ifndef AUTHPOOL_H
+#define AUTHPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Ограничения пула проверки паролей
+ */
+struct AuthLimits {
+    size_t threadCount = 2;                             ///< Потоков проверки
+    size_t maxQueueSize = 1024;                         ///< Максимум ожидающих проверок
+    size_t maxPendingPerAddress = 4;                    ///< Максимум одновременных проверок с одного адреса
+    std::chrono::milliseconds sessionCacheTtl{300000};  ///< Срок действия подтвержденного входа в кэше
+    size_t maxCachedSessions = 10000;                   ///< Размер кэша подтвержденных входов
+};
+
+/**
+ * @brief Пул потоков проверки паролей
+ *
+ * Проверка стойкого хеша пароля занимает миллисекунды процессорного
+ * времени, поэтому выполняется отдельными потоками, а не потоками
+ * соединений и маршрутизации. Очередь ограничена, число одновременных
+ * проверок с одного адреса тоже: поток входов с одного хоста получает
+ * отказ, а не занимает весь пул. Успешные проверки кэшируются
+ * (хранится только свертка пароля со случайной солью процесса), и
+ * повторный вход с тем же паролем не требует новой проверки.
+ */
+class AuthPool {
+public:
+    /**
+     * @brief Функция проверки пароля (вызывается в потоке пула)
+     *
+     * Для еще не зарегистрированного имени решает, разрешена ли регистрация.
+     */
+    using Verifier = std::function<bool(const std::string& username, const std::string& password)>;
+
+    /**
+     * @brief Функция завершения проверки (вызывается в потоке пула)
+     */
+    using Completion = std::function<void(bool verified)>;
+
+    /**
+     * @brief Результат постановки проверки
+     */
+    enum class SubmitResult {
+        QUEUED,             ///< Проверка поставлена в очередь
+        CACHED,             ///< Вход уже подтвержден, проверка не нужна
+        ADDRESS_LIMIT,      ///< Слишком много проверок с адреса
+        QUEUE_FULL          ///< Очередь переполнена или пул остановлен
+    };
+
+    /**
+     * @brief Конструктор
+     * @param limits Ограничения пула
+     */
+    explicit AuthPool(const AuthLimits& limits = AuthLimits());
+
+    /**
+     * @brief Деструктор (останавливает пул)
+     */
+    ~AuthPool();
+
+    /**
+     * @brief Запуск потоков проверки
+     */
+    void start();
+
+    /**
+     * @brief Остановка с выполнением уже поставленных проверок
+     */
+    void stop();
+
+    /**
+     * @brief Установка функции проверки (вызывать до start())
+     * @param verifier Функция проверки (пустая - любой пароль верен)
+     */
+    void setVerifier(Verifier verifier);
+
+    /**
+     * @brief Постановка проверки пароля
+     * @param address Адрес клиента
+     * @param username Имя пользователя
+     * @param password Пароль
+     * @param completion Вызывается после проверки, если результат QUEUED
+     * @return Результат постановки
+     */
+    SubmitResult submit(const std::string& address, const std::string& username,
+                        const std::string& password, Completion completion);
+
+    /**
+     * @brief Удаление подтвержденного входа из кэша (например, при смене пароля)
+     * @param username Имя пользователя
+     */
+    void invalidate(const std::string& username);
+
+    /**
+     * @brief Количество ожидающих проверок
+     * @return Длина очереди
+     */
+    size_t queueDepth() const { return m_queued.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @brief Ожидающая проверка
+     */
+    struct Request {
+        std::string address;        ///< Адрес клиента
+        std::string username;       ///< Имя пользователя
+        std::string password;       ///< Пароль
+        Completion completion;      ///< Функция завершения
+    };
+
+    /**
+     * @brief Подтвержденный вход в кэше
+     */
+    struct CachedSession {
+        std::string username;       ///< Имя пользователя
+        uint64_t digest;            ///< Свертка пароля с солью процесса
+        int64_t expiresNs;          ///< Момент истечения, нс steady_clock
+    };
+
+    /**
+     * @brief Цикл потока проверки
+     * @param index Номер потока
+     */
+    void workerLoop(size_t index);
+
+    /**
+     * @brief Свертка пароля с солью процесса
+     * @param password Пароль
+     * @return Свертка
+     */
+    uint64_t passwordDigest(const std::string& password) const;
+
+    /**
+     * @brief Проверка кэша подтвержденных входов
+     * @param username Имя пользователя
+     * @param digest Свертка пароля
+     * @return true если вход подтвержден и срок не истек
+     */
+    bool isCached(const std::string& username, uint64_t digest);
+
+    /**
+     * @brief Запоминание подтвержденного входа (вытесняется самый старый)
+     * @param username Имя пользователя
+     * @param digest Свертка пароля
+     */
+    void remember(const std::string& username, uint64_t digest);
+
+    AuthLimits m_limits;                            ///< Ограничения
+    Verifier m_verifier;                            ///< Функция проверки
+    uint64_t m_salt;                                ///< Соль процесса для сверток паролей
+    std::vector<std::thread> m_threads;             ///< Потоки проверки
+    std::mutex m_mutex;                             ///< Мьютекс очереди и счетчиков адресов
+    std::condition_variable m_cv;                   ///< Пробуждение потоков
+    std::deque<Request> m_queue;                    ///< Ожидающие проверки
+    std::unordered_map<std::string, size_t> m_pendingByAddress; ///< Проверок в работе по адресам
+    std::atomic<size_t> m_queued;                   ///< Ожидающих проверок
+    bool m_running;                                 ///< Флаг работы пула
+    std::mutex m_cacheMutex;                        ///< Мьютекс кэша
+    std::list<CachedSession> m_sessions;            ///< Кэш, от недавних к старым
+    std::unordered_map<std::string, std::list<CachedSession>::iterator> m_sessionIndex; ///< Индекс кэша по имени
+};
+
+#endif // AUTHPOOL_H
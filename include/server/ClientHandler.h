@@ -4,22 +4,53 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "common/User.h"
 #include "common/Message.h"
+#include "common/ReliableChannel.h"
+#include "common/SocketTransport.h"
+#include "common/Transport.h"
+#include "server/OutboundQueue.h"
+#include "server/RateLimiter.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
     typedef SOCKET socket_t;
 #else
     #include <sys/socket.h>
+    #include <unistd.h>
     typedef int socket_t;
+    #ifndef INVALID_SOCKET
+        #define INVALID_SOCKET (-1)
+    #endif
+    #ifndef SOCKET_ERROR
+        #define SOCKET_ERROR (-1)
+    #endif
 #endif
 
 /**
  * @brief Класс для обработки отдельного клиентского подключения
  * 
  * Этот класс инкапсулирует логику работы с конкретным клиентом,
- * включая прием и отправку сообщений.
+ * включая прием и отправку сообщений. Принятый поток байтов делится
+ * на кадры, и каждый кадр проходит ограничение скорости соединения
+ * до разбора.
+ *
+ * Клиент на том же хосте может перевести соединение на разделяемую
+ * память кадром SHM_ATTACH с дескрипторами сегмента (см. ShmSegment):
+ * после ответа "SHM_OK" кадры в обе стороны идут через кольца, а сокет
+ * остается признаком жизни соединения.
+ *
+ * Байты читаются и пишутся через Transport, поэтому соединение может
+ * быть и не сокетом (LoopbackTransport для бенчмарков в одном процессе).
+ *
+ * Исходящие сообщения проходят через OutboundQueue: служебные кадры
+ * обгоняют личные сообщения и объемные данные. Отдельного потока
+ * отправки нет - очередь разбирает поток, который застал ее пустой,
+ * остальные только добавляют сообщения и возвращаются.
  */
 class ClientHandler {
 public:
@@ -27,8 +58,17 @@ public:
      * @brief Конструктор обработчика клиента
      * @param clientSocket Сокет клиента
      * @param clientId Уникальный ID клиента
+     * @param limits Ограничения скорости соединения
      */
-    ClientHandler(socket_t clientSocket, int clientId);
+    ClientHandler(socket_t clientSocket, int clientId, const RateLimits& limits = RateLimits());
+
+    /**
+     * @brief Конструктор обработчика соединения через произвольный транспорт
+     * @param transport Транспорт соединения
+     * @param clientId Уникальный ID клиента
+     * @param limits Ограничения скорости соединения
+     */
+    ClientHandler(std::unique_ptr<Transport> transport, int clientId, const RateLimits& limits = RateLimits());
 
     /**
      * @brief Деструктор
@@ -42,9 +82,89 @@ public:
 
     /**
      * @brief Остановка обработки клиента
+     *
+     * Может вызываться из любого потока, в том числе из обработчиков
+     * самого соединения.
      */
     void stop();
 
+    /**
+     * @brief Запрос отключения клиента без ожидания потока соединения
+     *
+     * Будит поток соединения, который завершится и вызовет обработчик
+     * отключения. Безопасна для вызова из потока таймеров.
+     */
+    void disconnect();
+
+    /**
+     * @brief Подключение сигнала отсоединения потока чтения от сокета
+     *
+     * Поток чтения ждет данные вместе с дескриптором пробуждения; если
+     * после пробуждения выставлен флаг, поток завершается, не закрывая
+     * сокет (он передается новому процессу). Вызывать до start().
+     * Без сигнала поток просто блокируется в recv.
+     * @param wakeFd Дескриптор, готовность которого будит поток чтения
+     * @param detachRequested Флаг запроса отсоединения
+     */
+    void setDetachSignal(int wakeFd, const std::atomic<bool>* detachRequested);
+
+    /**
+     * @brief Подключение общей статистики исходящих очередей
+     * @param stats Статистика (живет дольше обработчика; вызывать до start())
+     */
+    void setOutboundStats(OutboundStats* stats) { m_outboundStats = stats; }
+
+    /**
+     * @brief Размер буфера одного чтения из транспорта
+     * @param bytes Размер (вызывать до start())
+     */
+    void setReceiveBufferSize(size_t bytes) { m_receiveBufferSize = bytes; }
+
+    /**
+     * @brief Процессоры потока чтения соединения
+     *
+     * Поток закрепляется до выделения буферов чтения, поэтому они
+     * размещаются на узле NUMA этих процессоров.
+     * @param cpus Процессоры (пусто - без закрепления; вызывать до start())
+     */
+    void setCpuAffinity(const std::vector<int>& cpus) { m_cpus = cpus; }
+
+    /**
+     * @brief Ожидание завершения потока чтения после запроса отсоединения
+     *
+     * Соединение не через сокет передать нельзя: оно отключается.
+     */
+    void waitDetached();
+
+    /**
+     * @brief Передача сокета вызывающему после отсоединения
+     *
+     * После вызова обработчик больше не владеет сокетом и не отправляет данные.
+     * Соединение через разделяемую память или не через сокет не передается:
+     * оно закрывается для клиента, и тот восстанавливает сессию заново.
+     * @param pendingInput Принятые байты незавершенного кадра
+     * @return Сокет или INVALID_SOCKET, если соединение уже закрыто
+     */
+    socket_t releaseSocket(std::string& pendingInput);
+
+    /**
+     * @brief Байты незавершенного кадра, принятые предыдущим процессом
+     * @param pendingInput Байты (вызывать до start())
+     */
+    void setPendingInput(const std::string& pendingInput) { m_pendingInput = pendingInput; }
+
+    /**
+     * @brief Установка адреса клиента
+     * @param address Адрес (вызывать до start())
+     */
+    void setPeerAddress(const std::string& address) { m_peerAddress = address; }
+
+    /**
+     * @brief Получение адреса клиента
+     * @return IP-адрес клиента
+     */
+    const std::string& getPeerAddress() const { return m_peerAddress; }
+
     /**
      * @brief Проверка активности клиента
      * @return true если клиент активен
@@ -61,27 +181,157 @@ public:
      * @brief Получение пользователя
      * @return Указатель на пользователя
      */
-    std::shared_ptr<User> getUser() const { return m_user; }
+    std::shared_ptr<User> getUser() const;
 
     /**
      * @brief Установка пользователя
      * @param user Указатель на пользователя
      */
-    void setUser(std::shared_ptr<User> user) { m_user = user; }
+    void setUser(std::shared_ptr<User> user);
+
+    /**
+     * @brief Время последнего приема данных от клиента
+     * @return Время, нс с эпохи
+     */
+    int64_t getLastActivityNs() const { return m_lastActivityNs.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Сохранение идентификатора таймера срока входа
+     * @param timerId Идентификатор таймера
+     */
+    void setLoginTimer(uint64_t timerId) { m_loginTimer.store(timerId); }
+
+    /**
+     * @brief Извлечение идентификатора таймера срока входа
+     * @return Идентификатор таймера (0, если уже извлечен)
+     */
+    uint64_t takeLoginTimer() { return m_loginTimer.exchange(0); }
+
+    /**
+     * @brief Сохранение сессии, под которой вошел пользователь
+     * @param sessionId ID сессии
+     * @param expiresMs Срок действия токена, мс с эпохи Unix
+     */
+    void setSession(uint64_t sessionId, int64_t expiresMs);
+
+    /**
+     * @brief Получение сессии соединения
+     * @param expiresMs Срок действия токена
+     * @return ID сессии (0 - вход не выполнен)
+     */
+    uint64_t getSession(int64_t& expiresMs) const;
+
+    /**
+     * @brief Установка канала надежной доставки сессии
+     * @param channel Канал (nullptr - доставка без номеров)
+     */
+    void setChannel(std::shared_ptr<ReliableChannel> channel);
+
+    /**
+     * @brief Получение канала надежной доставки
+     * @return Канал или nullptr
+     */
+    std::shared_ptr<ReliableChannel> getChannel() const;
+
+    /**
+     * @brief Продолжение сессии на этом соединении
+     *
+     * Под мьютексом отправки устанавливает канал, отправляет ответ и
+     * повторяет неподтвержденные сообщения: новые сообщения не могут
+     * вклиниться между ними.
+     * @param channel Канал сессии
+     * @param peerAck Последний номер, принятый клиентом до переподключения
+     * @param reply Ответ на восстановление сессии
+     * @return Количество повторенных сообщений
+     */
+    size_t resumeChannel(std::shared_ptr<ReliableChannel> channel, uint64_t peerAck, const Message& reply);
+
+    /**
+     * @brief Отправка отложенного подтверждения, если оно еще нужно
+     *
+     * Подтверждение уходит служебным кадром через исходящую очередь.
+     */
+    void flushAck();
 
     /**
      * @brief Отправка сообщения клиенту
+     *
+     * Сообщение ставится в очередь своего класса приоритета. Номер канала
+     * надежной доставки и подтверждение оно получает при записи, поэтому
+     * номера идут в порядке записи; при заполненном окне (клиент не
+     * подтверждает прием) соединение разрывается. Если соединение
+     * закроется раньше записи, пронумерованные сообщения остаются в окне
+     * повтора.
      * @param message Сообщение для отправки
-     * @return true если сообщение отправлено успешно
+     * @return true если сообщение принято к отправке
      */
     bool sendMessage(const Message& message);
 
+    /**
+     * @brief Отправка сообщения клиенту без копирования
+     *
+     * Сообщение переносится в очередь, а при записи получает номер и время
+     * отправки на месте и сериализуется в буфер соединения, поэтому
+     * отправка не выделяет память.
+     * @param message Сообщение для отправки
+     * @return true если сообщение принято к отправке
+     */
+    bool sendMessage(Message&& message);
+
+    /**
+     * @brief Отправка сообщения с содержимым, сериализованным заранее
+     *
+     * Как sendMessage(Message&&), но при записи сериализуется только
+     * заголовок, а содержимое берется готовым: одно сообщение нескольким
+     * получателям экранируется один раз.
+     * @param message Сообщение для отправки (содержимое остается в нем
+     *                для повтора после RESUME)
+     * @param content Содержимое (результат message.serializeContent())
+     * @return true если сообщение принято к отправке
+     */
+    bool sendMessage(Message&& message, std::shared_ptr<const std::string> content);
+
+    /**
+     * @brief Отправка уже сериализованного кадра
+     *
+     * Потокобезопасна: кадры от разных потоков не перемешиваются,
+     * частичная запись досылается до конца.
+     * @param frame Кадр (результат Message::serialize)
+     * @param priority Класс приоритета кадра
+     * @return true если кадр принят к отправке
+     */
+    bool sendFrame(const std::string& frame, OutboundQueue::Priority priority);
+
     /**
      * @brief Установка обработчика входящих сообщений
      * @param handler Функция-обработчик
      */
     void setMessageHandler(std::function<void(int, const Message&)> handler);
 
+    /**
+     * @brief Установка обработчика превышения ограничения скорости соединения
+     * @param handler Функция-обработчик (ID клиента, размер отклоненного кадра)
+     */
+    void setRateLimitHandler(std::function<void(int, size_t)> handler);
+
+    /**
+     * @brief Установка обработчика отключения клиента
+     *
+     * Вызывается из потока соединения последним действием перед его завершением.
+     * @param handler Функция-обработчик
+     */
+    void setDisconnectHandler(std::function<void(int)> handler);
+
+    /**
+     * @brief Проверка, пора ли снова сообщать клиенту об отказе
+     *
+     * Ограничивает ответы ERROR одним в секунду, чтобы отказ
+     * не превращался в усиление потока от клиента.
+     * @param nowNs Текущее время, нс
+     * @return true если клиента нужно уведомить
+     */
+    bool shouldNotifyRejection(int64_t nowNs);
+
 private:
     /**
      * @brief Основной цикл обработки клиента
@@ -100,18 +350,81 @@ private:
      */
     void sendResponse(const Message& message);
 
+    /**
+     * @brief Переход соединения на разделяемую память по кадру SHM_ATTACH
+     *
+     * Использует дескрипторы, принятые вместе с кадром; отвечает
+     * "SHM_OK" по сокету последним кадром перед переключением
+     * или ошибкой "SHM_FAILED" (в том числе для соединения не через сокет).
+     */
+    void attachSharedMemory();
+
+    /**
+     * @brief Разбор исходящей очереди до опустошения
+     *
+     * Выполняет поток, который застал очередь пустой (m_draining).
+     * Если соединение закрылось, оставшиеся сообщения отбрасываются,
+     * а пронумерованные сохраняются в окне повтора.
+     */
+    void drainOutbound();
+
+    /**
+     * @brief Запись элемента очереди
+     * @param entry Элемент
+     * @return true если кадр отправлен целиком
+     */
+    bool writeEntry(OutboundQueue::Entry& entry);
+
+    /**
+     * @brief Запись кадра в транспорт (вызывается под m_sendMutex)
+     *
+     * При неудаче соединение разрывается: часть кадра могла уйти.
+     * @param frame Кадр
+     * @return true если кадр отправлен целиком
+     */
+    bool writeFrame(const std::string& frame);
+
+    /**
+     * @brief Освобождение транспорта соединения
+     */
+    void closeSocket();
+
     /**
      * @brief Обработка ошибок сети
      * @param error Код ошибки
      */
     void handleNetworkError(int error);
 
-    socket_t m_clientSocket;                        ///< Сокет клиента
+    std::unique_ptr<Transport> m_transport;         ///< Транспорт соединения
+    SocketTransport* m_socketTransport;             ///< Тот же транспорт, если это сокет (иначе nullptr)
     int m_clientId;                                 ///< ID клиента
+    std::string m_peerAddress;                      ///< IP-адрес клиента
     std::atomic<bool> m_active;                     ///< Флаг активности
     std::thread m_clientThread;                     ///< Поток обработки клиента
+    mutable std::mutex m_userMutex;                 ///< Мьютекс пользователя
     std::shared_ptr<User> m_user;                   ///< Пользователь
+    std::mutex m_sendMutex;                         ///< Мьютекс отправки (целостность кадров)
+    std::string m_sendBuffer;                       ///< Буфер сериализации (под m_sendMutex)
+    std::mutex m_queueMutex;                        ///< Мьютекс исходящей очереди
+    OutboundQueue m_outbound;                       ///< Исходящая очередь (под m_queueMutex)
+    bool m_draining;                                ///< Очередь разбирается (под m_queueMutex)
+    OutboundQueue::Entry m_sending;                 ///< Элемент, который записывает разбирающий поток
+    OutboundStats* m_outboundStats;                 ///< Общая статистика очередей (может быть nullptr)
+    MessageRateLimiter m_rateLimiter;               ///< Ограничение скорости соединения
+    std::atomic<int64_t> m_lastRejectionNs;         ///< Время последнего уведомления об отказе
+    std::atomic<int64_t> m_lastActivityNs;          ///< Время последнего приема данных
+    std::atomic<uint64_t> m_loginTimer;             ///< Таймер срока входа
+    uint64_t m_sessionId;                           ///< ID сессии (под m_userMutex)
+    int64_t m_sessionExpiresMs;                     ///< Срок действия токена (под m_userMutex)
+    std::shared_ptr<ReliableChannel> m_channel;     ///< Канал надежной доставки (под m_userMutex)
+    int m_wakeFd;                                   ///< Дескриптор пробуждения потока чтения
+    const std::atomic<bool>* m_detachRequested;     ///< Флаг запроса отсоединения
+    std::string m_pendingInput;                     ///< Байты незавершенного кадра при передаче
+    size_t m_receiveBufferSize;                     ///< Буфер одного чтения, байтов
+    std::vector<int> m_cpus;                        ///< Процессоры потока чтения (пусто - без закрепления)
     std::function<void(int, const Message&)> m_messageHandler; ///< Обработчик сообщений
+    std::function<void(int, size_t)> m_rateLimitHandler; ///< Обработчик превышения скорости
+    std::function<void(int)> m_disconnectHandler;   ///< Обработчик отключения
 };
 
 #endif // CLIENTHANDLER_H
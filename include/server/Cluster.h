@@ -0,0 +1,256 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common/Message.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    typedef SOCKET socket_t;
+#else
+    #include <sys/socket.h>
+    #include <unistd.h>
+    typedef int socket_t;
+    #ifndef INVALID_SOCKET
+        #define INVALID_SOCKET (-1)
+    #endif
+    #ifndef SOCKET_ERROR
+        #define SOCKET_ERROR (-1)
+    #endif
+#endif
+
+/**
+ * @brief Настройки кластера серверов
+ */
+struct ClusterSettings {
+    int nodeId = 0;                                     ///< Номер узла (1..MAX_NODES-1; 0 - кластер выключен)
+    int port = 0;                                       ///< Порт для связей от других узлов
+    std::vector<std::string> peers;                     ///< Адреса других узлов "хост:порт"
+    std::chrono::milliseconds reconnectInterval{1000};  ///< Пауза между попытками подключения к узлу
+    size_t maxQueuedBytes = 16 * 1024 * 1024;           ///< Максимум неотправленных байтов одной связи
+};
+
+/**
+ * @brief Связи между процессами сервера и справочник присутствия
+ *
+ * Каждый узел держит постоянное исходящее соединение к каждому узлу из
+ * списка и принимает входящие на своем порту; по исходящей связи узел
+ * только пишет, по входящей только читает. Кадры связи завершаются
+ * '\n' (вложенное сообщение уже экранировано):
+ *   H|узел            - приветствие с номером узла (в обе стороны);
+ *   P|пользователь|0/1 - вход и выход пользователя на узле-отправителе;
+ *   D|пользователь|<сообщение> - доставка пользователю на узле-получателе;
+ *   B|<сообщение>     - рассылка всем клиентам узла-получателя.
+ * Кадры копятся в очереди связи, пока поток связи пишет предыдущую
+ * пачку, и уходят одним send(); рассылка пересекает связь один раз,
+ * а не по разу на каждого удаленного клиента.
+ *
+ * После подключения узел отправляет снимок своих вошедших пользователей,
+ * а при разрыве входящей связи получатель удаляет из справочника
+ * пользователей ее узла. Кадры, не отправленные до разрыва, теряются.
+ *
+ * ID пользователей в кластере выдаются с шагом MAX_NODES (см.
+ * UserStore::setIdAllocation), поэтому ID определяет узел, где
+ * зарегистрирован пользователь и хранятся сообщения для него.
+ */
+class Cluster {
+public:
+    /**
+     * @brief Максимальное количество узлов (и шаг выдачи ID пользователей)
+     */
+    static constexpr int MAX_NODES = 64;
+
+    /**
+     * @brief Обработчик доставки пользователю этого узла
+     */
+    using DeliverHandler = std::function<void(int userId, const Message& message)>;
+
+    /**
+     * @brief Обработчик рассылки клиентам этого узла
+     */
+    using BroadcastHandler = std::function<void(const Message& message)>;
+
+    /**
+     * @brief Конструктор
+     * @param settings Настройки кластера
+     */
+    explicit Cluster(const ClusterSettings& settings);
+
+    /**
+     * @brief Деструктор (останавливает связи)
+     */
+    ~Cluster();
+
+    /**
+     * @brief Установка обработчика доставки (вызывать до start())
+     * @param handler Функция-обработчик (вызывается из потока входящей связи)
+     */
+    void setDeliverHandler(DeliverHandler handler);
+
+    /**
+     * @brief Установка обработчика рассылки (вызывать до start())
+     * @param handler Функция-обработчик (вызывается из потока входящей связи)
+     */
+    void setBroadcastHandler(BroadcastHandler handler);
+
+    /**
+     * @brief Открытие порта и запуск связей к узлам
+     * @return true если порт открыт
+     */
+    bool start();
+
+    /**
+     * @brief Закрытие всех связей
+     */
+    void stop();
+
+    /**
+     * @brief Номер этого узла
+     * @return Номер узла
+     */
+    int getNodeId() const { return m_settings.nodeId; }
+
+    /**
+     * @brief Узел, где зарегистрирован пользователь
+     * @param userId ID пользователя
+     * @return Номер узла
+     */
+    static int homeNode(int userId) { return userId % MAX_NODES; }
+
+    /**
+     * @brief Объявление входа или выхода пользователя на этом узле
+     * @param userId ID пользователя
+     * @param online true - вход, false - выход
+     */
+    void publishPresence(int userId, bool online);
+
+    /**
+     * @brief Поиск узла, на котором пользователь сейчас в сети
+     * @param userId ID пользователя
+     * @return Номер узла или -1, если пользователь не в сети на других узлах
+     */
+    int findUserNode(int userId) const;
+
+    /**
+     * @brief Пересылка сообщения пользователю на другом узле
+     * @param nodeId Узел получателя
+     * @param userId ID получателя
+     * @param message Сообщение
+     * @return false если связи с узлом нет или ее очередь заполнена
+     */
+    bool forward(int nodeId, int userId, const Message& message);
+
+    /**
+     * @brief Рассылка сообщения клиентам всех остальных узлов
+     * @param message Сообщение
+     */
+    void broadcast(const Message& message);
+
+private:
+    /**
+     * @brief Исходящая связь к узлу
+     */
+    struct Link {
+        std::string host;                           ///< Хост узла
+        int port = 0;                               ///< Порт узла
+        int nodeId = -1;                            ///< Номер узла (известен после приветствия)
+        socket_t socket = INVALID_SOCKET;           ///< Сокет связи
+        bool connected = false;                     ///< Приветствие завершено, связь принимает кадры
+        std::string queue;                          ///< Кадры, ожидающие отправки
+        std::mutex mutex;                           ///< Мьютекс очереди и состояния
+        std::condition_variable cv;                 ///< Пробуждение потока связи
+        std::thread thread;                         ///< Поток подключения и отправки
+    };
+
+    /**
+     * @brief Входящая связь от узла
+     */
+    struct Inbound {
+        socket_t socket = INVALID_SOCKET;           ///< Сокет связи
+        std::atomic<bool> finished{false};          ///< Поток чтения завершился
+        std::thread thread;                         ///< Поток чтения
+    };
+
+    /**
+     * @brief Цикл приема входящих связей
+     */
+    void acceptLoop();
+
+    /**
+     * @brief Цикл чтения входящей связи
+     * @param inbound Связь
+     */
+    void readLoop(Inbound& inbound);
+
+    /**
+     * @brief Цикл исходящей связи: подключение, приветствие, отправка пачек
+     * @param link Связь
+     */
+    void linkLoop(Link& link);
+
+    /**
+     * @brief Подключение к узлу и обмен приветствиями
+     * @param link Связь
+     * @return true если связь готова
+     */
+    bool connectLink(Link& link);
+
+    /**
+     * @brief Закрытие исходящей связи с потерей неотправленных кадров
+     * @param link Связь
+     */
+    void closeLink(Link& link);
+
+    /**
+     * @brief Постановка кадра в очередь связи
+     * @param link Связь
+     * @param frame Кадр
+     * @param nodeId Узел, которому предназначен кадр (-1 - любой)
+     * @return false если связь не готова, ведет к другому узлу или очередь заполнена
+     */
+    bool enqueue(Link& link, const std::string& frame, int nodeId = -1);
+
+    /**
+     * @brief Обработка кадра входящей связи
+     * @param nodeId Узел-отправитель
+     * @param frame Кадр без разделителя
+     */
+    void handleFrame(int nodeId, const std::string& frame);
+
+    /**
+     * @brief Удаление из справочника пользователей узла
+     * @param nodeId Номер узла
+     */
+    void dropNode(int nodeId);
+
+    /**
+     * @brief Освобождение завершившихся потоков чтения
+     */
+    void reapInbound();
+
+    ClusterSettings m_settings;                     ///< Настройки
+    DeliverHandler m_deliverHandler;                ///< Обработчик доставки
+    BroadcastHandler m_broadcastHandler;            ///< Обработчик рассылки
+    std::atomic<bool> m_running;                    ///< Флаг работы
+    socket_t m_listener;                            ///< Сокет для входящих связей
+    std::thread m_acceptThread;                     ///< Поток приема связей
+    std::vector<std::unique_ptr<Link>> m_links;     ///< Исходящие связи
+    std::mutex m_inboundMutex;                      ///< Мьютекс входящих связей
+    std::vector<std::unique_ptr<Inbound>> m_inbound; ///< Входящие связи
+    mutable std::mutex m_presenceMutex;             ///< Мьютекс присутствия
+    std::unordered_set<int> m_localUsers;           ///< Пользователи, вошедшие на этом узле
+    std::unordered_map<int, int> m_directory;       ///< Пользователи других узлов: ID -> узел
+    std::unordered_map<int, int> m_inboundCount;    ///< Открытые входящие связи по узлам
+};
+
+#endif // CLUSTER_H
@@ -0,0 +1,80 @@
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Раскладка процессоров по узлам NUMA и закрепление потоков
+ *
+ * Топология читается из /sys/devices/system/node (Linux). Где она
+ * недоступна, все процессоры считаются одним узлом, а закрепление
+ * потоков ничего не делает.
+ *
+ * Память, которую поток впервые записывает после закрепления, ядро
+ * выделяет на узле этого потока, поэтому буферы, созданные самим
+ * закрепленным потоком, оказываются локальными для его узла.
+ */
+class CpuTopology {
+public:
+    /**
+     * @brief Конструктор: один узел без известных процессоров
+     */
+    CpuTopology();
+
+    /**
+     * @brief Определение топологии текущей машины
+     * @return Топология
+     */
+    static CpuTopology detect();
+
+    /**
+     * @brief Разбор списка процессоров вида "0-3,8,10-11"
+     * @param text Список
+     * @param cpus Номера процессоров по возрастанию без повторов
+     * @return false если список записан неверно
+     */
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+    /**
+     * @brief Запись списка процессоров в виде "0-3,8"
+     * @param cpus Номера процессоров по возрастанию
+     * @return Список
+     */
+    static std::string formatCpuList(const std::vector<int>& cpus);
+
+    /**
+     * @brief Закрепление текущего потока за процессорами
+     * @param cpus Процессоры (пустой список - без изменений)
+     * @return true если закрепление выполнено
+     */
+    static bool pinCurrentThread(const std::vector<int>& cpus);
+
+    /**
+     * @brief Количество узлов NUMA
+     * @return Узлов (не меньше одного)
+     */
+    size_t nodeCount() const { return m_nodeCount; }
+
+    /**
+     * @brief Узел процессора
+     * @param cpu Номер процессора
+     * @return Номер узла или -1, если процессор неизвестен
+     */
+    int nodeOf(int cpu) const;
+
+    /**
+     * @brief Процессоры из списка, принадлежащие узлу
+     * @param cpus Список процессоров
+     * @param node Номер узла
+     * @return Процессоры узла в порядке списка
+     */
+    std::vector<int> cpusOnNode(const std::vector<int>& cpus, int node) const;
+
+private:
+    std::vector<int> m_cpuNode; ///< Номер процессора -> узел (-1 - нет процессора)
+    size_t m_nodeCount;         ///< Количество узлов
+};
+
+#endif // CPUTOPOLOGY_H
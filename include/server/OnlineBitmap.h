@@ -0,0 +1,76 @@
+#ifndef ONLINEBITMAP_H
+#define ONLINEBITMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Битовая карта пользователей в сети, индексированная ID
+ *
+ * Один бит на пользователя: миллион пользователей занимает 128 КиБ.
+ * Биты хранятся страницами по 65536, страница выделяется при первой
+ * установке бита в ее диапазоне (ID пользователей выдаются подряд,
+ * поэтому занятые страницы плотные). Проверка и установка бита не
+ * блокируют: снимок присутствия сотен контактов читается без мьютекса
+ * и без поиска в хеш-таблице соединений.
+ */
+class OnlineBitmap {
+public:
+    /**
+     * @brief Конструктор: пустая карта
+     */
+    OnlineBitmap();
+
+    /**
+     * @brief Деструктор (освобождает страницы)
+     */
+    ~OnlineBitmap();
+
+    OnlineBitmap(const OnlineBitmap&) = delete;
+    OnlineBitmap& operator=(const OnlineBitmap&) = delete;
+
+    /**
+     * @brief Установка состояния пользователя
+     * @param userId ID пользователя (отрицательные не хранятся)
+     * @param online true - в сети
+     * @return true если состояние изменилось
+     */
+    bool set(int userId, bool online);
+
+    /**
+     * @brief Проверка состояния пользователя
+     * @param userId ID пользователя
+     * @return true если пользователь в сети
+     */
+    bool test(int userId) const;
+
+    /**
+     * @brief Количество пользователей в сети
+     * @return Количество установленных битов
+     */
+    size_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int PAGE_BITS = 16;                                ///< Разрядность номера бита в странице
+    static constexpr size_t PAGE_WORDS = (size_t(1) << PAGE_BITS) / 64; ///< Слов в странице
+    static constexpr size_t PAGE_COUNT = size_t(1) << (31 - PAGE_BITS); ///< Страниц на все неотрицательные ID
+
+    typedef std::atomic<uint64_t> Word;
+
+    /**
+     * @brief Слово карты, содержащее бит пользователя
+     * @param userId ID пользователя
+     * @param create Выделить страницу, если ее нет
+     * @return Слово или nullptr, если страницы нет
+     */
+    Word* word(int userId, bool create) const;
+
+    std::unique_ptr<std::atomic<Word*>[]> m_pages;  ///< Страницы (nullptr - не выделена)
+    mutable std::mutex m_pagesMutex;                ///< Мьютекс выделения страниц
+    std::atomic<size_t> m_count;                    ///< Установленных битов
+};
+
+#endif // ONLINEBITMAP_H
@@ -0,0 +1,224 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common/Message.h"
+
+/**
+ * @brief Исходящая очередь соединения с классами приоритета
+ *
+ * Сообщения делятся на классы по типу (classify): служебные кадры
+ * (ERROR, STATUS, LOGOUT, PING/PONG, ACK), личные сообщения и объемные
+ * данные (файлы и рассылки всем). У каждого класса своя очередь, а
+ * очередь для отправки выбирается по алгоритму deficit round robin: за
+ * свой ход класс получает квант байтов и отправляет сообщения, пока
+ * квант не исчерпан. Служебные кадры, кроме того, проходят вне очереди,
+ * пока у их класса есть неизрасходованный квант, поэтому ответ на вход
+ * или PING не ждет за мегабайтным файлом, а объемные данные все равно
+ * получают свою долю.
+ *
+ * Класс не потокобезопасен: синхронизацию обеспечивает владелец.
+ */
+class OutboundQueue {
+public:
+    /**
+     * @brief Класс приоритета
+     */
+    enum class Priority {
+        CONTROL = 0,    ///< Служебные кадры
+        INTERACTIVE,    ///< Личные сообщения
+        BULK            ///< Файлы и рассылки всем
+    };
+
+    static constexpr size_t PRIORITY_COUNT = 3;
+
+    /**
+     * @brief Квант байтов класса за один ход
+     *
+     * Отношение квантов задает доли пропускной способности классов,
+     * когда все очереди заняты.
+     */
+    static constexpr size_t QUANTUM_BYTES[PRIORITY_COUNT] = {16 * 1024, 16 * 1024, 4 * 1024};
+
+    /**
+     * @brief Оценка заголовка кадра для сообщений, еще не сериализованных
+     */
+    static constexpr size_t FRAME_OVERHEAD = 64;
+
+    /**
+     * @brief Элемент очереди: сообщение или готовый кадр
+     */
+    struct Entry {
+        Message message;            ///< Сообщение (сериализуется при отправке)
+        std::string frame;          ///< Готовый кадр (если serialized)
+        std::shared_ptr<const std::string> content; ///< Общее сериализованное содержимое (может быть nullptr)
+        bool serialized = false;    ///< Элемент - готовый кадр
+        Priority priority = Priority::CONTROL; ///< Класс приоритета
+        size_t bytes = 0;           ///< Размер кадра (для сообщения - оценка)
+        int64_t enqueuedNs = 0;     ///< Время постановки в очередь
+    };
+
+    /**
+     * @brief Класс приоритета сообщения
+     * @param message Сообщение
+     * @return Класс по типу и получателю
+     */
+    static Priority classify(const Message& message);
+
+    /**
+     * @brief Конструктор
+     */
+    OutboundQueue();
+
+    /**
+     * @brief Постановка сообщения в очередь его класса
+     * @param message Сообщение
+     * @param nowNs Текущее время, нс
+     */
+    void push(Message&& message, int64_t nowNs);
+
+    /**
+     * @brief Постановка сообщения с уже сериализованным содержимым
+     * @param message Сообщение (заголовок сериализуется при отправке)
+     * @param content Содержимое (результат Message::serializeContent)
+     * @param nowNs Текущее время, нс
+     */
+    void push(Message&& message, std::shared_ptr<const std::string> content, int64_t nowNs);
+
+    /**
+     * @brief Постановка готового кадра
+     * @param frame Кадр (результат Message::serialize)
+     * @param priority Класс приоритета
+     * @param nowNs Текущее время, нс
+     */
+    void pushFrame(const std::string& frame, Priority priority, int64_t nowNs);
+
+    /**
+     * @brief Извлечение следующего элемента для отправки
+     *
+     * Буферы элемента переиспользуются: в установившемся режиме
+     * извлечение не выделяет память.
+     * @param entry Элемент (перезаписывается)
+     * @return false если очередь пуста
+     */
+    bool pop(Entry& entry);
+
+    /**
+     * @brief Проверка пустоты
+     * @return true если ни в одном классе нет элементов
+     */
+    bool empty() const { return m_count == 0; }
+
+    /**
+     * @brief Количество элементов во всех классах
+     * @return Количество элементов
+     */
+    size_t size() const { return m_count; }
+
+    /**
+     * @brief Суммарный размер элементов
+     * @return Байтов (для сообщений - оценка)
+     */
+    size_t bytes() const { return m_bytes; }
+
+private:
+    /**
+     * @brief Очередь одного класса: растущее кольцо элементов
+     */
+    struct Lane {
+        std::vector<Entry> ring;    ///< Кольцо (растет вдвое, не сжимается)
+        size_t head = 0;            ///< Первый элемент
+        size_t count = 0;           ///< Количество элементов
+        size_t deficit = 0;         ///< Неизрасходованный квант, байтов
+    };
+
+    /**
+     * @brief Свободная ячейка в конце очереди класса
+     * @param priority Класс
+     * @return Ячейка (уже учтена в счетчиках)
+     */
+    Entry& append(Priority priority);
+
+    /**
+     * @brief Извлечение первого элемента класса
+     * @param lane Очередь класса
+     * @param entry Элемент (перезаписывается)
+     */
+    void take(Lane& lane, Entry& entry);
+
+    Lane m_lanes[PRIORITY_COUNT];   ///< Очереди классов
+    size_t m_current;               ///< Класс, чей ход идет
+    bool m_turnStarted;             ///< Квант текущего хода уже начислен
+    size_t m_count;                 ///< Элементов во всех классах
+    size_t m_bytes;                 ///< Суммарный размер элементов
+};
+
+/**
+ * @brief Задержка в исходящей очереди для одного класса
+ */
+struct QueueLatency {
+    uint64_t messages = 0;  ///< Отправлено сообщений
+    uint64_t meanNs = 0;    ///< Среднее ожидание в очереди, нс
+    uint64_t p99Ns = 0;     ///< 99-й перцентиль (верхняя граница степени двойки), нс
+    uint64_t maxNs = 0;     ///< Наибольшее ожидание, нс
+};
+
+/**
+ * @brief Общая статистика исходящих очередей всех соединений
+ *
+ * Потокобезопасна: счетчики атомарные, время ожидания
+ * раскладывается по корзинам степеней двойки.
+ */
+class OutboundStats {
+public:
+    /**
+     * @brief Учет отправленного элемента
+     * @param priority Класс приоритета
+     * @param waitNs Время в очереди, нс
+     */
+    void record(OutboundQueue::Priority priority, int64_t waitNs);
+
+    /**
+     * @brief Сводка по классу
+     * @param priority Класс приоритета
+     * @return Количество, среднее, 99-й перцентиль и максимум ожидания
+     */
+    QueueLatency snapshot(OutboundQueue::Priority priority) const;
+
+    /**
+     * @brief Изменение числа байтов в очередях всех соединений
+     * @param delta Приращение (отрицательное при отправке)
+     */
+    void addQueuedBytes(int64_t delta) {
+        m_queuedBytes.fetch_add(static_cast<size_t>(delta), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Байтов в очередях всех соединений
+     * @return Байтов, ожидающих отправки
+     */
+    size_t queuedBytes() const { return m_queuedBytes.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t LATENCY_BUCKETS = 64;
+
+    /**
+     * @brief Счетчики одного класса
+     */
+    struct Lane {
+        std::atomic<uint64_t> messages{0};                  ///< Отправлено сообщений
+        std::atomic<uint64_t> totalNs{0};                   ///< Суммарное ожидание
+        std::atomic<uint64_t> maxNs{0};                     ///< Наибольшее ожидание
+        std::atomic<uint64_t> buckets[LATENCY_BUCKETS] = {}; ///< Ожиданий в [2^i, 2^(i+1)) нс
+    };
+
+    Lane m_lanes[OutboundQueue::PRIORITY_COUNT];    ///< Счетчики классов
+    std::atomic<size_t> m_queuedBytes{0};           ///< Байтов в очередях
+};
+
+#endif // OUTBOUNDQUEUE_H
@@ -0,0 +1,117 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * @brief Корзина токенов
+ *
+ * Токены пополняются с постоянной скоростью до размера корзины;
+ * операция разрешена, если в корзине хватает токенов на ее стоимость.
+ * Класс не потокобезопасен: синхронизацию обеспечивает владелец.
+ */
+class TokenBucket {
+public:
+    /**
+     * @brief Конструктор
+     * @param ratePerSecond Скорость пополнения, токенов в секунду
+     * @param burst Емкость корзины (допустимый всплеск)
+     */
+    TokenBucket(double ratePerSecond, double burst);
+
+    /**
+     * @brief Попытка списать токены
+     * @param cost Стоимость операции
+     * @param nowNs Текущее время, нс
+     * @return true если токенов достаточно и они списаны
+     */
+    bool tryConsume(double cost, int64_t nowNs);
+
+private:
+    double m_ratePerNs;     ///< Скорость пополнения, токенов в наносекунду
+    double m_burst;         ///< Емкость корзины
+    double m_tokens;        ///< Текущее количество токенов
+    int64_t m_lastRefillNs; ///< Время последнего пополнения (0 - еще не было)
+};
+
+/**
+ * @brief Ограничения скорости для одного ключа (соединения или пользователя)
+ */
+struct RateLimits {
+    double messagesPerSecond = 100.0;       ///< Сообщений в секунду
+    double messageBurst = 200.0;            ///< Допустимый всплеск сообщений
+    double bytesPerSecond = 1024.0 * 1024;  ///< Байтов в секунду
+    double byteBurst = 2.0 * 1024 * 1024;   ///< Допустимый всплеск байтов
+};
+
+/**
+ * @brief Пара корзин "сообщения + байты"
+ */
+class MessageRateLimiter {
+public:
+    /**
+     * @brief Конструктор
+     * @param limits Ограничения
+     */
+    explicit MessageRateLimiter(const RateLimits& limits = RateLimits());
+
+    /**
+     * @brief Учет одного сообщения
+     * @param bytes Размер сообщения
+     * @param nowNs Текущее время, нс
+     * @return true если сообщение укладывается в оба ограничения
+     */
+    bool tryConsume(size_t bytes, int64_t nowNs);
+
+private:
+    TokenBucket m_messages;     ///< Корзина сообщений
+    TokenBucket m_bytes;        ///< Корзина байтов
+};
+
+/**
+ * @brief Ограничение скорости по пользователям
+ *
+ * Общая корзина на пользователя, сколько бы соединений он ни открыл.
+ * Потокобезопасен.
+ */
+class UserRateLimiter {
+public:
+    /**
+     * @brief Конструктор
+     * @param limits Ограничения на одного пользователя
+     */
+    explicit UserRateLimiter(const RateLimits& limits = RateLimits());
+
+    /**
+     * @brief Учет сообщения пользователя
+     * @param userId ID пользователя
+     * @param bytes Размер сообщения
+     * @param nowNs Текущее время, нс
+     * @return true если сообщение укладывается в ограничения пользователя
+     */
+    bool tryConsume(int userId, size_t bytes, int64_t nowNs);
+
+    /**
+     * @brief Смена ограничений
+     *
+     * Корзины пользователей создаются заново с новыми ограничениями.
+     * @param limits Ограничения на одного пользователя
+     */
+    void setLimits(const RateLimits& limits);
+
+    /**
+     * @brief Забыть пользователя (например, после выхода из системы)
+     * @param userId ID пользователя
+     */
+    void remove(int userId);
+
+private:
+    RateLimits m_limits;                                    ///< Ограничения
+    std::mutex m_mutex;                                     ///< Мьютекс карты корзин
+    std::unordered_map<int, MessageRateLimiter> m_users;    ///< Корзины пользователей
+};
+
+#endif // RATELIMITER_H
@@ -6,10 +6,28 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <deque>
+#include <chrono>
 #include <string>
 #include <functional>
+#include <atomic>
+#include <cstdint>
+#include "common/Endpoint.h"
 #include "common/User.h"
 #include "common/Message.h"
+#include "common/PresenceUpdate.h"
+#include "server/AuthPool.h"
+#include "server/ClientHandler.h"
+#include "server/Cluster.h"
+#include "server/CpuTopology.h"
+#include "server/OnlineBitmap.h"
+#include "server/RateLimiter.h"
+#include "server/ServerConfig.h"
+#include "server/SessionTokens.h"
+#include "server/TimerWheel.h"
+#include "server/UpgradeChannel.h"
+#include "server/UserStore.h"
+#include "server/WorkerPool.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -20,14 +38,37 @@
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
+    #include <unistd.h>
     typedef int socket_t;
+    #ifndef INVALID_SOCKET
+        #define INVALID_SOCKET (-1)
+    #endif
+    #ifndef SOCKET_ERROR
+        #define SOCKET_ERROR (-1)
+    #endif
 #endif
 
+/**
+ * @brief Счетчики отказов сервера и состояние исходящих очередей
+ */
+struct ServerStats {
+    uint64_t rejectedConnections = 0;   ///< Подключения, отклоненные из-за перегрузки
+    uint64_t rateLimitedMessages = 0;   ///< Сообщения сверх ограничения скорости
+    uint64_t shedMessages = 0;          ///< Сообщения, сброшенные из-за перегрузки
+    uint64_t rejectedLogins = 0;        ///< Входы, отклоненные из-за перегрузки проверки паролей
+    uint64_t failedLogins = 0;          ///< Входы с неверным паролем
+    size_t outboundQueuedBytes = 0;     ///< Байтов в исходящих очередях соединений
+    QueueLatency outboundLatency[OutboundQueue::PRIORITY_COUNT]; ///< Ожидание в исходящих очередях по классам
+};
+
 /**
  * @brief Класс сервера для обработки клиентских подключений
  * 
  * Этот класс реализует многопоточный сервер, который может обрабатывать
- * множественные клиентские подключения одновременно.
+ * множественные клиентские подключения одновременно. Каждое подключение
+ * читается своим ClientHandler, а разбор и маршрутизация сообщений
+ * выполняются пулом рабочих потоков; сообщения одного клиента
+ * обрабатываются по порядку.
  */
 class Server {
 public:
@@ -37,6 +78,12 @@ public:
      */
     explicit Server(int port = 8080);
 
+    /**
+     * @brief Конструктор с настройками
+     * @param config Настройки (порт, пулы потоков, буферы, сокеты, ограничения)
+     */
+    explicit Server(const ServerConfig& config);
+
     /**
      * @brief Деструктор сервера
      */
@@ -48,6 +95,87 @@ public:
      */
     bool start();
 
+    /**
+     * @brief Запуск с сокетами, переданными работающим процессом
+     *
+     * Подключается к управляющему сокету работающего сервера (см.
+     * enableHotUpgrade), получает слушающий сокет, открытые соединения
+     * с их состоянием, пользователей и сохраненные сообщения и продолжает
+     * обслуживание без разрыва соединений.
+     * @param controlPath Путь к управляющему сокету работающего процесса
+     * @return true если соединения приняты и сервер запущен
+     */
+    bool takeOver(const std::string& controlPath);
+
+    /**
+     * @brief Дополнительный адрес для приема подключений
+     *
+     * Кроме TCP-порта сервер может слушать другие адреса, например
+     * "unix:/run/chat.sock" для ботов и шлюзов на том же хосте: Unix-сокет
+     * минует стек TCP/IP, а кадры и обработка сообщений те же. Файл
+     * сокета пересоздается при запуске и удаляется при остановке.
+     * Через Unix-сокет клиент может перейти на разделяемую память
+     * (адрес "shm:" у клиента); сам адрес "shm:" не слушается.
+     * Вызывать до start() или takeOver(). Только для POSIX-систем.
+     * @param address Адрес (см. Endpoint)
+     * @return true если адрес корректен
+     */
+    bool addListenAddress(const std::string& address);
+
+    /**
+     * @brief Подключение клиента через готовый транспорт
+     *
+     * Соединение обслуживается так же, как принятое из сокета, но байты
+     * идут через переданный транспорт. Конец LoopbackTransport позволяет
+     * гонять тысячи клиентов в одном процессе без сокетов и измерять
+     * только обработку сообщений. Такие соединения не передаются при
+     * горячем обновлении. Вызывать после start().
+     * @param transport Транспорт соединения со стороны сервера
+     * @param peerAddress Адрес клиента для журнала и ограничений входа
+     * @return ID клиента или -1, если сервер не запущен или перегружен
+     */
+    int attachConnection(std::unique_ptr<Transport> transport, const std::string& peerAddress = "loopback");
+
+    /**
+     * @brief Включение горячего обновления
+     *
+     * Сервер слушает управляющий Unix-сокет. Когда к нему подключается
+     * новый процесс (takeOver), сервер перестает принимать подключения
+     * и читать сокеты, дорабатывает очередь сообщений, передает все
+     * сокеты и состояние новому процессу и останавливается.
+     * Вызывать до start() или takeOver(). Только для POSIX-систем.
+     * @param controlPath Путь к управляющему сокету
+     * @return true если горячее обновление поддерживается
+     */
+    bool enableHotUpgrade(const std::string& controlPath);
+
+    /**
+     * @brief Включение сохранения пользователей на диск
+     *
+     * Реестр пользователей и контактов хранится в каталоге как снимок
+     * и журнал упреждающей записи (см. UserStore). Вызывать до start()
+     * или takeOver().
+     * @param directory Каталог данных
+     */
+    void setDataDirectory(const std::string& directory);
+
+    /**
+     * @brief Включение режима кластера
+     *
+     * Узлы обмениваются присутствием пользователей и пересылают друг
+     * другу личные сообщения и рассылки (см. Cluster). ID новых
+     * пользователей выдаются с шагом Cluster::MAX_NODES и остатком,
+     * равным номеру узла. Вызывать до start() или takeOver().
+     * @param settings Настройки кластера
+     */
+    void setCluster(const ClusterSettings& settings);
+
+    /**
+     * @brief Проверка, переданы ли соединения новому процессу
+     * @return true если сервер остановлен передачей соединений
+     */
+    bool isHandedOff() const { return m_handedOff; }
+
     /**
      * @brief Остановка сервера
      */
@@ -59,12 +187,90 @@ public:
      */
     bool isRunning() const { return m_running; }
 
+    /**
+     * @brief Установка ограничений скорости для одного подключения
+     * @param limits Ограничения (применяются к новым подключениям)
+     */
+    void setConnectionRateLimits(const RateLimits& limits);
+
+    /**
+     * @brief Установка ограничений скорости для одного пользователя
+     * @param limits Ограничения (корзины пользователей создаются заново)
+     */
+    void setUserRateLimits(const RateLimits& limits);
+
+    /**
+     * @brief Установка порогов перегрузки
+     * @param limits Пороги
+     */
+    void setOverloadLimits(const OverloadLimits& limits);
+
+    /**
+     * @brief Установка сроков проверки соединений и хранения сообщений
+     * @param timeouts Сроки (применяются к новым подключениям и сообщениям)
+     */
+    void setTimeouts(const TimeoutSettings& timeouts);
+
+    /**
+     * @brief Установка ограничений пула проверки паролей
+     * @param limits Ограничения (вызывать до start())
+     */
+    void setAuthLimits(const AuthLimits& limits);
+
+    /**
+     * @brief Применение новых настроек без перезапуска
+     *
+     * Ограничения скорости, пороги перегрузки и сроки действуют сразу
+     * (корзины ограничений пользователей создаются заново), размер буфера
+     * приема и параметры сокетов - для новых соединений. Параметры,
+     * требующие перезапуска (ServerConfig::restartRequired), сохраняют
+     * прежние значения, о чем пишется предупреждение в журнал.
+     * Безопасна для вызова из любого потока.
+     * @param config Новые настройки
+     */
+    void applyConfig(const ServerConfig& config);
+
+    /**
+     * @brief Текущие настройки
+     * @return Копия действующих настроек
+     */
+    ServerConfig getConfig() const;
+
+    /**
+     * @brief Установка функции проверки пароля
+     *
+     * Функция выполняется в пуле проверки паролей, а не в потоках
+     * соединений и маршрутизации, поэтому может быть дорогой (стойкий
+     * хеш с солью). Без функции принимается любой пароль.
+     * @param verifier Функция проверки (вызывать до start())
+     */
+    void setPasswordVerifier(AuthPool::Verifier verifier);
+
+    /**
+     * @brief Проверка перегрузки сервера
+     * @return true если превышен порог очереди или отправки
+     */
+    bool isOverloaded() const;
+
+    /**
+     * @brief Получение счетчиков отказов
+     * @return Счетчики
+     */
+    ServerStats getStats() const;
+
     /**
      * @brief Получение количества подключенных клиентов
      * @return Количество активных подключений
      */
     size_t getClientCount() const;
 
+    /**
+     * @brief Проверка, вошел ли пользователь на этом узле
+     * @param userId ID пользователя
+     * @return true если пользователь в сети
+     */
+    bool isUserOnline(int userId) const { return m_online.test(userId); }
+
     /**
      * @brief Отправка сообщения конкретному клиенту
      * @param clientId ID клиента
@@ -101,6 +307,29 @@ public:
      */
     std::shared_ptr<User> getUser(int userId);
 
+    /**
+     * @brief Добавление контакта пользователю
+     * @param userId ID пользователя
+     * @param contactId ID контакта
+     * @return true если оба пользователя существуют и контакт добавлен
+     */
+    bool addContact(int userId, int contactId);
+
+    /**
+     * @brief Удаление контакта пользователя
+     * @param userId ID пользователя
+     * @param contactId ID контакта
+     * @return true если контакт был удален
+     */
+    bool removeContact(int userId, int contactId);
+
+    /**
+     * @brief Получение контактов пользователя
+     * @param userId ID пользователя
+     * @return Отсортированный список ID контактов
+     */
+    std::vector<int> getContacts(int userId) const;
+
     /**
      * @brief Установка обработчика сообщений
      * @param handler Функция-обработчик
@@ -108,24 +337,395 @@ public:
     void setMessageHandler(std::function<void(int, const Message&)> handler);
 
 private:
+    /**
+     * @brief Сообщение, ожидающее подключения получателя
+     */
+    struct OfflineMessage {
+        uint64_t id;                    ///< Номер сообщения
+        Message message;                ///< Сообщение
+        TimerWheel::TimerId timer;      ///< Таймер истечения срока хранения
+    };
+
+    /**
+     * @brief Состояние надежной доставки сессии, переживающее переподключение
+     */
+    struct ReliableSession {
+        int userId;                                 ///< ID пользователя
+        int clientId;                               ///< Текущее соединение (-1 - отключена)
+        std::shared_ptr<ReliableChannel> channel;   ///< Номера и окно повтора
+        TimerWheel::TimerId expiry;                 ///< Таймер удаления после разрыва
+    };
+
+    /**
+     * @brief Дополнительный слушающий сокет
+     */
+    struct Listener {
+        Endpoint endpoint;                          ///< Адрес
+        socket_t socket;                            ///< Сокет
+    };
+
     /**
      * @brief Основной цикл сервера
      */
     void serverLoop();
 
     /**
-     * @brief Обработка нового клиентского подключения
+     * @brief Открытие дополнительных адресов, еще не переданных предыдущим процессом
+     * @return true если все адреса открыты
+     */
+    bool openListeners();
+
+    /**
+     * @brief Закрытие дополнительных слушающих сокетов
+     * @param removeFiles Удалять файлы Unix-сокетов (не при передаче новому процессу)
+     */
+    void closeListeners(bool removeFiles);
+
+    /**
+     * @brief Запуск пула, таймеров и потоков приема на готовом слушающем сокете
+     */
+    void startServing();
+
+    /**
+     * @brief Подключение нового клиента
      * @param clientSocket Сокет клиента
      */
     void handleClient(socket_t clientSocket);
 
     /**
-     * @brief Обработка входящего сообщения
+     * @brief Создание обработчика для нового или переданного соединения
+     * @param clientSocket Сокет клиента
+     * @param state Состояние соединения
+     */
+    void attachClient(socket_t clientSocket, const ConnectionState& state);
+
+    /**
+     * @brief Процессоры потока чтения принятого соединения
+     *
+     * Из процессоров соединений (ServerConfig::ioCpus) выбираются
+     * процессоры узла NUMA, на котором ядро принимает пакеты соединения.
+     * @param clientSocket Сокет клиента
+     * @return Процессоры (пусто - без закрепления)
+     */
+    std::vector<int> connectionCpus(socket_t clientSocket) const;
+
+    /**
+     * @brief Регистрация обработчика соединения и запуск его потока
+     * @param client Обработчик соединения
+     * @param peer Адрес клиента
+     * @param state Состояние соединения
+     */
+    void attachClient(std::shared_ptr<ClientHandler> client, const std::string& peer, const ConnectionState& state);
+
+    /**
+     * @brief Цикл управляющего сокета горячего обновления
+     */
+    void upgradeLoop();
+
+    /**
+     * @brief Передача сокетов и состояния новому процессу (поток обновления)
+     * @param channel Канал к новому процессу
+     * @return true если передача завершена полностью
+     */
+    bool handOff(int channel);
+
+    /**
+     * @brief Восстановление пользователя из записи "id|имя|email"
+     * @param record Запись
+     */
+    void restoreUser(const std::string& record);
+
+    /**
+     * @brief Пробуждение потоков, ожидающих сокеты вместе с каналом пробуждения
+     */
+    void wakeWaiters();
+
+    /**
+     * @brief Прием сообщения от клиента (поток соединения)
+     *
+     * Проверяет ограничения пользователя и перегрузку, затем
+     * передает сообщение в пул рабочих потоков.
+     * @param handler Обработчик клиента
+     * @param message Сообщение
+     */
+    void onClientMessage(ClientHandler& handler, const Message& message);
+
+    /**
+     * @brief Обработка входящего сообщения (рабочий поток)
+     *
+     * Обработчик выбирается по типу через MessageDispatcher.
      * @param clientId ID клиента
      * @param message Сообщение
      */
     void processMessage(int clientId, const Message& message);
 
+    /**
+     * @brief Пересылка текстового сообщения получателю или всем
+     * @param clientId ID клиента-отправителя
+     * @param message Сообщение TEXT
+     */
+    void handleText(int clientId, const Message& message);
+
+    /**
+     * @brief Вход пользователя (первый вход регистрирует пользователя)
+     * @param clientId ID клиента
+     * @param message Сообщение LOGIN с содержимым "имя:пароль"
+     */
+    void handleLogin(int clientId, const Message& message);
+
+    /**
+     * @brief Завершение входа после проверки пароля (рабочий поток)
+     * @param clientId ID клиента
+     * @param username Имя пользователя
+     * @param verified Результат проверки пароля
+     */
+    void completeLogin(int clientId, const std::string& username, bool verified);
+
+    /**
+     * @brief Восстановление сессии по токену без повторной проверки пароля
+     * @param clientId ID клиента
+     * @param message Сообщение RESUME с токеном
+     */
+    void handleResume(int clientId, const Message& message);
+
+    /**
+     * @brief Привязка вошедшего пользователя к соединению
+     *
+     * Снимает срок входа, подключает надежную доставку сессии,
+     * отправляет ответ и сохраненные сообщения.
+     * @param client Соединение
+     * @param user Пользователь
+     * @param session Сессия соединения
+     * @param reply Содержимое ответа STATUS
+     * @param resumed Сессия восстановлена (RESUME), а не начата входом
+     * @param peerAck Последний номер, принятый клиентом (для RESUME)
+     */
+    void attachUser(const std::shared_ptr<ClientHandler>& client, const std::shared_ptr<User>& user,
+                    const SessionTokens::Session& session, const std::string& reply,
+                    bool resumed, uint64_t peerAck);
+
+    /**
+     * @brief Продолжение надежной доставки на новом соединении
+     *
+     * Если состояние сессии сохранилось, неподтвержденные сообщения
+     * повторяются после ответа; иначе ответ содержит ":RESET", и
+     * клиент начинает нумерацию заново.
+     * @param client Соединение
+     * @param session Восстановленная сессия
+     * @param userId ID пользователя
+     * @param peerAck Последний номер, принятый клиентом
+     * @param reply Содержимое ответа STATUS
+     */
+    void resumeDelivery(const std::shared_ptr<ClientHandler>& client, const SessionTokens::Session& session,
+                        int userId, uint64_t peerAck, const std::string& reply);
+
+    /**
+     * @brief Отсоединение сессии от закрытого соединения с отложенным удалением
+     * @param client Соединение
+     */
+    void detachSession(ClientHandler& client);
+
+    /**
+     * @brief Удаление сессии; неподтвержденные сообщения доставляются заново
+     * @param sessionId ID сессии
+     */
+    void expireSession(uint64_t sessionId);
+
+    /**
+     * @brief Учет принятого сообщения и планирование подтверждения
+     * @param handler Соединение
+     * @param channel Канал сессии
+     */
+    void scheduleAck(ClientHandler& handler, ReliableChannel& channel);
+
+    /**
+     * @brief Отзыв сессии до истечения ее токена
+     * @param sessionId ID сессии
+     * @param expiresMs Срок действия токена, мс с эпохи Unix
+     */
+    void revokeSession(uint64_t sessionId, int64_t expiresMs);
+
+    /**
+     * @brief Выход пользователя без разрыва соединения
+     * @param clientId ID клиента
+     */
+    void handleLogout(int clientId);
+
+    /**
+     * @brief Сохранение сообщения до входа пользователя (вызывается под m_offlineMutex)
+     * @param userId ID пользователя
+     * @param message Сообщение
+     * @return false если пользователь не существует
+     */
+    bool storeOffline(int userId, const Message& message);
+
+    /**
+     * @brief Доставка сообщения пользователю (на этом или другом узле кластера)
+     * @param userId ID получателя
+     * @param message Сообщение
+     * @return true если получатель существует или сообщение передано его узлу
+     */
+    bool deliverToUser(int userId, const Message& message);
+
+    /**
+     * @brief Доставка сообщения списку получателей
+     *
+     * Получатели других узлов кластера получают сообщение через их узел,
+     * отключенные - при входе; соединениям вошедших получателей сообщение
+     * ставится в очередь без повторного разбора и маршрутизации, а общий
+     * кадр сериализуется один раз. По запросу отправитель получает
+     * STATUS с отчетом о доставке (см. DeliveryReport), иначе - ERROR
+     * со списком несуществующих получателей.
+     * @param sender Соединение отправителя (может быть nullptr)
+     * @param message Сообщение (список получателей упорядочивается)
+     */
+    void deliverToRecipients(const std::shared_ptr<ClientHandler>& sender, Message& message);
+
+    /**
+     * @brief Доставка пользователю этого узла или сохранение до его входа
+     * @param userId ID получателя
+     * @param message Сообщение
+     * @return true если получатель существует
+     */
+    bool deliverLocally(int userId, const Message& message);
+
+    /**
+     * @brief Выбор узла кластера для сообщения пользователю
+     *
+     * Пользователь, вошедший на этом узле, обслуживается локально; иначе
+     * сообщение идет на узел, где пользователь в сети, а если он не в
+     * сети - на узел, где он зарегистрирован.
+     * @param userId ID получателя
+     * @return Номер узла или -1, если доставка локальная
+     */
+    int routeNode(int userId);
+
+    /**
+     * @brief Объявление входа или выхода пользователя узлам кластера и его наблюдателям
+     *
+     * Вызывается после изменения m_userClients и m_online. Изменение
+     * попадает в очередь и рассылается пользователям, у которых он в
+     * контактах, не сразу, а по истечении окна presenceDelay.
+     * @param userId ID пользователя
+     * @param online true - вход, false - выход
+     */
+    void publishPresence(int userId, bool online);
+
+    /**
+     * @brief Согласование подписки пользователя на присутствие его контактов
+     *
+     * Вошедший пользователь становится наблюдателем своих контактов,
+     * вышедший перестает им быть. Решение принимается по текущему биту
+     * m_online, поэтому повторные и переставленные вызовы безопасны.
+     * @param userId ID пользователя
+     */
+    void updateWatcher(int userId);
+
+    /**
+     * @brief Рассылка накопленных за окно изменений присутствия
+     *
+     * Вызывается колесом таймеров. Для каждого изменившегося пользователя
+     * текущее состояние сравнивается с последним объявленным: вход и выход
+     * внутри одного окна взаимно сокращаются. Каждый наблюдатель получает
+     * один кадр со всеми изменениями своих контактов.
+     */
+    void flushPresence();
+
+    /**
+     * @brief Отправка снимка присутствия контактов вошедшему пользователю
+     * @param client Соединение пользователя
+     * @param userId ID пользователя
+     */
+    void sendPresenceSnapshot(const std::shared_ptr<ClientHandler>& client, int userId);
+
+    /**
+     * @brief Отправка статуса присутствия вошедшим пользователям
+     * @param updates ID пользователя -> его изменения
+     */
+    void sendPresence(const std::map<int, PresenceUpdate>& updates);
+
+    /**
+     * @brief Отправка сохраненных сообщений вошедшему пользователю
+     * @param userId ID пользователя
+     * @param clientId ID клиента
+     */
+    void deliverOfflineMessages(int userId, int clientId);
+
+    /**
+     * @brief Удаление сохраненного сообщения по истечении срока (поток таймеров)
+     * @param userId ID получателя
+     * @param messageId Номер сообщения
+     */
+    void expireOfflineMessage(int userId, uint64_t messageId);
+
+    /**
+     * @brief Проверка живости соединения (поток таймеров)
+     *
+     * Шлет PING после heartbeatInterval тишины и закрывает соединение
+     * после idleTimeout тишины, затем ставит следующую проверку.
+     * @param client Обработчик клиента
+     */
+    void checkConnection(std::weak_ptr<ClientHandler> client);
+
+    /**
+     * @brief Закрытие соединения, не выполнившего вход в срок (поток таймеров)
+     * @param client Обработчик клиента
+     */
+    void enforceLoginDeadline(std::weak_ptr<ClientHandler> client);
+
+    /**
+     * @brief Периодическое освобождение завершившихся соединений (поток таймеров)
+     */
+    void scheduleReaper();
+
+    /**
+     * @brief Поиск активного клиента
+     * @param clientId ID клиента
+     * @return Обработчик клиента или nullptr
+     */
+    std::shared_ptr<ClientHandler> findClient(int clientId) const;
+
+    /**
+     * @brief Отказ в обработке сообщения с уведомлением клиента
+     * @param handler Обработчик клиента
+     * @param reason Причина отказа
+     */
+    void rejectMessage(ClientHandler& handler, const std::string& reason);
+
+    /**
+     * @brief Удаление отключившегося клиента (поток соединения)
+     * @param clientId ID клиента
+     */
+    void removeClient(int clientId);
+
+    /**
+     * @brief Освобождение обработчиков завершившихся соединений
+     */
+    void reapFinishedClients();
+
+    /**
+     * @brief Проверка, относится ли сообщение к дорогим
+     * @param message Сообщение
+     * @return true для рассылок всем, сообщений нескольким получателям и файлов
+     */
+    static bool isExpensive(const Message& message);
+
+    /**
+     * @brief Действующие настройки
+     *
+     * Снимок не изменяется; замененный освобождается, когда его отпустит
+     * последний читатель. Ссылку на поля можно держать, только пока
+     * держится возвращенный указатель.
+     * @return Снимок настроек
+     */
+    std::shared_ptr<const ServerConfig> config() const { return std::atomic_load(&m_config); }
+
+    /**
+     * @brief Публикация нового снимка настроек (вызывается под m_configMutex)
+     * @param config Настройки
+     */
+    void publishConfig(const ServerConfig& config);
+
     /**
      * @brief Инициализация сетевой библиотеки
      * @return true если инициализация успешна
@@ -138,16 +738,57 @@ private:
     void cleanupNetwork();
 
     int m_port;                                     ///< Порт сервера
+    std::mutex m_configMutex;                       ///< Мьютекс смены настроек
+    std::shared_ptr<const ServerConfig> m_config;   ///< Действующий снимок настроек (std::atomic_load/atomic_store)
     socket_t m_serverSocket;                        ///< Сокет сервера
-    bool m_running;                                 ///< Флаг работы сервера
+    std::vector<Endpoint> m_listenEndpoints;        ///< Дополнительные адреса приема подключений
+    std::vector<Listener> m_listeners;              ///< Открытые дополнительные сокеты
+    std::atomic<bool> m_running;                    ///< Флаг работы сервера
     std::thread m_serverThread;                     ///< Поток сервера
-    std::vector<std::thread> m_clientThreads;       ///< Потоки клиентов
     mutable std::mutex m_clientsMutex;              ///< Мьютекс для защиты клиентов
-    std::map<int, socket_t> m_clients;              ///< Карта клиентских сокетов
-    std::map<int, std::shared_ptr<User>> m_users;   ///< Карта пользователей
+    std::map<int, std::shared_ptr<ClientHandler>> m_clients; ///< Карта клиентских подключений
+    std::map<int, int> m_userClients;               ///< Вошедшие пользователи: ID пользователя -> ID клиента
+    OnlineBitmap m_online;                          ///< Вошедшие пользователи (меняется вместе с m_userClients)
+    std::vector<std::shared_ptr<ClientHandler>> m_finishedClients; ///< Завершившиеся подключения
+    mutable std::mutex m_usersMutex;                ///< Мьютекс для защиты пользователей
+    std::map<int, std::shared_ptr<User>> m_users;   ///< Загруженные пользователи
+    UserStore m_userStore;                          ///< Реестр пользователей и контактов
+    std::string m_dataDirectory;                    ///< Каталог данных (пусто - только память)
+    ClusterSettings m_clusterSettings;              ///< Настройки кластера (номер 0 - выключен)
+    std::unique_ptr<Cluster> m_cluster;             ///< Связи с узлами кластера
     std::function<void(int, const Message&)> m_messageHandler; ///< Обработчик сообщений
-    int m_nextClientId;                             ///< Счетчик ID клиентов
-    int m_nextUserId;                               ///< Счетчик ID пользователей
+    std::atomic<int> m_nextClientId;                ///< Счетчик ID клиентов
+    std::unique_ptr<WorkerPool> m_workers;          ///< Пул обработки сообщений
+    CpuTopology m_topology;                         ///< Узлы NUMA процессоров
+    AuthPool::Verifier m_passwordVerifier;          ///< Функция проверки пароля
+    std::unique_ptr<AuthPool> m_authPool;           ///< Пул проверки паролей
+    std::unique_ptr<UserRateLimiter> m_userLimiter; ///< Ограничения скорости пользователей
+    OutboundStats m_outboundStats;                  ///< Статистика исходящих очередей соединений
+    std::atomic<uint64_t> m_rejectedConnections;    ///< Отклонено подключений
+    std::atomic<uint64_t> m_rateLimitedMessages;    ///< Сообщений сверх ограничения скорости
+    std::atomic<uint64_t> m_shedMessages;           ///< Сообщений, сброшенных при перегрузке
+    std::atomic<uint64_t> m_rejectedLogins;         ///< Входов, отклоненных пулом проверки
+    std::atomic<uint64_t> m_failedLogins;           ///< Входов с неверным паролем
+    TimerWheel m_timers;                            ///< Колесо таймеров соединений и сообщений
+    SessionTokens m_sessionTokens;                  ///< Подпись токенов сессий
+    std::mutex m_sessionsMutex;                     ///< Мьютекс отозванных сессий
+    std::map<uint64_t, int64_t> m_revokedSessions;  ///< Отозванные сессии -> срок их токенов, мс
+    std::map<uint64_t, ReliableSession> m_reliableSessions; ///< Состояние доставки по ID сессии
+    std::mutex m_presenceMutex;                     ///< Мьютекс подписок и очереди присутствия
+    std::map<int, std::vector<int>> m_watchers;     ///< ID пользователя -> вошедшие, у кого он в контактах
+    std::map<int, std::vector<int>> m_watching;     ///< Вошедший пользователь -> его контакты в m_watchers
+    std::vector<int> m_presencePending;             ///< Пользователи, изменившие состояние за окно
+    bool m_presenceFlushScheduled;                  ///< Рассылка изменений поставлена в колесо
+    OnlineBitmap m_announced;                       ///< Состояние, объявленное наблюдателям
+    std::mutex m_offlineMutex;                      ///< Мьютекс сохраненных сообщений
+    std::map<int, std::deque<OfflineMessage>> m_offlineMessages; ///< Сообщения для отключенных пользователей
+    uint64_t m_nextOfflineId;                       ///< Счетчик номеров сохраненных сообщений
+    std::string m_upgradePath;                      ///< Путь к управляющему сокету обновления
+    int m_upgradeListener;                          ///< Управляющий сокет обновления
+    int m_wakePipe[2];                              ///< Канал пробуждения потоков при передаче
+    std::thread m_upgradeThread;                    ///< Поток управляющего сокета
+    std::atomic<bool> m_handingOff;                 ///< Идет передача соединений
+    std::atomic<bool> m_handedOff;                  ///< Соединения переданы новому процессу
 };
 
 #endif // SERVER_H
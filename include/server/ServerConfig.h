@@ -0,0 +1,119 @@
+#ifndef SERVERCONFIG_H
+#define SERVERCONFIG_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "server/AuthPool.h"
+#include "server/RateLimiter.h"
+
+/**
+ * @brief Пороги перегрузки сервера
+ *
+ * При превышении любого из порогов сервер отклоняет новые подключения
+ * и дорогие сообщения (рассылки всем и файлы), продолжая обслуживать
+ * остальной трафик.
+ */
+struct OverloadLimits {
+    size_t maxConnections = 10000;                  ///< Максимум одновременных подключений
+    size_t maxWorkerQueueDepth = 10000;             ///< Максимум задач в очередях рабочих потоков
+    size_t maxSendBacklogBytes = 64 * 1024 * 1024;  ///< Максимум байтов в исходящих очередях соединений
+};
+
+/**
+ * @brief Сроки, отслеживаемые колесом таймеров сервера
+ */
+struct TimeoutSettings {
+    std::chrono::milliseconds heartbeatInterval{15000};     ///< Тишина, после которой клиенту шлется PING
+    std::chrono::milliseconds idleTimeout{45000};           ///< Тишина, после которой соединение закрывается
+    std::chrono::milliseconds loginTimeout{30000};          ///< Срок входа после подключения
+    std::chrono::milliseconds offlineMessageTtl{86400000};  ///< Время хранения сообщений для отключенных
+    size_t maxOfflineMessages = 100;                        ///< Максимум хранимых сообщений на пользователя
+    std::chrono::milliseconds sessionTtl{86400000};         ///< Срок действия токена сессии
+    std::chrono::milliseconds sessionRetention{120000};     ///< Хранение неподтвержденных сообщений после разрыва
+    std::chrono::milliseconds ackDelay{20};                 ///< Задержка подтверждения в ожидании попутного кадра
+    std::chrono::milliseconds presenceDelay{200};           ///< Окно объединения изменений присутствия
+};
+
+/**
+ * @brief Параметры сокетов соединений и слушающих сокетов
+ *
+ * Нулевой размер буфера или параметр keepalive оставляет значение системы.
+ */
+struct SocketOptions {
+    bool noDelay = true;                ///< TCP_NODELAY для соединений
+    int sendBufferBytes = 0;            ///< SO_SNDBUF соединения
+    int receiveBufferBytes = 0;         ///< SO_RCVBUF соединения
+    int listenBacklog = 0;              ///< Очередь listen() (0 - SOMAXCONN)
+    bool reuseAddress = true;           ///< SO_REUSEADDR для TCP-порта
+    bool keepAlive = false;             ///< SO_KEEPALIVE для соединений
+    int keepAliveIdleSeconds = 0;       ///< Тишина до первой пробы keepalive, с
+    int keepAliveIntervalSeconds = 0;   ///< Интервал проб keepalive, с
+    int keepAliveCount = 0;             ///< Число проб до разрыва
+};
+
+/**
+ * @brief Настройки сервера, задаваемые при запуске
+ *
+ * Читаются из файла строк "ключ = значение" (# - комментарий) и
+ * дополняются параметрами командной строки (set). Размеры принимают
+ * суффиксы K, M и G (степени 1024), флаги - true/false, on/off, yes/no,
+ * 1/0; сроки с суффиксом _ms задаются в миллисекундах, списки
+ * процессоров - в виде "0-3,8".
+ *
+ * Часть настроек сервер применяет на ходу (Server::applyConfig):
+ * ограничения скорости, пороги перегрузки, сроки, размер буфера приема,
+ * параметры сокетов и процессоры новых соединений. Порт, пулы потоков
+ * и их процессоры, очередь listen() и SO_REUSEADDR вступают в силу
+ * только после перезапуска.
+ */
+struct ServerConfig {
+    int port = 8080;                        ///< TCP-порт
+    size_t workerThreads = 0;               ///< Рабочих потоков (0 - по числу ядер)
+    size_t workerQueueSize = 4096;          ///< Максимальная длина очереди одного рабочего потока
+    size_t receiveBufferBytes = 16 * 1024;  ///< Буфер одного чтения из соединения
+    std::vector<int> workerCpus;            ///< Процессоры рабочих потоков, по одному на поток (пусто - без закрепления)
+    std::vector<int> ioCpus;                ///< Процессоры потоков соединений (пусто - без закрепления)
+    size_t maxRecipients = 256;             ///< Максимум получателей одного сообщения
+    SocketOptions socket;                   ///< Параметры сокетов
+    RateLimits connectionLimits;            ///< Ограничения скорости подключения
+    RateLimits userLimits;                  ///< Ограничения скорости пользователя
+    OverloadLimits overload;                ///< Пороги перегрузки
+    TimeoutSettings timeouts;               ///< Сроки соединений и сообщений
+    AuthLimits authLimits;                  ///< Ограничения проверки паролей
+
+    /**
+     * @brief Установка одного параметра
+     * @param key Ключ (например, "worker_threads")
+     * @param value Значение
+     * @param error Описание ошибки
+     * @return false если ключ неизвестен или значение неверно
+     */
+    bool set(const std::string& key, const std::string& value, std::string& error);
+
+    /**
+     * @brief Установка параметра из строки "ключ=значение"
+     * @param assignment Строка
+     * @param error Описание ошибки
+     * @return false если строка или значение неверны
+     */
+    bool set(const std::string& assignment, std::string& error);
+
+    /**
+     * @brief Чтение файла настроек поверх текущих значений
+     * @param path Путь к файлу
+     * @param error Описание первой ошибки с номером строки
+     * @return false если файл не прочитан или содержит ошибку
+     */
+    bool load(const std::string& path, std::string& error);
+
+    /**
+     * @brief Параметры, изменение которых требует перезапуска
+     * @param other Новые настройки
+     * @return Ключи параметров, отличающихся от текущих
+     */
+    std::vector<std::string> restartRequired(const ServerConfig& other) const;
+};
+
+#endif // SERVERCONFIG_H
@@ -0,0 +1,76 @@
+#ifndef SESSIONTOKENS_H
+#define SESSIONTOKENS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Выпуск и проверка подписанных токенов сессии
+ *
+ * Токен "userId.имя.срок_мс.id_сессии.подпись" подписан HMAC-SHA256
+ * ключом сервера. Проверка не обращается к реестру пользователей и к
+ * состоянию сервера: достаточно ключа. Ключ создается случайно при
+ * запуске и передается новому процессу при горячем обновлении; после
+ * обычного перезапуска прежние токены недействительны, и клиент
+ * входит заново.
+ */
+class SessionTokens {
+public:
+    /**
+     * @brief Данные, восстановленные из токена
+     */
+    struct Session {
+        int userId = -1;            ///< ID пользователя
+        std::string username;       ///< Имя пользователя
+        uint64_t sessionId = 0;     ///< ID сессии
+        int64_t expiresMs = 0;      ///< Срок действия, мс с эпохи Unix
+    };
+
+    /**
+     * @brief Конструктор (создает случайный ключ)
+     */
+    SessionTokens();
+
+    /**
+     * @brief Установка ключа подписи
+     * @param key Ключ
+     */
+    void setKey(const std::string& key) { m_key = key; }
+
+    /**
+     * @brief Получение ключа подписи
+     * @return Ключ
+     */
+    const std::string& getKey() const { return m_key; }
+
+    /**
+     * @brief Выпуск токена
+     * @param userId ID пользователя
+     * @param username Имя пользователя
+     * @param ttl Срок действия
+     * @param session Данные выпущенной сессии
+     * @return Токен
+     */
+    std::string issue(int userId, const std::string& username, std::chrono::milliseconds ttl, Session& session) const;
+
+    /**
+     * @brief Проверка подписи и срока действия токена
+     * @param token Токен
+     * @param session Данные сессии
+     * @return true если токен подлинный и не истек
+     */
+    bool verify(const std::string& token, Session& session) const;
+
+private:
+    /**
+     * @brief Подпись тела токена
+     * @param body Тело токена (без подписи)
+     * @return Подпись в шестнадцатеричном виде
+     */
+    std::string sign(const std::string& body) const;
+
+    std::string m_key;                              ///< Ключ подписи
+};
+
+#endif // SESSIONTOKENS_H
@@ -0,0 +1,148 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Иерархическое колесо таймеров
+ *
+ * Таймеры хранятся в интрузивных двусвязных списках по ячейкам нескольких
+ * колес разной грубости (как в ядре Linux): постановка и отмена таймера
+ * выполняются за O(1), без отдельного потока или упорядоченного контейнера
+ * на каждый таймер. Узлы лежат в одном массиве и переиспользуются, поэтому
+ * сотни тысяч таймеров подключений не создают нагрузки на аллокатор.
+ *
+ * Колесо обслуживает один фоновый поток, который продвигает время с шагом
+ * tick и вызывает сработавшие обработчики вне внутренней блокировки:
+ * обработчики могут ставить и отменять таймеры. Обработчики должны быть
+ * короткими - долгая работа задерживает все остальные таймеры.
+ */
+class TimerWheel {
+public:
+    /**
+     * @brief Идентификатор таймера (0 - недействительный)
+     */
+    typedef uint64_t TimerId;
+
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    /**
+     * @brief Конструктор
+     * @param tick Шаг (разрешение) таймеров
+     */
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+    /**
+     * @brief Деструктор (останавливает поток колеса)
+     */
+    ~TimerWheel();
+
+    /**
+     * @brief Запуск фонового потока
+     */
+    void start();
+
+    /**
+     * @brief Остановка фонового потока (таймеры не срабатывают до следующего start())
+     */
+    void stop();
+
+    /**
+     * @brief Постановка таймера
+     * @param delay Задержка до срабатывания (округляется вверх до шага)
+     * @param callback Обработчик, вызываемый в потоке колеса
+     * @return Идентификатор таймера
+     */
+    TimerId schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+
+    /**
+     * @brief Отмена таймера
+     * @param id Идентификатор таймера
+     * @return true если таймер был активен и отменен
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Количество активных таймеров
+     * @return Количество таймеров
+     */
+    size_t size() const;
+
+private:
+    static constexpr int LEVELS = 4;                ///< Количество колес
+    static constexpr int SLOT_BITS = 8;             ///< Разрядность номера ячейки
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS; ///< Ячеек в колесе
+    static constexpr uint32_t NIL = UINT32_MAX;     ///< Пустая ссылка списка
+
+    /**
+     * @brief Узел таймера
+     */
+    struct Node {
+        std::function<void()> callback;     ///< Обработчик
+        uint64_t expiryTick = 0;            ///< Тик срабатывания
+        uint32_t prev = NIL;                ///< Предыдущий узел в ячейке
+        uint32_t next = NIL;                ///< Следующий узел в ячейке (или в списке свободных)
+        uint32_t generation = 0;            ///< Поколение узла (защита от устаревших ID)
+        uint16_t level = 0;                 ///< Колесо, в котором лежит узел
+        uint16_t slot = 0;                  ///< Ячейка колеса
+        bool active = false;                ///< Узел поставлен в колесо
+    };
+
+    /**
+     * @brief Размещение узла в ячейке по его тику срабатывания
+     * @param index Номер узла
+     */
+    void link(uint32_t index);
+
+    /**
+     * @brief Удаление узла из ячейки
+     * @param index Номер узла
+     */
+    void unlink(uint32_t index);
+
+    /**
+     * @brief Возврат узла в список свободных
+     * @param index Номер узла
+     */
+    void release(uint32_t index);
+
+    /**
+     * @brief Перенос узлов ячейки старшего колеса в младшие
+     * @param level Колесо
+     * @param slot Ячейка
+     */
+    void cascade(int level, uint32_t slot);
+
+    /**
+     * @brief Продвижение времени до заданного тика
+     * @param targetTick Целевой тик
+     * @param expired Сработавшие обработчики
+     */
+    void advance(uint64_t targetTick, std::vector<std::function<void()>>& expired);
+
+    /**
+     * @brief Цикл фонового потока
+     */
+    void run();
+
+    std::chrono::milliseconds m_tick;                   ///< Шаг таймеров
+    std::chrono::steady_clock::time_point m_origin;     ///< Момент нулевого тика
+    uint64_t m_currentTick;                             ///< Текущий тик
+    std::vector<Node> m_nodes;                          ///< Узлы таймеров
+    uint32_t m_freeHead;                                ///< Голова списка свободных узлов
+    uint32_t m_slots[LEVELS][SLOTS];                    ///< Головы списков ячеек
+    size_t m_activeCount;                               ///< Активных таймеров
+    mutable std::mutex m_mutex;                         ///< Мьютекс колеса
+    std::condition_variable m_cv;                       ///< Пробуждение потока при остановке
+    bool m_running;                                     ///< Флаг работы потока
+    std::thread m_thread;                               ///< Поток колеса
+};
+
+#endif // TIMERWHEEL_H
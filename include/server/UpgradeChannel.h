@@ -0,0 +1,123 @@
+#ifndef UPGRADECHANNEL_H
+#define UPGRADECHANNEL_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Состояние соединения, передаваемое новому процессу сервера
+ */
+struct ConnectionState {
+    int clientId = -1;              ///< ID клиента
+    int userId = -1;                ///< ID вошедшего пользователя (-1 - вход не выполнен)
+    std::string pendingInput;       ///< Принятые байты незавершенного кадра
+
+    /**
+     * @brief Сериализация состояния
+     * @return Строка "clientId|userId|<байты незавершенного кадра>"
+     */
+    std::string serialize() const;
+
+    /**
+     * @brief Десериализация состояния
+     * @param data Строка, полученная из serialize()
+     * @return true если разбор успешен
+     */
+    bool deserialize(const std::string& data);
+};
+
+/**
+ * @brief Канал передачи сокетов между процессами сервера (горячее обновление)
+ *
+ * Работающий процесс слушает управляющий Unix-сокет. Новый процесс
+ * подключается к нему и получает последовательность записей
+ * [длина, тип, данные]; дескрипторы сокетов передаются вместе с записью
+ * во вспомогательных данных SCM_RIGHTS, поэтому открытые TCP-соединения
+ * продолжают работать без разрыва. Оба процесса должны работать на одном
+ * хосте от одного пользователя. Доступно только на POSIX-системах.
+ */
+class UpgradeChannel {
+public:
+    /**
+     * @brief Типы записей канала
+     */
+    enum class RecordType : uint8_t {
+        LISTENER = 1,       ///< Слушающий сокет (только дескриптор)
+        USER,               ///< Пользователь: "id|имя|email"
+        CONNECTION,         ///< Соединение: ConnectionState и дескриптор сокета
+        OFFLINE_MESSAGE,    ///< Сохраненное сообщение: "userId|кадр сообщения"
+        END,                ///< Конец передачи
+        SESSION_KEY,        ///< Ключ подписи токенов сессий
+        REVOKED_SESSION,    ///< Отозванная сессия: "id_сессии|срок_мс"
+        EXTRA_LISTENER      ///< Дополнительный слушающий сокет: адрес (Endpoint) и дескриптор
+    };
+
+    /**
+     * @brief Запись канала
+     */
+    struct Record {
+        RecordType type = RecordType::END;  ///< Тип записи
+        std::string payload;                ///< Данные записи
+        int fd = -1;                        ///< Передаваемый дескриптор (-1 - нет)
+    };
+
+    /**
+     * @brief Создание управляющего сокета (старый файл сокета удаляется)
+     * @param path Путь к файлу сокета
+     * @return Дескриптор слушающего сокета или -1 при ошибке
+     */
+    static int listen(const std::string& path);
+
+    /**
+     * @brief Закрытие управляющего сокета с удалением его файла
+     * @param listener Слушающий сокет
+     * @param path Путь к файлу сокета
+     */
+    static void closeListener(int listener, const std::string& path);
+
+    /**
+     * @brief Прием подключения нового процесса
+     *
+     * Подключения от процессов другого пользователя отклоняются.
+     * @param listener Слушающий сокет
+     * @return Дескриптор канала или -1 при ошибке
+     */
+    static int accept(int listener);
+
+    /**
+     * @brief Подключение к работающему процессу
+     * @param path Путь к файлу сокета
+     * @return Дескриптор канала или -1 при ошибке
+     */
+    static int connect(const std::string& path);
+
+    /**
+     * @brief Отправка записи
+     * @param channel Дескриптор канала
+     * @param record Запись
+     * @return true если запись отправлена целиком
+     */
+    static bool send(int channel, const Record& record);
+
+    /**
+     * @brief Прием записи
+     * @param channel Дескриптор канала
+     * @param record Принятая запись (дескриптор принадлежит вызывающему)
+     * @return true если запись принята целиком
+     */
+    static bool receive(int channel, Record& record);
+
+    /**
+     * @brief Закрытие дескриптора
+     * @param fd Дескриптор
+     */
+    static void close(int fd);
+
+    /**
+     * @brief Проверка поддержки горячего обновления на платформе
+     * @return true на POSIX-системах
+     */
+    static bool isSupported();
+};
+
+#endif // UPGRADECHANNEL_H
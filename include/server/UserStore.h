@@ -0,0 +1,319 @@
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Хранилище пользователей и их контактов: снимок + журнал упреждающей записи
+ *
+ * Состояние хранится в двух файлах каталога данных:
+ * - users.snapshot - компактный снимок: отсортированные по ID записи
+ *   фиксированного размера, индекс по имени, массив контактов и блок строк.
+ *   При запуске снимок отображается в память (mmap) и не разбирается:
+ *   поиск идет двоичным поиском прямо по отображению, поэтому запуск
+ *   не зависит от числа пользователей;
+ * - users.wal - журнал регистраций и изменений контактов после снимка.
+ *   При запуске воспроизводится только он, изменения попадают в небольшой
+ *   слой поверх снимка.
+ *
+ * Записи журнала пишутся сразу (переживают падение процесса) и
+ * сбрасываются на диск фоновым потоком раз в секунду. Когда журнал
+ * вырастает, фоновый поток записывает новый снимок и очищает журнал;
+ * чтение при этом не блокируется, блокируются только изменения.
+ * Воспроизведение журнала идемпотентно, поэтому сбой между записью
+ * снимка и очисткой журнала безопасен.
+ *
+ * Без каталога данных хранилище работает только в памяти.
+ */
+class UserStore {
+public:
+    /**
+     * @brief Данные пользователя
+     */
+    struct UserRecord {
+        int id = -1;            ///< ID пользователя
+        std::string username;   ///< Имя пользователя
+        std::string email;      ///< Email
+    };
+
+    /**
+     * @brief Размер журнала (в записях), после которого пишется новый снимок
+     */
+    static constexpr size_t COMPACTION_THRESHOLD = 100000;
+
+    /**
+     * @brief Конструктор (хранилище в памяти до вызова open)
+     */
+    UserStore();
+
+    /**
+     * @brief Деструктор
+     */
+    ~UserStore();
+
+    /**
+     * @brief Открытие каталога данных: отображение снимка и воспроизведение журнала
+     * @param directory Каталог данных (создается при необходимости)
+     * @return true если хранилище открыто
+     */
+    bool open(const std::string& directory);
+
+    /**
+     * @brief Закрытие с записью журнала на диск (без нового снимка)
+     */
+    void close();
+
+    /**
+     * @brief Проверка, сохраняется ли состояние на диск
+     * @return true если открыт каталог данных
+     */
+    bool isPersistent() const { return !m_directory.empty(); }
+
+    /**
+     * @brief Выдача ID с шагом: новые ID дают остаток offset при делении на stride
+     *
+     * Узлы кластера выдают непересекающиеся ID без согласования.
+     * Вызывать до open().
+     * @param offset Остаток (номер узла)
+     * @param stride Шаг (1 - ID подряд)
+     */
+    void setIdAllocation(int offset, int stride);
+
+    /**
+     * @brief Регистрация пользователя
+     * @param username Имя пользователя
+     * @param email Email
+     * @return ID пользователя или -1, если имя занято
+     */
+    int addUser(const std::string& username, const std::string& email);
+
+    /**
+     * @brief Восстановление пользователя с заданным ID
+     * @param record Данные пользователя
+     * @return true если пользователь добавлен (false, если ID или имя заняты)
+     */
+    bool restoreUser(const UserRecord& record);
+
+    /**
+     * @brief Поиск пользователя по ID
+     * @param userId ID пользователя
+     * @param record Найденные данные
+     * @return true если пользователь найден
+     */
+    bool findUser(int userId, UserRecord& record) const;
+
+    /**
+     * @brief Поиск ID пользователя по имени
+     * @param username Имя пользователя
+     * @return ID пользователя или -1
+     */
+    int findUserId(const std::string& username) const;
+
+    /**
+     * @brief Добавление контакта
+     * @param userId ID пользователя
+     * @param contactId ID контакта
+     * @return true если оба пользователя существуют и контакт добавлен
+     */
+    bool addContact(int userId, int contactId);
+
+    /**
+     * @brief Удаление контакта
+     * @param userId ID пользователя
+     * @param contactId ID контакта
+     * @return true если контакт был в списке
+     */
+    bool removeContact(int userId, int contactId);
+
+    /**
+     * @brief Получение контактов пользователя
+     * @param userId ID пользователя
+     * @return Отсортированный список ID контактов
+     */
+    std::vector<int> getContacts(int userId) const;
+
+    /**
+     * @brief Количество пользователей
+     * @return Количество пользователей
+     */
+    size_t userCount() const;
+
+    /**
+     * @brief Обход всех пользователей
+     * @param visitor Функция, вызываемая для каждого пользователя
+     */
+    void forEachUser(const std::function<void(const UserRecord&)>& visitor) const;
+
+    /**
+     * @brief Запись нового снимка и очистка журнала
+     * @return true если снимок записан
+     */
+    bool compact();
+
+    /**
+     * @brief Количество записей журнала после последнего снимка
+     * @return Количество записей
+     */
+    size_t walRecordCount() const { return m_walRecords.load(); }
+
+private:
+    struct SnapshotHeader;
+    struct SnapshotRecord;
+
+    /**
+     * @brief Пользователь, добавленный после снимка
+     */
+    struct AddedUser {
+        std::string username;   ///< Имя пользователя
+        std::string email;      ///< Email
+    };
+
+    /**
+     * @brief Типы записей журнала
+     */
+    enum class WalRecordType : uint8_t {
+        ADD_USER = 1,       ///< Регистрация: id, имя, email
+        ADD_CONTACT,        ///< Добавление контакта: id, id контакта
+        REMOVE_CONTACT      ///< Удаление контакта: id, id контакта
+    };
+
+    /**
+     * @brief Отображение файла снимка в память с проверкой формата
+     * @param path Путь к снимку
+     * @return true если снимок отображен или отсутствует
+     */
+    bool mapSnapshot(const std::string& path);
+
+    /**
+     * @brief Освобождение отображения снимка
+     */
+    void unmapSnapshot();
+
+    /**
+     * @brief Заголовок отображенного снимка
+     * @return Указатель на заголовок или nullptr, если снимка нет
+     */
+    const SnapshotHeader* snapshotHeader() const;
+
+    /**
+     * @brief Записи пользователей снимка
+     * @return Указатель на первую запись или nullptr
+     */
+    const SnapshotRecord* snapshotRecords() const;
+
+    /**
+     * @brief Двоичный поиск записи снимка по ID
+     * @param userId ID пользователя
+     * @return Указатель на запись или nullptr
+     */
+    const SnapshotRecord* findSnapshotRecord(int userId) const;
+
+    /**
+     * @brief Двоичный поиск в индексе снимка по имени
+     * @param username Имя пользователя
+     * @return ID пользователя или -1
+     */
+    int findSnapshotUserId(const std::string& username) const;
+
+    /**
+     * @brief Строка из блока строк снимка
+     * @param offset Смещение строки
+     * @param length Длина строки
+     * @return Строка
+     */
+    std::string snapshotString(uint32_t offset, uint16_t length) const;
+
+    /**
+     * @brief Контакты пользователя из снимка
+     * @param record Запись пользователя
+     * @param contacts Список контактов (заменяется)
+     */
+    void snapshotContacts(const SnapshotRecord& record, std::vector<int>& contacts) const;
+
+    /**
+     * @brief Проверка существования пользователя (вызывается под m_mutex)
+     * @param userId ID пользователя
+     * @return true если пользователь есть в снимке или слое изменений
+     */
+    bool userExists(int userId) const;
+
+    /**
+     * @brief Добавление пользователя в слой изменений (вызывается под m_mutex)
+     * @param userId ID пользователя
+     * @param username Имя пользователя
+     * @param email Email
+     * @return true если ID и имя были свободны
+     */
+    bool insertUser(int userId, const std::string& username, const std::string& email);
+
+    /**
+     * @brief Изменяемый список контактов (копируется из снимка при первом изменении)
+     * @param userId ID пользователя
+     * @return Ссылка на список в слое изменений
+     */
+    std::vector<int>& mutableContacts(int userId);
+
+    /**
+     * @brief Воспроизведение журнала; оборванный хвост отбрасывается
+     * @param path Путь к журналу
+     * @return true если журнал прочитан
+     */
+    bool replayWal(const std::string& path);
+
+    /**
+     * @brief Добавление записи в журнал (вызывается под m_writeMutex)
+     * @param type Тип записи
+     * @param payload Данные записи
+     * @return true если запись добавлена
+     */
+    bool appendWal(WalRecordType type, const std::string& payload);
+
+    /**
+     * @brief Запись снимка текущего состояния в файл
+     * @param path Путь к файлу
+     * @return true если файл записан и сброшен на диск
+     */
+    bool writeSnapshot(const std::string& path) const;
+
+    /**
+     * @brief Фоновый поток: сброс журнала на диск и запись снимков
+     */
+    void maintenanceLoop();
+
+    std::string m_directory;                        ///< Каталог данных (пусто - только память)
+    mutable std::shared_mutex m_mutex;              ///< Чтение - общий доступ, изменение слоя - монопольный
+    std::mutex m_writeMutex;                        ///< Упорядочивает изменения и запись снимка
+
+    const char* m_snapshot;                         ///< Отображенный снимок
+    size_t m_snapshotSize;                          ///< Размер снимка
+    std::vector<char> m_snapshotCopy;               ///< Снимок в памяти, если mmap недоступен
+
+    std::unordered_map<int, AddedUser> m_addedUsers;            ///< Пользователи после снимка
+    std::unordered_map<std::string, int> m_addedByName;         ///< Индекс добавленных по имени
+    std::unordered_map<int, std::vector<int>> m_changedContacts; ///< Контакты, измененные после снимка
+    int m_nextUserId;                               ///< Следующий ID пользователя
+    int m_idOffset;                                 ///< Остаток новых ID по модулю шага
+    int m_idStride;                                 ///< Шаг новых ID
+
+    FILE* m_wal;                                    ///< Файл журнала
+    std::atomic<size_t> m_walRecords;               ///< Записей журнала после снимка
+    std::atomic<bool> m_walDirty;                   ///< Есть записи, не сброшенные на диск
+
+    std::mutex m_maintenanceMutex;                  ///< Мьютекс фонового потока
+    std::condition_variable m_maintenanceCv;        ///< Пробуждение фонового потока
+    bool m_maintenanceRunning;                      ///< Флаг работы фонового потока
+    std::thread m_maintenanceThread;                ///< Сброс журнала и запись снимков
+};
+
+#endif // USERSTORE_H
@@ -0,0 +1,212 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Пул рабочих потоков с очередью на каждый поток
+ *
+ * Задача направляется в очередь по ключу (например, ID клиента), поэтому
+ * задачи с одним ключом выполняются последовательно и в порядке поступления,
+ * а задачи разных ключей - параллельно. Очереди ограничены: при
+ * переполнении submit() возвращает false, и вызывающий сам решает,
+ * как отказать клиенту.
+ *
+ * Задачи хранятся во встроенном буфере Task, а очередь - кольцо, которое
+ * растет, но не сжимается, поэтому постановка и выполнение задачи
+ * в установившемся режиме не выделяют память.
+ */
+class WorkerPool {
+public:
+    /**
+     * @brief Задача без копирования: вызываемый объект во встроенном буфере
+     *
+     * Объект до INLINE_SIZE байтов (например, лямбда с сообщением)
+     * хранится внутри задачи; больший объект размещается в куче.
+     */
+    class Task {
+    public:
+        /**
+         * @brief Размер встроенного буфера
+         */
+        static constexpr size_t INLINE_SIZE = 256;
+
+        /**
+         * @brief Пустая задача
+         */
+        Task() noexcept : m_ops(nullptr) {}
+
+        /**
+         * @brief Задача из вызываемого объекта
+         * @param function Вызываемый объект без аргументов
+         */
+        template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+        Task(F&& function);
+
+        Task(Task&& other) noexcept : m_ops(nullptr) { *this = std::move(other); }
+        Task& operator=(Task&& other) noexcept;
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() { reset(); }
+
+        /**
+         * @brief Выполнение задачи
+         */
+        void operator()() { m_ops->invoke(m_storage); }
+
+        /**
+         * @brief Проверка наличия задачи
+         * @return true если задача не пуста
+         */
+        explicit operator bool() const { return m_ops != nullptr; }
+
+        /**
+         * @brief Уничтожение вызываемого объекта
+         */
+        void reset() noexcept;
+
+    private:
+        /**
+         * @brief Операции над хранимым объектом
+         */
+        struct Ops {
+            void (*invoke)(void* storage);              ///< Вызов
+            void (*move)(void* from, void* to);         ///< Перенос в другой буфер
+            void (*destroy)(void* storage);             ///< Уничтожение
+        };
+
+        template <typename F>
+        static const Ops* inlineOps();
+
+        template <typename F>
+        static const Ops* heapOps();
+
+        alignas(std::max_align_t) unsigned char m_storage[INLINE_SIZE]; ///< Объект или указатель на него
+        const Ops* m_ops;                                               ///< Операции (nullptr - пусто)
+    };
+
+    /**
+     * @brief Конструктор
+     * @param threadCount Количество рабочих потоков (0 - по числу ядер)
+     * @param maxQueueSize Максимальная длина очереди одного потока
+     */
+    explicit WorkerPool(size_t threadCount = 0, size_t maxQueueSize = 4096);
+
+    /**
+     * @brief Деструктор (останавливает пул)
+     */
+    ~WorkerPool();
+
+    /**
+     * @brief Закрепление рабочих потоков за процессорами
+     *
+     * Поток i закрепляется за процессором cpus[i % cpus.size()] и сам
+     * выделяет кольцо задач полной емкости, поэтому очередь лежит в
+     * памяти узла NUMA своего потока.
+     * @param cpus Процессоры (вызывать до start())
+     */
+    void setAffinity(const std::vector<int>& cpus) { m_cpus = cpus; }
+
+    /**
+     * @brief Запуск рабочих потоков
+     */
+    void start();
+
+    /**
+     * @brief Остановка с выполнением уже поставленных задач
+     */
+    void stop();
+
+    /**
+     * @brief Постановка задачи в очередь
+     * @param key Ключ, определяющий рабочий поток
+     * @param task Задача
+     * @return true если задача принята
+     */
+    bool submit(size_t key, Task task);
+
+    /**
+     * @brief Суммарное количество задач в очередях
+     * @return Количество ожидающих задач
+     */
+    size_t queueDepth() const { return m_queued.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Количество рабочих потоков
+     * @return Количество потоков
+     */
+    size_t threadCount() const { return m_workers.size(); }
+
+private:
+    /**
+     * @brief Очередь и поток одного работника
+     */
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<Task> tasks;    ///< Кольцо задач
+        size_t head = 0;            ///< Индекс первой задачи в кольце
+        size_t count = 0;           ///< Количество задач в кольце
+        std::thread thread;
+    };
+
+    /**
+     * @brief Цикл рабочего потока
+     * @param worker Работник
+     * @param index Номер работника
+     */
+    void workerLoop(Worker& worker, size_t index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers; ///< Работники
+    size_t m_maxQueueSize;                          ///< Максимальная длина очереди
+    std::vector<int> m_cpus;                        ///< Процессоры рабочих потоков (пусто - без закрепления)
+    std::atomic<size_t> m_queued;                   ///< Задач в очередях
+    std::atomic<bool> m_running;                    ///< Флаг работы пула
+};
+
+template <typename F, typename>
+WorkerPool::Task::Task(F&& function) : m_ops(nullptr) {
+    using Function = std::decay_t<F>;
+    if constexpr (sizeof(Function) <= INLINE_SIZE && alignof(Function) <= alignof(std::max_align_t) &&
+                  std::is_nothrow_move_constructible<Function>::value) {
+        new (m_storage) Function(std::forward<F>(function));
+        m_ops = inlineOps<Function>();
+    } else {
+        new (m_storage) Function*(new Function(std::forward<F>(function)));
+        m_ops = heapOps<Function>();
+    }
+}
+
+template <typename F>
+const WorkerPool::Task::Ops* WorkerPool::Task::inlineOps() {
+    static const Ops ops = {
+        [](void* storage) { (*static_cast<F*>(storage))(); },
+        [](void* from, void* to) {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        },
+        [](void* storage) { static_cast<F*>(storage)->~F(); }
+    };
+    return &ops;
+}
+
+template <typename F>
+const WorkerPool::Task::Ops* WorkerPool::Task::heapOps() {
+    static const Ops ops = {
+        [](void* storage) { (**static_cast<F**>(storage))(); },
+        [](void* from, void* to) { new (to) F*(*static_cast<F**>(from)); },
+        [](void* storage) { delete *static_cast<F**>(storage); }
+    };
+    return &ops;
+}
+
+#endif // WORKERPOOL_H
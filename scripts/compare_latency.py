@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+
+# Сравнение результатов бенчмарка pingpong двух сборок
+#
+# Использование: compare_latency.py базовый.json новый.json
+#                    [--tolerance 0.10] [--min-delta-us 20]
+#                    [--percentiles p50,p99,p999]
+#
+# Регрессией считается перцентиль исправленной задержки, выросший больше
+# чем на tolerance (доля) и одновременно больше чем на min-delta-us
+# микросекунд: второй порог отсекает шум на малых задержках. Потерянные
+# ответы в новом прогоне - тоже регрессия.
+#
+# Коды выхода: 0 - регрессий нет, 1 - есть регрессии, 2 - ошибка входных данных
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    try:
+        with open(path, encoding="utf-8") as file:
+            data = json.load(file)
+    except (OSError, ValueError) as error:
+        print(f"Ошибка: не удалось прочитать {path}: {error}", file=sys.stderr)
+        sys.exit(2)
+    if data.get("benchmark") != "pingpong":
+        print(f"Ошибка: {path} не является результатом pingpong", file=sys.stderr)
+        sys.exit(2)
+    return {result["payload"]: result for result in data.get("results", [])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Сравнение задержек pingpong двух сборок")
+    parser.add_argument("baseline", help="результат базовой сборки (--json)")
+    parser.add_argument("candidate", help="результат проверяемой сборки (--json)")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="допустимый относительный рост задержки (по умолчанию 0.10)")
+    parser.add_argument("--min-delta-us", type=float, default=20.0,
+                        help="рост меньше этого порога в мкс не считается регрессией")
+    parser.add_argument("--percentiles", default="p50,p99,p999",
+                        help="сравниваемые перцентили через запятую")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    candidate = load(args.candidate)
+    keys = [key.strip() for key in args.percentiles.split(",") if key.strip()]
+    payloads = sorted(set(baseline) & set(candidate))
+    if not payloads:
+        print("Ошибка: в результатах нет общих размеров содержимого", file=sys.stderr)
+        return 2
+
+    regressions = 0
+    print(f"{'bytes':>7} {'perc':>6} {'base us':>10} {'new us':>10} {'change':>8}")
+    for payload in payloads:
+        base = baseline[payload]
+        new = candidate[payload]
+        if new["received"] < new["sent"]:
+            print(f"{payload:>7} потеряно ответов: {new['sent'] - new['received']}  РЕГРЕССИЯ")
+            regressions += 1
+        for key in keys:
+            field = f"{key}_ns"
+            if field not in base["corrected"] or field not in new["corrected"]:
+                print(f"Ошибка: нет перцентиля {key}", file=sys.stderr)
+                return 2
+            before = base["corrected"][field] / 1000.0
+            after = new["corrected"][field] / 1000.0
+            change = (after - before) / before if before > 0 else 0.0
+            regressed = change > args.tolerance and after - before > args.min_delta_us
+            mark = "  РЕГРЕССИЯ" if regressed else ""
+            print(f"{payload:>7} {key:>6} {before:>10.1f} {after:>10.1f} {change:>+8.1%}{mark}")
+            regressions += regressed
+
+    if regressions:
+        print(f"Найдено регрессий: {regressions}")
+        return 1
+    print("Регрессий не найдено")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,13 +1,51 @@
 #include "client/Client.h"
-#include <iostream>
+#include "common/Endpoint.h"
+#include "common/FrameBuffer.h"
+#include "common/Logger.h"
+#include "common/MessageDispatch.h"
+#include "common/Trace.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 
+#ifndef _WIN32
+    #include <netinet/tcp.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Задержка отдельного подтверждения, если нет встречного трафика
+ */
+const int ACK_DELAY_MS = 20;
+
+/**
+ * @brief Наибольшая часть очереди отправки за одну запись в транспорт
+ */
+const size_t SEND_CHUNK_BYTES = 64 * 1024;
+
+/**
+ * @brief Верхняя отметка очереди отправки по умолчанию
+ */
+const size_t DEFAULT_SEND_HIGH_WATER_MARK = 1024 * 1024;
+
+/**
+ * @brief Предельное ожидание записи очереди при отключении
+ */
+const auto SEND_DRAIN_TIMEOUT = std::chrono::milliseconds(1000);
+
+} // namespace
+
 Client::Client() 
-    : m_socket(INVALID_SOCKET), m_connected(false), m_clientId(-1) {
+    : m_connected(false), m_clientId(-1), m_serverPort(0), m_sendFailed(false), m_queuedBytes(0),
+      m_sendHighWaterMark(DEFAULT_SEND_HIGH_WATER_MARK), m_aboveHighWater(false) {
 }
 
 Client::~Client() {
     disconnect();
+    stopDispatcher();
     cleanupNetwork();
 }
 
@@ -17,41 +55,70 @@ bool Client::connect(const std::string& serverAddress, int port) {
     }
     
     if (!initializeNetwork()) {
-        std::cerr << "Ошибка инициализации сети" << std::endl;
+        LOG_ERROR("Ошибка инициализации сети");
         return false;
     }
     
-    // Создание сокета
-    m_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (m_socket == INVALID_SOCKET) {
-        std::cerr << "Ошибка создания сокета" << std::endl;
+    // Транспорт выбирается схемой адреса: "unix:/путь" или TCP
+    Endpoint endpoint;
+    sockaddr_storage serverAddr{};
+    socklen_t serverAddrLen = 0;
+    if (!Endpoint::parse(serverAddress, port, endpoint) || !endpoint.toSockaddr(serverAddr, serverAddrLen)) {
+        LOG_ERROR("Неверный адрес сервера");
         return false;
     }
     
-    // Настройка адреса сервера
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    
-    if (inet_pton(AF_INET, serverAddress.c_str(), &serverAddr.sin_addr) <= 0) {
-        std::cerr << "Неверный адрес сервера" << std::endl;
+    // Создание сокета
+    socket_t clientSocket = socket(endpoint.family(), SOCK_STREAM, 0);
+    if (clientSocket == INVALID_SOCKET) {
+        LOG_ERROR("Ошибка создания сокета");
         return false;
     }
+    auto transport = std::make_unique<SocketTransport>(clientSocket);
     
     // Подключение к серверу
-    if (::connect(m_socket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "Ошибка подключения к серверу" << std::endl;
+    if (::connect(clientSocket, reinterpret_cast<sockaddr*>(&serverAddr), serverAddrLen) == SOCKET_ERROR) {
+        LOG_ERROR("Ошибка подключения к серверу");
         return false;
     }
+    if (endpoint.scheme == Endpoint::Scheme::SHM && !attachSharedMemory(*transport)) {
+        return false;
+    }
+    if (endpoint.scheme == Endpoint::Scheme::TCP) {
+        // Сообщения короткие и уходят по одному: задержка Нейгла только мешает
+        int noDelay = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    }
     
-    m_connected = true;
+    if (!connect(std::move(transport))) {
+        return false;
+    }
     m_serverAddress = serverAddress;
     m_serverPort = port;
     
-    // Запуск потока приема сообщений
-    m_receiveThread = std::thread(&Client::receiveLoop, this);
+    LOG_INFO("Подключение к серверу ", endpoint.toString(), " установлено");
+    return true;
+}
+
+bool Client::connect(std::unique_ptr<Transport> transport) {
+    if (m_connected) {
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_transport = std::move(transport);
+        m_sendFailed = false;
+    }
+    m_serverAddress.clear();
+    if (m_delivery) {
+        m_delivery->resume();
+    }
+    m_connected = true;
     
-    std::cout << "Подключение к серверу " << serverAddress << ":" << port << " установлено" << std::endl;
+    // Запуск потоков приема и отправки сообщений
+    m_receiveThread = std::thread(&Client::receiveLoop, this);
+    m_sendThread = std::thread(&Client::sendLoop, this);
     return true;
 }
 
@@ -60,43 +127,280 @@ void Client::disconnect() {
         return;
     }
     
+    // Уже принятые кадры (например, LOGOUT) успевают уйти на сервер
+    {
+        std::unique_lock<std::mutex> lock(m_sendMutex);
+        m_sendDrained.wait_for(lock, SEND_DRAIN_TIMEOUT, [this] {
+            return m_queuedBytes.load(std::memory_order_relaxed) == 0 || m_sendFailed;
+        });
+    }
+    
     m_connected = false;
     
-    // Закрытие сокета
-    if (m_socket != INVALID_SOCKET) {
-#ifdef _WIN32
-        closesocket(m_socket);
-#else
-        close(m_socket);
-#endif
-        m_socket = INVALID_SOCKET;
+    // shutdown будит поток приема, заблокированный в recv, а прерывание
+    // очереди доставки - ждущий в ней места (например, если disconnect
+    // вызван из обработчика пакета)
+    if (m_transport) {
+        m_transport->shutdown();
+    }
+    if (m_delivery) {
+        m_delivery->interrupt();
     }
     
-    // Ожидание завершения потока приема сообщений
+    // Ожидание завершения потоков приема и отправки сообщений
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_sendReady.notify_all();
+    }
     if (m_receiveThread.joinable()) {
         m_receiveThread.join();
     }
+    if (m_sendThread.joinable()) {
+        m_sendThread.join();
+    }
+    
+    // Закрытие соединения; неотправленные кадры теряются, а пронумерованные
+    // сообщения остаются в окне и повторяются после восстановления сессии
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_transport->close();
+        m_outbox.clear();
+        m_queuedBytes.store(0, std::memory_order_relaxed);
+        m_aboveHighWater = false;
+    }
+    
+    LOG_INFO("Отключение от сервера");
+}
+
+bool Client::reconnect() {
+    if (m_serverAddress.empty()) {
+        return false;
+    }
+    disconnect();
+    if (!connect(m_serverAddress, m_serverPort)) {
+        return false;
+    }
     
-    std::cout << "Отключение от сервера" << std::endl;
+    std::string token = getSessionToken();
+    if (!token.empty()) {
+        sendMessage(Message(Message::Type::RESUME, token, -1));
+    }
+    return true;
+}
+
+std::string Client::getSessionToken() const {
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    return m_sessionToken;
+}
+
+void Client::setSessionToken(const std::string& token) {
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    m_sessionToken = token;
+}
+
+std::shared_ptr<ReliableChannel> Client::getChannel() const {
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    return m_channel;
+}
+
+void Client::setChannel(std::shared_ptr<ReliableChannel> channel) {
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    m_channel = channel;
 }
 
 bool Client::sendMessage(const Message& message) {
+    return sendMessage(Message(message));
+}
+
+bool Client::sendMessage(Message&& message) {
     if (!m_connected) {
         return false;
     }
     
-    std::string serializedMessage = message.serialize();
-    int result = send(m_socket, serializedMessage.c_str(), serializedMessage.length(), 0);
-    return result != SOCKET_ERROR;
+    auto channel = getChannel();
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    // Номер присваивается под мьютексом отправки: порядок номеров совпадает с порядком в сокете
+    if (channel && !channel->stamp(message)) {
+        LOG_WARNING("Сервер не подтверждает прием, окно заполнено");
+        if (m_errorHandler) {
+            m_errorHandler("Сервер не подтверждает прием, сообщение не отправлено");
+        }
+        return false;
+    }
+    
+    {
+        TRACE_SCOPE("Message::serialize");
+        message.serializeTo(m_sendBuffer);
+    }
+    return enqueueFrame(m_sendBuffer);
+}
+
+bool Client::attachSharedMemory(SocketTransport& transport) {
+    auto segment = ShmSegment::create();
+    std::string attach = Message(Message::Type::SHM_ATTACH, "", -1).serialize();
+    if (!segment || !segment->sendAttach(static_cast<int>(transport.socket()), attach)) {
+        LOG_ERROR("Не удалось передать серверу сегмент разделяемой памяти");
+        return false;
+    }
+    
+    // Ответ - последний кадр, который сервер пишет в сокет
+    FrameBuffer frames;
+    std::string frame;
+    char buffer[256];
+    while (!frames.nextFrame(frame)) {
+        int received = recv(transport.socket(), buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            LOG_ERROR("Сервер закрыл соединение при переходе на разделяемую память");
+            return false;
+        }
+        frames.append(buffer, static_cast<size_t>(received));
+    }
+    Message reply;
+    if (!reply.deserialize(frame) || reply.getType() != Message::Type::STATUS || reply.getContent() != "SHM_OK") {
+        LOG_ERROR("Сервер отклонил разделяемую память: ", reply.getContent());
+        return false;
+    }
+    transport.useSharedMemory(std::move(segment));
+    return true;
+}
+
+bool Client::enqueueFrame(const std::string& frame) {
+    if (m_sendFailed) {
+        return false;
+    }
+    m_outbox.append(frame);
+    size_t queued = m_queuedBytes.load(std::memory_order_relaxed) + frame.size();
+    m_queuedBytes.store(queued, std::memory_order_relaxed);
+    if (queued >= m_sendHighWaterMark.load(std::memory_order_relaxed)) {
+        m_aboveHighWater = true;
+    }
+    m_sendReady.notify_one();
+    return true;
+}
+
+void Client::sendLoop() {
+    std::string writing;
+    TRACE_THREAD_NAME("client-send");
+    
+    std::unique_lock<std::mutex> lock(m_sendMutex);
+    while (true) {
+        m_sendReady.wait(lock, [this] { return !m_outbox.empty() || !m_connected; });
+        if (!m_connected) {
+            break;
+        }
+        // Очередь забирается целиком: производители пишут в пустой буфер
+        // с емкостью прошлой очереди, и в установившемся режиме память не выделяется
+        writing.swap(m_outbox);
+        lock.unlock();
+        
+        size_t offset = 0;
+        bool written = true;
+        while (offset < writing.size()) {
+            size_t chunk = std::min(SEND_CHUNK_BYTES, writing.size() - offset);
+            {
+                TRACE_SCOPE("Client::send");
+                written = m_transport->send(writing.data() + offset, chunk);
+            }
+            if (!written) {
+                break;
+            }
+            offset += chunk;
+            releaseQueued(chunk);
+        }
+        writing.clear();
+        
+        lock.lock();
+        if (!written && !m_sendFailed) {
+            // Потерю соединения сообщит поток приема: после shutdown он получит 0
+            LOG_WARNING("Ошибка записи на сервер, очередь отправки сброшена");
+            m_sendFailed = true;
+            m_outbox.clear();
+            m_queuedBytes.store(0, std::memory_order_relaxed);
+            m_transport->shutdown();
+            m_sendDrained.notify_all();
+        }
+    }
 }
 
-bool Client::sendTextMessage(const std::string& content, int receiverId) {
+void Client::releaseQueued(size_t bytes) {
+    bool writable = false;
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        size_t queued = m_queuedBytes.load(std::memory_order_relaxed) - bytes;
+        m_queuedBytes.store(queued, std::memory_order_relaxed);
+        if (m_aboveHighWater && queued <= m_sendHighWaterMark.load(std::memory_order_relaxed) / 2) {
+            m_aboveHighWater = false;
+            writable = true;
+        }
+        if (queued == 0) {
+            // Очередь пуста: ее может ждать disconnect
+            m_sendDrained.notify_all();
+        }
+    }
+    if (writable && m_writableHandler) {
+        m_writableHandler();
+    }
+}
+
+void Client::setSendHighWaterMark(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    m_sendHighWaterMark.store(std::max<size_t>(bytes, 1), std::memory_order_relaxed);
+}
+
+void Client::setWritableHandler(std::function<void()> handler) {
+    m_writableHandler = handler;
+}
+
+void Client::flushAck() {
+    auto channel = getChannel();
+    Message ack;
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    if (channel && channel->takeAck(ack)) {
+        ack.serializeTo(m_sendBuffer);
+        enqueueFrame(m_sendBuffer);
+    }
+}
+
+void Client::replayUnacknowledged(uint64_t peerAck, bool reset) {
+    auto channel = getChannel();
+    if (!channel) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    if (reset) {
+        channel->restart();
+    } else {
+        channel->acknowledge(peerAck);
+    }
+    std::vector<Message> replay = channel->unacknowledged();
+    for (const auto& message : replay) {
+        message.serializeTo(m_sendBuffer);
+        if (!enqueueFrame(m_sendBuffer)) {
+            break;
+        }
+    }
+    if (!replay.empty()) {
+        LOG_INFO("Повторно отправлено сообщений: ", replay.size());
+    }
+}
+
+bool Client::sendTextMessage(std::string_view content, int receiverId) {
     if (!m_currentUser) {
         return false;
     }
     
-    Message message(Message::Type::TEXT, content, m_currentUser->getId(), receiverId);
-    return sendMessage(message);
+    return sendMessage(Message(Message::Type::TEXT, content, m_currentUser->getId(), receiverId));
+}
+
+bool Client::sendTextMessage(std::string_view content, const std::vector<int>& receiverIds, bool deliveryReport) {
+    if (!m_currentUser || receiverIds.empty()) {
+        return false;
+    }
+    
+    Message message(Message::Type::TEXT, content, m_currentUser->getId());
+    message.setRecipients(receiverIds);
+    message.setDeliveryReport(deliveryReport);
+    return sendMessage(std::move(message));
 }
 
 bool Client::login(const std::string& username, const std::string& password) {
@@ -105,10 +409,11 @@ bool Client::login(const std::string& username, const std::string& password) {
     }
     
     // Создание сообщения для входа
-    std::string loginData = username + ":" + password;
-    Message loginMessage(Message::Type::LOGIN, loginData, -1);
+    std::string loginData;
+    loginData.reserve(username.size() + 1 + password.size());
+    loginData.append(username).append(1, ':').append(password);
     
-    if (!sendMessage(loginMessage)) {
+    if (!sendMessage(Message(Message::Type::LOGIN, std::move(loginData), -1))) {
         return false;
     }
     
@@ -131,6 +436,8 @@ bool Client::logout() {
     if (result) {
         m_currentUser->setStatus(User::Status::OFFLINE);
         m_currentUser.reset();
+        setSessionToken("");
+        setChannel(nullptr);
     }
     
     return result;
@@ -141,8 +448,12 @@ bool Client::registerUser(const std::string& username, const std::string& email,
         return false;
     }
     
-    // В реальном приложении здесь должна быть отправка данных регистрации на сервер
-    // Для простоты создаем пользователя локально
+    // Сервер регистрирует пользователя при первом входе; ID придет в ответе LOGIN_OK
+    Message loginMessage(Message::Type::LOGIN, username + ":" + password, -1);
+    if (!sendMessage(loginMessage)) {
+        return false;
+    }
+    
     m_currentUser = std::make_shared<User>(1, username, email);
     m_currentUser->setStatus(User::Status::ONLINE);
     
@@ -153,55 +464,222 @@ void Client::setMessageHandler(std::function<void(const Message&)> handler) {
     m_messageHandler = handler;
 }
 
+void Client::setBatchHandler(std::function<void(MessageSpan)> handler, const DeliveryQueue::Settings& settings) {
+    stopDispatcher();
+    m_batchHandler = handler;
+    if (!m_batchHandler) {
+        return;
+    }
+    m_delivery = std::make_unique<DeliveryQueue>(settings);
+    m_delivery->setWatermarkHandler(m_watermarkHandler);
+    m_dispatchThread = std::thread(&Client::dispatchLoop, this);
+}
+
+void Client::setWatermarkHandler(std::function<void(size_t, bool)> handler) {
+    m_watermarkHandler = handler;
+}
+
+uint64_t Client::getDroppedMessages() const {
+    return m_delivery ? m_delivery->dropped() : 0;
+}
+
 void Client::setErrorHandler(std::function<void(const std::string&)> handler) {
     m_errorHandler = handler;
 }
 
+void Client::setDeliveryReportHandler(std::function<void(const DeliveryReport&)> handler) {
+    m_deliveryReportHandler = handler;
+}
+
+void Client::setPresenceHandler(std::function<void(const PresenceUpdate&)> handler) {
+    m_presenceHandler = handler;
+}
+
+void Client::setLatencyHandler(std::function<void(const Message&, const Message::HopLatency&)> handler) {
+    m_latencyHandler = handler;
+}
+
 void Client::receiveLoop() {
     char buffer[1024];
+    FrameBuffer frames;
+    FrameScanner::Frame batch[FrameScanner::BATCH_SIZE];
+    TRACE_THREAD_NAME("client-receive");
     
     while (m_connected) {
-        int bytesReceived = recv(m_socket, buffer, sizeof(buffer) - 1, 0);
+        // Накопленное подтверждение отправляется, если за ACK_DELAY_MS
+        // не нашлось исходящего кадра, с которым оно ушло бы попутно
+        auto channel = getChannel();
+        if (!m_transport->wait(-1, channel && channel->pendingAcks() > 0 ? ACK_DELAY_MS : -1)) {
+            flushAck();
+            continue;
+        }
+        
+        int bytesReceived = m_transport->receive(buffer, sizeof(buffer));
         if (bytesReceived <= 0) {
             if (m_connected) {
-                std::cout << "Соединение с сервером потеряно" << std::endl;
+                LOG_INFO("Соединение с сервером потеряно");
                 if (m_errorHandler) {
                     m_errorHandler("Соединение с сервером потеряно");
                 }
             }
             break;
         }
+        int64_t receivedNs = Message::currentTimeNs();
         
-        buffer[bytesReceived] = '\0';
-        std::string messageData(buffer);
+        frames.append(buffer, static_cast<size_t>(bytesReceived));
+        if (frames.overflowed()) {
+            LOG_ERROR("Сервер прислал кадр больше допустимого размера");
+            if (m_errorHandler) {
+                m_errorHandler("Сервер прислал кадр больше допустимого размера");
+            }
+            break;
+        }
         
-        Message message;
-        if (message.deserialize(messageData)) {
-            processIncomingMessage(message);
+        size_t count;
+        while ((count = frames.nextFrames(batch, FrameScanner::BATCH_SIZE)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                Message message;
+                bool parsed;
+                {
+                    TRACE_SCOPE("Message::deserialize");
+                    parsed = message.deserialize(batch[i]);
+                }
+                if (!parsed) {
+                    continue;
+                }
+                // Повтор после переподключения уже был обработан
+                channel = getChannel();
+                if (channel && !channel->accept(message)) {
+                    continue;
+                }
+                if (message.getType() == Message::Type::ACK) {
+                    continue;
+                }
+                {
+                    TRACE_SCOPE("Client::processIncomingMessage");
+                    processIncomingMessage(message);
+                }
+                deliver(std::move(message), receivedNs);
+            }
+        }
+        
+        channel = getChannel();
+        if (channel && channel->pendingAcks() >= ReliableChannel::ACK_BATCH_SIZE) {
+            flushAck();
         }
     }
 }
 
 void Client::processIncomingMessage(const Message& message) {
+    struct Handlers {
+        using Ignored [[maybe_unused]] = IgnoredTypes<Message::Type::LOGIN, Message::Type::LOGOUT, Message::Type::FILE,
+                                     Message::Type::PONG, Message::Type::RESUME, Message::Type::ACK,
+                                     Message::Type::SHM_ATTACH>;
+        
+        Client& client;
+        
+        void handle(MessageTag<Message::Type::TEXT>, const Message& message) {
+            LOG_INFO("Получено сообщение: ", message.getContent());
+        }
+        void handle(MessageTag<Message::Type::ERROR>, const Message& message) {
+            LOG_WARNING("Ошибка от сервера: ", message.getContent());
+            if (message.getContent().compare(0, 13, "RESUME_FAILED") == 0) {
+                client.setSessionToken("");
+                client.setChannel(nullptr);
+            }
+            if (client.m_errorHandler) {
+                client.m_errorHandler(std::string(message.getContent()));
+            }
+        }
+        void handle(MessageTag<Message::Type::STATUS>, const Message& message) {
+            client.handleStatus(message);
+        }
+        void handle(MessageTag<Message::Type::PING>, const Message&) {
+            client.sendMessage(Message(Message::Type::PONG, "", -1));
+        }
+    };
+    Handlers handlers{*this};
+    MessageDispatcher<Handlers>::dispatch(handlers, message);
+}
+
+void Client::deliver(Message&& message, int64_t receivedNs) {
+    if (m_delivery) {
+        // Поток приема не ждет обработчиков: при BLOCK он ждет только места в очереди
+        m_delivery->push(std::move(message), receivedNs);
+        return;
+    }
+    if (m_latencyHandler) {
+        m_latencyHandler(message, message.hopLatency(receivedNs));
+    }
     if (m_messageHandler) {
         m_messageHandler(message);
     }
+}
+
+void Client::dispatchLoop() {
+    std::vector<Message> messages;
+    std::vector<int64_t> receivedNs;
+    TRACE_THREAD_NAME("client-dispatch");
     
-    // Обработка различных типов сообщений
-    switch (message.getType()) {
-        case Message::Type::TEXT: {
-            std::cout << "Получено сообщение: " << message.getContent() << std::endl;
-            break;
-        }
-        case Message::Type::ERROR: {
-            std::cout << "Ошибка от сервера: " << message.getContent() << std::endl;
-            if (m_errorHandler) {
-                m_errorHandler(message.getContent());
+    while (m_delivery->popBatch(messages, receivedNs)) {
+        TRACE_SCOPE("Client::dispatchBatch");
+        for (size_t i = 0; i < messages.size(); ++i) {
+            if (m_latencyHandler) {
+                m_latencyHandler(messages[i], messages[i].hopLatency(receivedNs[i]));
+            }
+            if (m_messageHandler) {
+                m_messageHandler(messages[i]);
             }
-            break;
         }
-        default:
-            break;
+        m_batchHandler(MessageSpan(messages.data(), messages.size()));
+    }
+}
+
+void Client::stopDispatcher() {
+    if (m_delivery) {
+        m_delivery->close();
+    }
+    if (m_dispatchThread.joinable()) {
+        m_dispatchThread.join();
+    }
+    m_delivery.reset();
+}
+
+void Client::handleStatus(const Message& message) {
+    // Ответ на вход и восстановление сессии содержит ID пользователя,
+    // назначенный сервером; токен сессии приходит отдельным статусом
+    std::string_view content = message.getContent();
+    const std::string_view loginPrefix = "LOGIN_OK:";
+    const std::string_view resumePrefix = "RESUME_OK:";
+    const std::string_view sessionPrefix = "SESSION:";
+    auto parseId = [&content](size_t offset) {
+        int id = 0;
+        std::from_chars(content.data() + offset, content.data() + content.size(), id);
+        return id;
+    };
+    auto user = m_currentUser;
+    if (user && content.compare(0, loginPrefix.size(), loginPrefix) == 0) {
+        user->setId(parseId(loginPrefix.size()));
+    } else if (content.compare(0, resumePrefix.size(), resumePrefix) == 0) {
+        if (user) {
+            user->setId(parseId(resumePrefix.size()));
+        }
+        // ":RESET" - сервер потерял состояние сессии, нумерация начинается заново
+        bool reset = content.size() >= 6 && content.compare(content.size() - 6, 6, ":RESET") == 0;
+        replayUnacknowledged(message.getAck(), reset);
+    } else if (content.compare(0, sessionPrefix.size(), sessionPrefix) == 0) {
+        setSessionToken(std::string(content.substr(sessionPrefix.size())));
+        setChannel(std::make_shared<ReliableChannel>());
+    } else if (content.compare(0, DeliveryReport::PREFIX.size(), DeliveryReport::PREFIX) == 0) {
+        DeliveryReport report;
+        if (report.parse(content) && m_deliveryReportHandler) {
+            m_deliveryReportHandler(report);
+        }
+    } else if (content.compare(0, PresenceUpdate::PREFIX.size(), PresenceUpdate::PREFIX) == 0) {
+        PresenceUpdate update;
+        if (update.parse(content) && m_presenceHandler) {
+            m_presenceHandler(update);
+        }
     }
 }
 
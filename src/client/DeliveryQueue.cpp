@@ -0,0 +1,133 @@
+#include "client/DeliveryQueue.h"
+#include <algorithm>
+
+DeliveryQueue::DeliveryQueue(const Settings& settings)
+    : m_settings(settings), m_head(0), m_count(0), m_closed(false), m_interrupted(false), m_aboveHighWater(false), m_dropped(0) {
+    m_settings.capacity = std::max<size_t>(m_settings.capacity, 1);
+    m_settings.maxBatch = std::max<size_t>(m_settings.maxBatch, 1);
+    m_settings.highWaterMark = std::min(std::max<size_t>(m_settings.highWaterMark, 1), m_settings.capacity);
+    m_settings.lowWaterMark = std::min(m_settings.lowWaterMark, m_settings.highWaterMark - 1);
+    m_messages.resize(m_settings.capacity);
+    m_receivedNs.resize(m_settings.capacity);
+}
+
+void DeliveryQueue::setWatermarkHandler(std::function<void(size_t, bool)> handler) {
+    m_watermarkHandler = handler;
+}
+
+bool DeliveryQueue::push(Message&& message, int64_t receivedNs) {
+    size_t depth = 0;
+    bool crossed = false;
+    bool stored = true;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_count == m_settings.capacity && !m_closed) {
+            switch (m_settings.overflow) {
+                case Overflow::BLOCK:
+                    m_notFull.wait(lock, [this] {
+                        return m_count < m_settings.capacity || m_closed || m_interrupted;
+                    });
+                    if (m_count == m_settings.capacity && !m_closed) {
+                        ++m_dropped;
+                        return false;
+                    }
+                    break;
+                case Overflow::DROP_NEWEST:
+                    ++m_dropped;
+                    return false;
+                case Overflow::DROP_OLDEST:
+                    m_head = (m_head + 1) % m_settings.capacity;
+                    --m_count;
+                    ++m_dropped;
+                    stored = false;
+                    break;
+            }
+        }
+        if (m_closed) {
+            return false;
+        }
+
+        size_t tail = (m_head + m_count) % m_settings.capacity;
+        m_messages[tail] = std::move(message);
+        m_receivedNs[tail] = receivedNs;
+        ++m_count;
+        depth = m_count;
+        if (!m_aboveHighWater && m_count >= m_settings.highWaterMark) {
+            m_aboveHighWater = true;
+            crossed = true;
+        }
+    }
+    m_notEmpty.notify_one();
+
+    if (crossed && m_watermarkHandler) {
+        m_watermarkHandler(depth, true);
+    }
+    // При DROP_OLDEST новое сообщение сохранено, но одно из принятых потеряно
+    return stored;
+}
+
+bool DeliveryQueue::popBatch(std::vector<Message>& messages, std::vector<int64_t>& receivedNs) {
+    size_t depth = 0;
+    bool crossed = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_count > 0 || m_closed; });
+        if (m_count == 0) {
+            return false;
+        }
+
+        size_t count = std::min(m_count, m_settings.maxBatch);
+        messages.resize(count);
+        receivedNs.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            // Обмен вместо копирования: буферы содержимого возвращаются в кольцо
+            std::swap(messages[i], m_messages[m_head]);
+            receivedNs[i] = m_receivedNs[m_head];
+            m_head = (m_head + 1) % m_settings.capacity;
+        }
+        m_count -= count;
+        depth = m_count;
+        if (m_aboveHighWater && m_count <= m_settings.lowWaterMark) {
+            m_aboveHighWater = false;
+            crossed = true;
+        }
+    }
+    m_notFull.notify_one();
+
+    if (crossed && m_watermarkHandler) {
+        m_watermarkHandler(depth, false);
+    }
+    return true;
+}
+
+void DeliveryQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+}
+
+void DeliveryQueue::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interrupted = true;
+    }
+    m_notFull.notify_all();
+}
+
+void DeliveryQueue::resume() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_interrupted = false;
+}
+
+size_t DeliveryQueue::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+uint64_t DeliveryQueue::dropped() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
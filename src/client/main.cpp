@@ -1,10 +1,27 @@
 #include "client/Client.h"
+#include "common/Trace.h"
+#include <cstdlib>
 #include <iostream>
+#include <signal.h>
 #include <string>
 #include <thread>
 #include <chrono>
+#include <vector>
+
+#ifdef ENABLE_TRACING
+// Обработчик сигнала выгрузки трассы: только выставляет флаг
+void traceDumpHandler(int) {
+    Trace::requestDump();
+}
+#endif
 
 int main() {
+#if defined(ENABLE_TRACING) && defined(SIGUSR1)
+    // kill -USR1 <pid> сохраняет трассу в client-trace-<pid>-<N>.json
+    signal(SIGUSR1, traceDumpHandler);
+    Trace::startDumpWatcher("client-trace");
+#endif
+
     std::cout << "=== Клиент клиент-серверного приложения ===" << std::endl;
     std::cout << "Автор: Эдуард" << std::endl;
     std::cout << "Версия: 1.0" << std::endl;
@@ -14,27 +31,62 @@ int main() {
     
     // Подключение к серверу
     std::string serverAddress;
-    std::cout << "Введите адрес сервера (по умолчанию 127.0.0.1): ";
+    std::cout << "Введите адрес сервера (по умолчанию 127.0.0.1; unix:/путь - локальный сокет, shm:/путь - разделяемая память): ";
     std::getline(std::cin, serverAddress);
     if (serverAddress.empty()) {
         serverAddress = "127.0.0.1";
     }
     
-    if (!client.connect(serverAddress, 8080)) {
-        std::cerr << "Не удалось подключиться к серверу" << std::endl;
-        return 1;
-    }
-    
-    // Установка обработчиков
-    client.setMessageHandler([](const Message& message) {
-        std::cout << "Получено сообщение типа " << Message::typeToString(message.getType()) 
-                  << ": " << message.getContent() << std::endl;
+    // Установка обработчиков: вывод в консоль идет из потока доставки,
+    // поэтому медленный терминал не задерживает чтение сокета
+    client.setLatencyHandler([](const Message&, const Message::HopLatency& latency) {
+        if (latency.totalNs >= 0) {
+            std::cout << "Задержка (мкс): до сервера " << latency.uplinkNs / 1000
+                      << ", на сервере " << latency.serverNs / 1000
+                      << ", до клиента " << latency.downlinkNs / 1000
+                      << ", всего " << latency.totalNs / 1000 << std::endl;
+        }
     });
     
     client.setErrorHandler([](const std::string& error) {
         std::cerr << "Ошибка: " << error << std::endl;
     });
     
+    client.setDeliveryReportHandler([](const DeliveryReport& report) {
+        std::cout << "\nОтчет о доставке:";
+        for (const auto& recipient : report.recipients) {
+            std::cout << " " << recipient.first << "=" << DeliveryReport::statusName(recipient.second);
+        }
+        std::cout << std::endl;
+    });
+    
+    client.setPresenceHandler([](const PresenceUpdate& update) {
+        std::cout << (update.snapshot ? "\nКонтакты:" : "\nИзменения контактов:");
+        for (const auto& contact : update.contacts) {
+            std::cout << " " << contact.first << (contact.second ? " в сети" : " не в сети") << ";";
+        }
+        std::cout << std::endl;
+    });
+    
+    client.setWatermarkHandler([](size_t depth, bool high) {
+        if (high) {
+            std::cerr << "Вывод не успевает за сообщениями: в очереди " << depth << std::endl;
+        }
+    });
+    
+    client.setBatchHandler([](MessageSpan batch) {
+        for (const Message& message : batch) {
+            std::cout << "Получено сообщение типа " << Message::typeToString(message.getType())
+                      << ": " << message.getContent() << '\n';
+        }
+        std::cout.flush();
+    });
+    
+    if (!client.connect(serverAddress, 8080)) {
+        std::cerr << "Не удалось подключиться к серверу" << std::endl;
+        return 1;
+    }
+    
     // Меню пользователя
     std::string choice;
     while (true) {
@@ -85,7 +137,27 @@ int main() {
             std::cout << "Введите сообщение: ";
             std::getline(std::cin, message);
             
-            if (client.sendTextMessage(message)) {
+            // Список "12,15" или "+12,15" (с отчетом о доставке); пусто - всем
+            std::string list;
+            std::cout << "Получатели через запятую (+ в начале - отчет о доставке, пусто - всем): ";
+            std::getline(std::cin, list);
+            bool deliveryReport = !list.empty() && list[0] == '+';
+            std::vector<int> receiverIds;
+            for (size_t position = deliveryReport ? 1 : 0; position < list.size();) {
+                size_t comma = list.find(',', position);
+                if (comma == std::string::npos) {
+                    comma = list.size();
+                }
+                int receiverId = std::atoi(list.substr(position, comma - position).c_str());
+                if (receiverId > 0) {
+                    receiverIds.push_back(receiverId);
+                }
+                position = comma + 1;
+            }
+            
+            bool sent = receiverIds.empty() ? client.sendTextMessage(message)
+                                            : client.sendTextMessage(message, receiverIds, deliveryReport);
+            if (sent) {
                 std::cout << "Сообщение отправлено" << std::endl;
             } else {
                 std::cout << "Ошибка отправки сообщения" << std::endl;
@@ -107,6 +179,9 @@ int main() {
     }
     
     client.disconnect();
+#ifdef ENABLE_TRACING
+    Trace::stopDumpWatcher();
+#endif
     std::cout << "Клиент завершен" << std::endl;
     return 0;
 }
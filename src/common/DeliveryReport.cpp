@@ -0,0 +1,69 @@
+#include "common/DeliveryReport.h"
+#include <array>
+#include <charconv>
+
+namespace {
+
+const std::array<std::string_view, 4> STATUS_NAMES = {"QUEUED", "STORED", "FORWARDED", "NOT_FOUND"};
+
+template <typename T>
+bool parseNumber(std::string_view text, T& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+} // namespace
+
+std::string_view DeliveryReport::statusName(Status status) {
+    return STATUS_NAMES[static_cast<size_t>(status)];
+}
+
+std::string DeliveryReport::toContent() const {
+    std::string content(PREFIX);
+    content += std::to_string(messageTimestampNs);
+    content.push_back(':');
+    for (size_t i = 0; i < recipients.size(); ++i) {
+        if (i > 0) {
+            content.push_back(',');
+        }
+        content += std::to_string(recipients[i].first);
+        content.push_back('=');
+        content.append(statusName(recipients[i].second));
+    }
+    return content;
+}
+
+bool DeliveryReport::parse(std::string_view content) {
+    if (content.compare(0, PREFIX.size(), PREFIX) != 0) {
+        return false;
+    }
+    content.remove_prefix(PREFIX.size());
+    size_t separator = content.find(':');
+    if (separator == std::string_view::npos || !parseNumber(content.substr(0, separator), messageTimestampNs)) {
+        return false;
+    }
+    content.remove_prefix(separator + 1);
+
+    recipients.clear();
+    while (!content.empty()) {
+        size_t end = content.find(',');
+        std::string_view entry = content.substr(0, end);
+        size_t equals = entry.find('=');
+        int id = 0;
+        if (equals == std::string_view::npos || !parseNumber(entry.substr(0, equals), id)) {
+            return false;
+        }
+        std::string_view name = entry.substr(equals + 1);
+        size_t index = 0;
+        while (index < STATUS_NAMES.size() && STATUS_NAMES[index] != name) {
+            ++index;
+        }
+        if (index == STATUS_NAMES.size()) {
+            return false;
+        }
+        recipients.emplace_back(id, static_cast<Status>(index));
+        content.remove_prefix(end == std::string_view::npos ? content.size() : end + 1);
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#include "common/Endpoint.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/un.h>
+#endif
+
+namespace {
+
+const std::string UNIX_PREFIX = "unix:";
+const std::string SHM_PREFIX = "shm:";
+const std::string TCP_PREFIX = "tcp:";
+
+} // namespace
+
+bool Endpoint::parse(const std::string& address, int defaultPort, Endpoint& endpoint) {
+    endpoint = Endpoint();
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        endpoint.scheme = Scheme::UNIX;
+        endpoint.path = address.substr(UNIX_PREFIX.size());
+        return !endpoint.path.empty();
+    }
+    if (address.compare(0, SHM_PREFIX.size(), SHM_PREFIX) == 0) {
+        endpoint.scheme = Scheme::SHM;
+        endpoint.path = address.substr(SHM_PREFIX.size());
+        return !endpoint.path.empty();
+    }
+
+    std::string hostPort = address.compare(0, TCP_PREFIX.size(), TCP_PREFIX) == 0
+        ? address.substr(TCP_PREFIX.size()) : address;
+    size_t separator = hostPort.rfind(':');
+    endpoint.scheme = Scheme::TCP;
+    if (separator == std::string::npos) {
+        endpoint.host = hostPort;
+        endpoint.port = defaultPort;
+    } else {
+        endpoint.host = hostPort.substr(0, separator);
+        endpoint.port = std::atoi(hostPort.c_str() + separator + 1);
+    }
+    return endpoint.port > 0 && endpoint.port < 65536;
+}
+
+int Endpoint::family() const {
+#ifdef _WIN32
+    return AF_INET;
+#else
+    return scheme == Scheme::TCP ? AF_INET : AF_UNIX;
+#endif
+}
+
+bool Endpoint::toSockaddr(sockaddr_storage& address, socklen_t& length) const {
+    std::memset(&address, 0, sizeof(address));
+    if (scheme != Scheme::TCP) {
+#ifdef _WIN32
+        return false;
+#else
+        sockaddr_un* unixAddress = reinterpret_cast<sockaddr_un*>(&address);
+        if (path.size() >= sizeof(unixAddress->sun_path)) {
+            return false;
+        }
+        unixAddress->sun_family = AF_UNIX;
+        std::memcpy(unixAddress->sun_path, path.c_str(), path.size() + 1);
+        length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+        return true;
+#endif
+    }
+
+    sockaddr_in* inetAddress = reinterpret_cast<sockaddr_in*>(&address);
+    inetAddress->sin_family = AF_INET;
+    inetAddress->sin_port = htons(static_cast<uint16_t>(port));
+    if (host.empty()) {
+        inetAddress->sin_addr.s_addr = INADDR_ANY;
+    } else if (inet_pton(AF_INET, host.c_str(), &inetAddress->sin_addr) <= 0) {
+        return false;
+    }
+    length = sizeof(sockaddr_in);
+    return true;
+}
+
+std::string Endpoint::toString() const {
+    if (scheme != Scheme::TCP) {
+        return (scheme == Scheme::UNIX ? UNIX_PREFIX : SHM_PREFIX) + path;
+    }
+    return TCP_PREFIX + host + ":" + std::to_string(port);
+}
@@ -0,0 +1,60 @@
+#include "common/FrameBuffer.h"
+#include "common/Message.h"
+
+FrameBuffer::FrameBuffer(size_t maxFrameSize)
+    : m_readPos(0), m_scanPos(0), m_maxFrameSize(maxFrameSize) {
+}
+
+void FrameBuffer::append(const char* data, size_t length) {
+    // Сдвигаем данные к началу, когда извлеченная часть занимает больше половины буфера
+    if (m_readPos > 0 && m_readPos >= m_buffer.size() / 2) {
+        m_buffer.erase(0, m_readPos);
+        m_scanPos -= m_readPos;
+        m_readPos = 0;
+    }
+    m_buffer.append(data, length);
+}
+
+bool FrameBuffer::nextFrame(std::string& frame) {
+    size_t delimiter = m_buffer.find(Message::FRAME_DELIMITER, m_scanPos);
+    if (delimiter == std::string::npos) {
+        m_scanPos = m_buffer.size();
+        return false;
+    }
+
+    frame.assign(m_buffer, m_readPos, delimiter - m_readPos);
+    m_readPos = delimiter + 1;
+    m_scanPos = m_readPos;
+    if (m_readPos == m_buffer.size()) {
+        m_buffer.clear();
+        m_readPos = 0;
+        m_scanPos = 0;
+    }
+    return true;
+}
+
+size_t FrameBuffer::nextFrames(FrameScanner::Frame* frames, size_t capacity) {
+    // Незавершенный кадр не разбирается заново, пока не пришел его конец
+    if (m_buffer.find(Message::FRAME_DELIMITER, m_scanPos) == std::string::npos) {
+        m_scanPos = m_buffer.size();
+        return 0;
+    }
+
+    size_t consumed = 0;
+    size_t count = FrameScanner::scan(std::string_view(m_buffer).substr(m_readPos), frames, capacity, consumed);
+    m_readPos += consumed;
+    m_scanPos = m_readPos;
+    return count;
+}
+
+std::string FrameBuffer::takePending() {
+    std::string pendingBytes = m_buffer.substr(m_readPos);
+    clear();
+    return pendingBytes;
+}
+
+void FrameBuffer::clear() {
+    m_buffer.clear();
+    m_readPos = 0;
+    m_scanPos = 0;
+}
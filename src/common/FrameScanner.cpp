@@ -0,0 +1,238 @@
+#include "common/FrameScanner.h"
+#include "common/Message.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define FRAMESCANNER_SSE2
+    #include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define FRAMESCANNER_AVX2
+    #include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace {
+
+const char FIELD_SEPARATOR = '|';
+
+/**
+ * @brief Состояние просмотра: текущий кадр и поле
+ */
+struct ScanState {
+    const char* base;               ///< Начало буфера
+    FrameScanner::Frame* frames;    ///< Массив найденных кадров
+    size_t capacity;                ///< Размер массива
+    size_t count = 0;               ///< Найдено кадров
+    size_t frameStart = 0;          ///< Начало текущего кадра
+    size_t fieldStart = 0;          ///< Начало текущего поля
+    size_t field = 0;               ///< Номер текущего поля заголовка
+
+    ScanState(const char* data, FrameScanner::Frame* output, size_t size)
+        : base(data), frames(output), capacity(size) {}
+
+    bool inHeader() const { return field < FrameScanner::HEADER_FIELDS; }
+};
+
+inline unsigned countTrailingZeros(uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(value));
+#endif
+}
+
+inline void addField(ScanState& state, size_t position) {
+    state.frames[state.count].fields[state.field++] =
+        std::string_view(state.base + state.fieldStart, position - state.fieldStart);
+    state.fieldStart = position + 1;
+}
+
+// false - массив кадров заполнен
+inline bool finishFrame(ScanState& state, size_t position) {
+    FrameScanner::Frame& frame = state.frames[state.count];
+    frame.data = std::string_view(state.base + state.frameStart, position - state.frameStart);
+    frame.complete = !state.inHeader();
+    frame.content = frame.complete ? std::string_view(state.base + state.fieldStart, position - state.fieldStart)
+                                   : std::string_view();
+    ++state.count;
+    state.frameStart = position + 1;
+    state.fieldStart = position + 1;
+    state.field = 0;
+    return state.count < state.capacity;
+}
+
+/**
+ * @brief Обработка масок блока: бит i - символ в позиции blockStart + i
+ */
+inline bool consumeMasks(ScanState& state, size_t blockStart, uint32_t separators, uint32_t delimiters) {
+    uint32_t marks = delimiters | (state.inHeader() ? separators : 0);
+    while (marks != 0) {
+        unsigned bit = countTrailingZeros(marks);
+        size_t position = blockStart + bit;
+        if (delimiters & (1u << bit)) {
+            if (!finishFrame(state, position)) {
+                return false;
+            }
+            // Следующий кадр начинается с заголовка: снова нужны и разделители полей
+            uint32_t rest = ~((2u << bit) - 1);
+            marks = (separators | delimiters) & rest;
+        } else {
+            marks &= marks - 1;
+            addField(state, position);
+            if (!state.inHeader()) {
+                marks &= delimiters;
+            }
+        }
+    }
+    return true;
+}
+
+bool scanRange(ScanState& state, size_t from, size_t to) {
+    size_t position = from;
+    while (position < to) {
+        if (!state.inHeader()) {
+            // Содержимое пропускается до конца кадра целиком
+            const void* end = std::memchr(state.base + position, Message::FRAME_DELIMITER, to - position);
+            if (!end) {
+                return true;
+            }
+            position = static_cast<size_t>(static_cast<const char*>(end) - state.base);
+        }
+        char c = state.base[position];
+        if (c == Message::FRAME_DELIMITER) {
+            if (!finishFrame(state, position)) {
+                return false;
+            }
+        } else if (c == FIELD_SEPARATOR) {
+            addField(state, position);
+        }
+        ++position;
+    }
+    return true;
+}
+
+size_t finishScan(const ScanState& state, size_t& consumed) {
+    consumed = state.frameStart;
+    return state.count;
+}
+
+size_t scanScalar(std::string_view data, FrameScanner::Frame* frames, size_t capacity, size_t& consumed) {
+    ScanState state(data.data(), frames, capacity);
+    scanRange(state, 0, data.size());
+    return finishScan(state, consumed);
+}
+
+#ifdef FRAMESCANNER_SSE2
+size_t scanSse2(std::string_view data, FrameScanner::Frame* frames, size_t capacity, size_t& consumed) {
+    ScanState state(data.data(), frames, capacity);
+    const __m128i separator = _mm_set1_epi8(FIELD_SEPARATOR);
+    const __m128i delimiter = _mm_set1_epi8(Message::FRAME_DELIMITER);
+    size_t position = 0;
+    for (; position + 16 <= data.size(); position += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state.base + position));
+        uint32_t delimiters = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, delimiter)));
+        uint32_t separators = state.inHeader() || delimiters != 0
+            ? static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, separator))) : 0;
+        if (!consumeMasks(state, position, separators, delimiters)) {
+            return finishScan(state, consumed);
+        }
+    }
+    scanRange(state, position, data.size());
+    return finishScan(state, consumed);
+}
+#endif
+
+#ifdef FRAMESCANNER_AVX2
+__attribute__((target("avx2")))
+size_t scanAvx2(std::string_view data, FrameScanner::Frame* frames, size_t capacity, size_t& consumed) {
+    ScanState state(data.data(), frames, capacity);
+    const __m256i separator = _mm256_set1_epi8(FIELD_SEPARATOR);
+    const __m256i delimiter = _mm256_set1_epi8(Message::FRAME_DELIMITER);
+    size_t position = 0;
+    for (; position + 32 <= data.size(); position += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.base + position));
+        uint32_t delimiters = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, delimiter)));
+        uint32_t separators = state.inHeader() || delimiters != 0
+            ? static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, separator))) : 0;
+        if (!consumeMasks(state, position, separators, delimiters)) {
+            return finishScan(state, consumed);
+        }
+    }
+    scanRange(state, position, data.size());
+    return finishScan(state, consumed);
+}
+#endif
+
+FrameScanner::Isa detectIsa() {
+#ifdef FRAMESCANNER_AVX2
+    // Вызывается при инициализации статических объектов, возможно раньше libgcc
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return FrameScanner::Isa::AVX2;
+    }
+#endif
+#ifdef FRAMESCANNER_SSE2
+    return FrameScanner::Isa::SSE2;
+#else
+    return FrameScanner::Isa::SCALAR;
+#endif
+}
+
+const FrameScanner::Isa ACTIVE_ISA = detectIsa();
+
+} // namespace
+
+size_t FrameScanner::scan(std::string_view data, Frame* frames, size_t capacity, size_t& consumed) {
+    return scan(ACTIVE_ISA, data, frames, capacity, consumed);
+}
+
+size_t FrameScanner::scan(Isa isa, std::string_view data, Frame* frames, size_t capacity, size_t& consumed) {
+    consumed = 0;
+    if (capacity == 0) {
+        return 0;
+    }
+    switch (isa) {
+#ifdef FRAMESCANNER_AVX2
+        case Isa::AVX2:
+            return scanAvx2(data, frames, capacity, consumed);
+#endif
+#ifdef FRAMESCANNER_SSE2
+        case Isa::SSE2:
+            return scanSse2(data, frames, capacity, consumed);
+#endif
+        default:
+            return scanScalar(data, frames, capacity, consumed);
+    }
+}
+
+bool FrameScanner::supported(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2:
+            return ACTIVE_ISA == Isa::AVX2;
+        case Isa::SSE2:
+            return ACTIVE_ISA != Isa::SCALAR;
+        default:
+            return true;
+    }
+}
+
+FrameScanner::Isa FrameScanner::active() {
+    return ACTIVE_ISA;
+}
+
+const char* FrameScanner::isaName(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,308 @@
+#include "common/Logger.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Запись журнала в кольцевом буфере потока
+ */
+struct Record {
+    Logger::Level level;
+    uint32_t threadId;
+    int64_t timestampNs;
+    uint32_t length;
+    char text[Logger::RECORD_TEXT_SIZE];
+};
+
+/**
+ * @brief Кольцевой буфер записей одного потока (один производитель, один потребитель)
+ */
+struct ThreadRing {
+    Record records[Logger::RING_CAPACITY];
+    std::atomic<uint64_t> head{0};      ///< Записано производителем
+    std::atomic<uint64_t> tail{0};      ///< Забрано фоновым потоком
+    std::atomic<bool> inUse{true};      ///< Буфер закреплен за живым потоком
+    std::atomic<bool> writing{false};   ///< Производитель пишет запись (см. Logger::stop)
+};
+
+std::mutex g_ringsMutex;                            ///< Защищает реестр буферов (не горячий путь)
+std::vector<std::unique_ptr<ThreadRing>> g_rings;   ///< Буферы всех потоков
+std::atomic<uint32_t> g_nextThreadId{1};
+
+std::atomic<int> g_minLevel{static_cast<int>(Logger::Level::INFO)};
+std::atomic<bool> g_async{false};
+std::atomic<uint64_t> g_dropped{0};
+std::mutex g_syncMutex;                             ///< Синхронный вывод без фонового потока
+
+std::mutex g_writerMutex;
+std::condition_variable g_writerCv;
+bool g_writerRunning = false;
+std::thread g_writerThread;
+FILE* g_output = nullptr;
+
+const auto FLUSH_INTERVAL = std::chrono::milliseconds(10);
+
+/**
+ * @brief Состояние журнала текущего потока
+ *
+ * Буфер завершившегося потока возвращается в реестр; его недочитанные
+ * записи заберет фоновый поток, а новый владелец продолжит с того же места.
+ */
+struct ThreadState {
+    ThreadRing* ring = nullptr;
+    uint32_t threadId = 0;
+
+    ~ThreadState() {
+        if (ring) {
+            ring->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadState t_state;
+
+ThreadState& threadState() {
+    if (!t_state.ring) {
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        for (auto& ring : g_rings) {
+            bool expected = false;
+            if (ring->inUse.compare_exchange_strong(expected, true)) {
+                t_state.ring = ring.get();
+                break;
+            }
+        }
+        if (!t_state.ring) {
+            g_rings.push_back(std::make_unique<ThreadRing>());
+            t_state.ring = g_rings.back().get();
+        }
+        t_state.threadId = g_nextThreadId++;
+    }
+    return t_state;
+}
+
+/**
+ * @brief Форматирование записи в пакет для записи в файл
+ *
+ * Вызывается только из фонового потока, поэтому кэш секундной части
+ * времени не требует синхронизации.
+ */
+void formatRecord(std::string& batch, const Record& record) {
+    static time_t cachedSecond = -1;
+    static char cachedPrefix[32];
+
+    time_t second = static_cast<time_t>(record.timestampNs / 1000000000);
+    if (second != cachedSecond) {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &second);
+#else
+        localtime_r(&second, &tm);
+#endif
+        std::strftime(cachedPrefix, sizeof(cachedPrefix), "%Y-%m-%d %H:%M:%S", &tm);
+        cachedSecond = second;
+    }
+
+    char header[96];
+    int length = std::snprintf(header, sizeof(header), "%s.%06d [%s] [%u] ",
+                               cachedPrefix,
+                               static_cast<int>(record.timestampNs % 1000000000 / 1000),
+                               Logger::levelToString(record.level).c_str(),
+                               record.threadId);
+    batch.append(header, length > 0 ? static_cast<size_t>(length) : 0);
+    batch.append(record.text, record.length);
+    batch.push_back('\n');
+}
+
+/**
+ * @brief Сбор записей из всех буферов в один пакет
+ */
+void drainRings(std::string& batch) {
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    for (auto& ring : g_rings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            formatRecord(batch, ring->records[tail & (Logger::RING_CAPACITY - 1)]);
+        }
+        ring->tail.store(head, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Синхронный вывод записи (журнал не запущен или остановлен)
+ */
+void writeSync(Logger::Level level, const char* text, size_t length) {
+    // Без фонового потока пишем сразу, как раньше делал std::cout
+    std::lock_guard<std::mutex> lock(g_syncMutex);
+    FILE* stream = level >= Logger::Level::WARNING ? stderr : stdout;
+    std::fwrite(text, 1, length, stream);
+    std::fputc('\n', stream);
+    std::fflush(stream);
+}
+
+void writerLoop() {
+    std::string batch;
+    batch.reserve(64 * 1024);
+    uint64_t reportedDropped = 0;
+
+    std::unique_lock<std::mutex> lock(g_writerMutex);
+    while (true) {
+        bool running = g_writerRunning;
+        lock.unlock();
+
+        batch.clear();
+        drainRings(batch);
+
+        uint64_t dropped = g_dropped.load();
+        if (dropped != reportedDropped) {
+            batch += "[WARNING] журнал: отброшено записей из-за переполнения буферов: " +
+                     std::to_string(dropped - reportedDropped) + "\n";
+            reportedDropped = dropped;
+        }
+
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), g_output);
+            std::fflush(g_output);
+        }
+
+        lock.lock();
+        if (!running) {
+            break;
+        }
+        g_writerCv.wait_for(lock, FLUSH_INTERVAL);
+    }
+}
+
+} // namespace
+
+bool Logger::start(const std::string& path, Level minLevel) {
+    std::lock_guard<std::mutex> lock(g_writerMutex);
+    if (g_writerRunning) {
+        return true;
+    }
+
+    if (path.empty()) {
+        g_output = stdout;
+    } else {
+        g_output = std::fopen(path.c_str(), "a");
+        if (!g_output) {
+            return false;
+        }
+    }
+
+    setLevel(minLevel);
+    g_writerRunning = true;
+    g_writerThread = std::thread(writerLoop);
+    g_async.store(true);
+    return true;
+}
+
+void Logger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(g_writerMutex);
+        if (!g_writerRunning) {
+            return;
+        }
+        g_writerRunning = false;
+    }
+    g_writerCv.notify_all();
+    if (g_writerThread.joinable()) {
+        g_writerThread.join();
+    }
+
+    // Новые записи идут синхронно; производители, успевшие выбрать буфер,
+    // дописывают запись, после чего буферы выгружаются в последний раз
+    g_async.store(false);
+    {
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        for (auto& ring : g_rings) {
+            while (ring->writing.load()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    std::string batch;
+    drainRings(batch);
+    if (!batch.empty()) {
+        std::fwrite(batch.data(), 1, batch.size(), g_output);
+        std::fflush(g_output);
+    }
+
+    if (g_output && g_output != stdout) {
+        std::fclose(g_output);
+    }
+    g_output = nullptr;
+}
+
+void Logger::setLevel(Level level) {
+    g_minLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool Logger::isEnabled(Level level) {
+    return static_cast<int>(level) >= g_minLevel.load(std::memory_order_relaxed);
+}
+
+uint64_t Logger::droppedCount() {
+    return g_dropped.load();
+}
+
+std::string Logger::levelToString(Level level) {
+    switch (level) {
+        case Level::DEBUG: return "DEBUG";
+        case Level::INFO: return "INFO";
+        case Level::WARNING: return "WARNING";
+        case Level::ERROR: return "ERROR";
+        default: return "UNKNOWN";
+    }
+}
+
+Logger::Level Logger::stringToLevel(const std::string& levelStr) {
+    if (levelStr == "DEBUG") return Level::DEBUG;
+    if (levelStr == "INFO") return Level::INFO;
+    if (levelStr == "WARNING") return Level::WARNING;
+    if (levelStr == "ERROR") return Level::ERROR;
+    return Level::INFO; // По умолчанию
+}
+
+void Logger::write(Level level, const char* text, size_t length) {
+    if (!g_async.load(std::memory_order_acquire)) {
+        writeSync(level, text, length);
+        return;
+    }
+
+    ThreadState& state = threadState();
+    ThreadRing* ring = state.ring;
+
+    // Флаг выставляется до повторной проверки режима: stop() либо увидит
+    // его и дождется записи, либо запись уйдет синхронно
+    ring->writing.store(true);
+    if (!g_async.load()) {
+        ring->writing.store(false, std::memory_order_release);
+        writeSync(level, text, length);
+        return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        ring->writing.store(false, std::memory_order_release);
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head & (RING_CAPACITY - 1)];
+    record.level = level;
+    record.threadId = state.threadId;
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.length = static_cast<uint32_t>(length);
+    std::char_traits<char>::copy(record.text, text, length);
+    ring->head.store(head + 1, std::memory_order_release);
+    ring->writing.store(false, std::memory_order_release);
+}
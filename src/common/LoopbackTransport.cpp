@@ -0,0 +1,104 @@
+#include "common/LoopbackTransport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+LoopbackTransport::createPair(size_t capacity) {
+    auto shared = std::make_shared<Shared>(std::max<size_t>(capacity, 1));
+    return {std::unique_ptr<LoopbackTransport>(new LoopbackTransport(shared, 0)),
+            std::unique_ptr<LoopbackTransport>(new LoopbackTransport(shared, 1))};
+}
+
+LoopbackTransport::LoopbackTransport(std::shared_ptr<Shared> shared, int side)
+    : m_shared(std::move(shared)), m_incoming(m_shared->pipes[side]), m_outgoing(m_shared->pipes[1 - side]) {
+}
+
+LoopbackTransport::~LoopbackTransport() {
+    shutdown();
+}
+
+int LoopbackTransport::receive(char* buffer, size_t size) {
+    Pipe& pipe = m_incoming;
+    std::unique_lock<std::mutex> lock(pipe.mutex);
+    pipe.readable.wait(lock, [&pipe] { return pipe.size > 0 || pipe.closed; });
+    if (pipe.size == 0) {
+        return 0;
+    }
+
+    size_t capacity = pipe.data.size();
+    size_t count = std::min(size, pipe.size);
+    size_t first = std::min(count, capacity - pipe.head);
+    std::memcpy(buffer, pipe.data.data() + pipe.head, first);
+    std::memcpy(buffer + first, pipe.data.data(), count - first);
+    pipe.head = (pipe.head + count) % capacity;
+    pipe.size -= count;
+    lock.unlock();
+    pipe.writable.notify_one();
+    return static_cast<int>(count);
+}
+
+bool LoopbackTransport::send(const char* data, size_t size) {
+    Pipe& pipe = m_outgoing;
+    size_t capacity = pipe.data.size();
+    std::unique_lock<std::mutex> lock(pipe.mutex);
+    while (size > 0) {
+        // Кадр больше буфера пишется частями по мере чтения другой стороной
+        pipe.writable.wait(lock, [&pipe, capacity] { return pipe.size < capacity || pipe.closed; });
+        if (pipe.closed) {
+            return false;
+        }
+
+        size_t tail = (pipe.head + pipe.size) % capacity;
+        size_t count = std::min(size, capacity - pipe.size);
+        size_t first = std::min(count, capacity - tail);
+        std::memcpy(pipe.data.data() + tail, data, first);
+        std::memcpy(pipe.data.data(), data + first, count - first);
+        pipe.size += count;
+        data += count;
+        size -= count;
+        pipe.readable.notify_one();
+    }
+    return true;
+}
+
+bool LoopbackTransport::wait(int, int timeoutMs) {
+    // Соединение не передается при горячем обновлении, поэтому дескриптор
+    // пробуждения не нужен: release() закрывает соединение и будит поток
+    Pipe& pipe = m_incoming;
+    std::unique_lock<std::mutex> lock(pipe.mutex);
+    auto ready = [&pipe] { return pipe.size > 0 || pipe.closed; };
+    if (timeoutMs < 0) {
+        pipe.readable.wait(lock, ready);
+        return true;
+    }
+    return pipe.readable.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+}
+
+void LoopbackTransport::shutdown() {
+    closePipe(m_incoming);
+    closePipe(m_outgoing);
+}
+
+void LoopbackTransport::close() {
+    shutdown();
+}
+
+socket_t LoopbackTransport::release() {
+    shutdown();
+    return INVALID_SOCKET;
+}
+
+size_t LoopbackTransport::available() const {
+    std::lock_guard<std::mutex> lock(m_incoming.mutex);
+    return m_incoming.size;
+}
+
+void LoopbackTransport::closePipe(Pipe& pipe) {
+    {
+        std::lock_guard<std::mutex> lock(pipe.mutex);
+        pipe.closed = true;
+    }
+    pipe.readable.notify_all();
+    pipe.writable.notify_all();
+}
@@ -1,85 +1,320 @@
 #include "common/Message.h"
-#include <sstream>
-#include <iomanip>
+#include "common/SimulatedClock.h"
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief Параметры хеша имени типа: длина, первый и второй символы
+ */
+struct TypeHash {
+    uint32_t lengthFactor;      ///< Множитель длины
+    uint32_t secondFactor;      ///< Множитель второго символа
+};
+
+const size_t TYPE_HASH_SIZE = 32;
+
+constexpr size_t hashTypeName(std::string_view name, TypeHash hash) {
+    return (name.size() * hash.lengthFactor + static_cast<unsigned char>(name[0]) +
+            static_cast<unsigned char>(name[1]) * hash.secondFactor) % TYPE_HASH_SIZE;
+}
+
+/**
+ * @brief Подбор множителей, при которых имена типов не дают коллизий
+ */
+constexpr TypeHash findTypeHash() {
+    for (uint32_t lengthFactor = 1; lengthFactor < 64; ++lengthFactor) {
+        for (uint32_t secondFactor = 0; secondFactor < 64; ++secondFactor) {
+            TypeHash hash{lengthFactor, secondFactor};
+            std::array<bool, TYPE_HASH_SIZE> used{};
+            bool collision = false;
+            for (std::string_view name : MESSAGE_TYPE_NAMES) {
+                size_t slot = hashTypeName(name, hash);
+                collision = collision || used[slot];
+                used[slot] = true;
+            }
+            if (!collision) {
+                return hash;
+            }
+        }
+    }
+    return TypeHash{0, 0};
+}
+
+constexpr TypeHash TYPE_HASH = findTypeHash();
+static_assert(TYPE_HASH.lengthFactor != 0, "имена типов сообщений не различаются хешем: увеличьте TYPE_HASH_SIZE");
+
+/**
+ * @brief Ячейка хеша -> индекс типа (-1 - пусто)
+ */
+constexpr std::array<int8_t, TYPE_HASH_SIZE> makeTypeIndex() {
+    std::array<int8_t, TYPE_HASH_SIZE> index{};
+    for (auto& slot : index) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < Message::TYPE_COUNT; ++i) {
+        index[hashTypeName(MESSAGE_TYPE_NAMES[i], TYPE_HASH)] = static_cast<int8_t>(i);
+    }
+    return index;
+}
+
+constexpr std::array<int8_t, TYPE_HASH_SIZE> TYPE_INDEX = makeTypeIndex();
+
+constexpr bool namesAreValid() {
+    for (std::string_view name : MESSAGE_TYPE_NAMES) {
+        if (name.size() < 2) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(namesAreValid(), "имя каждого типа сообщения должно быть не короче двух символов");
+
+} // namespace
 
 Message::Message() 
-    : m_type(Type::TEXT), m_senderId(-1), m_receiverId(-1), m_timestamp(std::chrono::system_clock::now()) {
+    : m_type(Type::TEXT), m_senderId(-1), m_receiverId(-1), m_deliveryReport(false), m_timestampNs(currentTimeNs()),
+      m_serverReceiveNs(0), m_serverSendNs(0), m_seq(0), m_ack(0) {
+}
+
+Message::Message(Type type, Payload content, int senderId, int receiverId)
+    : m_type(type), m_content(std::move(content)), m_senderId(senderId), m_receiverId(receiverId),
+      m_deliveryReport(false), m_timestampNs(currentTimeNs()), m_serverReceiveNs(0), m_serverSendNs(0), m_seq(0), m_ack(0) {
+}
+
+void Message::setRecipients(std::vector<int> recipients) {
+    m_recipients = std::move(recipients);
+    m_receiverId = m_recipients.empty() ? -1 : m_recipients.front();
+}
+
+std::chrono::system_clock::time_point Message::getTimestamp() const {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(m_timestampNs)));
+}
+
+int64_t Message::currentTimeNs() {
+    if (SimulatedClock::isEnabled()) {
+        return SimulatedClock::now();
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+Message::HopLatency Message::hopLatency(int64_t receivedNs) const {
+    HopLatency latency;
+    if (m_timestampNs != 0 && m_serverReceiveNs != 0) {
+        latency.uplinkNs = m_serverReceiveNs - m_timestampNs;
+    }
+    if (m_serverReceiveNs != 0 && m_serverSendNs != 0) {
+        latency.serverNs = m_serverSendNs - m_serverReceiveNs;
+    }
+    if (m_serverSendNs != 0 && receivedNs != 0) {
+        latency.downlinkNs = receivedNs - m_serverSendNs;
+    }
+    if (m_timestampNs != 0 && receivedNs != 0) {
+        latency.totalNs = receivedNs - m_timestampNs;
+    }
+    return latency;
+}
+
+namespace {
+
+// Содержимое не может содержать разделитель кадров, поэтому '\n' и '\\' экранируются
+void appendEscaped(std::string& buffer, std::string_view content) {
+    size_t begin = 0;
+    for (size_t i = 0; i < content.size(); ++i) {
+        char c = content[i];
+        if (c != '\\' && c != Message::FRAME_DELIMITER) {
+            continue;
+        }
+        buffer.append(content.data() + begin, i - begin);
+        buffer.push_back('\\');
+        buffer.push_back(c == '\\' ? '\\' : 'n');
+        begin = i + 1;
+    }
+    buffer.append(content.data() + begin, content.size() - begin);
+}
+
+// Снятие экранирования; возвращает длину результата (не больше исходной)
+size_t unescapeTo(std::string_view content, char* target) {
+    // Участки между '\\' копируются целиком: экранирование редко, а memchr
+    // и memcpy просматривают содержимое блоками, а не побайтово
+    size_t length = 0;
+    size_t i = 0;
+    while (i < content.size()) {
+        const void* escape = std::memchr(content.data() + i, '\\', content.size() - i);
+        size_t end = escape ? static_cast<size_t>(static_cast<const char*>(escape) - content.data()) : content.size();
+        std::memcpy(target + length, content.data() + i, end - i);
+        length += end - i;
+        if (end + 1 >= content.size()) {
+            // Одиночный '\\' в конце сохраняется как есть
+            if (end < content.size()) {
+                target[length++] = content[end];
+            }
+            break;
+        }
+        target[length++] = content[end + 1] == 'n' ? Message::FRAME_DELIMITER : content[end + 1];
+        i = end + 2;
+    }
+    return length;
+}
+
+template <typename T>
+void appendNumber(std::string& buffer, T value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, static_cast<size_t>(result.ptr - digits));
+    buffer.push_back('|');
+}
+
+// Поле заголовка должно целиком состоять из числа
+template <typename T>
+bool parseField(std::string_view field, T& value) {
+    const char* end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
 }
 
-Message::Message(Type type, const std::string& content, int senderId, int receiverId)
-    : m_type(type), m_content(content), m_senderId(senderId), m_receiverId(receiverId), 
-      m_timestamp(std::chrono::system_clock::now()) {
+/**
+ * @brief Разбор поля получателя: "12", "+12" или "+12,15,19"
+ */
+bool parseRecipients(std::string_view field, int& receiverId, std::vector<int>& recipients, bool& report) {
+    recipients.clear();
+    report = !field.empty() && field.front() == '+';
+    if (report) {
+        field.remove_prefix(1);
+    }
+    size_t comma = field.find(',');
+    if (comma == std::string_view::npos) {
+        return parseField(field, receiverId);
+    }
+    while (true) {
+        int id = 0;
+        if (!parseField(field.substr(0, comma), id) || recipients.size() == Message::MAX_RECIPIENTS) {
+            return false;
+        }
+        recipients.push_back(id);
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        field.remove_prefix(comma + 1);
+        comma = field.find(',');
+    }
+    receiverId = recipients.front();
+    return true;
 }
 
+} // namespace
+
 std::string Message::serialize() const {
-    std::ostringstream oss;
-    
-    // Конвертируем timestamp в строку
-    auto time_t = std::chrono::system_clock::to_time_t(m_timestamp);
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    
-    // Формат: TYPE|SENDER_ID|RECEIVER_ID|TIMESTAMP|CONTENT
-    oss << typeToString(m_type) << "|" 
-        << m_senderId << "|" 
-        << m_receiverId << "|" 
-        << oss.str() << "|" 
-        << m_content;
-    
-    return oss.str();
+    std::string buffer;
+    serializeTo(buffer);
+    return buffer;
+}
+
+void Message::serializeTo(std::string& buffer) const {
+    serializeHeaderTo(buffer);
+    appendEscaped(buffer, m_content.view());
+    buffer.push_back(FRAME_DELIMITER);
 }
 
-bool Message::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string token;
-    std::vector<std::string> tokens;
+void Message::serializeHeaderTo(std::string& buffer) const {
+    buffer.clear();
     
-    // Разделяем строку по символу '|'
-    while (std::getline(iss, token, '|')) {
-        tokens.push_back(token);
+    // Формат: TYPE|SENDER_ID|RECEIVER_ID|TIMESTAMP_NS|SERVER_RECV_NS|SERVER_SEND_NS|SEQ|ACK|CONTENT\n
+    buffer.append(typeName(m_type));
+    buffer.push_back('|');
+    appendNumber(buffer, m_senderId);
+    if (m_deliveryReport) {
+        buffer.push_back('+');
+    }
+    if (m_recipients.empty()) {
+        appendNumber(buffer, m_receiverId);
+    } else {
+        for (size_t i = 0; i < m_recipients.size(); ++i) {
+            appendNumber(buffer, m_recipients[i]);
+            buffer.back() = i + 1 < m_recipients.size() ? ',' : '|';
+        }
+    }
+    appendNumber(buffer, m_timestampNs);
+    appendNumber(buffer, m_serverReceiveNs);
+    appendNumber(buffer, m_serverSendNs);
+    appendNumber(buffer, m_seq);
+    appendNumber(buffer, m_ack);
+}
+
+std::string Message::serializeContent() const {
+    std::string content;
+    content.reserve(m_content.size() + 1);
+    appendEscaped(content, m_content.view());
+    content.push_back(FRAME_DELIMITER);
+    return content;
+}
+
+bool Message::deserialize(std::string_view data) {
+    // Разделитель кадра в конце необязателен
+    if (!data.empty() && data.back() == FRAME_DELIMITER) {
+        data.remove_suffix(1);
     }
     
-    // Проверяем количество токенов
-    if (tokens.size() < 5) {
+    // Разделяем заголовок по символу '|'; содержимое - весь остаток строки,
+    // поэтому '|' внутри него не теряется
+    std::string_view fields[FrameScanner::HEADER_FIELDS];
+    for (size_t i = 0; i < FrameScanner::HEADER_FIELDS; ++i) {
+        size_t separator = data.find('|');
+        if (separator == std::string_view::npos) {
+            return false;
+        }
+        fields[i] = data.substr(0, separator);
+        data.remove_prefix(separator + 1);
+    }
+    return parseFields(fields, data);
+}
+
+bool Message::deserialize(const FrameScanner::Frame& frame) {
+    return frame.complete && parseFields(frame.fields, frame.content);
+}
+
+bool Message::parseFields(const std::string_view* fields, std::string_view content) {
+    if (!parseField(fields[1], m_senderId) ||
+        !parseRecipients(fields[2], m_receiverId, m_recipients, m_deliveryReport) ||
+        !parseField(fields[3], m_timestampNs) ||
+        !parseField(fields[4], m_serverReceiveNs) ||
+        !parseField(fields[5], m_serverSendNs) ||
+        !parseField(fields[6], m_seq) ||
+        !parseField(fields[7], m_ack)) {
         return false;
     }
+    if (!parseType(fields[0], m_type)) {
+        m_type = Type::TEXT;
+    }
     
-    try {
-        m_type = stringToType(tokens[0]);
-        m_senderId = std::stoi(tokens[1]);
-        m_receiverId = std::stoi(tokens[2]);
-        
-        // Парсим timestamp
-        std::tm tm = {};
-        std::istringstream timeStream(tokens[3]);
-        timeStream >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-        m_timestamp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-        
-        m_content = tokens[4];
-        
-        return true;
-    } catch (const std::exception&) {
+    char* target = m_content.prepare(content.size());
+    m_content.truncate(unescapeTo(content, target));
+    return true;
+}
+
+bool Message::parseType(std::string_view name, Type& type) {
+    if (name.size() < 2) {
+        return false;
+    }
+    int8_t index = TYPE_INDEX[hashTypeName(name, TYPE_HASH)];
+    if (index < 0 || MESSAGE_TYPE_NAMES[static_cast<size_t>(index)] != name) {
         return false;
     }
+    type = static_cast<Type>(index);
+    return true;
 }
 
 std::string Message::typeToString(Type type) {
-    switch (type) {
-        case Type::LOGIN: return "LOGIN";
-        case Type::LOGOUT: return "LOGOUT";
-        case Type::TEXT: return "TEXT";
-        case Type::FILE: return "FILE";
-        case Type::STATUS: return "STATUS";
-        case Type::ERROR: return "ERROR";
-        default: return "UNKNOWN";
-    }
+    size_t index = static_cast<size_t>(type);
+    return index < TYPE_COUNT ? std::string(MESSAGE_TYPE_NAMES[index]) : "UNKNOWN";
 }
 
 Message::Type Message::stringToType(const std::string& typeStr) {
-    if (typeStr == "LOGIN") return Type::LOGIN;
-    if (typeStr == "LOGOUT") return Type::LOGOUT;
-    if (typeStr == "TEXT") return Type::TEXT;
-    if (typeStr == "FILE") return Type::FILE;
-    if (typeStr == "STATUS") return Type::STATUS;
-    if (typeStr == "ERROR") return Type::ERROR;
-    return Type::TEXT; // По умолчанию
+    Type type = Type::TEXT; // По умолчанию
+    parseType(typeStr, type);
+    return type;
 }
@@ -0,0 +1,70 @@
+#include "common/Payload.h"
+#include <cstring>
+#include <utility>
+
+Payload::Payload(Payload&& other) noexcept : Payload() {
+    *this = std::move(other);
+}
+
+Payload& Payload::operator=(const Payload& other) {
+    if (this != &other) {
+        assign(other.view());
+    }
+    return *this;
+}
+
+Payload& Payload::operator=(Payload&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (other.isInline()) {
+        std::memcpy(m_inline, other.m_inline, other.m_size + 1);
+    } else {
+        m_heap.swap(other.m_heap);
+    }
+    m_size = other.m_size;
+    other.m_size = 0;
+    other.m_inline[0] = '\0';
+    return *this;
+}
+
+void Payload::assign(std::string_view text) {
+    char* target = prepare(text.size());
+    std::memcpy(target, text.data(), text.size());
+}
+
+void Payload::assign(std::string&& text) {
+    if (text.size() <= INLINE_CAPACITY) {
+        assign(std::string_view(text));
+        return;
+    }
+    m_heap = std::move(text);
+    m_size = m_heap.size();
+}
+
+char* Payload::prepare(size_t size) {
+    m_size = size;
+    if (size <= INLINE_CAPACITY) {
+        m_inline[size] = '\0';
+        return m_inline;
+    }
+    // Емкость строки сохраняется между сообщениями, поэтому повторная
+    // подготовка того же размера не выделяет память
+    m_heap.resize(size);
+    return &m_heap[0];
+}
+
+void Payload::truncate(size_t size) {
+    if (size >= m_size) {
+        return;
+    }
+    if (!isInline() && size <= INLINE_CAPACITY) {
+        std::memcpy(m_inline, m_heap.data(), size);
+    }
+    m_size = size;
+    if (isInline()) {
+        m_inline[size] = '\0';
+    } else {
+        m_heap.resize(size);
+    }
+}
@@ -0,0 +1,61 @@
+#include "common/PresenceUpdate.h"
+#include <charconv>
+
+namespace {
+
+const std::string_view SNAPSHOT = "SNAPSHOT:";
+const std::string_view UPDATE = "UPDATE:";
+const std::string_view ONLINE = "ONLINE";
+const std::string_view OFFLINE = "OFFLINE";
+
+} // namespace
+
+std::string PresenceUpdate::toContent() const {
+    std::string content(PREFIX);
+    content.append(snapshot ? SNAPSHOT : UPDATE);
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (i > 0) {
+            content.push_back(',');
+        }
+        content += std::to_string(contacts[i].first);
+        content.push_back('=');
+        content.append(contacts[i].second ? ONLINE : OFFLINE);
+    }
+    return content;
+}
+
+bool PresenceUpdate::parse(std::string_view content) {
+    if (content.compare(0, PREFIX.size(), PREFIX) != 0) {
+        return false;
+    }
+    content.remove_prefix(PREFIX.size());
+    if (content.compare(0, SNAPSHOT.size(), SNAPSHOT) == 0) {
+        snapshot = true;
+        content.remove_prefix(SNAPSHOT.size());
+    } else if (content.compare(0, UPDATE.size(), UPDATE) == 0) {
+        snapshot = false;
+        content.remove_prefix(UPDATE.size());
+    } else {
+        return false;
+    }
+
+    contacts.clear();
+    while (!content.empty()) {
+        size_t end = content.find(',');
+        std::string_view entry = content.substr(0, end);
+        size_t equals = entry.find('=');
+        if (equals == std::string_view::npos) {
+            return false;
+        }
+        int id = 0;
+        const char* idEnd = entry.data() + equals;
+        auto result = std::from_chars(entry.data(), idEnd, id);
+        std::string_view state = entry.substr(equals + 1);
+        if (result.ec != std::errc() || result.ptr != idEnd || (state != ONLINE && state != OFFLINE)) {
+            return false;
+        }
+        contacts.emplace_back(id, state == ONLINE);
+        content.remove_prefix(end == std::string_view::npos ? content.size() : end + 1);
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+#include "common/ReliableChannel.h"
+#include <algorithm>
+
+ReliableChannel::ReliableChannel(size_t windowSize)
+    : m_windowSize(windowSize), m_nextSeq(1), m_received(0), m_ackSent(0), m_ackTimerArmed(false),
+      m_windowHead(0), m_windowCount(0) {
+}
+
+bool ReliableChannel::isSequenced(Message::Type type) {
+    return type == Message::Type::TEXT || type == Message::Type::FILE;
+}
+
+bool ReliableChannel::stamp(Message& message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (isSequenced(message.getType())) {
+        if (m_windowCount >= m_windowSize) {
+            return false;
+        }
+        message.setSeq(m_nextSeq++);
+        if (m_windowCount == m_window.size()) {
+            // Кольцо растет вдвое и не сжимается: освобожденные ячейки
+            // переиспользуются, и в установившемся режиме память не выделяется
+            std::vector<Message> grown(std::min(m_windowSize, std::max<size_t>(16, m_window.size() * 2)));
+            for (size_t i = 0; i < m_windowCount; ++i) {
+                grown[i] = std::move(windowAt(i));
+            }
+            m_window.swap(grown);
+            m_windowHead = 0;
+        }
+        m_window[(m_windowHead + m_windowCount) % m_window.size()] = message;
+        ++m_windowCount;
+    }
+    // Подтверждение едет попутно с любым исходящим кадром
+    message.setAck(m_received);
+    m_ackSent = m_received;
+    return true;
+}
+
+bool ReliableChannel::accept(const Message& message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t ack = message.getAck();
+    if (ack != 0) {
+        releaseUpTo(ack);
+    }
+
+    uint64_t seq = message.getSeq();
+    if (seq == 0) {
+        return true;
+    }
+    if (seq <= m_received) {
+        return false;
+    }
+    // Внутри соединения TCP сохраняет порядок, а повтор начинается
+    // с подтвержденного места, поэтому номера идут подряд
+    m_received = seq;
+    return true;
+}
+
+void ReliableChannel::acknowledge(uint64_t ack) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    releaseUpTo(ack);
+}
+
+void ReliableChannel::releaseUpTo(uint64_t ack) {
+    // Ячейки не очищаются: их буферы переиспользуются следующими сообщениями
+    while (m_windowCount > 0 && m_window[m_windowHead].getSeq() <= ack) {
+        m_windowHead = (m_windowHead + 1) % m_window.size();
+        --m_windowCount;
+    }
+}
+
+std::vector<Message> ReliableChannel::unacknowledged() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Message> messages;
+    messages.reserve(m_windowCount);
+    for (size_t i = 0; i < m_windowCount; ++i) {
+        messages.push_back(windowAt(i));
+        messages.back().setAck(m_received);
+    }
+    m_ackSent = m_received;
+    return messages;
+}
+
+void ReliableChannel::restart() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nextSeq = 1;
+    for (size_t i = 0; i < m_windowCount; ++i) {
+        windowAt(i).setSeq(m_nextSeq++);
+    }
+    m_received = 0;
+    m_ackSent = 0;
+}
+
+uint64_t ReliableChannel::received() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_received;
+}
+
+size_t ReliableChannel::pendingAcks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<size_t>(m_received - m_ackSent);
+}
+
+bool ReliableChannel::armAckTimer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_ackTimerArmed || m_received == m_ackSent) {
+        return false;
+    }
+    m_ackTimerArmed = true;
+    return true;
+}
+
+bool ReliableChannel::takeAck(Message& ackMessage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ackTimerArmed = false;
+    if (m_received == m_ackSent) {
+        return false;
+    }
+    ackMessage = Message(Message::Type::ACK, "", -1);
+    ackMessage.setAck(m_received);
+    m_ackSent = m_received;
+    return true;
+}
+
+size_t ReliableChannel::inFlight() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_windowCount;
+}
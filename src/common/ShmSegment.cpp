@@ -0,0 +1,428 @@
+#include "common/ShmSegment.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#elif defined(_WIN32)
+    #include <winsock2.h>
+#else
+    #include <sys/socket.h>
+#endif
+
+#ifdef __linux__
+
+/**
+ * @brief Позиции кольца и флаги ожидания
+ *
+ * Позиции только растут; индекс в данных - позиция по модулю размера.
+ * Поля читателя и писателя лежат в разных строках кэша.
+ */
+struct ShmSegment::RingHeader {
+    alignas(64) std::atomic<uint64_t> head;         ///< Прочитано читателем
+    alignas(64) std::atomic<uint64_t> tail;         ///< Записано писателем
+    alignas(64) std::atomic<uint32_t> readerWaiting; ///< Читатель спит на dataFd
+    std::atomic<uint32_t> writerWaiting;            ///< Писатель спит на spaceFd
+};
+
+/**
+ * @brief Заголовок сегмента; за ним лежат данные колец 0 и 1
+ */
+struct ShmSegment::SegmentHeader {
+    uint64_t magic;                 ///< Признак сегмента
+    uint64_t ringSize;              ///< Размер каждого кольца
+    RingHeader rings[2];            ///< Кольцо 0: клиент -> сервер, 1: сервер -> клиент
+};
+
+namespace {
+
+const uint64_t SEGMENT_MAGIC = 0x314d48535643u;    ///< "CVSHM1"
+const size_t MIN_RING_SIZE = 4096;
+const unsigned int REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "кольцу нужны атомарные операции без блокировок");
+
+bool isValidRingSize(uint64_t size) {
+    return size >= MIN_RING_SIZE && size <= ShmSegment::MAX_RING_SIZE && (size & (size - 1)) == 0;
+}
+
+void closeAll(std::vector<int>& descriptors) {
+    for (int fd : descriptors) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    descriptors.clear();
+}
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+} // namespace
+
+std::unique_ptr<ShmSegment> ShmSegment::create(size_t ringSize) {
+    if (!isValidRingSize(ringSize)) {
+        return nullptr;
+    }
+    std::vector<int> descriptors;
+    int memfd = memfd_create("client-server-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0) {
+        return nullptr;
+    }
+    descriptors.push_back(memfd);
+
+    // Печати запрещают менять размер: другая сторона не получит SIGBUS
+    size_t mappedSize = sizeof(SegmentHeader) + 2 * ringSize;
+    if (ftruncate(memfd, static_cast<off_t>(mappedSize)) != 0 ||
+        fcntl(memfd, F_ADD_SEALS, REQUIRED_SEALS) != 0) {
+        closeAll(descriptors);
+        return nullptr;
+    }
+    for (int i = 0; i < 4; ++i) {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            closeAll(descriptors);
+            return nullptr;
+        }
+        descriptors.push_back(fd);
+    }
+
+    void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (memory == MAP_FAILED) {
+        closeAll(descriptors);
+        return nullptr;
+    }
+    SegmentHeader* header = new (memory) SegmentHeader();
+    header->magic = SEGMENT_MAGIC;
+    header->ringSize = ringSize;
+    return std::unique_ptr<ShmSegment>(
+        new ShmSegment(memory, mappedSize, ringSize, std::move(descriptors), Side::CLIENT));
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::attach(std::vector<int>& descriptors) {
+    std::vector<int> owned;
+    owned.swap(descriptors);
+    if (owned.size() != DESCRIPTOR_COUNT) {
+        closeAll(owned);
+        return nullptr;
+    }
+
+    // Размер и печати проверяются до отображения: сегмент пришел от другого процесса
+    struct stat info{};
+    int seals = fcntl(owned[0], F_GET_SEALS);
+    if (fstat(owned[0], &info) != 0 || seals < 0 ||
+        (static_cast<unsigned int>(seals) & REQUIRED_SEALS) != REQUIRED_SEALS ||
+        info.st_size < static_cast<off_t>(sizeof(SegmentHeader)) ||
+        info.st_size > static_cast<off_t>(sizeof(SegmentHeader) + 2 * MAX_RING_SIZE)) {
+        closeAll(owned);
+        return nullptr;
+    }
+    size_t mappedSize = static_cast<size_t>(info.st_size);
+    void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, owned[0], 0);
+    if (memory == MAP_FAILED) {
+        closeAll(owned);
+        return nullptr;
+    }
+
+    const SegmentHeader* header = static_cast<const SegmentHeader*>(memory);
+    uint64_t ringSize = header->ringSize;
+    if (header->magic != SEGMENT_MAGIC || !isValidRingSize(ringSize) ||
+        sizeof(SegmentHeader) + 2 * ringSize != mappedSize) {
+        munmap(memory, mappedSize);
+        closeAll(owned);
+        return nullptr;
+    }
+    return std::unique_ptr<ShmSegment>(
+        new ShmSegment(memory, mappedSize, static_cast<size_t>(ringSize), std::move(owned), Side::SERVER));
+}
+
+ShmSegment::ShmSegment(void* memory, size_t mappedSize, size_t ringSize, std::vector<int> descriptors, Side side)
+    : m_memory(memory), m_mappedSize(mappedSize), m_ringSize(ringSize), m_descriptors(std::move(descriptors)) {
+    SegmentHeader* header = static_cast<SegmentHeader*>(memory);
+    char* data = static_cast<char*>(memory) + sizeof(SegmentHeader);
+    Ring rings[2];
+    for (size_t i = 0; i < 2; ++i) {
+        rings[i].header = &header->rings[i];
+        rings[i].data = data + i * ringSize;
+        rings[i].dataFd = m_descriptors[1 + 2 * i];
+        rings[i].spaceFd = m_descriptors[2 + 2 * i];
+    }
+    m_outgoing = side == Side::CLIENT ? rings[0] : rings[1];
+    m_incoming = side == Side::CLIENT ? rings[1] : rings[0];
+}
+
+ShmSegment::~ShmSegment() {
+    munmap(m_memory, m_mappedSize);
+    closeAll(m_descriptors);
+}
+
+bool ShmSegment::write(const char* data, size_t size, int aliveFd, int timeoutMs) {
+    RingHeader* header = m_outgoing.header;
+    const uint64_t mask = m_ringSize - 1;
+    int64_t deadlineNs = timeoutMs < 0 ? -1 : steadyNowNs() + static_cast<int64_t>(timeoutMs) * 1000000;
+
+    while (size > 0) {
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        if (tail - head > m_ringSize) {
+            return false;
+        }
+        size_t space = static_cast<size_t>(m_ringSize - (tail - head));
+        if (space == 0) {
+            // Флаг выставляется до повторной проверки: читатель, освободивший
+            // место после проверки, увидит флаг и разбудит писателя
+            header->writerWaiting.store(1, std::memory_order_seq_cst);
+            if (header->head.load(std::memory_order_seq_cst) != head) {
+                header->writerWaiting.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            int waitMs = -1;
+            if (deadlineNs >= 0) {
+                int64_t remainingNs = deadlineNs - steadyNowNs();
+                if (remainingNs <= 0) {
+                    header->writerWaiting.store(0, std::memory_order_relaxed);
+                    return false;
+                }
+                waitMs = static_cast<int>(std::min<int64_t>(remainingNs / 1000000 + 1, INT_MAX));
+            }
+            pollfd fds[2] = {{m_outgoing.spaceFd, POLLIN, 0}, {aliveFd, POLLIN, 0}};
+            poll(fds, 2, waitMs);
+            header->writerWaiting.store(0, std::memory_order_relaxed);
+            if (fds[0].revents & POLLIN) {
+                drain(m_outgoing.spaceFd);
+            }
+            if (fds[1].revents != 0) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t chunk = std::min(space, size);
+        size_t offset = static_cast<size_t>(tail & mask);
+        size_t first = std::min(chunk, m_ringSize - offset);
+        std::memcpy(m_outgoing.data + offset, data, first);
+        std::memcpy(m_outgoing.data, data + first, chunk - first);
+        header->tail.store(tail + chunk, std::memory_order_seq_cst);
+        data += chunk;
+        size -= chunk;
+
+        if (header->readerWaiting.load(std::memory_order_seq_cst) != 0 &&
+            header->readerWaiting.exchange(0) != 0) {
+            signal(m_outgoing.dataFd);
+        }
+    }
+    return true;
+}
+
+int ShmSegment::read(char* buffer, size_t size) {
+    RingHeader* header = m_incoming.header;
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    uint64_t available = tail - head;
+    if (available > m_ringSize) {
+        return -1;
+    }
+    if (available == 0) {
+        return 0;
+    }
+
+    size_t chunk = static_cast<size_t>(std::min<uint64_t>(available, std::min<size_t>(size, INT_MAX)));
+    size_t offset = static_cast<size_t>(head & (m_ringSize - 1));
+    size_t first = std::min(chunk, m_ringSize - offset);
+    std::memcpy(buffer, m_incoming.data + offset, first);
+    std::memcpy(buffer + first, m_incoming.data, chunk - first);
+    header->head.store(head + chunk, std::memory_order_seq_cst);
+
+    if (header->writerWaiting.load(std::memory_order_seq_cst) != 0 &&
+        header->writerWaiting.exchange(0) != 0) {
+        signal(m_incoming.spaceFd);
+    }
+    return static_cast<int>(chunk);
+}
+
+ShmSegment::WaitResult ShmSegment::waitForData(pollfd* fds, size_t count, int timeoutMs) {
+    RingHeader* header = m_incoming.header;
+    auto hasData = [header] {
+        return header->tail.load(std::memory_order_acquire) != header->head.load(std::memory_order_relaxed);
+    };
+
+    // Пока собеседник активен, данные обычно приходят за микросекунды:
+    // короткое вращение дешевле пары системных вызовов на сон и пробуждение.
+    // На одном ядре вращение только отнимает время у собеседника
+    static const int64_t spinNs = std::thread::hardware_concurrency() > 1 ? SPIN_NS : 0;
+    int64_t spinUntilNs = steadyNowNs() + spinNs;
+    for (unsigned int i = 1; spinNs > 0; ++i) {
+        if (hasData()) {
+            return WaitResult::DATA;
+        }
+        if ((i & 63) == 0 && steadyNowNs() >= spinUntilNs) {
+            break;
+        }
+        cpuRelax();
+    }
+
+    header->readerWaiting.store(1, std::memory_order_seq_cst);
+    if (header->tail.load(std::memory_order_seq_cst) != header->head.load(std::memory_order_relaxed)) {
+        header->readerWaiting.store(0, std::memory_order_relaxed);
+        return WaitResult::DATA;
+    }
+
+    pollfd all[4];
+    count = std::min<size_t>(count, 3);
+    std::copy(fds, fds + count, all);
+    all[count] = {m_incoming.dataFd, POLLIN, 0};
+    poll(all, count + 1, timeoutMs);
+    header->readerWaiting.store(0, std::memory_order_relaxed);
+    if (all[count].revents & POLLIN) {
+        drain(m_incoming.dataFd);
+    }
+
+    bool event = false;
+    for (size_t i = 0; i < count; ++i) {
+        fds[i].revents = all[i].revents;
+        event = event || all[i].revents != 0;
+    }
+    if (hasData()) {
+        return WaitResult::DATA;
+    }
+    return event ? WaitResult::EVENT : WaitResult::TIMEOUT;
+}
+
+bool ShmSegment::sendAttach(int socket, const std::string& frame) const {
+    iovec iov{};
+    iov.iov_base = const_cast<char*>(frame.data());
+    iov.iov_len = frame.size();
+
+    // Дескрипторы прикрепляются к первому байту кадра
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * DESCRIPTOR_COUNT)];
+    std::memset(control, 0, sizeof(control));
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * DESCRIPTOR_COUNT);
+    std::memcpy(CMSG_DATA(cmsg), m_descriptors.data(), sizeof(int) * DESCRIPTOR_COUNT);
+
+    ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    if (sent <= 0) {
+        return false;
+    }
+    size_t total = static_cast<size_t>(sent);
+    while (total < frame.size()) {
+        sent = ::send(socket, frame.data() + total, frame.size() - total, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        total += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+int ShmSegment::receive(int socket, char* buffer, size_t size, std::vector<int>& descriptors) {
+    iovec iov{};
+    iov.iov_base = buffer;
+    iov.iov_len = size;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * DESCRIPTOR_COUNT)];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    if (received > 0) {
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const unsigned char* fdData = CMSG_DATA(cmsg);
+                for (size_t i = 0; i < count; ++i) {
+                    int fd;
+                    std::memcpy(&fd, fdData + i * sizeof(int), sizeof(int));
+                    descriptors.push_back(fd);
+                }
+            }
+        }
+    }
+    return static_cast<int>(received);
+}
+
+void ShmSegment::signal(int fd) {
+    uint64_t value = 1;
+    ssize_t written = ::write(fd, &value, sizeof(value));
+    (void)written;
+}
+
+void ShmSegment::drain(int fd) {
+    uint64_t value;
+    ssize_t received = ::read(fd, &value, sizeof(value));
+    (void)received;
+}
+
+#else
+
+// Разделяемая память доступна только на Linux (memfd, eventfd);
+// create и attach сообщают об ошибке, и соединение остается на сокете
+
+struct ShmSegment::RingHeader {};
+struct ShmSegment::SegmentHeader {};
+
+std::unique_ptr<ShmSegment> ShmSegment::create(size_t) {
+    return nullptr;
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::attach(std::vector<int>& descriptors) {
+    descriptors.clear();
+    return nullptr;
+}
+
+ShmSegment::~ShmSegment() {
+}
+
+bool ShmSegment::write(const char*, size_t, int, int) {
+    return false;
+}
+
+int ShmSegment::read(char*, size_t) {
+    return -1;
+}
+
+#ifndef _WIN32
+ShmSegment::WaitResult ShmSegment::waitForData(pollfd*, size_t, int) {
+    return WaitResult::EVENT;
+}
+#endif
+
+bool ShmSegment::sendAttach(int, const std::string&) const {
+    return false;
+}
+
+int ShmSegment::receive(int socket, char* buffer, size_t size, std::vector<int>&) {
+    return static_cast<int>(recv(socket, buffer, size, 0));
+}
+
+#endif
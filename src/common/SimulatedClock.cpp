@@ -0,0 +1,30 @@
+#include "common/SimulatedClock.h"
+#include <atomic>
+
+namespace {
+
+std::atomic<bool> g_enabled(false);
+std::atomic<int64_t> g_nowNs(0);
+
+} // namespace
+
+void SimulatedClock::enable(int64_t startNs) {
+    g_nowNs.store(startNs, std::memory_order_relaxed);
+    g_enabled.store(true, std::memory_order_release);
+}
+
+void SimulatedClock::disable() {
+    g_enabled.store(false, std::memory_order_release);
+}
+
+bool SimulatedClock::isEnabled() {
+    return g_enabled.load(std::memory_order_acquire);
+}
+
+int64_t SimulatedClock::now() {
+    return g_nowNs.load(std::memory_order_relaxed);
+}
+
+void SimulatedClock::advance(int64_t deltaNs) {
+    g_nowNs.fetch_add(deltaNs, std::memory_order_relaxed);
+}
@@ -0,0 +1,171 @@
+#include "common/SocketTransport.h"
+#include "common/Logger.h"
+#include "common/Trace.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <cerrno>
+    #include <poll.h>
+    #include <sys/select.h>
+    #include <sys/time.h>
+#endif
+
+namespace {
+
+void closeDescriptors(std::vector<int>& descriptors) {
+#ifndef _WIN32
+    for (int fd : descriptors) {
+        ::close(fd);
+    }
+#endif
+    descriptors.clear();
+}
+
+#ifdef _WIN32
+const int SHUTDOWN_BOTH = SD_BOTH;
+#else
+const int SHUTDOWN_BOTH = SHUT_RDWR;
+#endif
+
+// Запись в закрытый другой стороной сокет должна вернуть ошибку, а не SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+} // namespace
+
+SocketTransport::SocketTransport(socket_t socket)
+    : m_socket(socket), m_shmSendTimeoutMs(-1) {
+}
+
+SocketTransport::~SocketTransport() {
+    close();
+}
+
+int SocketTransport::receive(char* buffer, size_t size) {
+    TRACE_SCOPE("SocketTransport::recv");
+#ifdef _WIN32
+    return recv(m_socket, buffer, static_cast<int>(size), 0);
+#else
+    if (m_shm) {
+        // Пустое кольцо после пробуждения: сокет вернет 0 при отключении другой стороны
+        int received = m_shm->read(buffer, size);
+        if (received < 0) {
+            LOG_WARNING("Другая сторона повредила кольцо разделяемой памяти");
+        }
+        return received != 0 ? received : static_cast<int>(recv(m_socket, buffer, size, 0));
+    }
+
+    size_t previous = m_receivedFds.size();
+    int received = ShmSegment::receive(m_socket, buffer, size, m_receivedFds);
+    if (previous > 0 && m_receivedFds.size() > previous) {
+        // Дескрипторы, не дождавшиеся своего кадра SHM_ATTACH, заменяются новыми
+        std::vector<int> stale(m_receivedFds.begin(), m_receivedFds.begin() + static_cast<std::ptrdiff_t>(previous));
+        m_receivedFds.erase(m_receivedFds.begin(), m_receivedFds.begin() + static_cast<std::ptrdiff_t>(previous));
+        closeDescriptors(stale);
+    }
+    return received;
+#endif
+}
+
+bool SocketTransport::send(const char* data, size_t size) {
+    if (m_socket == INVALID_SOCKET) {
+        return false;
+    }
+    if (m_shm) {
+        // Кадр, записанный в кольцо не целиком, сбил бы разбор у другой стороны
+        return m_shm->write(data, size, static_cast<int>(m_socket), m_shmSendTimeoutMs);
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        int result = ::send(m_socket, data + sent, static_cast<int>(size - sent), SEND_FLAGS);
+#ifndef _WIN32
+        // Прерванная сигналом запись досылается: часть кадра могла уже уйти
+        if (result == SOCKET_ERROR && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (result == SOCKET_ERROR || result == 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+bool SocketTransport::wait(int wakeFd, int timeoutMs) {
+#ifndef _WIN32
+    if (m_shm) {
+        // Сокет после перехода на кольца готов к чтению только при отключении
+        pollfd fds[2] = {{m_socket, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        return m_shm->waitForData(fds, wakeFd >= 0 ? 2 : 1, timeoutMs) != ShmSegment::WaitResult::TIMEOUT;
+    }
+    if (wakeFd >= 0) {
+        pollfd fds[2] = {{m_socket, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        return poll(fds, 2, timeoutMs) != 0;
+    }
+#else
+    (void)wakeFd;
+#endif
+    if (timeoutMs < 0) {
+        // Ждать нечего, кроме данных: их дождется блокирующий recv
+        return true;
+    }
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(m_socket, &readSet);
+    timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    return select(static_cast<int>(m_socket) + 1, &readSet, nullptr, nullptr, &timeout) != 0;
+}
+
+void SocketTransport::shutdown() {
+    if (m_socket != INVALID_SOCKET) {
+        ::shutdown(m_socket, SHUTDOWN_BOTH);
+    }
+}
+
+void SocketTransport::close() {
+    if (m_socket != INVALID_SOCKET) {
+#ifdef _WIN32
+        closesocket(m_socket);
+#else
+        ::close(m_socket);
+#endif
+        m_socket = INVALID_SOCKET;
+    }
+    m_shm.reset();
+    closeDescriptors(m_receivedFds);
+}
+
+socket_t SocketTransport::release() {
+    socket_t socket = m_socket;
+    if (socket != INVALID_SOCKET && m_shm) {
+        // Кольца остаются в памяти этого процесса: другая сторона переподключится
+        ::shutdown(socket, SHUTDOWN_BOTH);
+        return INVALID_SOCKET;
+    }
+    m_socket = INVALID_SOCKET;
+    return socket;
+}
+
+std::unique_ptr<ShmSegment> SocketTransport::attachReceivedSegment() {
+    std::unique_ptr<ShmSegment> segment = m_shm ? nullptr : ShmSegment::attach(m_receivedFds);
+    closeDescriptors(m_receivedFds);
+    return segment;
+}
+
+void SocketTransport::useSharedMemory(std::unique_ptr<ShmSegment> segment) {
+#ifndef _WIN32
+    // Ожидание места в кольце ограничено так же, как отправка в сокет
+    timeval timeout{};
+    socklen_t length = sizeof(timeout);
+    if (getsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, &length) == 0 &&
+        (timeout.tv_sec != 0 || timeout.tv_usec != 0)) {
+        m_shmSendTimeoutMs = static_cast<int>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+    }
+#endif
+    m_shm = std::move(segment);
+}
@@ -0,0 +1,271 @@
+#include "common/Trace.h"
+#include "common/Logger.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Слот кольцевого буфера
+ *
+ * Выгрузка читает слот, пока владелец может его перезаписывать, поэтому
+ * поля атомарные (без упорядочивания), а целостность проверяется номером
+ * версии: 2 * i + 1 - идет запись события i, 2 * i + 2 - событие i записано.
+ */
+struct EventSlot {
+    std::atomic<uint64_t> sequence{0};      ///< Версия слота
+    std::atomic<const char*> name{nullptr}; ///< Имя точки трассировки
+    std::atomic<uint64_t> startNs{0};       ///< Начало интервала
+    std::atomic<uint64_t> durationNs{0};    ///< Длительность интервала
+    std::atomic<uint32_t> threadId{0};      ///< Номер потока
+};
+
+/**
+ * @brief Кольцевой буфер событий одного потока
+ *
+ * Пишет в буфер только поток-владелец, читает только выгрузка: счетчик
+ * записанных событий задает диапазон, а версии слотов отсеивают события,
+ * перезаписанные во время копирования.
+ */
+struct ThreadBuffer {
+    EventSlot slots[Trace::RING_CAPACITY];
+    std::atomic<uint64_t> head{0};          ///< Количество записанных событий
+    std::atomic<bool> inUse{true};          ///< Буфер закреплен за живым потоком
+    uint32_t threadId = 0;                  ///< Номер последнего владельца (под g_registryMutex)
+    std::string threadName;                 ///< Имя последнего владельца (под g_registryMutex)
+};
+
+struct ThreadName {
+    uint32_t threadId;
+    std::string name;
+};
+
+std::mutex g_registryMutex;                             ///< Защищает реестр буферов (не горячий путь)
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;   ///< Буферы всех потоков
+std::atomic<uint32_t> g_nextThreadId{1};
+
+std::atomic<bool> g_dumpRequested{false};
+std::mutex g_watcherMutex;
+std::condition_variable g_watcherCv;
+bool g_watcherRunning = false;
+std::thread g_watcherThread;
+
+/**
+ * @brief Состояние трассировки текущего потока
+ *
+ * При завершении потока буфер возвращается в реестр и может быть
+ * переиспользован новым потоком: при модели "поток на клиента" это
+ * ограничивает память числом одновременно живых потоков.
+ */
+struct ThreadState {
+    ThreadBuffer* buffer = nullptr;
+    uint32_t threadId = 0;
+
+    ~ThreadState() {
+        if (buffer) {
+            buffer->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadState t_state;
+
+ThreadState& threadState() {
+    if (!t_state.buffer) {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (auto& buffer : g_buffers) {
+            bool expected = false;
+            if (buffer->inUse.compare_exchange_strong(expected, true)) {
+                t_state.buffer = buffer.get();
+                break;
+            }
+        }
+        if (!t_state.buffer) {
+            g_buffers.push_back(std::make_unique<ThreadBuffer>());
+            t_state.buffer = g_buffers.back().get();
+        }
+        t_state.threadId = g_nextThreadId++;
+        // Имя хранится в буфере и заменяется вместе с владельцем: таблица имен
+        // не растет с числом завершившихся потоков
+        t_state.buffer->threadId = t_state.threadId;
+        t_state.buffer->threadName.clear();
+    }
+    return t_state;
+}
+
+void writeMicros(std::ostream& out, uint64_t ns) {
+    // Chrome trace-event ожидает микросекунды; сохраняем наносекундную точность дробной частью
+    char fraction[4];
+    unsigned remainder = static_cast<unsigned>(ns % 1000);
+    fraction[0] = static_cast<char>('0' + remainder / 100);
+    fraction[1] = static_cast<char>('0' + remainder / 10 % 10);
+    fraction[2] = static_cast<char>('0' + remainder % 10);
+    fraction[3] = '\0';
+    out << ns / 1000 << '.' << fraction;
+}
+
+void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void watcherLoop(std::string filePrefix) {
+    int dumpIndex = 0;
+    std::unique_lock<std::mutex> lock(g_watcherMutex);
+    while (g_watcherRunning) {
+        g_watcherCv.wait_for(lock, std::chrono::milliseconds(200));
+        if (!g_dumpRequested.exchange(false)) {
+            continue;
+        }
+
+        std::string path = filePrefix + "-" + std::to_string(getpid()) + "-" +
+                           std::to_string(++dumpIndex) + ".json";
+        lock.unlock();
+        if (Trace::dumpChromeTrace(path)) {
+            LOG_INFO("Трасса сохранена в ", path);
+        } else {
+            LOG_ERROR("Не удалось сохранить трассу в ", path);
+        }
+        lock.lock();
+    }
+}
+
+} // namespace
+
+uint64_t Trace::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Trace::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadState& state = threadState();
+    ThreadBuffer* buffer = state.buffer;
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    EventSlot& slot = buffer->slots[head & (RING_CAPACITY - 1)];
+    slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+    slot.threadId.store(state.threadId, std::memory_order_relaxed);
+    slot.sequence.store(2 * head + 2, std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const std::string& name) {
+    ThreadBuffer* buffer = threadState().buffer;
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    buffer->threadName = name;
+}
+
+bool Trace::dumpChromeTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    std::vector<Event> events;
+    std::vector<ThreadName> threadNames;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (auto& buffer : g_buffers) {
+            if (!buffer->threadName.empty()) {
+                threadNames.push_back({buffer->threadId, buffer->threadName});
+            }
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+            for (uint64_t i = begin; i < head; ++i) {
+                // Событие берется, только если версия слота до и после
+                // копирования совпадает с записанным событием i: слоты,
+                // которые владелец перезаписал за это время, отбрасываются
+                const EventSlot& slot = buffer->slots[i & (RING_CAPACITY - 1)];
+                uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                Event event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.startNs = slot.startNs.load(std::memory_order_relaxed);
+                event.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+                event.threadId = slot.threadId.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+                if (before == 2 * i + 2 && after == before) {
+                    events.push_back(event);
+                }
+            }
+        }
+    }
+
+    const auto pid = getpid();
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& threadName : threadNames) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":" << threadName.threadId << ",\"args\":{\"name\":";
+        writeJsonString(out, threadName.name);
+        out << "}}";
+        first = false;
+    }
+    for (const auto& event : events) {
+        out << (first ? "" : ",") << "\n{\"name\":";
+        writeJsonString(out, event.name);
+        out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << event.threadId << ",\"ts\":";
+        writeMicros(out, event.startNs);
+        out << ",\"dur\":";
+        writeMicros(out, event.durationNs);
+        out << "}";
+        first = false;
+    }
+    out << "\n]}\n";
+
+    return static_cast<bool>(out);
+}
+
+void Trace::requestDump() {
+    g_dumpRequested.store(true);
+}
+
+void Trace::startDumpWatcher(const std::string& filePrefix) {
+    std::lock_guard<std::mutex> lock(g_watcherMutex);
+    if (g_watcherRunning) {
+        return;
+    }
+    g_watcherRunning = true;
+    g_watcherThread = std::thread(watcherLoop, filePrefix);
+}
+
+void Trace::stopDumpWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(g_watcherMutex);
+        if (!g_watcherRunning) {
+            return;
+        }
+        g_watcherRunning = false;
+    }
+    g_watcherCv.notify_all();
+    if (g_watcherThread.joinable()) {
+        g_watcherThread.join();
+    }
+}
@@ -0,0 +1,174 @@
+#include "server/AuthPool.h"
+#include "common/Trace.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+AuthPool::AuthPool(const AuthLimits& limits)
+    : m_limits(limits), m_salt(0), m_queued(0), m_running(false) {
+    std::random_device random;
+    m_salt = (static_cast<uint64_t>(random()) << 32) | random();
+    m_limits.threadCount = std::max<size_t>(1, m_limits.threadCount);
+}
+
+AuthPool::~AuthPool() {
+    stop();
+}
+
+void AuthPool::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+    }
+    for (size_t i = 0; i < m_limits.threadCount; ++i) {
+        m_threads.emplace_back(&AuthPool::workerLoop, this, i);
+    }
+}
+
+void AuthPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+}
+
+void AuthPool::setVerifier(Verifier verifier) {
+    m_verifier = std::move(verifier);
+}
+
+AuthPool::SubmitResult AuthPool::submit(const std::string& address, const std::string& username,
+                                        const std::string& password, Completion completion) {
+    if (isCached(username, passwordDigest(password))) {
+        return SubmitResult::CACHED;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || m_queue.size() >= m_limits.maxQueueSize) {
+            return SubmitResult::QUEUE_FULL;
+        }
+        size_t& pending = m_pendingByAddress[address];
+        if (pending >= m_limits.maxPendingPerAddress) {
+            return SubmitResult::ADDRESS_LIMIT;
+        }
+        ++pending;
+        m_queue.push_back(Request{address, username, password, std::move(completion)});
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_cv.notify_one();
+    return SubmitResult::QUEUED;
+}
+
+void AuthPool::invalidate(const std::string& username) {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    auto it = m_sessionIndex.find(username);
+    if (it != m_sessionIndex.end()) {
+        m_sessions.erase(it->second);
+        m_sessionIndex.erase(it);
+    }
+}
+
+void AuthPool::workerLoop(size_t index) {
+    TRACE_THREAD_NAME("auth-" + std::to_string(index));
+    (void)index;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_queue.empty() || !m_running; });
+        if (m_queue.empty()) {
+            break;
+        }
+
+        Request request = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+
+        bool verified;
+        {
+            TRACE_SCOPE("AuthPool::verify");
+            verified = !m_verifier || m_verifier(request.username, request.password);
+        }
+        if (verified) {
+            remember(request.username, passwordDigest(request.password));
+        }
+        request.completion(verified);
+
+        lock.lock();
+        auto pending = m_pendingByAddress.find(request.address);
+        if (pending != m_pendingByAddress.end() && --pending->second == 0) {
+            m_pendingByAddress.erase(pending);
+        }
+    }
+}
+
+uint64_t AuthPool::passwordDigest(const std::string& password) const {
+    // FNV-1a с солью процесса: в кэше не остается пароля в открытом виде
+    uint64_t digest = 14695981039346656037ull ^ m_salt;
+    for (unsigned char byte : password) {
+        digest ^= byte;
+        digest *= 1099511628211ull;
+    }
+    return digest;
+}
+
+bool AuthPool::isCached(const std::string& username, uint64_t digest) {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    auto it = m_sessionIndex.find(username);
+    if (it == m_sessionIndex.end()) {
+        return false;
+    }
+    if (it->second->expiresNs <= steadyNowNs()) {
+        m_sessions.erase(it->second);
+        m_sessionIndex.erase(it);
+        return false;
+    }
+    if (it->second->digest != digest) {
+        return false;
+    }
+    m_sessions.splice(m_sessions.begin(), m_sessions, it->second);
+    return true;
+}
+
+void AuthPool::remember(const std::string& username, uint64_t digest) {
+    if (m_limits.maxCachedSessions == 0) {
+        return;
+    }
+    int64_t expiresNs = steadyNowNs() +
+        std::chrono::duration_cast<std::chrono::nanoseconds>(m_limits.sessionCacheTtl).count();
+
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    auto it = m_sessionIndex.find(username);
+    if (it != m_sessionIndex.end()) {
+        it->second->digest = digest;
+        it->second->expiresNs = expiresNs;
+        m_sessions.splice(m_sessions.begin(), m_sessions, it->second);
+        return;
+    }
+    if (m_sessions.size() >= m_limits.maxCachedSessions) {
+        m_sessionIndex.erase(m_sessions.back().username);
+        m_sessions.pop_back();
+    }
+    m_sessions.push_front(CachedSession{username, digest, expiresNs});
+    m_sessionIndex[username] = m_sessions.begin();
+}
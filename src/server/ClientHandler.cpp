@@ -1,13 +1,34 @@
 #include "server/ClientHandler.h"
-#include <iostream>
+#include "common/FrameBuffer.h"
+#include "common/Logger.h"
+#include "common/MessageDispatch.h"
+#include "common/Trace.h"
+#include "server/CpuTopology.h"
 #include <cstring>
 
-ClientHandler::ClientHandler(socket_t clientSocket, int clientId)
-    : m_clientSocket(clientSocket), m_clientId(clientId), m_active(true) {
+namespace {
+
+const int64_t REJECTION_NOTIFY_INTERVAL_NS = 1000000000LL;
+const size_t DEFAULT_RECEIVE_BUFFER_SIZE = 16 * 1024;
+
+} // namespace
+
+ClientHandler::ClientHandler(socket_t clientSocket, int clientId, const RateLimits& limits)
+    : ClientHandler(std::make_unique<SocketTransport>(clientSocket), clientId, limits) {
+    m_socketTransport = static_cast<SocketTransport*>(m_transport.get());
+}
+
+ClientHandler::ClientHandler(std::unique_ptr<Transport> transport, int clientId, const RateLimits& limits)
+    : m_transport(std::move(transport)), m_socketTransport(nullptr), m_clientId(clientId), m_active(true),
+      m_draining(false), m_outboundStats(nullptr), m_rateLimiter(limits), m_lastRejectionNs(0),
+      m_lastActivityNs(Message::currentTimeNs()), m_loginTimer(0),
+      m_sessionId(0), m_sessionExpiresMs(0),
+      m_wakeFd(-1), m_detachRequested(nullptr), m_receiveBufferSize(DEFAULT_RECEIVE_BUFFER_SIZE) {
 }
 
 ClientHandler::~ClientHandler() {
     stop();
+    closeSocket();
 }
 
 void ClientHandler::start() {
@@ -17,58 +38,361 @@ void ClientHandler::start() {
 }
 
 void ClientHandler::stop() {
-    m_active = false;
+    disconnect();
     
     if (m_clientThread.joinable()) {
+        if (m_clientThread.get_id() == std::this_thread::get_id()) {
+            m_clientThread.detach();
+        } else {
+            m_clientThread.join();
+        }
+    }
+}
+
+void ClientHandler::disconnect() {
+    // shutdown будит поток, заблокированный в recv; сам сокет закрывается
+    // под мьютексом отправки, чтобы его номер не достался новому соединению,
+    // пока другие потоки еще могут в него писать
+    if (m_active.exchange(false)) {
+        m_transport->shutdown();
+    }
+}
+
+void ClientHandler::setDetachSignal(int wakeFd, const std::atomic<bool>* detachRequested) {
+    m_wakeFd = wakeFd;
+    m_detachRequested = detachRequested;
+}
+
+void ClientHandler::waitDetached() {
+    if (!m_socketTransport) {
+        // Соединение не через сокет не ждет дескриптор пробуждения и не передается
+        disconnect();
+    }
+    if (m_clientThread.joinable() && m_clientThread.get_id() != std::this_thread::get_id()) {
         m_clientThread.join();
     }
+}
+
+socket_t ClientHandler::releaseSocket(std::string& pendingInput) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    socket_t socket = m_active.exchange(false) ? m_transport->release() : INVALID_SOCKET;
+    pendingInput.swap(m_pendingInput);
+    return socket;
+}
+
+std::shared_ptr<User> ClientHandler::getUser() const {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    return m_user;
+}
+
+void ClientHandler::setUser(std::shared_ptr<User> user) {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    m_user = user;
+}
+
+void ClientHandler::setSession(uint64_t sessionId, int64_t expiresMs) {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    m_sessionId = sessionId;
+    m_sessionExpiresMs = expiresMs;
+}
+
+uint64_t ClientHandler::getSession(int64_t& expiresMs) const {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    expiresMs = m_sessionExpiresMs;
+    return m_sessionId;
+}
+
+void ClientHandler::setChannel(std::shared_ptr<ReliableChannel> channel) {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    m_channel = std::move(channel);
+}
+
+std::shared_ptr<ReliableChannel> ClientHandler::getChannel() const {
+    std::lock_guard<std::mutex> lock(m_userMutex);
+    return m_channel;
+}
+
+size_t ClientHandler::resumeChannel(std::shared_ptr<ReliableChannel> channel, uint64_t peerAck, const Message& reply) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    setChannel(channel);
+    channel->acknowledge(peerAck);
+    
+    Message outgoing(reply);
+    channel->stamp(outgoing);
+    outgoing.setServerSendNs(Message::currentTimeNs());
+    outgoing.serializeTo(m_sendBuffer);
+    writeFrame(m_sendBuffer);
     
-    if (m_clientSocket != INVALID_SOCKET) {
-#ifdef _WIN32
-        closesocket(m_clientSocket);
-#else
-        close(m_clientSocket);
-#endif
-        m_clientSocket = INVALID_SOCKET;
+    std::vector<Message> replay = channel->unacknowledged();
+    for (auto& message : replay) {
+        message.setServerSendNs(Message::currentTimeNs());
+        message.serializeTo(m_sendBuffer);
+        if (!writeFrame(m_sendBuffer)) {
+            break;
+        }
+    }
+    return replay.size();
+}
+
+void ClientHandler::flushAck() {
+    auto channel = getChannel();
+    Message ack;
+    if (channel && channel->takeAck(ack)) {
+        sendMessage(std::move(ack));
     }
 }
 
 bool ClientHandler::sendMessage(const Message& message) {
-    if (!m_active || m_clientSocket == INVALID_SOCKET) {
+    return sendMessage(Message(message));
+}
+
+bool ClientHandler::sendMessage(Message&& message) {
+    return sendMessage(std::move(message), nullptr);
+}
+
+bool ClientHandler::sendMessage(Message&& message, std::shared_ptr<const std::string> content) {
+    if (!m_active) {
         return false;
     }
     
-    std::string serializedMessage = message.serialize();
-    int result = send(m_clientSocket, serializedMessage.c_str(), serializedMessage.length(), 0);
-    return result != SOCKET_ERROR;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        size_t before = m_outbound.bytes();
+        m_outbound.push(std::move(message), std::move(content), Message::currentTimeNs());
+        if (m_outboundStats) {
+            m_outboundStats->addQueuedBytes(static_cast<int64_t>(m_outbound.bytes() - before));
+        }
+        // Очередь уже разбирает другой поток: он запишет и это сообщение
+        if (m_draining) {
+            return true;
+        }
+        m_draining = true;
+    }
+    drainOutbound();
+    return true;
+}
+
+bool ClientHandler::sendFrame(const std::string& frame, OutboundQueue::Priority priority) {
+    if (!m_active) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_outbound.pushFrame(frame, priority, Message::currentTimeNs());
+        if (m_outboundStats) {
+            m_outboundStats->addQueuedBytes(static_cast<int64_t>(frame.size()));
+        }
+        if (m_draining) {
+            return true;
+        }
+        m_draining = true;
+    }
+    drainOutbound();
+    return true;
+}
+
+void ClientHandler::drainOutbound() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (!m_outbound.pop(m_sending)) {
+                m_draining = false;
+                return;
+            }
+        }
+        
+        bool written = writeEntry(m_sending);
+        if (m_outboundStats) {
+            m_outboundStats->addQueuedBytes(-static_cast<int64_t>(m_sending.bytes));
+            if (written) {
+                m_outboundStats->record(m_sending.priority, Message::currentTimeNs() - m_sending.enqueuedNs);
+            }
+        }
+        // После неудачной записи соединение уже разорвано: следующий кадр
+        // после частично записанного сбил бы разбор у клиента
+        if (!written) {
+            break;
+        }
+    }
+    
+    // Соединение закрыто: сообщения с номером дождутся восстановления сессии в окне повтора
+    auto channel = getChannel();
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    while (m_outbound.pop(m_sending)) {
+        if (m_outboundStats) {
+            m_outboundStats->addQueuedBytes(-static_cast<int64_t>(m_sending.bytes));
+        }
+        if (channel && !m_sending.serialized && ReliableChannel::isSequenced(m_sending.message.getType())) {
+            channel->stamp(m_sending.message);
+        }
+    }
+    m_draining = false;
+}
+
+bool ClientHandler::writeEntry(OutboundQueue::Entry& entry) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    if (entry.serialized) {
+        return writeFrame(entry.frame);
+    }
+    
+    // Номер присваивается при записи: порядок номеров совпадает с порядком в сокете,
+    // хотя классы приоритета обгоняют друг друга
+    Message& message = entry.message;
+    auto channel = getChannel();
+    if (channel && !channel->stamp(message)) {
+        LOG_WARNING("Клиент ", m_clientId, " не подтверждает прием, окно заполнено: соединение разрывается");
+        disconnect();
+        return false;
+    }
+    message.setServerSendNs(Message::currentTimeNs());
+    
+    {
+        TRACE_SCOPE("Message::serialize");
+        if (entry.content) {
+            message.serializeHeaderTo(m_sendBuffer);
+            m_sendBuffer.append(*entry.content);
+        } else {
+            message.serializeTo(m_sendBuffer);
+        }
+    }
+    // Пронумерованное сообщение остается в окне и будет повторено после RESUME
+    return writeFrame(m_sendBuffer);
+}
+
+bool ClientHandler::writeFrame(const std::string& frame) {
+    if (!m_active) {
+        return false;
+    }
+    
+    TRACE_SCOPE("ClientHandler::send");
+    // Ошибка или истекший срок отправки (SO_SNDTIMEO, кольцо не освободилось)
+    // могли оставить кадр записанным наполовину: поток кадров испорчен
+    if (!m_transport->send(frame.data(), frame.size())) {
+        disconnect();
+        return false;
+    }
+    return true;
 }
 
 void ClientHandler::setMessageHandler(std::function<void(int, const Message&)> handler) {
     m_messageHandler = handler;
 }
 
+void ClientHandler::setRateLimitHandler(std::function<void(int, size_t)> handler) {
+    m_rateLimitHandler = handler;
+}
+
+void ClientHandler::setDisconnectHandler(std::function<void(int)> handler) {
+    m_disconnectHandler = handler;
+}
+
+bool ClientHandler::shouldNotifyRejection(int64_t nowNs) {
+    int64_t last = m_lastRejectionNs.load(std::memory_order_relaxed);
+    if (nowNs - last < REJECTION_NOTIFY_INTERVAL_NS) {
+        return false;
+    }
+    return m_lastRejectionNs.compare_exchange_strong(last, nowNs);
+}
+
 void ClientHandler::clientLoop() {
-    char buffer[1024];
+    // Закрепление до выделения буферов: их память достается узлу потока
+    if (!m_cpus.empty() && !CpuTopology::pinCurrentThread(m_cpus)) {
+        LOG_DEBUG("Поток клиента ", m_clientId, " не закреплен за процессорами ", CpuTopology::formatCpuList(m_cpus));
+    }
+    std::vector<char> buffer(m_receiveBufferSize);
+    FrameBuffer frames;
+    FrameScanner::Frame batch[FrameScanner::BATCH_SIZE];
+    TRACE_THREAD_NAME("client-handler-" + std::to_string(m_clientId));
+    
+    if (!m_pendingInput.empty()) {
+        frames.append(m_pendingInput.data(), m_pendingInput.size());
+        m_pendingInput.clear();
+    }
     
     while (m_active) {
-        int bytesReceived = recv(m_clientSocket, buffer, sizeof(buffer) - 1, 0);
+        m_transport->wait(m_wakeFd, -1);
+        if (m_detachRequested && m_detachRequested->load()) {
+            // Сокет остается открытым: его вместе с недочитанным кадром заберет новый процесс
+            m_pendingInput = frames.takePending();
+            return;
+        }
+        
+        int bytesReceived = m_transport->receive(buffer.data(), buffer.size());
         if (bytesReceived <= 0) {
             if (m_active) {
-                std::cout << "Клиент " << m_clientId << " отключился" << std::endl;
+                LOG_INFO("Клиент ", m_clientId, " отключился");
             }
             break;
         }
+        int64_t receivedNs = Message::currentTimeNs();
+        m_lastActivityNs.store(receivedNs, std::memory_order_relaxed);
         
-        buffer[bytesReceived] = '\0';
-        std::string messageData(buffer);
+        frames.append(buffer.data(), static_cast<size_t>(bytesReceived));
+        if (frames.overflowed()) {
+            LOG_WARNING("Клиент ", m_clientId, " превысил максимальный размер кадра");
+            break;
+        }
         
-        Message message;
-        if (message.deserialize(messageData)) {
-            processIncomingMessage(message);
+        // Все кадры принятого блока находятся одним проходом по буферу
+        size_t count;
+        while (m_active && (count = frames.nextFrames(batch, FrameScanner::BATCH_SIZE)) > 0) {
+            for (size_t i = 0; i < count && m_active; ++i) {
+                const FrameScanner::Frame& frame = batch[i];
+                // Ограничение скорости проверяется до разбора: поток мусора
+                // стоит серверу не больше, чем поток корректных сообщений
+                if (!m_rateLimiter.tryConsume(frame.data.size() + 1, receivedNs)) {
+                    if (m_rateLimitHandler) {
+                        m_rateLimitHandler(m_clientId, frame.data.size() + 1);
+                    }
+                    continue;
+                }
+                
+                Message message;
+                bool parsed;
+                {
+                    TRACE_SCOPE("Message::deserialize");
+                    parsed = message.deserialize(frame);
+                }
+                if (parsed && message.getType() == Message::Type::SHM_ATTACH) {
+                    attachSharedMemory();
+                } else if (parsed) {
+                    message.setServerReceiveNs(receivedNs);
+                    TRACE_SCOPE("ClientHandler::processIncomingMessage");
+                    processIncomingMessage(message);
+                }
+            }
         }
     }
     
     m_active = false;
+    closeSocket();
+    
+    // Последнее действие потока: обработчик может освободить этот объект
+    if (m_disconnectHandler) {
+        m_disconnectHandler(m_clientId);
+    }
+}
+
+void ClientHandler::attachSharedMemory() {
+    std::unique_ptr<ShmSegment> segment = m_socketTransport ? m_socketTransport->attachReceivedSegment() : nullptr;
+    
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    if (!segment) {
+        LOG_WARNING("Клиент ", m_clientId, " прислал неверный сегмент разделяемой памяти");
+        writeFrame(Message(Message::Type::ERROR, "SHM_FAILED", -1).serialize());
+        return;
+    }
+    
+    // Ответ уходит по сокету, все следующие кадры - через кольцо
+    writeFrame(Message(Message::Type::STATUS, "SHM_OK", -1).serialize());
+    m_socketTransport->useSharedMemory(std::move(segment));
+    LOG_INFO("Клиент ", m_clientId, " перешел на разделяемую память");
+}
+
+void ClientHandler::closeSocket() {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    m_transport->close();
 }
 
 void ClientHandler::processIncomingMessage(const Message& message) {
@@ -76,23 +400,26 @@ void ClientHandler::processIncomingMessage(const Message& message) {
         m_messageHandler(m_clientId, message);
     }
     
-    // Обработка различных типов сообщений
-    switch (message.getType()) {
-        case Message::Type::LOGIN: {
-            std::cout << "Клиент " << m_clientId << " пытается войти в систему" << std::endl;
-            break;
+    // SHM_ATTACH обрабатывается в clientLoop и сюда не попадает
+    struct Handlers {
+        using Ignored [[maybe_unused]] = IgnoredTypes<Message::Type::FILE, Message::Type::STATUS, Message::Type::ERROR,
+                                     Message::Type::PING, Message::Type::PONG, Message::Type::RESUME,
+                                     Message::Type::ACK, Message::Type::SHM_ATTACH>;
+        
+        int clientId;
+        
+        void handle(MessageTag<Message::Type::LOGIN>, const Message&) {
+            LOG_DEBUG("Клиент ", clientId, " пытается войти в систему");
         }
-        case Message::Type::LOGOUT: {
-            std::cout << "Клиент " << m_clientId << " выходит из системы" << std::endl;
-            break;
+        void handle(MessageTag<Message::Type::LOGOUT>, const Message&) {
+            LOG_DEBUG("Клиент ", clientId, " выходит из системы");
         }
-        case Message::Type::TEXT: {
-            std::cout << "Клиент " << m_clientId << " отправил сообщение: " << message.getContent() << std::endl;
-            break;
+        void handle(MessageTag<Message::Type::TEXT>, const Message& message) {
+            LOG_DEBUG("Клиент ", clientId, " отправил сообщение: ", message.getContent());
         }
-        default:
-            break;
-    }
+    };
+    Handlers handlers{m_clientId};
+    MessageDispatcher<Handlers>::dispatch(handlers, message);
 }
 
 void ClientHandler::sendResponse(const Message& message) {
@@ -100,6 +427,6 @@ void ClientHandler::sendResponse(const Message& message) {
 }
 
 void ClientHandler::handleNetworkError(int error) {
-    std::cerr << "Сетевая ошибка для клиента " << m_clientId << ": " << error << std::endl;
+    LOG_ERROR("Сетевая ошибка для клиента ", m_clientId, ": ", error);
     m_active = false;
 }
@@ -0,0 +1,539 @@
+#include "server/Cluster.h"
+#include "common/FrameBuffer.h"
+#include "common/Logger.h"
+#include "common/Trace.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <ws2tcpip.h>
+#else
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/select.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Период проверки, не закрыл ли узел простаивающую связь
+ */
+const auto LINK_CHECK_INTERVAL = std::chrono::milliseconds(500);
+
+/**
+ * @brief Срок ответа на приветствие
+ */
+const auto HANDSHAKE_TIMEOUT = std::chrono::milliseconds(2000);
+
+#ifdef _WIN32
+const int SHUTDOWN_BOTH = SD_BOTH;
+#else
+const int SHUTDOWN_BOTH = SHUT_RDWR;
+#endif
+
+/**
+ * @brief Флаги send: без SIGPIPE, если узел уже закрыл связь
+ */
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+void closeSocket(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+void setReceiveTimeout(socket_t socket, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+    DWORD value = static_cast<DWORD>(timeout.count());
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+#else
+    timeval value{};
+    value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    value.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+#endif
+}
+
+bool sendAll(socket_t socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int result = send(socket, data.c_str() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+        if (result == SOCKET_ERROR || result == 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+/**
+ * @brief Проверка, закрыл ли узел исходящую связь
+ *
+ * По исходящей связи после приветствия ничего не приходит, поэтому
+ * готовность к чтению означает конец потока или ошибку.
+ */
+bool peerClosed(socket_t socket) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(socket, &readSet);
+    timeval timeout{0, 0};
+    if (select(static_cast<int>(socket) + 1, &readSet, nullptr, nullptr, &timeout) <= 0) {
+        return false;
+    }
+    char byte;
+    return recv(socket, &byte, 1, MSG_PEEK) <= 0;
+}
+
+/**
+ * @brief Разбор "хост:порт"
+ */
+bool parseAddress(const std::string& address, std::string& host, int& port) {
+    size_t separator = address.rfind(':');
+    if (separator == std::string::npos || separator == 0) {
+        return false;
+    }
+    host = address.substr(0, separator);
+    port = std::atoi(address.c_str() + separator + 1);
+    return port > 0 && port < 65536;
+}
+
+} // namespace
+
+Cluster::Cluster(const ClusterSettings& settings)
+    : m_settings(settings), m_running(false), m_listener(INVALID_SOCKET) {
+}
+
+Cluster::~Cluster() {
+    stop();
+}
+
+void Cluster::setDeliverHandler(DeliverHandler handler) {
+    m_deliverHandler = std::move(handler);
+}
+
+void Cluster::setBroadcastHandler(BroadcastHandler handler) {
+    m_broadcastHandler = std::move(handler);
+}
+
+bool Cluster::start() {
+    if (m_running) {
+        return true;
+    }
+    if (m_settings.nodeId <= 0 || m_settings.nodeId >= MAX_NODES) {
+        LOG_ERROR("Номер узла кластера должен быть от 1 до ", MAX_NODES - 1);
+        return false;
+    }
+
+    m_listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listener == INVALID_SOCKET) {
+        LOG_ERROR("Ошибка создания сокета кластера");
+        return false;
+    }
+    // Порт кластера сразу занимается заново после перезапуска узла
+    int reuse = 1;
+    setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(static_cast<uint16_t>(m_settings.port));
+    if (bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(m_listener, SOMAXCONN) == SOCKET_ERROR) {
+        LOG_ERROR("Не удалось открыть порт кластера ", m_settings.port);
+        closeSocket(m_listener);
+        m_listener = INVALID_SOCKET;
+        return false;
+    }
+
+    m_running = true;
+    m_acceptThread = std::thread(&Cluster::acceptLoop, this);
+    for (const auto& peer : m_settings.peers) {
+        auto link = std::make_unique<Link>();
+        if (!parseAddress(peer, link->host, link->port)) {
+            LOG_WARNING("Неверный адрес узла кластера: ", peer);
+            continue;
+        }
+        m_links.push_back(std::move(link));
+    }
+    for (auto& link : m_links) {
+        link->thread = std::thread(&Cluster::linkLoop, this, std::ref(*link));
+    }
+
+    LOG_INFO("Узел кластера ", m_settings.nodeId, " слушает порт ", m_settings.port,
+             ", связей к узлам: ", m_links.size());
+    return true;
+}
+
+void Cluster::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    if (m_listener != INVALID_SOCKET) {
+        shutdown(m_listener, SHUTDOWN_BOTH);
+        closeSocket(m_listener);
+        m_listener = INVALID_SOCKET;
+    }
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+
+    for (auto& link : m_links) {
+        {
+            std::lock_guard<std::mutex> lock(link->mutex);
+            if (link->socket != INVALID_SOCKET) {
+                shutdown(link->socket, SHUTDOWN_BOTH);
+            }
+        }
+        link->cv.notify_all();
+    }
+    for (auto& link : m_links) {
+        if (link->thread.joinable()) {
+            link->thread.join();
+        }
+    }
+
+    std::vector<std::unique_ptr<Inbound>> inbound;
+    {
+        std::lock_guard<std::mutex> lock(m_inboundMutex);
+        inbound.swap(m_inbound);
+        for (auto& connection : inbound) {
+            shutdown(connection->socket, SHUTDOWN_BOTH);
+        }
+    }
+    for (auto& connection : inbound) {
+        if (connection->thread.joinable()) {
+            connection->thread.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    m_directory.clear();
+    m_inboundCount.clear();
+    m_localUsers.clear();
+}
+
+void Cluster::publishPresence(int userId, bool online) {
+    std::string frame = "P|" + std::to_string(userId) + (online ? "|1\n" : "|0\n");
+    // Снимок при подключении связи берется под тем же мьютексом,
+    // поэтому изменение не теряется между снимком и очередью
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    if (online) {
+        m_localUsers.insert(userId);
+    } else {
+        m_localUsers.erase(userId);
+    }
+    for (auto& link : m_links) {
+        enqueue(*link, frame);
+    }
+}
+
+int Cluster::findUserNode(int userId) const {
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    auto it = m_directory.find(userId);
+    return it != m_directory.end() ? it->second : -1;
+}
+
+bool Cluster::forward(int nodeId, int userId, const Message& message) {
+    std::string frame = "D|" + std::to_string(userId) + "|" + message.serialize();
+    for (auto& link : m_links) {
+        if (enqueue(*link, frame, nodeId)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cluster::broadcast(const Message& message) {
+    // Один кадр на связь: узел-получатель сам рассылает своим клиентам
+    std::string frame = "B|" + message.serialize();
+    for (auto& link : m_links) {
+        enqueue(*link, frame);
+    }
+}
+
+bool Cluster::enqueue(Link& link, const std::string& frame, int nodeId) {
+    {
+        std::lock_guard<std::mutex> lock(link.mutex);
+        if (!link.connected || (nodeId != -1 && link.nodeId != nodeId)) {
+            return false;
+        }
+        if (link.queue.size() + frame.size() > m_settings.maxQueuedBytes) {
+            LOG_WARNING("Очередь связи с узлом ", link.nodeId, " заполнена, кадр отброшен");
+            return false;
+        }
+        link.queue += frame;
+    }
+    link.cv.notify_one();
+    return true;
+}
+
+void Cluster::acceptLoop() {
+    TRACE_THREAD_NAME("cluster-accept");
+    while (m_running) {
+        socket_t socket = accept(m_listener, nullptr, nullptr);
+        if (socket == INVALID_SOCKET) {
+            if (!m_running) {
+                break;
+            }
+            continue;
+        }
+        reapInbound();
+
+        auto inbound = std::make_unique<Inbound>();
+        inbound->socket = socket;
+        Inbound& connection = *inbound;
+        std::lock_guard<std::mutex> lock(m_inboundMutex);
+        if (!m_running) {
+            closeSocket(socket);
+            break;
+        }
+        m_inbound.push_back(std::move(inbound));
+        connection.thread = std::thread(&Cluster::readLoop, this, std::ref(connection));
+    }
+}
+
+void Cluster::readLoop(Inbound& inbound) {
+    TRACE_THREAD_NAME("cluster-read");
+    char buffer[64 * 1024];
+    // Кадр связи - сообщение клиента с коротким префиксом
+    FrameBuffer frames(FrameBuffer::DEFAULT_MAX_FRAME_SIZE + 64);
+    std::string frame;
+    int nodeId = -1;
+    bool rejected = false;
+
+    while (m_running && !rejected) {
+        int received = recv(inbound.socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        frames.append(buffer, static_cast<size_t>(received));
+        while (!rejected && frames.nextFrame(frame)) {
+            if (nodeId != -1) {
+                TRACE_SCOPE("Cluster::handleFrame");
+                handleFrame(nodeId, frame);
+                continue;
+            }
+            // Первый кадр - приветствие; ответ сообщает узлу наш номер
+            nodeId = frame.compare(0, 2, "H|") == 0 ? std::atoi(frame.c_str() + 2) : 0;
+            if (nodeId <= 0 || nodeId >= MAX_NODES || nodeId == m_settings.nodeId ||
+                !sendAll(inbound.socket, "H|" + std::to_string(m_settings.nodeId) + "\n")) {
+                LOG_WARNING("Отклонена связь кластера с неверным приветствием");
+                nodeId = -1;
+                rejected = true;
+                break;
+            }
+            // Новая связь начинается со снимка: прежние записи узла устарели
+            std::lock_guard<std::mutex> lock(m_presenceMutex);
+            dropNode(nodeId);
+            ++m_inboundCount[nodeId];
+        }
+        if (frames.overflowed()) {
+            LOG_ERROR("Узел ", nodeId, " прислал кадр больше допустимого размера");
+            break;
+        }
+    }
+
+    if (nodeId != -1) {
+        std::lock_guard<std::mutex> lock(m_presenceMutex);
+        if (--m_inboundCount[nodeId] == 0) {
+            m_inboundCount.erase(nodeId);
+            dropNode(nodeId);
+            LOG_WARNING("Связь с узлом ", nodeId, " потеряна");
+        }
+    }
+    closeSocket(inbound.socket);
+    inbound.finished = true;
+}
+
+void Cluster::handleFrame(int nodeId, const std::string& frame) {
+    if (frame.size() < 2 || frame[1] != '|') {
+        return;
+    }
+    switch (frame[0]) {
+        case 'P': {
+            size_t separator = frame.find('|', 2);
+            if (separator == std::string::npos) {
+                return;
+            }
+            int userId = std::atoi(frame.c_str() + 2);
+            bool online = frame.compare(separator + 1, std::string::npos, "1") == 0;
+            std::lock_guard<std::mutex> lock(m_presenceMutex);
+            if (online) {
+                m_directory[userId] = nodeId;
+            } else {
+                auto it = m_directory.find(userId);
+                if (it != m_directory.end() && it->second == nodeId) {
+                    m_directory.erase(it);
+                }
+            }
+            break;
+        }
+        case 'D': {
+            size_t separator = frame.find('|', 2);
+            Message message;
+            if (separator != std::string::npos && message.deserialize(frame.substr(separator + 1)) &&
+                m_deliverHandler) {
+                m_deliverHandler(std::atoi(frame.c_str() + 2), message);
+            }
+            break;
+        }
+        case 'B': {
+            Message message;
+            if (message.deserialize(frame.substr(2)) && m_broadcastHandler) {
+                m_broadcastHandler(message);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Cluster::dropNode(int nodeId) {
+    for (auto it = m_directory.begin(); it != m_directory.end();) {
+        if (it->second == nodeId) {
+            it = m_directory.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Cluster::reapInbound() {
+    std::vector<std::unique_ptr<Inbound>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_inboundMutex);
+        for (auto it = m_inbound.begin(); it != m_inbound.end();) {
+            if ((*it)->finished) {
+                finished.push_back(std::move(*it));
+                it = m_inbound.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& connection : finished) {
+        connection->thread.join();
+    }
+}
+
+void Cluster::linkLoop(Link& link) {
+    TRACE_THREAD_NAME("cluster-link");
+    std::string batch;
+    while (m_running) {
+        if (!connectLink(link)) {
+            std::unique_lock<std::mutex> lock(link.mutex);
+            link.cv.wait_for(lock, m_settings.reconnectInterval, [this] { return !m_running; });
+            continue;
+        }
+        LOG_INFO("Связь с узлом ", link.nodeId, " (", link.host, ":", link.port, ") установлена");
+
+        while (m_running) {
+            {
+                // Пока пишется пачка, новые кадры копятся в очереди и уйдут следующей пачкой
+                std::unique_lock<std::mutex> lock(link.mutex);
+                link.cv.wait_for(lock, LINK_CHECK_INTERVAL, [&] { return !m_running || !link.queue.empty(); });
+                batch.swap(link.queue);
+            }
+            if (batch.empty()) {
+                if (peerClosed(link.socket)) {
+                    break;
+                }
+                continue;
+            }
+            bool sent;
+            {
+                TRACE_SCOPE("Cluster::send");
+                sent = sendAll(link.socket, batch);
+            }
+            batch.clear();
+            if (!sent) {
+                break;
+            }
+        }
+
+        int nodeId = link.nodeId;
+        closeLink(link);
+        if (m_running) {
+            LOG_WARNING("Связь с узлом ", nodeId, " разорвана, повторное подключение");
+        }
+    }
+    closeLink(link);
+}
+
+bool Cluster::connectLink(Link& link) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(link.host.c_str(), std::to_string(link.port).c_str(), &hints, &addresses) != 0) {
+        return false;
+    }
+    socket_t socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET) {
+        freeaddrinfo(addresses);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(link.mutex);
+        if (!m_running) {
+            closeSocket(socket);
+            freeaddrinfo(addresses);
+            return false;
+        }
+        link.socket = socket;
+    }
+    bool connected = ::connect(socket, addresses->ai_addr, static_cast<int>(addresses->ai_addrlen)) != SOCKET_ERROR;
+    freeaddrinfo(addresses);
+
+    // Пачки собираются самой связью, задержка Нейгла только добавит ожидание
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    setReceiveTimeout(socket, HANDSHAKE_TIMEOUT);
+
+    int nodeId = -1;
+    if (connected && sendAll(socket, "H|" + std::to_string(m_settings.nodeId) + "\n")) {
+        char buffer[64];
+        FrameBuffer frames;
+        std::string frame;
+        int received;
+        while (!frames.nextFrame(frame) && (received = recv(socket, buffer, sizeof(buffer), 0)) > 0) {
+            frames.append(buffer, static_cast<size_t>(received));
+        }
+        if (frame.compare(0, 2, "H|") == 0) {
+            nodeId = std::atoi(frame.c_str() + 2);
+        }
+    }
+    if (nodeId <= 0) {
+        closeLink(link);
+        return false;
+    }
+
+    // Снимок вошедших пользователей идет первым кадром связи
+    std::lock_guard<std::mutex> presenceLock(m_presenceMutex);
+    std::lock_guard<std::mutex> lock(link.mutex);
+    link.nodeId = nodeId;
+    link.connected = true;
+    link.queue.clear();
+    for (int userId : m_localUsers) {
+        link.queue += "P|" + std::to_string(userId) + "|1\n";
+    }
+    return true;
+}
+
+void Cluster::closeLink(Link& link) {
+    std::lock_guard<std::mutex> lock(link.mutex);
+    if (link.socket != INVALID_SOCKET) {
+        closeSocket(link.socket);
+        link.socket = INVALID_SOCKET;
+    }
+    link.connected = false;
+    link.queue.clear();
+}
@@ -0,0 +1,150 @@
+#include "server/CpuTopology.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#ifdef __linux__
+    #include <dirent.h>
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace {
+
+const char* NODE_DIRECTORY = "/sys/devices/system/node";
+
+} // namespace
+
+CpuTopology::CpuTopology()
+    : m_nodeCount(1) {
+}
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topology;
+#ifdef __linux__
+    DIR* directory = opendir(NODE_DIRECTORY);
+    if (directory) {
+        size_t nodes = 0;
+        while (dirent* entry = readdir(directory)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            int node = std::atoi(name.c_str() + 4);
+            std::ifstream file(std::string(NODE_DIRECTORY) + "/" + name + "/cpulist");
+            std::string list;
+            std::vector<int> cpus;
+            if (!std::getline(file, list) || !parseCpuList(list, cpus)) {
+                continue;
+            }
+            for (int cpu : cpus) {
+                if (static_cast<size_t>(cpu) >= topology.m_cpuNode.size()) {
+                    topology.m_cpuNode.resize(cpu + 1, -1);
+                }
+                topology.m_cpuNode[cpu] = node;
+            }
+            nodes = std::max(nodes, static_cast<size_t>(node) + 1);
+        }
+        closedir(directory);
+        if (nodes > 0) {
+            topology.m_nodeCount = nodes;
+            return topology;
+        }
+    }
+#endif
+    // Топология неизвестна: все процессоры на узле 0
+    topology.m_cpuNode.assign(std::max(1u, std::thread::hardware_concurrency()), 0);
+    return topology;
+}
+
+bool CpuTopology::parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::vector<int> parsed;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t end = text.find(',', position);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string range = text.substr(position, end - position);
+        range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+        size_t dash = range.find('-');
+        std::string first = range.substr(0, dash);
+        std::string last = dash == std::string::npos ? first : range.substr(dash + 1);
+        if (first.empty() || last.empty() ||
+            first.find_first_not_of("0123456789") != std::string::npos ||
+            last.find_first_not_of("0123456789") != std::string::npos ||
+            first.size() > 6 || last.size() > 6) {
+            return false;
+        }
+        int from = std::atoi(first.c_str());
+        int to = std::atoi(last.c_str());
+        if (from > to) {
+            return false;
+        }
+        for (int cpu = from; cpu <= to; ++cpu) {
+            parsed.push_back(cpu);
+        }
+        position = end + 1;
+    }
+    std::sort(parsed.begin(), parsed.end());
+    parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+    if (parsed.empty()) {
+        return false;
+    }
+    cpus.swap(parsed);
+    return true;
+}
+
+std::string CpuTopology::formatCpuList(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        text += (text.empty() ? "" : ",") + std::to_string(cpus[i]);
+        if (j > i) {
+            text += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text;
+}
+
+bool CpuTopology::pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    if (cpu < 0 || static_cast<size_t>(cpu) >= m_cpuNode.size()) {
+        return -1;
+    }
+    return m_cpuNode[cpu];
+}
+
+std::vector<int> CpuTopology::cpusOnNode(const std::vector<int>& cpus, int node) const {
+    std::vector<int> result;
+    for (int cpu : cpus) {
+        if (nodeOf(cpu) == node) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,59 @@
+#include "server/OnlineBitmap.h"
+
+OnlineBitmap::OnlineBitmap()
+    : m_pages(new std::atomic<Word*>[PAGE_COUNT]), m_count(0) {
+    for (size_t i = 0; i < PAGE_COUNT; ++i) {
+        m_pages[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+OnlineBitmap::~OnlineBitmap() {
+    for (size_t i = 0; i < PAGE_COUNT; ++i) {
+        delete[] m_pages[i].load(std::memory_order_relaxed);
+    }
+}
+
+OnlineBitmap::Word* OnlineBitmap::word(int userId, bool create) const {
+    if (userId < 0) {
+        return nullptr;
+    }
+    size_t bit = static_cast<size_t>(userId);
+    std::atomic<Word*>& slot = m_pages[bit >> PAGE_BITS];
+    Word* page = slot.load(std::memory_order_acquire);
+    if (!page && create) {
+        std::lock_guard<std::mutex> lock(m_pagesMutex);
+        page = slot.load(std::memory_order_acquire);
+        if (!page) {
+            page = new Word[PAGE_WORDS];
+            for (size_t i = 0; i < PAGE_WORDS; ++i) {
+                page[i].store(0, std::memory_order_relaxed);
+            }
+            slot.store(page, std::memory_order_release);
+        }
+    }
+    return page ? &page[(bit & ((size_t(1) << PAGE_BITS) - 1)) / 64] : nullptr;
+}
+
+bool OnlineBitmap::set(int userId, bool online) {
+    Word* target = word(userId, online);
+    if (!target) {
+        return false;
+    }
+    uint64_t mask = uint64_t(1) << (static_cast<size_t>(userId) % 64);
+    uint64_t previous = online ? target->fetch_or(mask, std::memory_order_acq_rel)
+                               : target->fetch_and(~mask, std::memory_order_acq_rel);
+    bool changed = ((previous & mask) != 0) != online;
+    if (changed) {
+        if (online) {
+            m_count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    return changed;
+}
+
+bool OnlineBitmap::test(int userId) const {
+    Word* target = word(userId, false);
+    return target && (target->load(std::memory_order_acquire) & (uint64_t(1) << (static_cast<size_t>(userId) % 64))) != 0;
+}
@@ -0,0 +1,144 @@
+#include "server/OutboundQueue.h"
+#include <algorithm>
+
+constexpr size_t OutboundQueue::QUANTUM_BYTES[OutboundQueue::PRIORITY_COUNT];
+
+OutboundQueue::Priority OutboundQueue::classify(const Message& message) {
+    switch (message.getType()) {
+        case Message::Type::FILE:
+            return Priority::BULK;
+        case Message::Type::TEXT:
+            return message.getReceiverId() == -1 ? Priority::BULK : Priority::INTERACTIVE;
+        default:
+            return Priority::CONTROL;
+    }
+}
+
+OutboundQueue::OutboundQueue()
+    : m_current(0), m_turnStarted(false), m_count(0), m_bytes(0) {
+}
+
+void OutboundQueue::push(Message&& message, int64_t nowNs) {
+    push(std::move(message), nullptr, nowNs);
+}
+
+void OutboundQueue::push(Message&& message, std::shared_ptr<const std::string> content, int64_t nowNs) {
+    Entry& entry = append(classify(message));
+    entry.bytes = (content ? content->size() : message.getContent().size()) + FRAME_OVERHEAD;
+    entry.message = std::move(message);
+    entry.content = std::move(content);
+    entry.serialized = false;
+    entry.enqueuedNs = nowNs;
+    m_bytes += entry.bytes;
+}
+
+void OutboundQueue::pushFrame(const std::string& frame, Priority priority, int64_t nowNs) {
+    Entry& entry = append(priority);
+    entry.bytes = frame.size();
+    entry.frame.assign(frame);
+    entry.content.reset();
+    entry.serialized = true;
+    entry.enqueuedNs = nowNs;
+    m_bytes += entry.bytes;
+}
+
+bool OutboundQueue::pop(Entry& entry) {
+    if (m_count == 0) {
+        return false;
+    }
+
+    // Служебный кадр идет вне очереди, пока у его класса остался квант;
+    // квант пополняется только в свой ход, поэтому остальные классы не голодают
+    Lane& control = m_lanes[static_cast<size_t>(Priority::CONTROL)];
+    if (control.count > 0 && control.ring[control.head].bytes <= control.deficit) {
+        take(control, entry);
+        return true;
+    }
+
+    while (true) {
+        Lane& lane = m_lanes[m_current];
+        if (lane.count > 0) {
+            if (!m_turnStarted) {
+                lane.deficit += QUANTUM_BYTES[m_current];
+                m_turnStarted = true;
+            }
+            if (lane.ring[lane.head].bytes <= lane.deficit) {
+                take(lane, entry);
+                return true;
+            }
+        }
+        m_current = (m_current + 1) % PRIORITY_COUNT;
+        m_turnStarted = false;
+    }
+}
+
+OutboundQueue::Entry& OutboundQueue::append(Priority priority) {
+    Lane& lane = m_lanes[static_cast<size_t>(priority)];
+    if (lane.count == lane.ring.size()) {
+        // Кольцо растет вдвое и не сжимается: буферы элементов переиспользуются
+        std::vector<Entry> grown(std::max<size_t>(8, lane.ring.size() * 2));
+        for (size_t i = 0; i < lane.count; ++i) {
+            grown[i] = std::move(lane.ring[(lane.head + i) % lane.ring.size()]);
+        }
+        lane.ring.swap(grown);
+        lane.head = 0;
+    }
+    Entry& entry = lane.ring[(lane.head + lane.count) % lane.ring.size()];
+    entry.priority = priority;
+    ++lane.count;
+    ++m_count;
+    return entry;
+}
+
+void OutboundQueue::take(Lane& lane, Entry& entry) {
+    Entry& first = lane.ring[lane.head];
+    lane.deficit -= first.bytes;
+    std::swap(entry, first);
+    lane.head = (lane.head + 1) % lane.ring.size();
+    --lane.count;
+    --m_count;
+    m_bytes -= entry.bytes;
+
+    if (lane.count == 0) {
+        // Опустевший класс не копит квант; служебный сохраняет не больше
+        // одного кванта, чтобы следующий кадр прошел вне очереди
+        lane.deficit = entry.priority == Priority::CONTROL ? std::min(lane.deficit, QUANTUM_BYTES[0]) : 0;
+    }
+}
+
+void OutboundStats::record(OutboundQueue::Priority priority, int64_t waitNs) {
+    Lane& lane = m_lanes[static_cast<size_t>(priority)];
+    uint64_t wait = static_cast<uint64_t>(std::max<int64_t>(waitNs, 0));
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKETS && (wait >> (bucket + 1)) != 0) {
+        ++bucket;
+    }
+    lane.messages.fetch_add(1, std::memory_order_relaxed);
+    lane.totalNs.fetch_add(wait, std::memory_order_relaxed);
+    lane.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = lane.maxNs.load(std::memory_order_relaxed);
+    while (wait > max && !lane.maxNs.compare_exchange_weak(max, wait, std::memory_order_relaxed)) {
+    }
+}
+
+QueueLatency OutboundStats::snapshot(OutboundQueue::Priority priority) const {
+    const Lane& lane = m_lanes[static_cast<size_t>(priority)];
+    QueueLatency latency;
+    latency.messages = lane.messages.load(std::memory_order_relaxed);
+    latency.maxNs = lane.maxNs.load(std::memory_order_relaxed);
+    if (latency.messages == 0) {
+        return latency;
+    }
+    latency.meanNs = lane.totalNs.load(std::memory_order_relaxed) / latency.messages;
+
+    uint64_t rank = latency.messages - latency.messages / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += lane.buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            latency.p99Ns = std::min(latency.maxNs, i + 1 < 64 ? (uint64_t(1) << (i + 1)) - 1 : UINT64_MAX);
+            break;
+        }
+    }
+    return latency;
+}
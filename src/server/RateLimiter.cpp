@@ -0,0 +1,58 @@
+#include "server/RateLimiter.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(double ratePerSecond, double burst)
+    : m_ratePerNs(ratePerSecond / 1e9), m_burst(burst), m_tokens(burst), m_lastRefillNs(0) {
+}
+
+bool TokenBucket::tryConsume(double cost, int64_t nowNs) {
+    if (m_lastRefillNs != 0 && nowNs > m_lastRefillNs) {
+        m_tokens = std::min(m_burst, m_tokens + (nowNs - m_lastRefillNs) * m_ratePerNs);
+    }
+    if (nowNs > m_lastRefillNs) {
+        m_lastRefillNs = nowNs;
+    }
+
+    if (m_tokens < cost) {
+        return false;
+    }
+    m_tokens -= cost;
+    return true;
+}
+
+MessageRateLimiter::MessageRateLimiter(const RateLimits& limits)
+    : m_messages(limits.messagesPerSecond, limits.messageBurst),
+      m_bytes(limits.bytesPerSecond, limits.byteBurst) {
+}
+
+bool MessageRateLimiter::tryConsume(size_t bytes, int64_t nowNs) {
+    // Байты проверяем первыми: отклоненное сообщение не должно тратить токен сообщений
+    if (!m_bytes.tryConsume(static_cast<double>(bytes), nowNs)) {
+        return false;
+    }
+    return m_messages.tryConsume(1.0, nowNs);
+}
+
+UserRateLimiter::UserRateLimiter(const RateLimits& limits)
+    : m_limits(limits) {
+}
+
+bool UserRateLimiter::tryConsume(int userId, size_t bytes, int64_t nowNs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_users.find(userId);
+    if (it == m_users.end()) {
+        it = m_users.emplace(userId, MessageRateLimiter(m_limits)).first;
+    }
+    return it->second.tryConsume(bytes, nowNs);
+}
+
+void UserRateLimiter::setLimits(const RateLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limits = limits;
+    m_users.clear();
+}
+
+void UserRateLimiter::remove(int userId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_users.erase(userId);
+}
@@ -1,14 +1,223 @@
 #include "server/Server.h"
-#include <iostream>
+#include "common/DeliveryReport.h"
+#include "common/Logger.h"
+#include "common/MessageDispatch.h"
+#include "common/Trace.h"
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 
-Server::Server(int port) 
-    : m_port(port), m_serverSocket(INVALID_SOCKET), m_running(false), 
-      m_nextClientId(1), m_nextUserId(1) {
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/un.h>
+#endif
+
+namespace {
+
+const auto REAP_INTERVAL = std::chrono::milliseconds(1000);
+
+#ifdef _WIN32
+const int SHUTDOWN_BOTH = SD_BOTH;
+#else
+const int SHUTDOWN_BOTH = SHUT_RDWR;
+#endif
+
+// Отклоненный клиент мог уже закрыть соединение: без SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+void closeSocket(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+/**
+ * @brief Ограничение времени блокирующей отправки
+ *
+ * Отправка полуоткрытому соединению с заполненным буфером иначе
+ * блокирует поток навсегда.
+ */
+void setSendTimeout(socket_t socket, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+    DWORD value = static_cast<DWORD>(timeout.count());
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+#else
+    timeval value{};
+    value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    value.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+#endif
+}
+
+void setIntOption(socket_t socket, int level, int name, int value) {
+    setsockopt(socket, level, name, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * @brief Параметры сокета принятого соединения
+ *
+ * TCP_NODELAY нужен потому, что ответы уходят отдельными send(): с
+ * Нейглом второй ответ ждет подтверждения первого, а клиент откладывает
+ * подтверждение. Для Unix-сокета параметры TCP ничего не делают.
+ */
+void applySocketOptions(socket_t socket, const SocketOptions& options) {
+    if (options.noDelay) {
+        setIntOption(socket, IPPROTO_TCP, TCP_NODELAY, 1);
+    }
+    if (options.sendBufferBytes > 0) {
+        setIntOption(socket, SOL_SOCKET, SO_SNDBUF, options.sendBufferBytes);
+    }
+    if (options.receiveBufferBytes > 0) {
+        setIntOption(socket, SOL_SOCKET, SO_RCVBUF, options.receiveBufferBytes);
+    }
+    if (options.keepAlive) {
+        setIntOption(socket, SOL_SOCKET, SO_KEEPALIVE, 1);
+#ifdef TCP_KEEPIDLE
+        if (options.keepAliveIdleSeconds > 0) {
+            setIntOption(socket, IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdleSeconds);
+        }
+#endif
+#ifdef TCP_KEEPINTVL
+        if (options.keepAliveIntervalSeconds > 0) {
+            setIntOption(socket, IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveIntervalSeconds);
+        }
+#endif
+#ifdef TCP_KEEPCNT
+        if (options.keepAliveCount > 0) {
+            setIntOption(socket, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount);
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Открытие слушающего сокета по адресу
+ * @return Сокет или INVALID_SOCKET
+ */
+socket_t openListener(const Endpoint& endpoint, const SocketOptions& options) {
+    sockaddr_storage address{};
+    socklen_t length = 0;
+    if (!endpoint.toSockaddr(address, length)) {
+        LOG_ERROR("Адрес ", endpoint.toString(), " не поддерживается");
+        return INVALID_SOCKET;
+    }
+    socket_t listener = socket(endpoint.family(), SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        LOG_ERROR("Ошибка создания сокета");
+        return INVALID_SOCKET;
+    }
+#ifndef _WIN32
+    // Файл сокета от прошлого запуска мешает bind
+    if (endpoint.scheme == Endpoint::Scheme::UNIX) {
+        unlink(endpoint.path.c_str());
+    }
+#endif
+    // Перезапуск не ждет, пока соединения прошлого процесса выйдут из TIME_WAIT
+    if (options.reuseAddress && endpoint.scheme == Endpoint::Scheme::TCP) {
+        setIntOption(listener, SOL_SOCKET, SO_REUSEADDR, 1);
+    }
+    // Буфер приема слушающего сокета наследуют принятые соединения; окно
+    // TCP больше 64 КБ согласуется только при установке до listen()
+    if (options.receiveBufferBytes > 0) {
+        setIntOption(listener, SOL_SOCKET, SO_RCVBUF, options.receiveBufferBytes);
+    }
+    
+    // Привязка сокета к адресу
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), length) == SOCKET_ERROR) {
+        LOG_ERROR("Ошибка привязки сокета к адресу ", endpoint.toString());
+        closeSocket(listener);
+        return INVALID_SOCKET;
+    }
+    
+    // Начало прослушивания
+    if (listen(listener, options.listenBacklog > 0 ? options.listenBacklog : SOMAXCONN) == SOCKET_ERROR) {
+        LOG_ERROR("Ошибка начала прослушивания ", endpoint.toString());
+        closeSocket(listener);
+        return INVALID_SOCKET;
+    }
+    return listener;
+}
+
+/**
+ * @brief Процессор, на котором ядро принимало пакеты соединения
+ * @return Номер процессора или -1, если неизвестен
+ */
+int incomingCpu(socket_t socket) {
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t length = sizeof(cpu);
+    if (getsockopt(socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length) == 0) {
+        return cpu;
+    }
+#else
+    (void)socket;
+#endif
+    return -1;
+}
+
+/**
+ * @brief IP-адрес удаленной стороны соединения
+ */
+std::string peerAddress(socket_t socket) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    char text[INET6_ADDRSTRLEN] = {0};
+    if (getpeername(socket, reinterpret_cast<sockaddr*>(&address), &length) == SOCKET_ERROR) {
+        return "unknown";
+    }
+    if (address.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(&address)->sin_addr, text, sizeof(text));
+    } else if (address.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(&address)->sin6_addr, text, sizeof(text));
+    } else {
+        return "local";
+    }
+    return text;
+}
+
+/**
+ * @brief Настройки по умолчанию с заданным портом
+ */
+ServerConfig configForPort(int port) {
+    ServerConfig config;
+    config.port = port;
+    return config;
+}
+
+} // namespace
+
+Server::Server(int port)
+    : Server(configForPort(port)) {
+}
+
+Server::Server(const ServerConfig& config)
+    : m_port(config.port), m_serverSocket(INVALID_SOCKET), m_running(false),
+      m_nextClientId(1),
+      m_userLimiter(std::make_unique<UserRateLimiter>(config.userLimits)),
+      m_rejectedConnections(0), m_rateLimitedMessages(0), m_shedMessages(0),
+      m_rejectedLogins(0), m_failedLogins(0), m_presenceFlushScheduled(false),
+      m_nextOfflineId(1), m_upgradeListener(-1), m_wakePipe{-1, -1},
+      m_handingOff(false), m_handedOff(false) {
+    publishConfig(config);
 }
 
 Server::~Server() {
     stop();
+#ifndef _WIN32
+    for (int fd : m_wakePipe) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
     cleanupNetwork();
 }
 
@@ -17,87 +226,315 @@ bool Server::start() {
         return true;
     }
     
+    if (!m_dataDirectory.empty() && !m_userStore.isPersistent() && !m_userStore.open(m_dataDirectory)) {
+        LOG_ERROR("Не удалось открыть хранилище пользователей в ", m_dataDirectory);
+        return false;
+    }
+    
     if (!initializeNetwork()) {
-        std::cerr << "Ошибка инициализации сети" << std::endl;
+        LOG_ERROR("Ошибка инициализации сети");
         return false;
     }
     
-    // Создание сокета
-    m_serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (m_serverSocket == INVALID_SOCKET) {
-        std::cerr << "Ошибка создания сокета" << std::endl;
+    // Основной TCP-порт на всех интерфейсах
+    Endpoint endpoint;
+    endpoint.port = m_port;
+    m_serverSocket = openListener(endpoint, config()->socket);
+    if (m_serverSocket == INVALID_SOCKET || !openListeners()) {
+        if (m_serverSocket != INVALID_SOCKET) {
+            closeSocket(m_serverSocket);
+            m_serverSocket = INVALID_SOCKET;
+        }
+        closeListeners(true);
+        cleanupNetwork();
         return false;
     }
     
-    // Настройка адреса сервера
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(m_port);
+    startServing();
+    return true;
+}
+
+bool Server::takeOver(const std::string& controlPath) {
+    if (m_running) {
+        return true;
+    }
+    if (!UpgradeChannel::isSupported()) {
+        LOG_ERROR("Горячее обновление не поддерживается на этой платформе");
+        return false;
+    }
+    if (!initializeNetwork()) {
+        LOG_ERROR("Ошибка инициализации сети");
+        return false;
+    }
     
-    // Привязка сокета к адресу
-    if (bind(m_serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "Ошибка привязки сокета к адресу" << std::endl;
-        cleanupNetwork();
+    int channel = UpgradeChannel::connect(controlPath);
+    if (channel < 0) {
+        LOG_ERROR("Не удалось подключиться к работающему серверу через ", controlPath);
         return false;
     }
     
-    // Начало прослушивания
-    if (listen(m_serverSocket, SOMAXCONN) == SOCKET_ERROR) {
-        std::cerr << "Ошибка начала прослушивания" << std::endl;
-        cleanupNetwork();
+    socket_t listener = INVALID_SOCKET;
+    std::vector<std::pair<socket_t, ConnectionState>> connections;
+    std::vector<std::pair<int, Message>> offlineMessages;
+    std::vector<std::pair<uint64_t, int64_t>> revokedSessions;
+    bool complete = false;
+    UpgradeChannel::Record record;
+    while (!complete && UpgradeChannel::receive(channel, record)) {
+        switch (record.type) {
+            case UpgradeChannel::RecordType::LISTENER:
+                listener = record.fd;
+                break;
+            case UpgradeChannel::RecordType::EXTRA_LISTENER: {
+                Endpoint endpoint;
+                if (record.fd >= 0 && Endpoint::parse(record.payload, m_port, endpoint)) {
+                    m_listeners.push_back(Listener{endpoint, static_cast<socket_t>(record.fd)});
+                } else {
+                    UpgradeChannel::close(record.fd);
+                }
+                break;
+            }
+            case UpgradeChannel::RecordType::USER:
+                restoreUser(record.payload);
+                break;
+            case UpgradeChannel::RecordType::CONNECTION: {
+                ConnectionState state;
+                if (record.fd >= 0 && state.deserialize(record.payload)) {
+                    connections.emplace_back(record.fd, std::move(state));
+                } else {
+                    UpgradeChannel::close(record.fd);
+                }
+                break;
+            }
+            case UpgradeChannel::RecordType::OFFLINE_MESSAGE: {
+                size_t separator = record.payload.find('|');
+                Message message;
+                if (separator != std::string::npos && message.deserialize(record.payload.substr(separator + 1))) {
+                    offlineMessages.emplace_back(std::atoi(record.payload.c_str()), message);
+                }
+                break;
+            }
+            case UpgradeChannel::RecordType::SESSION_KEY:
+                m_sessionTokens.setKey(record.payload);
+                break;
+            case UpgradeChannel::RecordType::REVOKED_SESSION: {
+                size_t separator = record.payload.find('|');
+                if (separator != std::string::npos) {
+                    revokedSessions.emplace_back(std::strtoull(record.payload.c_str(), nullptr, 10),
+                                                 std::atoll(record.payload.c_str() + separator + 1));
+                }
+                break;
+            }
+            case UpgradeChannel::RecordType::END:
+                complete = true;
+                break;
+            default:
+                UpgradeChannel::close(record.fd);
+                break;
+        }
+    }
+    UpgradeChannel::close(channel);
+    
+    // При неудаче закрываются все полученные дескрипторы: сокеты приема
+    // (и файлы Unix-сокетов) не должны оставаться занятыми
+    auto abandon = [&] {
+        UpgradeChannel::close(listener);
+        closeListeners(false);
+        for (auto& connection : connections) {
+            UpgradeChannel::close(connection.first);
+        }
+    };
+    if (!complete || listener == INVALID_SOCKET || !openListeners()) {
+        LOG_ERROR("Передача соединений от работающего сервера прервана");
+        abandon();
+        return false;
+    }
+    
+    // Предыдущий процесс закрыл хранилище перед концом передачи
+    if (!m_dataDirectory.empty() && !m_userStore.open(m_dataDirectory)) {
+        LOG_ERROR("Не удалось открыть хранилище пользователей в ", m_dataDirectory);
+        abandon();
+        return false;
+    }
+    
+    m_serverSocket = listener;
+    for (auto& connection : connections) {
+        m_nextClientId = std::max(m_nextClientId.load(), connection.second.clientId + 1);
+    }
+    startServing();
+    
+    for (auto& connection : connections) {
+        attachClient(connection.first, connection.second);
+    }
+    // Срок хранения сохраненных сообщений отсчитывается заново
+    for (auto& offline : offlineMessages) {
+        deliverToUser(offline.first, offline.second);
+    }
+    for (auto& revoked : revokedSessions) {
+        revokeSession(revoked.first, revoked.second);
+    }
+    LOG_INFO("Принято соединений от предыдущего процесса: ", connections.size(),
+             ", сохраненных сообщений: ", offlineMessages.size());
+    return true;
+}
+
+bool Server::enableHotUpgrade(const std::string& controlPath) {
+    if (!UpgradeChannel::isSupported()) {
+        LOG_WARNING("Горячее обновление не поддерживается на этой платформе");
         return false;
     }
+#ifndef _WIN32
+    if (m_wakePipe[0] < 0) {
+        if (pipe(m_wakePipe) != 0) {
+            LOG_ERROR("Не удалось создать канал пробуждения для горячего обновления");
+            return false;
+        }
+        for (int fd : m_wakePipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+#endif
+    m_upgradePath = controlPath;
+    return true;
+}
+
+void Server::startServing() {
+#ifndef _WIN32
+    // Пробуждение от прошлой остановки не должно будить новые потоки
+    if (m_wakePipe[0] >= 0) {
+        char drained[64];
+        while (read(m_wakePipe[0], drained, sizeof(drained)) > 0) {
+        }
+    }
+#endif
+    m_handingOff = false;
+    m_handedOff = false;
+    
+    std::shared_ptr<const ServerConfig> config = this->config();
+    m_topology = CpuTopology::detect();
+    m_workers = std::make_unique<WorkerPool>(config->workerThreads, config->workerQueueSize);
+    m_workers->setAffinity(config->workerCpus);
+    m_workers->start();
+    if (!config->workerCpus.empty() || !config->ioCpus.empty()) {
+        for (const auto* cpus : {&config->workerCpus, &config->ioCpus}) {
+            for (int cpu : *cpus) {
+                if (m_topology.nodeOf(cpu) < 0) {
+                    LOG_WARNING("Процессор ", cpu, " не найден в системе");
+                }
+            }
+        }
+        LOG_INFO("Узлов NUMA: ", m_topology.nodeCount(),
+                 ", процессоры рабочих потоков: ", CpuTopology::formatCpuList(config->workerCpus),
+                 ", соединений: ", CpuTopology::formatCpuList(config->ioCpus));
+    }
+    m_authPool = std::make_unique<AuthPool>(config->authLimits);
+    m_authPool->setVerifier(m_passwordVerifier);
+    m_authPool->start();
+    m_timers.start();
+    
+    if (m_clusterSettings.nodeId != 0) {
+        // Кадры от других узлов обрабатываются рабочими потоками по ключу получателя
+        m_cluster = std::make_unique<Cluster>(m_clusterSettings);
+        m_cluster->setDeliverHandler([this](int userId, const Message& message) {
+            if (!m_workers->submit(static_cast<size_t>(userId), [this, userId, message = Message(message)] {
+                    deliverLocally(userId, message);
+                })) {
+                LOG_WARNING("Очередь переполнена, сообщение с другого узла для ", userId, " отброшено");
+            }
+        });
+        m_cluster->setBroadcastHandler([this](const Message& message) {
+            m_workers->submit(static_cast<size_t>(message.getSenderId()), [this, message = Message(message)] {
+                broadcastMessage(message);
+            });
+        });
+        if (!m_cluster->start()) {
+            LOG_WARNING("Кластер не запущен, узел работает отдельно");
+            m_cluster.reset();
+        }
+    }
     
     m_running = true;
     m_serverThread = std::thread(&Server::serverLoop, this);
+    scheduleReaper();
     
-    std::cout << "Сервер запущен на порту " << m_port << std::endl;
-    return true;
+    if (!m_upgradePath.empty()) {
+        m_upgradeListener = UpgradeChannel::listen(m_upgradePath);
+        if (m_upgradeListener < 0) {
+            LOG_WARNING("Не удалось открыть управляющий сокет ", m_upgradePath, ": горячее обновление недоступно");
+        } else {
+            m_upgradeThread = std::thread(&Server::upgradeLoop, this);
+        }
+    }
+    
+    LOG_INFO("Сервер запущен на порту ", m_port, ", рабочих потоков: ", m_workers->threadCount());
 }
 
 void Server::stop() {
-    if (!m_running) {
-        return;
+    bool wasRunning = m_running.exchange(false);
+    
+    // Поток управляющего сокета будится каналом; если он сейчас передает
+    // соединения, дожидаемся окончания передачи
+    wakeWaiters();
+    if (m_upgradeThread.joinable() && m_upgradeThread.get_id() != std::this_thread::get_id()) {
+        m_upgradeThread.join();
     }
+    UpgradeChannel::closeListener(m_upgradeListener, m_upgradePath);
+    m_upgradeListener = -1;
     
-    m_running = false;
+    if (!wasRunning) {
+        return;
+    }
     
-    // Закрытие сокета сервера
+    // Закрытие сокета сервера; shutdown будит поток, заблокированный в accept
     if (m_serverSocket != INVALID_SOCKET) {
-#ifdef _WIN32
-        closesocket(m_serverSocket);
-#else
-        close(m_serverSocket);
-#endif
+        shutdown(m_serverSocket, SHUTDOWN_BOTH);
+        closeSocket(m_serverSocket);
         m_serverSocket = INVALID_SOCKET;
     }
+    for (auto& listener : m_listeners) {
+        shutdown(listener.socket, SHUTDOWN_BOTH);
+    }
     
     // Ожидание завершения потока сервера
     if (m_serverThread.joinable()) {
         m_serverThread.join();
     }
+    closeListeners(true);
     
-    // Закрытие всех клиентских сокетов
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    for (auto& client : m_clients) {
-#ifdef _WIN32
-        closesocket(client.second);
-#else
-        close(client.second);
-#endif
+    // Другие узлы перестают пересылать сюда сообщения и забывают наших пользователей
+    if (m_cluster) {
+        m_cluster->stop();
     }
-    m_clients.clear();
     
-    // Ожидание завершения всех клиентских потоков
-    for (auto& thread : m_clientThreads) {
-        if (thread.joinable()) {
-            thread.join();
-        }
+    // Таймеры больше не трогают соединения, которые сейчас будут остановлены
+    m_timers.stop();
+    
+    // Остановка всех клиентских подключений
+    std::map<int, std::shared_ptr<ClientHandler>> clients;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        clients.swap(m_clients);
+    }
+    for (auto& client : clients) {
+        client.second->stop();
+    }
+    
+    // Рабочие потоки дорабатывают очередь; отправка остановленным клиентам просто не удается
+    if (m_authPool) {
+        m_authPool->stop();
+    }
+    if (m_workers) {
+        m_workers->stop();
+    }
+    clients.clear();
+    reapFinishedClients();
+    
+    // Следующий запуск отобразит снимок и не будет воспроизводить журнал
+    if (m_userStore.isPersistent()) {
+        m_userStore.compact();
+        m_userStore.close();
     }
-    m_clientThreads.clear();
     
-    std::cout << "Сервер остановлен" << std::endl;
+    LOG_INFO("Сервер остановлен");
 }
 
 size_t Server::getClientCount() const {
@@ -105,157 +542,1545 @@ size_t Server::getClientCount() const {
     return m_clients.size();
 }
 
-bool Server::sendMessage(int clientId, const Message& message) {
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    auto it = m_clients.find(clientId);
-    if (it == m_clients.end()) {
-        return false;
-    }
-    
-    std::string serializedMessage = message.serialize();
-    int result = send(it->second, serializedMessage.c_str(), serializedMessage.length(), 0);
-    return result != SOCKET_ERROR;
+void Server::setConnectionRateLimits(const RateLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    ServerConfig updated = *config();
+    updated.connectionLimits = limits;
+    publishConfig(updated);
 }
 
-void Server::broadcastMessage(const Message& message) {
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    std::string serializedMessage = message.serialize();
-    
-    for (auto& client : m_clients) {
-        send(client.second, serializedMessage.c_str(), serializedMessage.length(), 0);
-    }
+void Server::setUserRateLimits(const RateLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    ServerConfig updated = *config();
+    updated.userLimits = limits;
+    publishConfig(updated);
+    m_userLimiter->setLimits(limits);
 }
 
-int Server::registerUser(const User& user) {
-    int userId = m_nextUserId++;
-    auto newUser = std::make_shared<User>(user);
-    newUser->setId(userId);
-    m_users[userId] = newUser;
-    return userId;
+void Server::setOverloadLimits(const OverloadLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    ServerConfig updated = *config();
+    updated.overload = limits;
+    publishConfig(updated);
 }
 
-int Server::authenticateUser(const std::string& username, const std::string& password) {
-    // Простая аутентификация (в реальном приложении нужно использовать хеширование)
-    for (auto& user : m_users) {
-        if (user.second->getUsername() == username) {
-            // В реальном приложении здесь должна быть проверка хеша пароля
-            return user.first;
+void Server::setTimeouts(const TimeoutSettings& timeouts) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    ServerConfig updated = *config();
+    updated.timeouts = timeouts;
+    publishConfig(updated);
+}
+
+void Server::setAuthLimits(const AuthLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    ServerConfig updated = *config();
+    updated.authLimits = limits;
+    publishConfig(updated);
+}
+
+void Server::applyConfig(const ServerConfig& config) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    std::shared_ptr<const ServerConfig> current = this->config();
+    ServerConfig updated = config;
+    std::vector<std::string> restart = current->restartRequired(config);
+    if (!restart.empty()) {
+        std::string keys;
+        for (const auto& key : restart) {
+            keys += (keys.empty() ? "" : ", ") + key;
         }
+        LOG_WARNING("Параметры ", keys, " вступят в силу после перезапуска сервера");
+        updated.port = current->port;
+        updated.workerThreads = current->workerThreads;
+        updated.workerQueueSize = current->workerQueueSize;
+        updated.workerCpus = current->workerCpus;
+        updated.socket.listenBacklog = current->socket.listenBacklog;
+        updated.socket.reuseAddress = current->socket.reuseAddress;
+        updated.authLimits = current->authLimits;
     }
-    return -1;
+    const RateLimits& before = current->userLimits;
+    const RateLimits& after = updated.userLimits;
+    bool userLimitsChanged = before.messagesPerSecond != after.messagesPerSecond ||
+                             before.messageBurst != after.messageBurst ||
+                             before.bytesPerSecond != after.bytesPerSecond ||
+                             before.byteBurst != after.byteBurst;
+    publishConfig(updated);
+    if (userLimitsChanged) {
+        m_userLimiter->setLimits(updated.userLimits);
+    }
+    LOG_INFO("Настройки сервера обновлены");
 }
 
-std::shared_ptr<User> Server::getUser(int userId) {
-    auto it = m_users.find(userId);
-    if (it != m_users.end()) {
-        return it->second;
-    }
-    return nullptr;
+ServerConfig Server::getConfig() const {
+    return *config();
 }
 
-void Server::setMessageHandler(std::function<void(int, const Message&)> handler) {
-    m_messageHandler = handler;
+void Server::publishConfig(const ServerConfig& config) {
+    std::atomic_store(&m_config, std::make_shared<const ServerConfig>(config));
 }
 
-void Server::serverLoop() {
-    while (m_running) {
-        sockaddr_in clientAddr{};
-        int clientAddrLen = sizeof(clientAddr);
-        
-        socket_t clientSocket = accept(m_serverSocket, (sockaddr*)&clientAddr, &clientAddrLen);
-        if (clientSocket == INVALID_SOCKET) {
-            if (m_running) {
-                std::cerr << "Ошибка принятия подключения" << std::endl;
-            }
+void Server::setPasswordVerifier(AuthPool::Verifier verifier) {
+    m_passwordVerifier = std::move(verifier);
+}
+
+bool Server::addListenAddress(const std::string& address) {
+    Endpoint endpoint;
+    // Клиенты разделяемой памяти подключаются к обычному Unix-сокету
+    if (!Endpoint::parse(address, m_port, endpoint) || endpoint.scheme == Endpoint::Scheme::SHM) {
+        return false;
+    }
+    m_listenEndpoints.push_back(endpoint);
+    return true;
+}
+
+bool Server::openListeners() {
+    for (const auto& endpoint : m_listenEndpoints) {
+        std::string address = endpoint.toString();
+        bool opened = std::any_of(m_listeners.begin(), m_listeners.end(), [&](const Listener& listener) {
+            return listener.endpoint.toString() == address;
+        });
+        if (opened) {
             continue;
         }
-        
-        std::cout << "Новое подключение от " << inet_ntoa(clientAddr.sin_addr) << std::endl;
-        
-        // Создание нового потока для обработки клиента
-        int clientId = m_nextClientId++;
-        {
-            std::lock_guard<std::mutex> lock(m_clientsMutex);
-            m_clients[clientId] = clientSocket;
+        socket_t socket = openListener(endpoint, config()->socket);
+        if (socket == INVALID_SOCKET) {
+            return false;
         }
-        
-        m_clientThreads.emplace_back(&Server::handleClient, this, clientSocket);
+        m_listeners.push_back(Listener{endpoint, socket});
+        LOG_INFO("Прием подключений на ", address);
     }
+    return true;
 }
 
-void Server::handleClient(socket_t clientSocket) {
-    char buffer[1024];
-    int clientId = -1;
-    
-    // Находим ID клиента по сокету
-    {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        for (auto& client : m_clients) {
-            if (client.second == clientSocket) {
-                clientId = client.first;
-                break;
-            }
+void Server::closeListeners(bool removeFiles) {
+    for (auto& listener : m_listeners) {
+        closeSocket(listener.socket);
+#ifndef _WIN32
+        if (removeFiles && listener.endpoint.scheme == Endpoint::Scheme::UNIX) {
+            unlink(listener.endpoint.path.c_str());
         }
+#endif
     }
-    
-    if (clientId == -1) {
-        return;
+    m_listeners.clear();
+}
+
+void Server::setDataDirectory(const std::string& directory) {
+    m_dataDirectory = directory;
+}
+
+void Server::setCluster(const ClusterSettings& settings) {
+    m_clusterSettings = settings;
+    m_userStore.setIdAllocation(settings.nodeId, settings.nodeId != 0 ? Cluster::MAX_NODES : 1);
+}
+
+bool Server::isOverloaded() const {
+    if (m_workers && m_workers->queueDepth() > config()->overload.maxWorkerQueueDepth) {
+        return true;
+    }
+    return m_outboundStats.queuedBytes() > config()->overload.maxSendBacklogBytes;
+}
+
+ServerStats Server::getStats() const {
+    ServerStats stats;
+    stats.rejectedConnections = m_rejectedConnections.load();
+    stats.rateLimitedMessages = m_rateLimitedMessages.load();
+    stats.shedMessages = m_shedMessages.load();
+    stats.rejectedLogins = m_rejectedLogins.load();
+    stats.failedLogins = m_failedLogins.load();
+    stats.outboundQueuedBytes = m_outboundStats.queuedBytes();
+    for (size_t i = 0; i < OutboundQueue::PRIORITY_COUNT; ++i) {
+        stats.outboundLatency[i] = m_outboundStats.snapshot(static_cast<OutboundQueue::Priority>(i));
+    }
+    return stats;
+}
+
+bool Server::sendMessage(int clientId, const Message& message) {
+    std::shared_ptr<ClientHandler> client;
+    {
+        std::unique_lock<std::mutex> lock(m_clientsMutex, std::defer_lock);
+        {
+            TRACE_SCOPE("Server::clientsMutex wait");
+            lock.lock();
+        }
+        auto it = m_clients.find(clientId);
+        if (it == m_clients.end()) {
+            return false;
+        }
+        client = it->second;
     }
     
-    while (m_running) {
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived <= 0) {
-            break;
+    // Номер сессии и отметку времени отправки сообщение получает при записи
+    return client->sendMessage(message);
+}
+
+void Server::broadcastMessage(const Message& message) {
+    // Отправка идет вне мьютекса: медленный получатель не блокирует остальные потоки
+    std::vector<std::shared_ptr<ClientHandler>> clients;
+    {
+        std::unique_lock<std::mutex> lock(m_clientsMutex, std::defer_lock);
+        {
+            TRACE_SCOPE("Server::clientsMutex wait");
+            lock.lock();
         }
-        
-        buffer[bytesReceived] = '\0';
-        std::string messageData(buffer);
-        
-        Message message;
-        if (message.deserialize(messageData)) {
-            processMessage(clientId, message);
+        clients.reserve(m_clients.size());
+        for (auto& client : m_clients) {
+            clients.push_back(client.second);
         }
     }
     
-    // Удаление клиента при отключении
+    Message outgoing(message);
+    outgoing.setServerSendNs(Message::currentTimeNs());
+    
+    std::string serializedMessage;
     {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        m_clients.erase(clientId);
+        TRACE_SCOPE("Message::serialize");
+        serializedMessage = outgoing.serialize();
     }
     
-#ifdef _WIN32
-    closesocket(clientSocket);
-#else
-    close(clientSocket);
-#endif
+    // Общий кадр уходит соединениям без надежной доставки; остальным
+    // сообщение нумеруется в их сессии
+    OutboundQueue::Priority priority = OutboundQueue::classify(message);
+    for (auto& client : clients) {
+        if (client->getChannel()) {
+            client->sendMessage(message);
+        } else {
+            client->sendFrame(serializedMessage, priority);
+        }
+    }
 }
 
-void Server::processMessage(int clientId, const Message& message) {
-    if (m_messageHandler) {
-        m_messageHandler(clientId, message);
+int Server::registerUser(const User& user) {
+    int userId = m_userStore.addUser(user.getUsername(), user.getEmail());
+    if (userId == -1) {
+        return -1;
+    }
+    auto newUser = std::make_shared<User>(user);
+    newUser->setId(userId);
+    std::lock_guard<std::mutex> lock(m_usersMutex);
+    m_users[userId] = newUser;
+    return userId;
+}
+
+int Server::authenticateUser(const std::string& username, const std::string& password) {
+    // Синхронная проверка для вызывающих вне сетевого пути; вход клиентов
+    // проверяется асинхронно пулом проверки паролей
+    int userId = m_userStore.findUserId(username);
+    if (userId != -1 && m_passwordVerifier && !m_passwordVerifier(username, password)) {
+        return -1;
+    }
+    return userId;
+}
+
+std::shared_ptr<User> Server::getUser(int userId) {
+    {
+        std::lock_guard<std::mutex> lock(m_usersMutex);
+        auto it = m_users.find(userId);
+        if (it != m_users.end()) {
+            return it->second;
+        }
     }
     
-    // Обработка различных типов сообщений
-    switch (message.getType()) {
-        case Message::Type::LOGIN: {
-            // Обработка входа в систему
-            break;
+    // Пользователь из снимка загружается при первом обращении
+    UserStore::UserRecord record;
+    if (!m_userStore.findUser(userId, record)) {
+        return nullptr;
+    }
+    auto user = std::make_shared<User>(record.id, record.username, record.email);
+    for (int contactId : m_userStore.getContacts(userId)) {
+        user->addContact(contactId);
+    }
+    std::lock_guard<std::mutex> lock(m_usersMutex);
+    return m_users.emplace(userId, user).first->second;
+}
+
+bool Server::addContact(int userId, int contactId) {
+    if (!m_userStore.addContact(userId, contactId)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_usersMutex);
+        auto it = m_users.find(userId);
+        if (it != m_users.end()) {
+            it->second->addContact(contactId);
+        }
+    }
+    
+    // Вошедший пользователь сразу узнает состояние нового контакта
+    // и получает его дальнейшие изменения
+    std::map<int, PresenceUpdate> updates;
+    {
+        std::lock_guard<std::mutex> lock(m_presenceMutex);
+        auto watching = m_watching.find(userId);
+        if (watching == m_watching.end()) {
+            return true;
+        }
+        auto& contacts = watching->second;
+        if (std::find(contacts.begin(), contacts.end(), contactId) == contacts.end()) {
+            contacts.push_back(contactId);
+            m_watchers[contactId].push_back(userId);
+        }
+        bool online = m_online.test(contactId) || (m_cluster && m_cluster->findUserNode(contactId) != -1);
+        updates[userId].contacts.emplace_back(contactId, online);
+    }
+    sendPresence(updates);
+    return true;
+}
+
+bool Server::removeContact(int userId, int contactId) {
+    if (!m_userStore.removeContact(userId, contactId)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_usersMutex);
+        auto it = m_users.find(userId);
+        if (it != m_users.end()) {
+            it->second->removeContact(contactId);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    auto watching = m_watching.find(userId);
+    if (watching == m_watching.end()) {
+        return true;
+    }
+    auto& contacts = watching->second;
+    contacts.erase(std::remove(contacts.begin(), contacts.end(), contactId), contacts.end());
+    auto watchers = m_watchers.find(contactId);
+    if (watchers != m_watchers.end()) {
+        watchers->second.erase(std::remove(watchers->second.begin(), watchers->second.end(), userId),
+                               watchers->second.end());
+        if (watchers->second.empty()) {
+            m_watchers.erase(watchers);
         }
-        case Message::Type::LOGOUT: {
-            // Обработка выхода из системы
+    }
+    return true;
+}
+
+std::vector<int> Server::getContacts(int userId) const {
+    return m_userStore.getContacts(userId);
+}
+
+void Server::setMessageHandler(std::function<void(int, const Message&)> handler) {
+    m_messageHandler = handler;
+}
+
+void Server::serverLoop() {
+    TRACE_THREAD_NAME("server-accept");
+    while (m_running) {
+        socket_t listener = m_serverSocket;
+#ifndef _WIN32
+        // При горячем обновлении слушающий сокет нельзя закрыть или shutdown:
+        // он уходит новому процессу, поэтому поток будится каналом
+        if (m_wakePipe[0] >= 0 || !m_listeners.empty()) {
+            // Канал пробуждения последним; poll пропускает отрицательный дескриптор
+            std::vector<pollfd> fds;
+            fds.push_back({m_serverSocket, POLLIN, 0});
+            for (auto& extra : m_listeners) {
+                fds.push_back({extra.socket, POLLIN, 0});
+            }
+            fds.push_back({m_wakePipe[0], POLLIN, 0});
+            poll(fds.data(), fds.size(), -1);
+            if (m_handingOff || !m_running) {
+                break;
+            }
+            auto ready = std::find_if(fds.begin(), fds.end() - 1, [](const pollfd& fd) {
+                return (fd.revents & POLLIN) != 0;
+            });
+            if (ready == fds.end() - 1) {
+                continue;
+            }
+            listener = ready->fd;
+        }
+#endif
+        socket_t clientSocket = accept(listener, nullptr, nullptr);
+        if (clientSocket == INVALID_SOCKET) {
+            if (m_running) {
+                LOG_ERROR("Ошибка принятия подключения");
+            }
+            continue;
+        }
+        
+        reapFinishedClients();
+        
+        // Контроль допуска: при перегрузке новые подключения отклоняются сразу,
+        // не занимая поток и место в m_clients
+        if (isOverloaded() || getClientCount() >= config()->overload.maxConnections) {
+            m_rejectedConnections.fetch_add(1, std::memory_order_relaxed);
+            LOG_WARNING("Подключение от ", peerAddress(clientSocket), " отклонено: сервер перегружен");
+            std::string frame = Message(Message::Type::ERROR, "Сервер перегружен, повторите позже", -1).serialize();
+            send(clientSocket, frame.c_str(), static_cast<int>(frame.length()), SEND_FLAGS);
+            closeSocket(clientSocket);
+            continue;
+        }
+        
+        LOG_INFO("Новое подключение от ", peerAddress(clientSocket));
+        handleClient(clientSocket);
+    }
+}
+
+void Server::handleClient(socket_t clientSocket) {
+    ConnectionState state;
+    state.clientId = m_nextClientId++;
+    attachClient(clientSocket, state);
+}
+
+int Server::attachConnection(std::unique_ptr<Transport> transport, const std::string& peerAddress) {
+    if (!m_running || m_handingOff) {
+        return -1;
+    }
+    reapFinishedClients();
+    if (isOverloaded() || getClientCount() >= config()->overload.maxConnections) {
+        m_rejectedConnections.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    
+    ConnectionState state;
+    state.clientId = m_nextClientId++;
+    auto client = std::make_shared<ClientHandler>(std::move(transport), state.clientId, config()->connectionLimits);
+    client->setCpuAffinity(config()->ioCpus);
+    attachClient(client, peerAddress, state);
+    return state.clientId;
+}
+
+void Server::attachClient(socket_t clientSocket, const ConnectionState& state) {
+    std::shared_ptr<const ServerConfig> config = this->config();
+    setSendTimeout(clientSocket, config->timeouts.idleTimeout);
+    applySocketOptions(clientSocket, config->socket);
+    auto client = std::make_shared<ClientHandler>(clientSocket, state.clientId, config->connectionLimits);
+    client->setCpuAffinity(connectionCpus(clientSocket));
+    attachClient(client, peerAddress(clientSocket), state);
+}
+
+std::vector<int> Server::connectionCpus(socket_t clientSocket) const {
+    std::shared_ptr<const ServerConfig> config = this->config();
+    const std::vector<int>& cpus = config->ioCpus;
+    if (cpus.empty() || m_topology.nodeCount() < 2) {
+        return cpus;
+    }
+    // Поток чтения работает на узле, где ядро принимает пакеты соединения:
+    // данные из сокета и буферы чтения не пересекают межузловую шину
+    int cpu = incomingCpu(clientSocket);
+    std::vector<int> local = m_topology.cpusOnNode(cpus, m_topology.nodeOf(cpu));
+    if (local.empty()) {
+        return cpus;
+    }
+    LOG_DEBUG("Соединение принято на процессоре ", cpu, ", узел ", m_topology.nodeOf(cpu));
+    return local;
+}
+
+void Server::attachClient(std::shared_ptr<ClientHandler> client, const std::string& peer, const ConnectionState& state) {
+    int clientId = state.clientId;
+    ClientHandler* handler = client.get();
+    client->setPeerAddress(peer);
+    client->setOutboundStats(&m_outboundStats);
+    client->setReceiveBufferSize(config()->receiveBufferBytes);
+    
+    // Обработчики вызываются из потока соединения, пока объект жив
+    client->setMessageHandler([this, handler](int, const Message& message) {
+        onClientMessage(*handler, message);
+    });
+    client->setRateLimitHandler([this, handler](int, size_t) {
+        m_rateLimitedMessages.fetch_add(1, std::memory_order_relaxed);
+        rejectMessage(*handler, "Превышено ограничение скорости подключения");
+    });
+    client->setDisconnectHandler([this](int id) {
+        removeClient(id);
+    });
+    if (m_wakePipe[0] >= 0) {
+        client->setDetachSignal(m_wakePipe[0], &m_handingOff);
+    }
+    client->setPendingInput(state.pendingInput);
+    
+    // Соединение, переданное предыдущим процессом, сохраняет вход пользователя
+    auto user = state.userId != -1 ? getUser(state.userId) : nullptr;
+    if (user) {
+        user->setStatus(User::Status::ONLINE);
+        client->setUser(user);
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            m_userClients[user->getId()] = clientId;
+            m_online.set(user->getId(), true);
+        }
+        publishPresence(user->getId(), true);
+    }
+    
+    // Таймеры держат слабые ссылки и не продлевают жизнь соединения
+    std::weak_ptr<ClientHandler> weak = client;
+    if (!user) {
+        client->setLoginTimer(m_timers.schedule(config()->timeouts.loginTimeout, [this, weak] {
+            enforceLoginDeadline(weak);
+        }));
+    }
+    m_timers.schedule(config()->timeouts.heartbeatInterval, [this, weak] {
+        checkConnection(weak);
+    });
+    
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients[clientId] = client;
+    }
+    client->start();
+}
+
+void Server::onClientMessage(ClientHandler& handler, const Message& message) {
+    auto channel = handler.getChannel();
+    if (channel) {
+        // Повтор после переподключения уже был принят
+        if (!channel->accept(message)) {
+            return;
+        }
+        if (ReliableChannel::isSequenced(message.getType())) {
+            scheduleAck(handler, *channel);
+        }
+    }
+    
+    // PONG нужен только для отметки активности, она уже сделана при приеме;
+    // подтверждение из ACK уже учтено каналом
+    if (message.getType() == Message::Type::PONG || message.getType() == Message::Type::ACK) {
+        return;
+    }
+    
+    auto user = handler.getUser();
+    if (user && !m_userLimiter->tryConsume(user->getId(), message.getContent().size(),
+                                           message.getServerReceiveNs())) {
+        m_rateLimitedMessages.fetch_add(1, std::memory_order_relaxed);
+        rejectMessage(handler, "Превышено ограничение скорости пользователя");
+        return;
+    }
+    
+    if (isExpensive(message) && isOverloaded()) {
+        m_shedMessages.fetch_add(1, std::memory_order_relaxed);
+        rejectMessage(handler, "Сервер перегружен, сообщение отклонено");
+        return;
+    }
+    
+    // Копия захватывается не константной: задача с переносимым сообщением
+    // помещается во встроенный буфер очереди без обращения к куче
+    int clientId = handler.getClientId();
+    bool queued = m_workers->submit(static_cast<size_t>(clientId), [this, clientId, message = Message(message)] {
+        TRACE_SCOPE("Server::processMessage");
+        processMessage(clientId, message);
+    });
+    if (!queued) {
+        m_shedMessages.fetch_add(1, std::memory_order_relaxed);
+        rejectMessage(handler, "Сервер перегружен, сообщение отклонено");
+    }
+}
+
+void Server::rejectMessage(ClientHandler& handler, const std::string& reason) {
+    if (handler.shouldNotifyRejection(Message::currentTimeNs())) {
+        handler.sendMessage(Message(Message::Type::ERROR, reason, -1, handler.getClientId()));
+    }
+}
+
+void Server::removeClient(int clientId) {
+    std::shared_ptr<ClientHandler> client;
+    int offlineUserId = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        auto it = m_clients.find(clientId);
+        if (it == m_clients.end()) {
+            return;
+        }
+        client = it->second;
+        // Объект нельзя разрушать в его же потоке: освобождаем его позже
+        m_finishedClients.push_back(client);
+        m_clients.erase(it);
+        
+        auto user = client->getUser();
+        if (user) {
+            auto userIt = m_userClients.find(user->getId());
+            if (userIt != m_userClients.end() && userIt->second == clientId) {
+                m_userClients.erase(userIt);
+                m_online.set(user->getId(), false);
+                user->setStatus(User::Status::OFFLINE);
+                offlineUserId = user->getId();
+            }
+        }
+    }
+    if (offlineUserId != -1) {
+        publishPresence(offlineUserId, false);
+    }
+    m_timers.cancel(client->takeLoginTimer());
+    detachSession(*client);
+}
+
+void Server::reapFinishedClients() {
+    std::vector<std::shared_ptr<ClientHandler>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        finished.swap(m_finishedClients);
+    }
+    // Деструкторы дожидаются завершения потоков соединений (они уже закончились)
+}
+
+void Server::wakeWaiters() {
+#ifndef _WIN32
+    if (m_wakePipe[1] >= 0) {
+        char signal = 1;
+        if (write(m_wakePipe[1], &signal, 1) < 0) {
+            // Канал уже заполнен - потоки и так будут разбужены
+        }
+    }
+#endif
+}
+
+void Server::upgradeLoop() {
+#ifndef _WIN32
+    TRACE_THREAD_NAME("server-upgrade");
+    while (m_running) {
+        pollfd fds[2] = {{m_upgradeListener, POLLIN, 0}, {m_wakePipe[0], POLLIN, 0}};
+        poll(fds, 2, -1);
+        if (!m_running) {
             break;
         }
-        case Message::Type::TEXT: {
-            // Пересылка текстового сообщения
-            if (message.getReceiverId() != -1) {
-                sendMessage(message.getReceiverId(), message);
-            } else {
-                broadcastMessage(message);
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        
+        int channel = UpgradeChannel::accept(m_upgradeListener);
+        if (channel < 0) {
+            LOG_WARNING("Подключение к управляющему сокету отклонено");
+            continue;
+        }
+        // Путь освобождается сразу: новый процесс займет его для следующего обновления
+        UpgradeChannel::closeListener(m_upgradeListener, m_upgradePath);
+        m_upgradeListener = -1;
+        
+        handOff(channel);
+        UpgradeChannel::close(channel);
+        break;
+    }
+#endif
+}
+
+bool Server::handOff(int channel) {
+    LOG_INFO("Новый процесс подключился, передача соединений");
+    
+    // Флаг выставляется до пробуждения: проснувшиеся потоки чтения сразу
+    // видят запрос и отпускают сокеты, не закрывая их
+    m_handingOff = true;
+    wakeWaiters();
+    if (m_serverThread.joinable()) {
+        m_serverThread.join();
+    }
+    // Порт кластера освобождается для нового процесса; он подключится
+    // к узлам заново и отправит им снимок пользователей
+    if (m_cluster) {
+        m_cluster->stop();
+    }
+    m_timers.stop();
+    
+    std::map<int, std::shared_ptr<ClientHandler>> clients;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        clients = m_clients;
+    }
+    for (auto& client : clients) {
+        client.second->waitDetached();
+    }
+    // Ответы на уже принятые сообщения уходят до передачи,
+    // чтобы два процесса не писали в один сокет одновременно;
+    // начатые входы завершаются через рабочие потоки
+    m_authPool->stop();
+    m_workers->stop();
+    
+    UpgradeChannel::Record record;
+    record.type = UpgradeChannel::RecordType::LISTENER;
+    record.fd = static_cast<int>(m_serverSocket);
+    bool sent = UpgradeChannel::send(channel, record);
+    record.type = UpgradeChannel::RecordType::EXTRA_LISTENER;
+    for (auto& listener : m_listeners) {
+        record.payload = listener.endpoint.toString();
+        record.fd = static_cast<int>(listener.socket);
+        sent = sent && UpgradeChannel::send(channel, record);
+    }
+    record.fd = -1;
+    record.payload.clear();
+    
+    // Сохраняемый реестр новый процесс читает с диска, остальной передается записями
+    if (!m_userStore.isPersistent()) {
+        record.type = UpgradeChannel::RecordType::USER;
+        m_userStore.forEachUser([&](const UserStore::UserRecord& user) {
+            record.payload = std::to_string(user.id) + "|" + user.username + "|" + user.email;
+            sent = sent && UpgradeChannel::send(channel, record);
+        });
+    }
+    
+    size_t transferred = 0;
+    for (auto& client : clients) {
+        ConnectionState state;
+        state.clientId = client.first;
+        auto user = client.second->getUser();
+        state.userId = user ? user->getId() : -1;
+        socket_t socket = client.second->releaseSocket(state.pendingInput);
+        if (socket == INVALID_SOCKET) {
+            continue;
+        }
+        
+        record.type = UpgradeChannel::RecordType::CONNECTION;
+        record.payload = state.serialize();
+        record.fd = static_cast<int>(socket);
+        sent = sent && UpgradeChannel::send(channel, record);
+        if (sent) {
+            ++transferred;
+        }
+        // Копия сокета уже у нового процесса (или соединение теряется при сбое)
+        closeSocket(socket);
+    }
+    record.fd = -1;
+    
+    {
+        // Окна повтора не переносятся: неподтвержденное уходит как сохраненные
+        // сообщения (клиент может получить его повторно), сессии начнут нумерацию заново
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        record.type = UpgradeChannel::RecordType::OFFLINE_MESSAGE;
+        for (auto& session : m_reliableSessions) {
+            for (auto& message : session.second.channel->unacknowledged()) {
+                message.setSeq(0);
+                message.setAck(0);
+                record.payload = std::to_string(session.second.userId) + "|" + message.serialize();
+                sent = sent && UpgradeChannel::send(channel, record);
             }
+        }
+        m_reliableSessions.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_offlineMutex);
+        record.type = UpgradeChannel::RecordType::OFFLINE_MESSAGE;
+        for (auto& queue : m_offlineMessages) {
+            for (auto& entry : queue.second) {
+                record.payload = std::to_string(queue.first) + "|" + entry.message.serialize();
+                sent = sent && UpgradeChannel::send(channel, record);
+            }
+        }
+        m_offlineMessages.clear();
+    }
+    
+    // Токены, выданные этим процессом, остаются действительными в новом
+    record.type = UpgradeChannel::RecordType::SESSION_KEY;
+    record.payload = m_sessionTokens.getKey();
+    sent = sent && UpgradeChannel::send(channel, record);
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        record.type = UpgradeChannel::RecordType::REVOKED_SESSION;
+        for (auto& revoked : m_revokedSessions) {
+            record.payload = std::to_string(revoked.first) + "|" + std::to_string(revoked.second);
+            sent = sent && UpgradeChannel::send(channel, record);
+        }
+    }
+    
+    // Журнал сбрасывается на диск до конца передачи: новый процесс
+    // открывает хранилище сразу после записи END
+    m_userStore.close();
+    
+    record.type = UpgradeChannel::RecordType::END;
+    record.payload.clear();
+    sent = sent && UpgradeChannel::send(channel, record);
+    
+    closeSocket(m_serverSocket);
+    m_serverSocket = INVALID_SOCKET;
+    // Файлы Unix-сокетов теперь принадлежат новому процессу
+    closeListeners(false);
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients.clear();
+        m_userClients.clear();
+    }
+    clients.clear();
+    reapFinishedClients();
+    
+    m_handedOff = true;
+    m_running = false;
+    if (sent) {
+        LOG_INFO("Новому процессу передано соединений: ", transferred);
+    } else {
+        LOG_ERROR("Передача соединений прервана, непереданные соединения закрыты");
+    }
+    return sent;
+}
+
+void Server::restoreUser(const std::string& record) {
+    size_t first = record.find('|');
+    size_t second = first == std::string::npos ? std::string::npos : record.find('|', first + 1);
+    if (second == std::string::npos) {
+        return;
+    }
+    
+    UserStore::UserRecord user;
+    user.id = std::atoi(record.c_str());
+    user.username = record.substr(first + 1, second - first - 1);
+    user.email = record.substr(second + 1);
+    m_userStore.restoreUser(user);
+}
+
+void Server::scheduleReaper() {
+    m_timers.schedule(REAP_INTERVAL, [this] {
+        reapFinishedClients();
+        if (m_running) {
+            scheduleReaper();
+        }
+    });
+}
+
+std::shared_ptr<ClientHandler> Server::findClient(int clientId) const {
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    auto it = m_clients.find(clientId);
+    return it != m_clients.end() ? it->second : nullptr;
+}
+
+void Server::checkConnection(std::weak_ptr<ClientHandler> weak) {
+    auto client = weak.lock();
+    if (!client || !client->isActive() || !m_running) {
+        return;
+    }
+    
+    int clientId = client->getClientId();
+    auto idle = std::chrono::nanoseconds(Message::currentTimeNs() - client->getLastActivityNs());
+    if (idle >= config()->timeouts.idleTimeout) {
+        LOG_INFO("Клиент ", clientId, " не отвечает ",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(idle).count(),
+                 " мс, соединение закрыто");
+        client->disconnect();
+        return;
+    }
+    
+    std::chrono::milliseconds next;
+    if (idle >= config()->timeouts.heartbeatInterval) {
+        // Отправка может заблокироваться, поэтому выполняется рабочим потоком клиента
+        m_workers->submit(static_cast<size_t>(clientId), [client, clientId] {
+            client->sendMessage(Message(Message::Type::PING, "", -1, clientId));
+        });
+        next = std::min(config()->timeouts.heartbeatInterval,
+                        std::chrono::ceil<std::chrono::milliseconds>(config()->timeouts.idleTimeout - idle));
+    } else {
+        next = std::chrono::ceil<std::chrono::milliseconds>(config()->timeouts.heartbeatInterval - idle);
+    }
+    
+    m_timers.schedule(next, [this, weak] {
+        checkConnection(weak);
+    });
+}
+
+void Server::enforceLoginDeadline(std::weak_ptr<ClientHandler> weak) {
+    auto client = weak.lock();
+    if (!client || !client->isActive()) {
+        return;
+    }
+    // Таймер уже извлечен входом в систему
+    if (client->takeLoginTimer() == TimerWheel::INVALID_TIMER || client->getUser()) {
+        return;
+    }
+    
+    int clientId = client->getClientId();
+    LOG_INFO("Клиент ", clientId, " не выполнил вход вовремя, соединение закрыто");
+    bool queued = m_workers->submit(static_cast<size_t>(clientId), [client, clientId] {
+        client->sendMessage(Message(Message::Type::ERROR, "Время на вход истекло", -1, clientId));
+        client->disconnect();
+    });
+    if (!queued) {
+        client->disconnect();
+    }
+}
+
+void Server::handleLogin(int clientId, const Message& message) {
+    auto client = findClient(clientId);
+    if (!client) {
+        return;
+    }
+    
+    std::string_view content = message.getContent();
+    size_t separator = content.find(':');
+    std::string username(content.substr(0, separator));
+    std::string password(separator == std::string_view::npos ? std::string_view() : content.substr(separator + 1));
+    if (!User::isValidUsername(username)) {
+        client->sendMessage(Message(Message::Type::ERROR, "Некорректное имя пользователя", -1, clientId));
+        return;
+    }
+    
+    // Проверка пароля не занимает рабочий поток: результат возвращается
+    // в очередь этого клиента, поэтому порядок его сообщений сохраняется
+    auto result = m_authPool->submit(client->getPeerAddress(), username, password,
+        [this, clientId, username](bool verified) {
+            if (!m_workers->submit(static_cast<size_t>(clientId), [this, clientId, username, verified] {
+                    completeLogin(clientId, username, verified);
+                })) {
+                m_rejectedLogins.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    switch (result) {
+        case AuthPool::SubmitResult::QUEUED:
+            break;
+        case AuthPool::SubmitResult::CACHED:
+            completeLogin(clientId, username, true);
             break;
+        case AuthPool::SubmitResult::ADDRESS_LIMIT:
+            m_rejectedLogins.fetch_add(1, std::memory_order_relaxed);
+            client->sendMessage(Message(Message::Type::ERROR, "Слишком много одновременных входов с адреса", -1, clientId));
+            break;
+        case AuthPool::SubmitResult::QUEUE_FULL:
+            m_rejectedLogins.fetch_add(1, std::memory_order_relaxed);
+            client->sendMessage(Message(Message::Type::ERROR, "Сервер перегружен, повторите вход позже", -1, clientId));
+            break;
+    }
+}
+
+void Server::completeLogin(int clientId, const std::string& username, bool verified) {
+    auto client = findClient(clientId);
+    if (!client) {
+        return;
+    }
+    if (!verified) {
+        m_failedLogins.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARNING("Неверный пароль пользователя ", username, " с клиента ", clientId);
+        client->sendMessage(Message(Message::Type::ERROR, "Неверное имя пользователя или пароль", -1, clientId));
+        return;
+    }
+    
+    int userId = m_userStore.findUserId(username);
+    if (userId == -1) {
+        userId = registerUser(User(0, username, username + "@example.com"));
+        if (userId != -1) {
+            LOG_INFO("Зарегистрирован пользователь ", username, " (", userId, ")");
+        } else {
+            // Имя успел занять параллельный вход
+            userId = m_userStore.findUserId(username);
+        }
+    }
+    auto user = getUser(userId);
+    if (!user) {
+        client->sendMessage(Message(Message::Type::ERROR, "Не удалось зарегистрировать пользователя", -1, clientId));
+        return;
+    }
+    
+    // Токен позволяет переподключиться без повторной проверки пароля
+    SessionTokens::Session session;
+    std::string token = m_sessionTokens.issue(userId, username, config()->timeouts.sessionTtl, session);
+    client->sendMessage(Message(Message::Type::STATUS, "SESSION:" + token, -1, userId));
+    LOG_INFO("Пользователь ", username, " (", userId, ") вошел с клиента ", clientId);
+    attachUser(client, user, session, "LOGIN_OK:" + std::to_string(userId), false, 0);
+}
+
+void Server::handleResume(int clientId, const Message& message) {
+    auto client = findClient(clientId);
+    if (!client) {
+        return;
+    }
+    
+    SessionTokens::Session session;
+    bool valid = m_sessionTokens.verify(std::string(message.getContent()), session);
+    if (valid) {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        valid = m_revokedSessions.count(session.sessionId) == 0;
+    }
+    auto user = valid ? getUser(session.userId) : nullptr;
+    if (!user || user->getUsername() != session.username) {
+        client->sendMessage(Message(Message::Type::ERROR, "RESUME_FAILED: сессия недействительна, требуется вход", -1, clientId));
+        return;
+    }
+    
+    LOG_INFO("Пользователь ", user->getUsername(), " (", user->getId(), ") восстановил сессию с клиента ", clientId);
+    attachUser(client, user, session, "RESUME_OK:" + std::to_string(user->getId()), true, message.getAck());
+}
+
+void Server::attachUser(const std::shared_ptr<ClientHandler>& client, const std::shared_ptr<User>& user,
+                        const SessionTokens::Session& session, const std::string& reply,
+                        bool resumed, uint64_t peerAck) {
+    int clientId = client->getClientId();
+    int userId = user->getId();
+    user->setStatus(User::Status::ONLINE);
+    
+    // Повторный вход на том же соединении начинает новую сессию
+    detachSession(*client);
+    
+    auto previous = client->getUser();
+    client->setUser(user);
+    client->setSession(session.sessionId, session.expiresMs);
+    m_timers.cancel(client->takeLoginTimer());
+    bool previousLeft = false;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        if (previous && previous->getId() != userId) {
+            auto it = m_userClients.find(previous->getId());
+            if (it != m_userClients.end() && it->second == clientId) {
+                m_userClients.erase(it);
+                m_online.set(previous->getId(), false);
+                previousLeft = true;
+            }
+        }
+        m_userClients[userId] = clientId;
+        m_online.set(userId, true);
+    }
+    if (previousLeft) {
+        publishPresence(previous->getId(), false);
+    }
+    publishPresence(userId, true);
+    
+    if (resumed) {
+        resumeDelivery(client, session, userId, peerAck, reply);
+    } else {
+        auto channel = std::make_shared<ReliableChannel>();
+        {
+            std::lock_guard<std::mutex> lock(m_sessionsMutex);
+            m_reliableSessions[session.sessionId] = ReliableSession{userId, clientId, channel, TimerWheel::INVALID_TIMER};
+        }
+        client->setChannel(channel);
+        client->sendMessage(Message(Message::Type::STATUS, reply, -1, userId));
+    }
+    sendPresenceSnapshot(client, userId);
+    deliverOfflineMessages(userId, clientId);
+}
+
+void Server::resumeDelivery(const std::shared_ptr<ClientHandler>& client, const SessionTokens::Session& session,
+                            int userId, uint64_t peerAck, const std::string& reply) {
+    int clientId = client->getClientId();
+    std::shared_ptr<ReliableChannel> channel;
+    int previousClient = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_reliableSessions.find(session.sessionId);
+        if (it != m_reliableSessions.end() && it->second.userId == userId) {
+            channel = it->second.channel;
+            m_timers.cancel(it->second.expiry);
+            it->second.expiry = TimerWheel::INVALID_TIMER;
+            previousClient = it->second.clientId;
+            it->second.clientId = clientId;
+        }
+    }
+    
+    if (!channel) {
+        // Состояние потеряно (перезапуск, срок хранения): нумерация начинается заново
+        channel = std::make_shared<ReliableChannel>();
+        {
+            std::lock_guard<std::mutex> lock(m_sessionsMutex);
+            m_reliableSessions[session.sessionId] = ReliableSession{userId, clientId, channel, TimerWheel::INVALID_TIMER};
+        }
+        client->resumeChannel(channel, 0, Message(Message::Type::STATUS, reply + ":RESET", -1, userId));
+        return;
+    }
+    
+    // Старое соединение могло еще не заметить разрыв: оно больше не пишет в канал
+    if (previousClient != -1 && previousClient != clientId) {
+        auto old = findClient(previousClient);
+        if (old) {
+            old->setChannel(nullptr);
+            old->disconnect();
+        }
+    }
+    size_t replayed = client->resumeChannel(channel, peerAck, Message(Message::Type::STATUS, reply, -1, userId));
+    LOG_DEBUG("Клиенту ", clientId, " повторено неподтвержденных сообщений: ", replayed);
+}
+
+void Server::detachSession(ClientHandler& client) {
+    int64_t expiresMs = 0;
+    uint64_t sessionId = client.getSession(expiresMs);
+    if (sessionId == 0) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto it = m_reliableSessions.find(sessionId);
+    if (it == m_reliableSessions.end() || it->second.clientId != client.getClientId()) {
+        return;
+    }
+    // Неподтвержденные сообщения ждут переподключения с RESUME
+    it->second.clientId = -1;
+    it->second.expiry = m_timers.schedule(config()->timeouts.sessionRetention, [this, sessionId] {
+        expireSession(sessionId);
+    });
+}
+
+void Server::expireSession(uint64_t sessionId) {
+    ReliableSession expired;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_reliableSessions.find(sessionId);
+        if (it == m_reliableSessions.end() || it->second.clientId != -1) {
+            return;
+        }
+        expired = it->second;
+        m_timers.cancel(expired.expiry);
+        m_reliableSessions.erase(it);
+    }
+    
+    // Клиент не вернулся: неподтвержденное доставляется как обычное сообщение
+    std::vector<Message> pending = expired.channel->unacknowledged();
+    for (auto& message : pending) {
+        message.setSeq(0);
+        message.setAck(0);
+        deliverToUser(expired.userId, message);
+    }
+    if (!pending.empty()) {
+        LOG_INFO("Сессия пользователя ", expired.userId, " закрыта, неподтвержденных сообщений: ", pending.size());
+    }
+}
+
+void Server::scheduleAck(ClientHandler& handler, ReliableChannel& channel) {
+    if (channel.pendingAcks() >= ReliableChannel::ACK_BATCH_SIZE) {
+        handler.flushAck();
+        return;
+    }
+    if (!channel.armAckTimer()) {
+        return;
+    }
+    // Подтверждение ждет попутного кадра; если его нет, уходит отдельным ACK
+    std::weak_ptr<ClientHandler> weak = findClient(handler.getClientId());
+    std::weak_ptr<ReliableChannel> weakChannel = handler.getChannel();
+    m_timers.schedule(config()->timeouts.ackDelay, [weak, weakChannel] {
+        if (auto client = weak.lock()) {
+            client->flushAck();
+        } else if (auto channel = weakChannel.lock()) {
+            Message unused;
+            channel->takeAck(unused);
+        }
+    });
+}
+
+void Server::revokeSession(uint64_t sessionId, int64_t expiresMs) {
+    int64_t remainingMs = expiresMs - Message::currentTimeNs() / 1000000;
+    if (sessionId == 0 || remainingMs <= 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_revokedSessions[sessionId] = expiresMs;
+    }
+    // После истечения токен отклоняется и без записи об отзыве
+    m_timers.schedule(std::chrono::milliseconds(remainingMs), [this, sessionId] {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_revokedSessions.erase(sessionId);
+    });
+}
+
+void Server::handleLogout(int clientId) {
+    auto client = findClient(clientId);
+    if (!client) {
+        return;
+    }
+    auto user = client->getUser();
+    if (!user) {
+        return;
+    }
+    
+    bool left = false;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        auto it = m_userClients.find(user->getId());
+        if (it != m_userClients.end() && it->second == clientId) {
+            m_userClients.erase(it);
+            m_online.set(user->getId(), false);
+            left = true;
+        }
+    }
+    if (left) {
+        publishPresence(user->getId(), false);
+    }
+    user->setStatus(User::Status::OFFLINE);
+    client->setUser(nullptr);
+    int64_t expiresMs = 0;
+    uint64_t sessionId = client->getSession(expiresMs);
+    detachSession(*client);
+    expireSession(sessionId);
+    revokeSession(sessionId, expiresMs);
+    client->setChannel(nullptr);
+    client->setSession(0, 0);
+    LOG_INFO("Пользователь ", user->getUsername(), " (", user->getId(), ") вышел");
+}
+
+void Server::deliverToRecipients(const std::shared_ptr<ClientHandler>& sender, Message& message) {
+    std::vector<int> recipients = message.getRecipients();
+    if (recipients.empty()) {
+        recipients.push_back(message.getReceiverId());
+    }
+    std::sort(recipients.begin(), recipients.end());
+    recipients.erase(std::unique(recipients.begin(), recipients.end()), recipients.end());
+    size_t maxRecipients = config()->maxRecipients;
+    if (recipients.size() > maxRecipients) {
+        if (sender) {
+            sender->sendMessage(Message(Message::Type::ERROR, "Слишком много получателей: " +
+                std::to_string(recipients.size()) + " (не больше " + std::to_string(maxRecipients) + ")",
+                -1, sender->getClientId()));
+        }
+        return;
+    }
+    
+    // Получатели видят общий список; запрос отчета касается только отправителя
+    bool report = message.wantsDeliveryReport();
+    message.setDeliveryReport(false);
+    message.setRecipients(recipients);
+    
+    DeliveryReport result;
+    result.messageTimestampNs = message.getTimestampNs();
+    std::vector<int> local;
+    for (int userId : recipients) {
+        int nodeId = m_cluster ? routeNode(userId) : -1;
+        if (nodeId != -1 && m_cluster->forward(nodeId, userId, message)) {
+            result.recipients.emplace_back(userId, DeliveryReport::Status::FORWARDED);
+        } else {
+            local.push_back(userId);
+        }
+    }
+    
+    // Присутствие проверяется под тем же мьютексом, что и выдача сохраненных
+    // сообщений при входе (как в deliverLocally)
+    std::vector<std::pair<int, std::shared_ptr<ClientHandler>>> online;
+    {
+        std::lock_guard<std::mutex> offlineLock(m_offlineMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            for (int userId : local) {
+                auto user = m_userClients.find(userId);
+                auto client = user != m_userClients.end() ? m_clients.find(user->second) : m_clients.end();
+                if (client != m_clients.end()) {
+                    online.emplace_back(userId, client->second);
+                }
+            }
+        }
+        for (int userId : local) {
+            bool isOnline = std::any_of(online.begin(), online.end(), [userId](const auto& entry) {
+                return entry.first == userId;
+            });
+            if (!isOnline) {
+                result.recipients.emplace_back(userId, storeOffline(userId, message) ?
+                    DeliveryReport::Status::STORED : DeliveryReport::Status::NOT_FOUND);
+            }
+        }
+    }
+    
+    // Содержимое экранируется один раз; при записи каждое соединение
+    // добавляет к нему только заголовок со своими номером и подтверждением
+    std::shared_ptr<const std::string> content;
+    {
+        TRACE_SCOPE("Message::serialize");
+        content = std::make_shared<const std::string>(message.serializeContent());
+    }
+    for (auto& recipient : online) {
+        bool sent = recipient.second->sendMessage(Message(message), content);
+        if (!sent) {
+            std::lock_guard<std::mutex> lock(m_offlineMutex);
+            storeOffline(recipient.first, message);
+        }
+        result.recipients.emplace_back(recipient.first,
+            sent ? DeliveryReport::Status::QUEUED : DeliveryReport::Status::STORED);
+    }
+    
+    if (!sender) {
+        return;
+    }
+    std::sort(result.recipients.begin(), result.recipients.end());
+    if (report) {
+        sender->sendMessage(Message(Message::Type::STATUS, result.toContent(), -1, sender->getClientId()));
+        return;
+    }
+    std::string missing;
+    for (const auto& recipient : result.recipients) {
+        if (recipient.second == DeliveryReport::Status::NOT_FOUND) {
+            missing += (missing.empty() ? "" : ",") + std::to_string(recipient.first);
+        }
+    }
+    if (!missing.empty()) {
+        sender->sendMessage(Message(Message::Type::ERROR, "Получатели " + missing + " не найдены",
+                                    -1, sender->getClientId()));
+    }
+}
+
+bool Server::deliverToUser(int userId, const Message& message) {
+    if (m_cluster) {
+        int nodeId = routeNode(userId);
+        if (nodeId != -1 && m_cluster->forward(nodeId, userId, message)) {
+            return true;
+        }
+    }
+    return deliverLocally(userId, message);
+}
+
+int Server::routeNode(int userId) {
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        if (m_userClients.count(userId)) {
+            return -1;
+        }
+    }
+    int nodeId = m_cluster->findUserNode(userId);
+    if (nodeId != -1) {
+        return nodeId;
+    }
+    // Не в сети: сообщение хранит узел, где пользователь зарегистрирован
+    int homeNode = Cluster::homeNode(userId);
+    return homeNode != m_cluster->getNodeId() ? homeNode : -1;
+}
+
+void Server::publishPresence(int userId, bool online) {
+    if (m_cluster) {
+        m_cluster->publishPresence(userId, online);
+    }
+    updateWatcher(userId);
+    
+    // Изменения копятся в течение окна: частые входы и выходы одного
+    // пользователя дают наблюдателям не больше одного кадра за окно
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    m_presencePending.push_back(userId);
+    if (!m_presenceFlushScheduled) {
+        m_presenceFlushScheduled = true;
+        m_timers.schedule(config()->timeouts.presenceDelay, [this] {
+            flushPresence();
+        });
+    }
+}
+
+void Server::updateWatcher(int userId) {
+    std::vector<int> contacts;
+    if (m_online.test(userId)) {
+        contacts = m_userStore.getContacts(userId);
+    }
+    
+    std::lock_guard<std::mutex> lock(m_presenceMutex);
+    bool online = m_online.test(userId);
+    auto watching = m_watching.find(userId);
+    if (online == (watching != m_watching.end())) {
+        return;
+    }
+    if (online) {
+        for (int contactId : contacts) {
+            m_watchers[contactId].push_back(userId);
+        }
+        m_watching.emplace(userId, std::move(contacts));
+        return;
+    }
+    for (int contactId : watching->second) {
+        auto it = m_watchers.find(contactId);
+        if (it == m_watchers.end()) {
+            continue;
+        }
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), userId), it->second.end());
+        if (it->second.empty()) {
+            m_watchers.erase(it);
+        }
+    }
+    m_watching.erase(watching);
+}
+
+void Server::flushPresence() {
+    std::map<int, PresenceUpdate> updates;
+    {
+        std::lock_guard<std::mutex> lock(m_presenceMutex);
+        std::vector<int> pending;
+        pending.swap(m_presencePending);
+        m_presenceFlushScheduled = false;
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        
+        for (int userId : pending) {
+            bool online = m_online.test(userId);
+            if (!m_announced.set(userId, online)) {
+                continue;
+            }
+            auto watchers = m_watchers.find(userId);
+            if (watchers == m_watchers.end()) {
+                continue;
+            }
+            for (int watcherId : watchers->second) {
+                updates[watcherId].contacts.emplace_back(userId, online);
+            }
+        }
+    }
+    sendPresence(updates);
+}
+
+void Server::sendPresenceSnapshot(const std::shared_ptr<ClientHandler>& client, int userId) {
+    // Снимок читается из битовой карты без блокировок; контакты, вошедшие
+    // на других узлах, берутся из присутствия кластера
+    PresenceUpdate snapshot;
+    snapshot.snapshot = true;
+    for (int contactId : m_userStore.getContacts(userId)) {
+        bool online = m_online.test(contactId) || (m_cluster && m_cluster->findUserNode(contactId) != -1);
+        snapshot.contacts.emplace_back(contactId, online);
+    }
+    client->sendMessage(Message(Message::Type::STATUS, snapshot.toContent(), -1, userId));
+}
+
+void Server::sendPresence(const std::map<int, PresenceUpdate>& updates) {
+    if (updates.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::shared_ptr<ClientHandler>, std::map<int, PresenceUpdate>::const_iterator>> targets;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        for (auto update = updates.begin(); update != updates.end(); ++update) {
+            auto userClient = m_userClients.find(update->first);
+            if (userClient == m_userClients.end()) {
+                continue;
+            }
+            auto client = m_clients.find(userClient->second);
+            if (client != m_clients.end()) {
+                targets.emplace_back(client->second, update);
+            }
+        }
+    }
+    for (const auto& target : targets) {
+        target.first->sendMessage(Message(Message::Type::STATUS, target.second->second.toContent(), -1,
+                                          target.second->first));
+    }
+}
+
+bool Server::deliverLocally(int userId, const Message& message) {
+    int clientId = -1;
+    {
+        // Проверка присутствия и сохранение выполняются под одним мьютексом
+        // с выдачей при входе, поэтому сообщение не теряется между ними
+        std::lock_guard<std::mutex> offlineLock(m_offlineMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            auto it = m_userClients.find(userId);
+            if (it != m_userClients.end()) {
+                clientId = it->second;
+            }
+        }
+        
+        if (clientId == -1) {
+            return storeOffline(userId, message);
+        }
+    }
+    
+    if (sendMessage(clientId, message)) {
+        return true;
+    }
+    // Соединение закрылось или не подтверждает прием: сообщение ждет следующего входа
+    std::lock_guard<std::mutex> lock(m_offlineMutex);
+    return storeOffline(userId, message);
+}
+
+bool Server::storeOffline(int userId, const Message& message) {
+    if (!getUser(userId)) {
+        return false;
+    }
+    auto& queue = m_offlineMessages[userId];
+    if (!queue.empty() && queue.size() >= config()->timeouts.maxOfflineMessages) {
+        m_timers.cancel(queue.front().timer);
+        queue.pop_front();
+        LOG_WARNING("Очередь сообщений пользователя ", userId, " переполнена, старое сообщение удалено");
+    }
+    uint64_t messageId = m_nextOfflineId++;
+    TimerWheel::TimerId timer = m_timers.schedule(config()->timeouts.offlineMessageTtl, [this, userId, messageId] {
+        expireOfflineMessage(userId, messageId);
+    });
+    queue.push_back(OfflineMessage{messageId, message, timer});
+    return true;
+}
+
+void Server::deliverOfflineMessages(int userId, int clientId) {
+    std::deque<OfflineMessage> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_offlineMutex);
+        auto it = m_offlineMessages.find(userId);
+        if (it == m_offlineMessages.end()) {
+            return;
         }
+        pending.swap(it->second);
+        m_offlineMessages.erase(it);
+        for (auto& entry : pending) {
+            m_timers.cancel(entry.timer);
+        }
+    }
+    
+    for (auto& entry : pending) {
+        sendMessage(clientId, entry.message);
+    }
+    LOG_INFO("Пользователю ", userId, " доставлено сохраненных сообщений: ", pending.size());
+}
+
+void Server::expireOfflineMessage(int userId, uint64_t messageId) {
+    std::lock_guard<std::mutex> lock(m_offlineMutex);
+    auto it = m_offlineMessages.find(userId);
+    if (it == m_offlineMessages.end()) {
+        return;
+    }
+    auto& queue = it->second;
+    auto entry = std::find_if(queue.begin(), queue.end(), [messageId](const OfflineMessage& message) {
+        return message.id == messageId;
+    });
+    if (entry != queue.end()) {
+        queue.erase(entry);
+        LOG_DEBUG("Срок хранения сообщения для пользователя ", userId, " истек");
+    }
+    if (queue.empty()) {
+        m_offlineMessages.erase(it);
+    }
+}
+
+bool Server::isExpensive(const Message& message) {
+    switch (message.getType()) {
+        case Message::Type::FILE:
+            return true;
+        case Message::Type::TEXT:
+            return message.getReceiverId() == -1 || message.getRecipients().size() > 1;
         default:
-            break;
+            return false;
+    }
+}
+
+void Server::processMessage(int clientId, const Message& message) {
+    if (m_messageHandler) {
+        m_messageHandler(clientId, message);
+    }
+    
+    // Таблица обработчиков строится при компиляции; тип без обработчика
+    // и без упоминания в Ignored не соберется
+    struct Handlers {
+        using Ignored [[maybe_unused]] = IgnoredTypes<Message::Type::FILE, Message::Type::STATUS, Message::Type::ERROR,
+                                     Message::Type::PONG, Message::Type::ACK, Message::Type::SHM_ATTACH>;
+        
+        Server& server;
+        int clientId;
+        
+        void handle(MessageTag<Message::Type::LOGIN>, const Message& message) {
+            server.handleLogin(clientId, message);
+        }
+        void handle(MessageTag<Message::Type::LOGOUT>, const Message&) {
+            server.handleLogout(clientId);
+        }
+        void handle(MessageTag<Message::Type::RESUME>, const Message& message) {
+            server.handleResume(clientId, message);
+        }
+        void handle(MessageTag<Message::Type::TEXT>, const Message& message) {
+            server.handleText(clientId, message);
+        }
+        void handle(MessageTag<Message::Type::PING>, const Message&) {
+            server.sendMessage(clientId, Message(Message::Type::PONG, "", -1, clientId));
+        }
+    };
+    Handlers handlers{*this, clientId};
+    MessageDispatcher<Handlers>::dispatch(handlers, message);
+}
+
+void Server::handleText(int clientId, const Message& message) {
+    // Отправителем считается вошедший пользователь, а не заявленный в сообщении;
+    // номер и подтверждение относятся к сессии отправителя
+    Message outgoing(message);
+    outgoing.setSeq(0);
+    outgoing.setAck(0);
+    auto client = findClient(clientId);
+    auto user = client ? client->getUser() : nullptr;
+    if (user) {
+        outgoing.setSenderId(user->getId());
+    }
+    
+    // Список получателей разбирается одним проходом, кадр сериализуется один раз
+    if (!message.getRecipients().empty() || message.wantsDeliveryReport()) {
+        deliverToRecipients(client, outgoing);
+        return;
+    }
+    
+    // Пересылка текстового сообщения (получатель - ID пользователя)
+    if (message.getReceiverId() != -1) {
+        if (!deliverToUser(message.getReceiverId(), outgoing) && client) {
+            client->sendMessage(Message(Message::Type::ERROR, "Получатель " +
+                std::to_string(message.getReceiverId()) + " не найден", -1, clientId));
+        }
+    } else {
+        broadcastMessage(outgoing);
+        if (m_cluster) {
+            m_cluster->broadcast(outgoing);
+        }
     }
 }
 
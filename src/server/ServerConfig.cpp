@@ -0,0 +1,297 @@
+#include "server/ServerConfig.h"
+#include "common/Message.h"
+#include "server/CpuTopology.h"
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+namespace {
+
+using Setter = std::function<bool(ServerConfig&, const std::string&)>;
+
+/**
+ * @brief Параметр файла настроек
+ */
+struct Option {
+    std::string key;    ///< Ключ
+    Setter apply;       ///< Разбор значения в поле настроек
+};
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+/**
+ * @brief Неотрицательное целое с необязательным суффиксом K, M или G
+ */
+bool parseSize(const std::string& text, size_t& value) {
+    if (text.empty() || text[0] == '-') {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str() || errno == ERANGE) {
+        return false;
+    }
+    unsigned long long scale = 1;
+    switch (*end) {
+        case 'K': case 'k': scale = 1024ULL; ++end; break;
+        case 'M': case 'm': scale = 1024ULL * 1024; ++end; break;
+        case 'G': case 'g': scale = 1024ULL * 1024 * 1024; ++end; break;
+        default: break;
+    }
+    if (*end != '\0' || number > std::numeric_limits<size_t>::max() / scale) {
+        return false;
+    }
+    value = static_cast<size_t>(number * scale);
+    return true;
+}
+
+bool parseInt(const std::string& text, int& value) {
+    size_t size = 0;
+    if (!parseSize(text, size) || size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return false;
+    }
+    value = static_cast<int>(size);
+    return true;
+}
+
+bool parseDouble(const std::string& text, double& value) {
+    char* end = nullptr;
+    double number = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !(number >= 0)) {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+bool parseBool(const std::string& text, bool& value) {
+    if (text == "true" || text == "on" || text == "yes" || text == "1") {
+        value = true;
+    } else if (text == "false" || text == "off" || text == "no" || text == "0") {
+        value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseMilliseconds(const std::string& text, std::chrono::milliseconds& value) {
+    size_t count = 0;
+    if (!parseSize(text, count)) {
+        return false;
+    }
+    value = std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(count));
+    return true;
+}
+
+/**
+ * @brief Ключи ограничений скорости с общим префиксом
+ */
+void addRateOptions(std::vector<Option>& options, const char* prefix, RateLimits ServerConfig::* limits) {
+    std::string base = prefix;
+    options.push_back({base + "_messages_per_second", [limits](ServerConfig& c, const std::string& v) {
+        return parseDouble(v, (c.*limits).messagesPerSecond);
+    }});
+    options.push_back({base + "_message_burst", [limits](ServerConfig& c, const std::string& v) {
+        return parseDouble(v, (c.*limits).messageBurst);
+    }});
+    options.push_back({base + "_bytes_per_second", [limits](ServerConfig& c, const std::string& v) {
+        return parseDouble(v, (c.*limits).bytesPerSecond);
+    }});
+    options.push_back({base + "_byte_burst", [limits](ServerConfig& c, const std::string& v) {
+        return parseDouble(v, (c.*limits).byteBurst);
+    }});
+}
+
+std::vector<Option> buildOptions() {
+    std::vector<Option> options = {
+        {"port", [](ServerConfig& c, const std::string& v) {
+            return parseInt(v, c.port) && c.port > 0 && c.port < 65536;
+        }},
+        {"worker_threads", [](ServerConfig& c, const std::string& v) { return parseSize(v, c.workerThreads); }},
+        {"worker_queue_size", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.workerQueueSize) && c.workerQueueSize > 0;
+        }},
+        {"worker_cpus", [](ServerConfig& c, const std::string& v) {
+            return CpuTopology::parseCpuList(v, c.workerCpus);
+        }},
+        {"io_cpus", [](ServerConfig& c, const std::string& v) { return CpuTopology::parseCpuList(v, c.ioCpus); }},
+        {"receive_buffer", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.receiveBufferBytes) && c.receiveBufferBytes >= 256;
+        }},
+
+        {"max_recipients", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.maxRecipients) && c.maxRecipients > 0 && c.maxRecipients <= Message::MAX_RECIPIENTS;
+        }},
+
+        {"tcp_nodelay", [](ServerConfig& c, const std::string& v) { return parseBool(v, c.socket.noDelay); }},
+        {"so_sndbuf", [](ServerConfig& c, const std::string& v) { return parseInt(v, c.socket.sendBufferBytes); }},
+        {"so_rcvbuf", [](ServerConfig& c, const std::string& v) { return parseInt(v, c.socket.receiveBufferBytes); }},
+        {"listen_backlog", [](ServerConfig& c, const std::string& v) { return parseInt(v, c.socket.listenBacklog); }},
+        {"reuse_address", [](ServerConfig& c, const std::string& v) { return parseBool(v, c.socket.reuseAddress); }},
+        {"keepalive", [](ServerConfig& c, const std::string& v) { return parseBool(v, c.socket.keepAlive); }},
+        {"keepalive_idle", [](ServerConfig& c, const std::string& v) {
+            return parseInt(v, c.socket.keepAliveIdleSeconds);
+        }},
+        {"keepalive_interval", [](ServerConfig& c, const std::string& v) {
+            return parseInt(v, c.socket.keepAliveIntervalSeconds);
+        }},
+        {"keepalive_count", [](ServerConfig& c, const std::string& v) { return parseInt(v, c.socket.keepAliveCount); }},
+
+        {"max_connections", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.overload.maxConnections);
+        }},
+        {"max_worker_queue_depth", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.overload.maxWorkerQueueDepth);
+        }},
+        {"max_send_backlog", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.overload.maxSendBacklogBytes);
+        }},
+
+        {"heartbeat_interval_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.heartbeatInterval) && c.timeouts.heartbeatInterval.count() > 0;
+        }},
+        {"idle_timeout_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.idleTimeout) && c.timeouts.idleTimeout.count() > 0;
+        }},
+        {"login_timeout_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.loginTimeout);
+        }},
+        {"offline_message_ttl_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.offlineMessageTtl);
+        }},
+        {"max_offline_messages", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.timeouts.maxOfflineMessages);
+        }},
+        {"session_ttl_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.sessionTtl);
+        }},
+        {"session_retention_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.sessionRetention);
+        }},
+        {"ack_delay_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.ackDelay);
+        }},
+        {"presence_delay_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.timeouts.presenceDelay);
+        }},
+
+        {"auth_threads", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.authLimits.threadCount) && c.authLimits.threadCount > 0;
+        }},
+        {"auth_queue_size", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.authLimits.maxQueueSize);
+        }},
+        {"auth_pending_per_address", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.authLimits.maxPendingPerAddress);
+        }},
+        {"auth_cache_ttl_ms", [](ServerConfig& c, const std::string& v) {
+            return parseMilliseconds(v, c.authLimits.sessionCacheTtl);
+        }},
+        {"auth_cache_size", [](ServerConfig& c, const std::string& v) {
+            return parseSize(v, c.authLimits.maxCachedSessions);
+        }},
+    };
+    addRateOptions(options, "connection", &ServerConfig::connectionLimits);
+    addRateOptions(options, "user", &ServerConfig::userLimits);
+    return options;
+}
+
+const std::vector<Option>& options() {
+    static const std::vector<Option> table = buildOptions();
+    return table;
+}
+
+} // namespace
+
+bool ServerConfig::set(const std::string& key, const std::string& value, std::string& error) {
+    for (const auto& option : options()) {
+        if (key != option.key) {
+            continue;
+        }
+        // Значение, не прошедшее проверку, не должно остаться в настройках
+        ServerConfig updated = *this;
+        if (!option.apply(updated, value)) {
+            error = "неверное значение \"" + value + "\" параметра " + key;
+            return false;
+        }
+        *this = updated;
+        return true;
+    }
+    error = "неизвестный параметр " + key;
+    return false;
+}
+
+bool ServerConfig::set(const std::string& assignment, std::string& error) {
+    size_t separator = assignment.find('=');
+    if (separator == std::string::npos) {
+        error = "ожидается ключ=значение: " + assignment;
+        return false;
+    }
+    return set(trim(assignment.substr(0, separator)), trim(assignment.substr(separator + 1)), error);
+}
+
+bool ServerConfig::load(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "не удалось открыть " + path;
+        return false;
+    }
+
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        if (!set(line, error)) {
+            error = path + ":" + std::to_string(number) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> ServerConfig::restartRequired(const ServerConfig& other) const {
+    std::vector<std::string> keys;
+    if (port != other.port) {
+        keys.push_back("port");
+    }
+    if (workerThreads != other.workerThreads) {
+        keys.push_back("worker_threads");
+    }
+    if (workerQueueSize != other.workerQueueSize) {
+        keys.push_back("worker_queue_size");
+    }
+    if (workerCpus != other.workerCpus) {
+        keys.push_back("worker_cpus");
+    }
+    if (socket.listenBacklog != other.socket.listenBacklog) {
+        keys.push_back("listen_backlog");
+    }
+    if (socket.reuseAddress != other.socket.reuseAddress) {
+        keys.push_back("reuse_address");
+    }
+    if (authLimits.threadCount != other.authLimits.threadCount ||
+        authLimits.maxQueueSize != other.authLimits.maxQueueSize ||
+        authLimits.maxPendingPerAddress != other.authLimits.maxPendingPerAddress ||
+        authLimits.sessionCacheTtl != other.authLimits.sessionCacheTtl ||
+        authLimits.maxCachedSessions != other.authLimits.maxCachedSessions) {
+        keys.push_back("auth_*");
+    }
+    return keys;
+}
@@ -0,0 +1,83 @@
+#include "server/SessionTokens.h"
+#include "common/Message.h"
+#include "common/Sha256.h"
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const size_t KEY_SIZE = 32;
+const size_t SIGNATURE_SIZE = Sha256::DIGEST_SIZE * 2;
+
+/**
+ * @brief Сравнение за время, не зависящее от места расхождения
+ */
+bool constantTimeEquals(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    unsigned char difference = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return difference == 0;
+}
+
+} // namespace
+
+SessionTokens::SessionTokens() {
+    std::random_device random;
+    m_key.resize(KEY_SIZE);
+    for (char& byte : m_key) {
+        byte = static_cast<char>(random());
+    }
+}
+
+std::string SessionTokens::issue(int userId, const std::string& username, std::chrono::milliseconds ttl,
+                                 Session& session) const {
+    std::random_device random;
+    session.userId = userId;
+    session.username = username;
+    session.sessionId = (static_cast<uint64_t>(random()) << 32) | random();
+    session.expiresMs = Message::currentTimeNs() / 1000000 + ttl.count();
+
+    std::ostringstream body;
+    body << userId << "." << username << "." << session.expiresMs << "." << std::hex << session.sessionId;
+    return body.str() + "." + sign(body.str());
+}
+
+bool SessionTokens::verify(const std::string& token, Session& session) const {
+    size_t bodyEnd = token.rfind('.');
+    if (bodyEnd == std::string::npos || token.size() - bodyEnd - 1 != SIGNATURE_SIZE) {
+        return false;
+    }
+    std::string body = token.substr(0, bodyEnd);
+    if (!constantTimeEquals(sign(body), token.substr(bodyEnd + 1))) {
+        return false;
+    }
+
+    // Подпись верна, поэтому тело сформировано сервером и разбирается без лишних проверок
+    std::vector<std::string> fields;
+    std::istringstream input(body);
+    std::string field;
+    while (std::getline(input, field, '.')) {
+        fields.push_back(field);
+    }
+    if (fields.size() != 4) {
+        return false;
+    }
+    try {
+        session.userId = std::stoi(fields[0]);
+        session.username = fields[1];
+        session.expiresMs = std::stoll(fields[2]);
+        session.sessionId = std::stoull(fields[3], nullptr, 16);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return session.expiresMs > Message::currentTimeNs() / 1000000;
+}
+
+std::string SessionTokens::sign(const std::string& body) const {
+    return Sha256::toHex(Sha256::hmac(m_key, body));
+}
@@ -0,0 +1,221 @@
+#include "server/TimerWheel.h"
+#include "common/Trace.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick)
+    : m_tick(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+      m_origin(std::chrono::steady_clock::now()), m_currentTick(0),
+      m_freeHead(NIL), m_activeCount(0), m_running(false) {
+    for (auto& level : m_slots) {
+        for (auto& head : level) {
+            head = NIL;
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    stop();
+}
+
+void TimerWheel::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_thread = std::thread(&TimerWheel::run, this);
+}
+
+void TimerWheel::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, std::function<void()> callback) {
+    // Срок отсчитывается от текущего момента, а не от последнего обработанного
+    // тика, и округляется вверх: таймер никогда не срабатывает раньше срока
+    auto due = std::chrono::steady_clock::now() - m_origin + std::max(delay, std::chrono::milliseconds(0));
+    uint64_t dueTick = static_cast<uint64_t>((due + m_tick - std::chrono::nanoseconds(1)) / m_tick);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (m_freeHead != NIL) {
+        index = m_freeHead;
+        m_freeHead = m_nodes[index].next;
+    } else {
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    Node& node = m_nodes[index];
+    node.callback = std::move(callback);
+    node.expiryTick = std::max(dueTick, m_currentTick + 1);
+    node.active = true;
+    link(index);
+    ++m_activeCount;
+
+    return (static_cast<uint64_t>(node.generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    if (id == INVALID_TIMER) {
+        return false;
+    }
+    uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFFu) - 1;
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index >= m_nodes.size()) {
+            return false;
+        }
+        Node& node = m_nodes[index];
+        if (!node.active || node.generation != generation) {
+            return false;
+        }
+        unlink(index);
+        // Захваченные обработчиком объекты разрушаются вне блокировки
+        callback = std::move(node.callback);
+        release(index);
+        --m_activeCount;
+    }
+    return true;
+}
+
+size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_activeCount;
+}
+
+void TimerWheel::link(uint32_t index) {
+    Node& node = m_nodes[index];
+    uint64_t delta = node.expiryTick - m_currentTick;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    // Слишком дальние таймеры ложатся в последнюю ячейку старшего колеса
+    // и переразмещаются при каждом ее обороте
+    uint64_t position = node.expiryTick;
+    uint64_t maxDelta = (1ull << (SLOT_BITS * LEVELS)) - 1;
+    if (delta > maxDelta) {
+        position = m_currentTick + maxDelta;
+    }
+    uint32_t slot = static_cast<uint32_t>((position >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    node.level = static_cast<uint16_t>(level);
+    node.slot = static_cast<uint16_t>(slot);
+    node.prev = NIL;
+    node.next = m_slots[level][slot];
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[level][slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = m_nodes[index];
+    if (node.prev != NIL) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_slots[node.level][node.slot] = node.next;
+    }
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.prev = NIL;
+    node.next = NIL;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& node = m_nodes[index];
+    node.active = false;
+    ++node.generation;
+    node.next = m_freeHead;
+    m_freeHead = index;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot) {
+    uint32_t index = m_slots[level][slot];
+    m_slots[level][slot] = NIL;
+    while (index != NIL) {
+        uint32_t next = m_nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t targetTick, std::vector<std::function<void()>>& expired) {
+    while (m_currentTick < targetTick) {
+        ++m_currentTick;
+
+        // На границе оборота младшего колеса опускаем таймеры из старших
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((m_currentTick & ((1ull << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level, static_cast<uint32_t>((m_currentTick >> (SLOT_BITS * level)) & (SLOTS - 1)));
+        }
+
+        uint32_t slot = static_cast<uint32_t>(m_currentTick & (SLOTS - 1));
+        uint32_t index = m_slots[0][slot];
+        m_slots[0][slot] = NIL;
+        while (index != NIL) {
+            Node& node = m_nodes[index];
+            uint32_t next = node.next;
+            expired.push_back(std::move(node.callback));
+            node.prev = NIL;
+            node.next = NIL;
+            release(index);
+            --m_activeCount;
+            index = next;
+        }
+
+        // Пустое колесо нет смысла прокручивать по одному тику
+        if (m_activeCount == 0) {
+            m_currentTick = targetTick;
+        }
+    }
+}
+
+void TimerWheel::run() {
+    TRACE_THREAD_NAME("timer-wheel");
+    std::vector<std::function<void()>> expired;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        auto nextTickTime = m_origin + m_tick * static_cast<int64_t>(m_currentTick + 1);
+        m_cv.wait_until(lock, nextTickTime, [this] { return !m_running; });
+        if (!m_running) {
+            break;
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - m_origin;
+        uint64_t targetTick = static_cast<uint64_t>(elapsed / m_tick);
+        advance(targetTick, expired);
+        if (expired.empty()) {
+            continue;
+        }
+
+        lock.unlock();
+        {
+            TRACE_SCOPE("TimerWheel::expire");
+            for (auto& callback : expired) {
+                callback();
+            }
+        }
+        expired.clear();
+        lock.lock();
+    }
+}
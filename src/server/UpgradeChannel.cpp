@@ -0,0 +1,250 @@
+#include "server/UpgradeChannel.h"
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+const size_t HEADER_SIZE = 5;                   ///< Длина (4 байта) и тип записи
+const uint32_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+
+#ifndef _WIN32
+
+bool makeAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+bool sendAll(int channel, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = ::send(channel, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool receiveAll(int channel, char* data, size_t length) {
+    while (length > 0) {
+        ssize_t received = ::recv(channel, data, length, 0);
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+#endif
+
+} // namespace
+
+std::string ConnectionState::serialize() const {
+    std::ostringstream oss;
+    oss << clientId << "|" << userId << "|";
+    return oss.str() + pendingInput;
+}
+
+bool ConnectionState::deserialize(const std::string& data) {
+    size_t first = data.find('|');
+    size_t second = first == std::string::npos ? std::string::npos : data.find('|', first + 1);
+    if (second == std::string::npos) {
+        return false;
+    }
+    try {
+        clientId = std::stoi(data.substr(0, first));
+        userId = std::stoi(data.substr(first + 1, second - first - 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    pendingInput = data.substr(second + 1);
+    return true;
+}
+
+bool UpgradeChannel::isSupported() {
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+#ifdef _WIN32
+
+int UpgradeChannel::listen(const std::string&) { return -1; }
+void UpgradeChannel::closeListener(int, const std::string&) {}
+int UpgradeChannel::accept(int) { return -1; }
+int UpgradeChannel::connect(const std::string&) { return -1; }
+bool UpgradeChannel::send(int, const Record&) { return false; }
+bool UpgradeChannel::receive(int, Record&) { return false; }
+void UpgradeChannel::close(int) {}
+
+#else
+
+int UpgradeChannel::listen(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        return -1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    ::unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listener, 1) < 0) {
+        ::close(listener);
+        return -1;
+    }
+    // Через этот сокет можно забрать все соединения сервера
+    chmod(path.c_str(), S_IRUSR | S_IWUSR);
+    return listener;
+}
+
+void UpgradeChannel::closeListener(int listener, const std::string& path) {
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(path.c_str());
+    }
+}
+
+int UpgradeChannel::accept(int listener) {
+    int channel = ::accept(listener, nullptr, nullptr);
+    if (channel < 0) {
+        return -1;
+    }
+#ifdef SO_PEERCRED
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0 ||
+        credentials.uid != geteuid()) {
+        ::close(channel);
+        return -1;
+    }
+#endif
+    return channel;
+}
+
+int UpgradeChannel::connect(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        return -1;
+    }
+
+    int channel = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (channel < 0) {
+        return -1;
+    }
+    if (::connect(channel, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(channel);
+        return -1;
+    }
+    return channel;
+}
+
+bool UpgradeChannel::send(int channel, const Record& record) {
+    std::string buffer(HEADER_SIZE, '\0');
+    uint32_t length = static_cast<uint32_t>(record.payload.size());
+    std::memcpy(&buffer[0], &length, sizeof(length));
+    buffer[4] = static_cast<char>(record.type);
+    buffer += record.payload;
+
+    iovec iov{};
+    iov.iov_base = &buffer[0];
+    iov.iov_len = buffer.size();
+
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+
+    // Дескриптор прикрепляется к первому байту записи
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    if (record.fd >= 0) {
+        std::memset(control, 0, sizeof(control));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &record.fd, sizeof(int));
+    }
+
+    ssize_t sent = sendmsg(channel, &message, MSG_NOSIGNAL);
+    if (sent <= 0) {
+        return false;
+    }
+    return sendAll(channel, buffer.data() + sent, buffer.size() - static_cast<size_t>(sent));
+}
+
+bool UpgradeChannel::receive(int channel, Record& record) {
+    char header[HEADER_SIZE];
+    iovec iov{};
+    iov.iov_base = header;
+    iov.iov_len = sizeof(header);
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(channel, &message, 0);
+    if (received <= 0) {
+        return false;
+    }
+
+    record.fd = -1;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&record.fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    // Остаток записи читается точно по длине, чтобы не захватить
+    // дескриптор следующей записи обычным recv
+    if (!receiveAll(channel, header + received, sizeof(header) - static_cast<size_t>(received))) {
+        close(record.fd);
+        return false;
+    }
+
+    uint32_t length;
+    std::memcpy(&length, header, sizeof(length));
+    if (length > MAX_RECORD_SIZE) {
+        close(record.fd);
+        return false;
+    }
+    record.type = static_cast<RecordType>(header[4]);
+    record.payload.resize(length);
+    if (length > 0 && !receiveAll(channel, &record.payload[0], length)) {
+        close(record.fd);
+        return false;
+    }
+    return true;
+}
+
+void UpgradeChannel::close(int fd) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+#endif
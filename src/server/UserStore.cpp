@@ -0,0 +1,785 @@
+#include "server/UserStore.h"
+#include "common/Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string_view>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/**
+ * @brief Заголовок файла снимка
+ *
+ * За заголовком следуют: записи пользователей (по возрастанию ID),
+ * индексы записей по возрастанию имени, массив контактов и блок строк.
+ */
+struct UserStore::SnapshotHeader {
+    char magic[8];              ///< Сигнатура файла
+    uint32_t version;           ///< Версия формата
+    int32_t nextUserId;         ///< Следующий ID пользователя
+    uint64_t userCount;         ///< Количество записей
+    uint64_t contactCount;      ///< Размер массива контактов
+    uint64_t stringsSize;       ///< Размер блока строк
+};
+
+/**
+ * @brief Запись пользователя в снимке (фиксированного размера)
+ */
+struct UserStore::SnapshotRecord {
+    int32_t id;                 ///< ID пользователя
+    uint32_t usernameOffset;    ///< Смещение имени в блоке строк
+    uint32_t emailOffset;       ///< Смещение email в блоке строк
+    uint16_t usernameLength;    ///< Длина имени
+    uint16_t emailLength;       ///< Длина email
+    uint32_t contactsIndex;     ///< Первый контакт в массиве контактов
+    uint32_t contactsCount;     ///< Количество контактов
+};
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'C', 'S', 'U', 'S', 'N', 'A', 'P', '1'};
+const uint32_t SNAPSHOT_VERSION = 1;
+const char* const SNAPSHOT_FILE = "users.snapshot";
+const char* const WAL_FILE = "users.wal";
+const size_t WAL_HEADER_SIZE = 5;               ///< Длина данных (4 байта) и тип записи
+const uint32_t MAX_WAL_PAYLOAD = 1024;
+const auto MAINTENANCE_INTERVAL = std::chrono::seconds(1);
+
+/**
+ * @brief CRC-32 (IEEE); значение можно продолжать, передав предыдущий результат
+ */
+uint32_t crc32(const char* data, size_t length, uint32_t previous = 0) {
+    static const auto table = [] {
+        std::vector<uint32_t> values(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            values[i] = value;
+        }
+        return values;
+    }();
+
+    uint32_t crc = previous ^ 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void appendValue(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(const std::string& buffer, size_t& offset, T& value) {
+    if (offset + sizeof(value) > buffer.size()) {
+        return false;
+    }
+    std::memcpy(&value, buffer.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+void appendString(std::string& buffer, const std::string& value) {
+    appendValue(buffer, static_cast<uint16_t>(value.size()));
+    buffer += value;
+}
+
+bool readString(const std::string& buffer, size_t& offset, std::string& value) {
+    uint16_t length;
+    if (!readValue(buffer, offset, length) || offset + length > buffer.size()) {
+        return false;
+    }
+    value.assign(buffer, offset, length);
+    offset += length;
+    return true;
+}
+
+/**
+ * @brief Сброс буферов файла на диск
+ */
+void syncFile(FILE* file) {
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+/**
+ * @brief Сброс на диск записи каталога после переименования файла
+ */
+void syncDirectory(const std::string& directory) {
+#ifndef _WIN32
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)directory;
+#endif
+}
+
+} // namespace
+
+UserStore::UserStore()
+    : m_snapshot(nullptr), m_snapshotSize(0), m_nextUserId(1), m_idOffset(0), m_idStride(1), m_wal(nullptr),
+      m_walRecords(0), m_walDirty(false), m_maintenanceRunning(false) {
+}
+
+UserStore::~UserStore() {
+    close();
+}
+
+bool UserStore::open(const std::string& directory) {
+    close();
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string snapshotPath = directory + "/" + SNAPSHOT_FILE;
+    std::string walPath = directory + "/" + WAL_FILE;
+
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (!mapSnapshot(snapshotPath)) {
+            LOG_ERROR("Файл снимка пользователей ", snapshotPath, " поврежден");
+            return false;
+        }
+        if (!replayWal(walPath)) {
+            LOG_ERROR("Не удалось прочитать журнал пользователей ", walPath);
+            unmapSnapshot();
+            return false;
+        }
+        m_wal = std::fopen(walPath.c_str(), "ab");
+        if (!m_wal) {
+            LOG_ERROR("Не удалось открыть журнал пользователей ", walPath);
+            unmapSnapshot();
+            return false;
+        }
+        m_directory = directory;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        m_maintenanceRunning = true;
+    }
+    m_maintenanceThread = std::thread(&UserStore::maintenanceLoop, this);
+
+    LOG_INFO("Хранилище пользователей открыто: ", userCount(), " пользователей, записей журнала: ",
+             m_walRecords.load());
+    return true;
+}
+
+void UserStore::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        m_maintenanceRunning = false;
+    }
+    m_maintenanceCv.notify_all();
+    if (m_maintenanceThread.joinable()) {
+        m_maintenanceThread.join();
+    }
+
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_wal) {
+        syncFile(m_wal);
+        std::fclose(m_wal);
+        m_wal = nullptr;
+    }
+    if (!m_directory.empty()) {
+        // Состояние остается на диске; в памяти хранилище начинается заново
+        unmapSnapshot();
+        m_addedUsers.clear();
+        m_addedByName.clear();
+        m_changedContacts.clear();
+        m_nextUserId = 1;
+        m_walRecords = 0;
+        m_directory.clear();
+    }
+}
+
+void UserStore::setIdAllocation(int offset, int stride) {
+    m_idStride = std::max(stride, 1);
+    m_idOffset = offset % m_idStride;
+}
+
+int UserStore::addUser(const std::string& username, const std::string& email) {
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    int userId;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (findSnapshotUserId(username) != -1 || m_addedByName.count(username)) {
+            return -1;
+        }
+        userId = m_nextUserId + (m_idOffset - m_nextUserId % m_idStride + m_idStride) % m_idStride;
+    }
+
+    std::string payload;
+    appendValue(payload, static_cast<int32_t>(userId));
+    appendString(payload, username);
+    appendString(payload, email);
+    if (!appendWal(WalRecordType::ADD_USER, payload)) {
+        return -1;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    insertUser(userId, username, email);
+    return userId;
+}
+
+bool UserStore::restoreUser(const UserRecord& record) {
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (userExists(record.id) || findSnapshotUserId(record.username) != -1 ||
+            m_addedByName.count(record.username)) {
+            return false;
+        }
+    }
+
+    std::string payload;
+    appendValue(payload, static_cast<int32_t>(record.id));
+    appendString(payload, record.username);
+    appendString(payload, record.email);
+    if (!appendWal(WalRecordType::ADD_USER, payload)) {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    return insertUser(record.id, record.username, record.email);
+}
+
+bool UserStore::findUser(int userId, UserRecord& record) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_addedUsers.find(userId);
+    if (it != m_addedUsers.end()) {
+        record.id = userId;
+        record.username = it->second.username;
+        record.email = it->second.email;
+        return true;
+    }
+
+    const SnapshotRecord* stored = findSnapshotRecord(userId);
+    if (!stored) {
+        return false;
+    }
+    record.id = userId;
+    record.username = snapshotString(stored->usernameOffset, stored->usernameLength);
+    record.email = snapshotString(stored->emailOffset, stored->emailLength);
+    return true;
+}
+
+int UserStore::findUserId(const std::string& username) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_addedByName.find(username);
+    if (it != m_addedByName.end()) {
+        return it->second;
+    }
+    return findSnapshotUserId(username);
+}
+
+bool UserStore::addContact(int userId, int contactId) {
+    if (userId == contactId) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (!userExists(userId) || !userExists(contactId)) {
+            return false;
+        }
+    }
+
+    std::string payload;
+    appendValue(payload, static_cast<int32_t>(userId));
+    appendValue(payload, static_cast<int32_t>(contactId));
+    if (!appendWal(WalRecordType::ADD_CONTACT, payload)) {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<int>& contacts = mutableContacts(userId);
+    auto position = std::lower_bound(contacts.begin(), contacts.end(), contactId);
+    if (position == contacts.end() || *position != contactId) {
+        contacts.insert(position, contactId);
+    }
+    return true;
+}
+
+bool UserStore::removeContact(int userId, int contactId) {
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        std::vector<int> contacts;
+        auto changed = m_changedContacts.find(userId);
+        if (changed != m_changedContacts.end()) {
+            contacts = changed->second;
+        } else if (const SnapshotRecord* stored = findSnapshotRecord(userId)) {
+            snapshotContacts(*stored, contacts);
+        }
+        if (!std::binary_search(contacts.begin(), contacts.end(), contactId)) {
+            return false;
+        }
+    }
+
+    std::string payload;
+    appendValue(payload, static_cast<int32_t>(userId));
+    appendValue(payload, static_cast<int32_t>(contactId));
+    if (!appendWal(WalRecordType::REMOVE_CONTACT, payload)) {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<int>& contacts = mutableContacts(userId);
+    contacts.erase(std::remove(contacts.begin(), contacts.end(), contactId), contacts.end());
+    return true;
+}
+
+std::vector<int> UserStore::getContacts(int userId) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<int> contacts;
+    auto changed = m_changedContacts.find(userId);
+    if (changed != m_changedContacts.end()) {
+        contacts = changed->second;
+    } else if (const SnapshotRecord* stored = findSnapshotRecord(userId)) {
+        snapshotContacts(*stored, contacts);
+    }
+    return contacts;
+}
+
+size_t UserStore::userCount() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    const SnapshotHeader* header = snapshotHeader();
+    return (header ? static_cast<size_t>(header->userCount) : 0) + m_addedUsers.size();
+}
+
+void UserStore::forEachUser(const std::function<void(const UserRecord&)>& visitor) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    UserRecord record;
+    const SnapshotHeader* header = snapshotHeader();
+    const SnapshotRecord* records = snapshotRecords();
+    for (uint64_t i = 0; header && i < header->userCount; ++i) {
+        record.id = records[i].id;
+        record.username = snapshotString(records[i].usernameOffset, records[i].usernameLength);
+        record.email = snapshotString(records[i].emailOffset, records[i].emailLength);
+        visitor(record);
+    }
+    for (auto& user : m_addedUsers) {
+        record.id = user.first;
+        record.username = user.second.username;
+        record.email = user.second.email;
+        visitor(record);
+    }
+}
+
+bool UserStore::compact() {
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    if (m_directory.empty()) {
+        return false;
+    }
+    std::string snapshotPath = m_directory + "/" + SNAPSHOT_FILE;
+    std::string temporaryPath = snapshotPath + ".tmp";
+    std::string walPath = m_directory + "/" + WAL_FILE;
+
+    // Снимок строится под общей блокировкой: чтение продолжается,
+    // изменения ждут на m_writeMutex
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (!writeSnapshot(temporaryPath)) {
+            LOG_ERROR("Не удалось записать снимок пользователей ", temporaryPath);
+            return false;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, snapshotPath, error);
+    if (error) {
+        LOG_ERROR("Не удалось заменить снимок пользователей: ", error.message());
+        return false;
+    }
+    syncDirectory(m_directory);
+
+    unmapSnapshot();
+    if (!mapSnapshot(snapshotPath)) {
+        LOG_ERROR("Не удалось отобразить новый снимок пользователей");
+        return false;
+    }
+    m_addedUsers.clear();
+    m_addedByName.clear();
+    m_changedContacts.clear();
+
+    // Журнал очищается только после того, как снимок надежно на диске
+    std::fclose(m_wal);
+    m_wal = std::fopen(walPath.c_str(), "wb");
+    m_walRecords = 0;
+    m_walDirty = false;
+    LOG_INFO("Записан снимок пользователей: ", snapshotHeader() ? snapshotHeader()->userCount : 0,
+             " пользователей");
+    return m_wal != nullptr;
+}
+
+bool UserStore::mapSnapshot(const std::string& path) {
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        return true;
+    }
+
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    m_snapshotCopy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_snapshot = m_snapshotCopy.data();
+    m_snapshotSize = m_snapshotCopy.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) < 0) {
+        ::close(fd);
+        return false;
+    }
+    m_snapshotSize = static_cast<size_t>(info.st_size);
+    if (m_snapshotSize > 0) {
+        void* mapping = mmap(nullptr, m_snapshotSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        m_snapshot = mapping == MAP_FAILED ? nullptr : static_cast<const char*>(mapping);
+    }
+    ::close(fd);
+    if (!m_snapshot) {
+        m_snapshotSize = 0;
+        return false;
+    }
+#endif
+
+    // Проверка целостности: сигнатура и точное совпадение размеров частей
+    const SnapshotHeader* header = snapshotHeader();
+    bool valid = m_snapshotSize >= sizeof(SnapshotHeader) &&
+                 header->userCount <= m_snapshotSize && header->contactCount <= m_snapshotSize &&
+                 std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                 header->version == SNAPSHOT_VERSION &&
+                 sizeof(SnapshotHeader) + header->userCount * (sizeof(SnapshotRecord) + sizeof(uint32_t)) +
+                     header->contactCount * sizeof(int32_t) + header->stringsSize == m_snapshotSize;
+    if (!valid) {
+        unmapSnapshot();
+        return false;
+    }
+    m_nextUserId = std::max(m_nextUserId, static_cast<int>(header->nextUserId));
+    return true;
+}
+
+void UserStore::unmapSnapshot() {
+#ifndef _WIN32
+    if (m_snapshot && m_snapshotCopy.empty()) {
+        munmap(const_cast<char*>(m_snapshot), m_snapshotSize);
+    }
+#endif
+    m_snapshotCopy.clear();
+    m_snapshot = nullptr;
+    m_snapshotSize = 0;
+}
+
+const UserStore::SnapshotHeader* UserStore::snapshotHeader() const {
+    return m_snapshot ? reinterpret_cast<const SnapshotHeader*>(m_snapshot) : nullptr;
+}
+
+const UserStore::SnapshotRecord* UserStore::snapshotRecords() const {
+    return m_snapshot ? reinterpret_cast<const SnapshotRecord*>(m_snapshot + sizeof(SnapshotHeader)) : nullptr;
+}
+
+const UserStore::SnapshotRecord* UserStore::findSnapshotRecord(int userId) const {
+    const SnapshotHeader* header = snapshotHeader();
+    if (!header) {
+        return nullptr;
+    }
+    const SnapshotRecord* begin = snapshotRecords();
+    const SnapshotRecord* end = begin + header->userCount;
+    const SnapshotRecord* found = std::lower_bound(begin, end, userId,
+        [](const SnapshotRecord& record, int id) { return record.id < id; });
+    return found != end && found->id == userId ? found : nullptr;
+}
+
+int UserStore::findSnapshotUserId(const std::string& username) const {
+    const SnapshotHeader* header = snapshotHeader();
+    if (!header) {
+        return -1;
+    }
+    const SnapshotRecord* records = snapshotRecords();
+    const uint32_t* begin = reinterpret_cast<const uint32_t*>(records + header->userCount);
+    const uint32_t* end = begin + header->userCount;
+    const char* strings = reinterpret_cast<const char*>(end) + header->contactCount * sizeof(int32_t);
+
+    auto nameOf = [&](uint32_t index) {
+        return std::string_view(strings + records[index].usernameOffset, records[index].usernameLength);
+    };
+    std::string_view name(username);
+    const uint32_t* found = std::lower_bound(begin, end, name,
+        [&](uint32_t index, std::string_view value) { return nameOf(index) < value; });
+    return found != end && nameOf(*found) == name ? records[*found].id : -1;
+}
+
+std::string UserStore::snapshotString(uint32_t offset, uint16_t length) const {
+    const SnapshotHeader* header = snapshotHeader();
+    const char* strings = m_snapshot + m_snapshotSize - header->stringsSize;
+    return std::string(strings + offset, length);
+}
+
+void UserStore::snapshotContacts(const SnapshotRecord& record, std::vector<int>& contacts) const {
+    const SnapshotHeader* header = snapshotHeader();
+    const int32_t* all = reinterpret_cast<const int32_t*>(
+        m_snapshot + sizeof(SnapshotHeader) + header->userCount * (sizeof(SnapshotRecord) + sizeof(uint32_t)));
+    contacts.assign(all + record.contactsIndex, all + record.contactsIndex + record.contactsCount);
+}
+
+bool UserStore::userExists(int userId) const {
+    return m_addedUsers.count(userId) || findSnapshotRecord(userId);
+}
+
+bool UserStore::insertUser(int userId, const std::string& username, const std::string& email) {
+    if (userExists(userId) || m_addedByName.count(username) || findSnapshotUserId(username) != -1) {
+        return false;
+    }
+    m_addedUsers[userId] = AddedUser{username, email};
+    m_addedByName[username] = userId;
+    m_nextUserId = std::max(m_nextUserId, userId + 1);
+    return true;
+}
+
+std::vector<int>& UserStore::mutableContacts(int userId) {
+    auto it = m_changedContacts.find(userId);
+    if (it != m_changedContacts.end()) {
+        return it->second;
+    }
+    // Первое изменение копирует контакты из снимка в слой изменений
+    std::vector<int>& contacts = m_changedContacts[userId];
+    if (const SnapshotRecord* stored = findSnapshotRecord(userId)) {
+        snapshotContacts(*stored, contacts);
+    }
+    return contacts;
+}
+
+bool UserStore::replayWal(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return true;
+    }
+
+    size_t validSize = 0;
+    size_t records = 0;
+    std::string payload;
+    while (true) {
+        char header[WAL_HEADER_SIZE];
+        if (std::fread(header, 1, sizeof(header), file) != sizeof(header)) {
+            break;
+        }
+        uint32_t length;
+        std::memcpy(&length, header, sizeof(length));
+        if (length > MAX_WAL_PAYLOAD) {
+            break;
+        }
+        payload.resize(length);
+        uint32_t storedCrc;
+        if (std::fread(&payload[0], 1, length, file) != length ||
+            std::fread(&storedCrc, 1, sizeof(storedCrc), file) != sizeof(storedCrc) ||
+            storedCrc != crc32(payload.data(), payload.size(), crc32(header + 4, 1))) {
+            break;
+        }
+
+        // Воспроизведение идемпотентно: запись, уже вошедшая в снимок, ничего не меняет
+        size_t offset = 0;
+        int32_t userId;
+        int32_t otherId;
+        std::string username;
+        std::string email;
+        switch (static_cast<WalRecordType>(header[4])) {
+            case WalRecordType::ADD_USER:
+                if (readValue(payload, offset, userId) && readString(payload, offset, username) &&
+                    readString(payload, offset, email)) {
+                    insertUser(userId, username, email);
+                }
+                break;
+            case WalRecordType::ADD_CONTACT:
+                if (readValue(payload, offset, userId) && readValue(payload, offset, otherId) &&
+                    userExists(userId) && userExists(otherId)) {
+                    std::vector<int>& contacts = mutableContacts(userId);
+                    auto position = std::lower_bound(contacts.begin(), contacts.end(), otherId);
+                    if (position == contacts.end() || *position != otherId) {
+                        contacts.insert(position, otherId);
+                    }
+                }
+                break;
+            case WalRecordType::REMOVE_CONTACT:
+                if (readValue(payload, offset, userId) && readValue(payload, offset, otherId)) {
+                    std::vector<int>& contacts = mutableContacts(userId);
+                    contacts.erase(std::remove(contacts.begin(), contacts.end(), otherId), contacts.end());
+                }
+                break;
+        }
+        validSize += sizeof(header) + length + sizeof(storedCrc);
+        ++records;
+    }
+    std::fclose(file);
+
+    // Оборванная последняя запись (сбой во время записи) отбрасывается
+    std::error_code error;
+    if (std::filesystem::file_size(path, error) != validSize && !error) {
+        LOG_WARNING("Журнал пользователей обрезан до последней целой записи");
+        std::filesystem::resize_file(path, validSize, error);
+    }
+    m_walRecords = records;
+    return !error;
+}
+
+bool UserStore::appendWal(WalRecordType type, const std::string& payload) {
+    if (!m_wal) {
+        return true;
+    }
+
+    std::string record;
+    appendValue(record, static_cast<uint32_t>(payload.size()));
+    record.push_back(static_cast<char>(type));
+    record += payload;
+    appendValue(record, crc32(record.data() + 4, record.size() - 4));
+
+    // Запись уходит в ядро сразу и переживает падение процесса;
+    // на диск ее сбрасывает фоновый поток
+    if (std::fwrite(record.data(), 1, record.size(), m_wal) != record.size() || std::fflush(m_wal) != 0) {
+        LOG_ERROR("Ошибка записи журнала пользователей");
+        return false;
+    }
+    ++m_walRecords;
+    m_walDirty = true;
+    return true;
+}
+
+bool UserStore::writeSnapshot(const std::string& path) const {
+    const SnapshotHeader* oldHeader = snapshotHeader();
+    const SnapshotRecord* oldRecords = snapshotRecords();
+    size_t oldCount = oldHeader ? static_cast<size_t>(oldHeader->userCount) : 0;
+
+    std::vector<int> addedIds;
+    addedIds.reserve(m_addedUsers.size());
+    for (auto& user : m_addedUsers) {
+        addedIds.push_back(user.first);
+    }
+    std::sort(addedIds.begin(), addedIds.end());
+
+    std::vector<SnapshotRecord> records;
+    records.reserve(oldCount + addedIds.size());
+    std::vector<int32_t> contacts;
+    std::string strings;
+    std::vector<int> userContacts;
+
+    auto appendUser = [&](int userId, const std::string& username, const std::string& email,
+                          const SnapshotRecord* stored) {
+        SnapshotRecord record{};
+        record.id = userId;
+        record.usernameOffset = static_cast<uint32_t>(strings.size());
+        record.usernameLength = static_cast<uint16_t>(username.size());
+        strings += username;
+        record.emailOffset = static_cast<uint32_t>(strings.size());
+        record.emailLength = static_cast<uint16_t>(email.size());
+        strings += email;
+
+        auto changed = m_changedContacts.find(userId);
+        if (changed != m_changedContacts.end()) {
+            userContacts = changed->second;
+        } else if (stored) {
+            snapshotContacts(*stored, userContacts);
+        } else {
+            userContacts.clear();
+        }
+        record.contactsIndex = static_cast<uint32_t>(contacts.size());
+        record.contactsCount = static_cast<uint32_t>(userContacts.size());
+        contacts.insert(contacts.end(), userContacts.begin(), userContacts.end());
+        records.push_back(record);
+    };
+
+    // Слияние отсортированных записей снимка и добавленных пользователей
+    size_t oldIndex = 0;
+    size_t addedIndex = 0;
+    while (oldIndex < oldCount || addedIndex < addedIds.size()) {
+        bool takeOld = addedIndex == addedIds.size() ||
+                       (oldIndex < oldCount && oldRecords[oldIndex].id < addedIds[addedIndex]);
+        if (takeOld) {
+            const SnapshotRecord& stored = oldRecords[oldIndex++];
+            appendUser(stored.id, snapshotString(stored.usernameOffset, stored.usernameLength),
+                       snapshotString(stored.emailOffset, stored.emailLength), &stored);
+        } else {
+            int userId = addedIds[addedIndex++];
+            const AddedUser& added = m_addedUsers.at(userId);
+            appendUser(userId, added.username, added.email, nullptr);
+        }
+    }
+    if (strings.size() > UINT32_MAX || contacts.size() > UINT32_MAX) {
+        return false;
+    }
+
+    std::vector<uint32_t> byName(records.size());
+    std::iota(byName.begin(), byName.end(), 0u);
+    auto nameOf = [&](uint32_t index) {
+        return std::string_view(strings.data() + records[index].usernameOffset, records[index].usernameLength);
+    };
+    std::sort(byName.begin(), byName.end(), [&](uint32_t a, uint32_t b) { return nameOf(a) < nameOf(b); });
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.nextUserId = m_nextUserId;
+    header.userCount = records.size();
+    header.contactCount = contacts.size();
+    header.stringsSize = strings.size();
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(records.data(), sizeof(SnapshotRecord), records.size(), file) == records.size() &&
+                   std::fwrite(byName.data(), sizeof(uint32_t), byName.size(), file) == byName.size() &&
+                   std::fwrite(contacts.data(), sizeof(int32_t), contacts.size(), file) == contacts.size() &&
+                   std::fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+    syncFile(file);
+    std::fclose(file);
+    return written;
+}
+
+void UserStore::maintenanceLoop() {
+    std::unique_lock<std::mutex> lock(m_maintenanceMutex);
+    while (m_maintenanceRunning) {
+        m_maintenanceCv.wait_for(lock, MAINTENANCE_INTERVAL);
+        if (!m_maintenanceRunning) {
+            break;
+        }
+        lock.unlock();
+
+        // Групповой сброс журнала на диск вместо fsync на каждую запись
+        if (m_walDirty.exchange(false)) {
+            std::lock_guard<std::mutex> writeLock(m_writeMutex);
+            if (m_wal) {
+                syncFile(m_wal);
+            }
+        }
+        if (m_walRecords.load() >= COMPACTION_THRESHOLD) {
+            compact();
+        }
+
+        lock.lock();
+    }
+}
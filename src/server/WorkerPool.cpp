@@ -0,0 +1,120 @@
+#include "server/WorkerPool.h"
+#include "common/Logger.h"
+#include "common/Trace.h"
+#include "server/CpuTopology.h"
+#include <algorithm>
+#include <string>
+
+WorkerPool::Task& WorkerPool::Task::operator=(Task&& other) noexcept {
+    if (this != &other) {
+        reset();
+        if (other.m_ops) {
+            other.m_ops->move(other.m_storage, m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+    return *this;
+}
+
+void WorkerPool::Task::reset() noexcept {
+    if (m_ops) {
+        m_ops->destroy(m_storage);
+        m_ops = nullptr;
+    }
+}
+
+WorkerPool::WorkerPool(size_t threadCount, size_t maxQueueSize)
+    : m_maxQueueSize(maxQueueSize), m_queued(0), m_running(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->thread = std::thread(&WorkerPool::workerLoop, this, std::ref(*m_workers[i]), i);
+    }
+}
+
+void WorkerPool::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    for (auto& worker : m_workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->cv.notify_all();
+    }
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+bool WorkerPool::submit(size_t key, Task task) {
+    Worker& worker = *m_workers[key % m_workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!m_running || worker.count >= m_maxQueueSize) {
+            return false;
+        }
+        if (worker.count == worker.tasks.size()) {
+            // Кольцо растет вдвое и не сжимается: после разогрева память не выделяется
+            std::vector<Task> grown(std::min(m_maxQueueSize, std::max<size_t>(16, worker.tasks.size() * 2)));
+            for (size_t i = 0; i < worker.count; ++i) {
+                grown[i] = std::move(worker.tasks[(worker.head + i) % worker.tasks.size()]);
+            }
+            worker.tasks.swap(grown);
+            worker.head = 0;
+        }
+        worker.tasks[(worker.head + worker.count) % worker.tasks.size()] = std::move(task);
+        ++worker.count;
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    worker.cv.notify_one();
+    return true;
+}
+
+void WorkerPool::workerLoop(Worker& worker, size_t index) {
+    TRACE_THREAD_NAME("worker-" + std::to_string(index));
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    if (!m_cpus.empty()) {
+        int cpu = m_cpus[index % m_cpus.size()];
+        if (!CpuTopology::pinCurrentThread({cpu})) {
+            LOG_WARNING("Рабочий поток ", index, " не закреплен за процессором ", cpu);
+        } else if (worker.count == 0) {
+            // Кольцо, записанное закрепленным потоком, размещается на его узле;
+            // полная емкость избавляет от роста в потоке, ставящем задачи
+            std::vector<Task>(m_maxQueueSize).swap(worker.tasks);
+            worker.head = 0;
+        }
+    }
+    while (true) {
+        worker.cv.wait(lock, [&] { return worker.count > 0 || !m_running; });
+        if (worker.count == 0) {
+            break;
+        }
+
+        Task task = std::move(worker.tasks[worker.head]);
+        worker.head = (worker.head + 1) % worker.tasks.size();
+        --worker.count;
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
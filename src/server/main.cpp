@@ -1,58 +1,248 @@
 #include "server/Server.h"
+#include "common/Logger.h"
+#include "common/Trace.h"
+#include <charconv>
+#include <cstring>
+#include <string>
 #include <iostream>
 #include <signal.h>
 #include <thread>
+#include <vector>
 #include <chrono>
+#include <csignal>
 
 // Глобальная переменная для сервера
 std::unique_ptr<Server> g_server;
 
-// Обработчик сигналов для корректного завершения
+// Запрос завершения (SIGINT, SIGTERM): обработчик только выставляет флаг,
+// остановка сервера и журнала выполняется в основном цикле
+volatile std::sig_atomic_t g_stopSignal = 0;
+
 void signalHandler(int signal) {
-    std::cout << "\nПолучен сигнал " << signal << ". Завершение работы сервера..." << std::endl;
-    if (g_server) {
-        g_server->stop();
+    g_stopSignal = signal;
+}
+
+// Запрос перечитать файл настроек (SIGHUP)
+volatile std::sig_atomic_t g_reloadRequested = 0;
+
+void reloadHandler(int) {
+    g_reloadRequested = 1;
+}
+
+// Настройки из файла (если задан) с параметрами командной строки поверх
+bool loadConfig(const std::string& path, const std::vector<std::string>& overrides,
+                ServerConfig& config, std::string& error) {
+    config = ServerConfig();
+    if (!path.empty() && !config.load(path, error)) {
+        return false;
     }
-    exit(0);
+    for (const auto& assignment : overrides) {
+        if (!config.set(assignment, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Остановка фоновых потоков перед выходом из main (после запуска журнала)
+int finishMain(int exitCode) {
+#ifdef ENABLE_TRACING
+    Trace::stopDumpWatcher();
+#endif
+    Logger::stop();
+    return exitCode;
 }
 
-int main() {
+// Целое значение параметра: строка целиком, в пределах [minimum, maximum]
+bool parseNumber(const char* text, int minimum, int maximum, int& value) {
+    const char* end = text + std::strlen(text);
+    int number = 0;
+    auto result = std::from_chars(text, end, number);
+    if (result.ec != std::errc() || result.ptr != end || number < minimum || number > maximum) {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+// Справка по параметрам командной строки
+void printUsage(const char* program) {
+    std::cerr << "Использование: " << program << " [--config файл] [--set ключ=значение]... [--port порт]\n"
+              << "    [--log-file файл] [--log-level уровень] [--data-dir каталог] [--listen адрес]...\n"
+              << "    [--node-id N] [--cluster-port порт] [--peer хост:порт]...\n"
+              << "    [--upgrade-socket путь] [--takeover путь]" << std::endl;
+}
+
+#ifdef ENABLE_TRACING
+// Обработчик сигнала выгрузки трассы: только выставляет флаг
+void traceDumpHandler(int) {
+    Trace::requestDump();
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    std::string logFile;
+    Logger::Level logLevel = Logger::Level::INFO;
+    std::string upgradeSocket;
+    std::string takeoverSocket;
+    std::string dataDirectory;
+    std::string configFile;
+    std::vector<std::string> overrides;
+    ClusterSettings cluster;
+    std::vector<std::string> listenAddresses;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "-h" || option == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Не задано значение параметра " << option << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        bool valid = true;
+        if (option == "--log-file") {
+            logFile = argv[i + 1];
+        } else if (option == "--log-level") {
+            logLevel = Logger::stringToLevel(argv[i + 1]);
+        } else if (option == "--upgrade-socket") {
+            upgradeSocket = argv[i + 1];
+        } else if (option == "--takeover") {
+            takeoverSocket = argv[i + 1];
+        } else if (option == "--data-dir") {
+            dataDirectory = argv[i + 1];
+        } else if (option == "--config") {
+            configFile = argv[i + 1];
+        } else if (option == "--set") {
+            // --set ключ=значение (повторяется): параметр поверх файла настроек
+            overrides.push_back(argv[i + 1]);
+        } else if (option == "--port") {
+            overrides.push_back(std::string("port=") + argv[i + 1]);
+        } else if (option == "--node-id") {
+            valid = parseNumber(argv[i + 1], 0, Cluster::MAX_NODES - 1, cluster.nodeId);
+        } else if (option == "--cluster-port") {
+            valid = parseNumber(argv[i + 1], 1, 65535, cluster.port);
+        } else if (option == "--peer") {
+            cluster.peers.push_back(argv[i + 1]);
+        } else if (option == "--listen") {
+            listenAddresses.push_back(argv[i + 1]);
+        } else {
+            std::cerr << "Неизвестный параметр " << option << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "Неверное значение параметра " << option << ": " << argv[i + 1] << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    ServerConfig config;
+    std::string configError;
+    if (!loadConfig(configFile, overrides, config, configError)) {
+        std::cerr << "Ошибка настроек: " << configError << std::endl;
+        return 1;
+    }
+    
     // Установка обработчиков сигналов
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+#ifdef SIGHUP
+    // kill -HUP <pid> перечитывает файл настроек и применяет допустимые изменения
+    signal(SIGHUP, reloadHandler);
+#endif
+#if defined(ENABLE_TRACING) && defined(SIGUSR1)
+    // kill -USR1 <pid> сохраняет трассу в server-trace-<pid>-<N>.json
+    signal(SIGUSR1, traceDumpHandler);
+#endif
     
     std::cout << "=== Сервер клиент-серверного приложения ===" << std::endl;
     std::cout << "Автор: Эдуард" << std::endl;
     std::cout << "Версия: 1.0" << std::endl;
     std::cout << "===========================================" << std::endl;
     
-    // Создание и запуск сервера
-    g_server = std::make_unique<Server>(8080);
-    
-    if (!g_server->start()) {
-        std::cerr << "Не удалось запустить сервер" << std::endl;
+    // Журнал пишется фоновым потоком, чтобы не тормозить обработку сообщений
+    if (!Logger::start(logFile, logLevel)) {
+        std::cerr << "Не удалось открыть файл журнала " << logFile << std::endl;
         return 1;
     }
+#ifdef ENABLE_TRACING
+    // Поток выгрузки пишет в журнал, поэтому запускается после него
+    Trace::startDumpWatcher("server-trace");
+#endif
     
-    // Установка обработчика сообщений
+    // Создание и запуск сервера
+    g_server = std::make_unique<Server>(config);
+    
+    // Установка обработчика сообщений (до запуска: переданные соединения читаются сразу)
     g_server->setMessageHandler([](int clientId, const Message& message) {
-        std::cout << "Получено сообщение от клиента " << clientId 
-                  << ": " << message.getContent() << std::endl;
+        LOG_INFO("Получено сообщение от клиента ", clientId, ": ", message.getContent(),
+                 " (задержка до сервера ", (message.getServerReceiveNs() - message.getTimestampNs()) / 1000, " мкс)");
     });
     
+    // --data-dir: пользователи и контакты сохраняются между запусками
+    if (!dataDirectory.empty()) {
+        g_server->setDataDirectory(dataDirectory);
+    }
+    
+    // --listen unix:/путь (повторяется): дополнительные адреса, например для локальных клиентов
+    for (const auto& address : listenAddresses) {
+        if (!g_server->addListenAddress(address)) {
+            std::cerr << "Неверный адрес " << address << std::endl;
+            return finishMain(1);
+        }
+    }
+    
+    // --node-id, --cluster-port, --peer хост:порт (повторяется): режим кластера
+    if (cluster.nodeId != 0) {
+        g_server->setCluster(cluster);
+    }
+    
+    // --upgrade-socket: следующая версия сервера сможет забрать соединения через этот сокет;
+    // --takeover: забрать соединения у работающего сервера вместо открытия порта
+    if (!upgradeSocket.empty()) {
+        g_server->enableHotUpgrade(upgradeSocket);
+    }
+    bool started = takeoverSocket.empty() ? g_server->start() : g_server->takeOver(takeoverSocket);
+    if (!started) {
+        LOG_ERROR("Не удалось запустить сервер");
+        return finishMain(1);
+    }
+    
     std::cout << "Сервер работает. Нажмите Ctrl+C для завершения." << std::endl;
     
     // Основной цикл сервера
     while (g_server->isRunning()) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        
+        if (g_stopSignal) {
+            std::cout << "\nПолучен сигнал " << g_stopSignal << ". Завершение работы сервера..." << std::endl;
+            g_server->stop();
+            break;
+        }
+        
+        if (g_reloadRequested) {
+            g_reloadRequested = 0;
+            if (loadConfig(configFile, overrides, config, configError)) {
+                g_server->applyConfig(config);
+            } else {
+                LOG_ERROR("Настройки не перечитаны: ", configError);
+            }
+        }
         
         // Вывод статистики каждые 10 секунд
         static int counter = 0;
-        if (++counter >= 10) {
-            std::cout << "Активных подключений: " << g_server->getClientCount() << std::endl;
+        if (++counter >= 100) {
+            LOG_INFO("Активных подключений: ", g_server->getClientCount());
             counter = 0;
         }
     }
     
-    return 0;
+    if (g_server->isHandedOff()) {
+        LOG_INFO("Соединения переданы новому процессу, завершение работы");
+    }
+    g_server.reset();
+    return finishMain(0);
 }